@@ -0,0 +1,39 @@
+/*
+  oo-eventlog - binary event log format (see oo-eventlog.c, osdp-eventlog.c)
+
+  a header, then one record per event in the order they happened.  a
+  record is a fixed part with the event and when it happened followed by
+  its fields.  a field is a type octet and then the value.  native byte
+  order.  osdp-eventlog renders the records as the text log would have had
+  them.
+*/
+
+#define OO_EVLOG_MAGIC      "OOEVLOG1"
+#define OO_EVLOG_FIELDS_MAX (4096) // octets of fields in one record
+
+// field types, as used in the fields argument to oo_eventlog
+
+#define OO_EVLOG_FIELD_OCTET  'b' // 1 octet
+#define OO_EVLOG_FIELD_SHORT  'h' // 2 octets
+#define OO_EVLOG_FIELD_INT    'u' // 4 octets
+#define OO_EVLOG_FIELD_OCTETS 'x' // 2 octet length then the octets
+#define OO_EVLOG_FIELD_STRING 's' // 2 octet length then the characters, no null
+
+typedef struct oo_evlog_header
+{
+  char magic [8];
+  int role; // OSDP_ROLE_... of the process that wrote it
+  int pid;
+  long long started_sec;
+  unsigned int reserved [4];
+} OO_EVLOG_HEADER;
+
+typedef struct oo_evlog_record
+{
+  unsigned char event; // OO_EVLOG_...
+  unsigned char verbosity; // when it was logged
+  unsigned short length; // of the fields that follow
+  unsigned int time_nsec;
+  long long time_sec;
+} OO_EVLOG_RECORD;
+
@@ -17,6 +17,7 @@
 */
 
 
+#include <sys/select.h>
 #include <termios.h>
 #include <time.h>
 
@@ -37,6 +38,10 @@
 
 #define OSDP_EXCLUSIVITY_LOCK "osdp-lock"
 #define OSDP_SAVED_PARAMETERS    "osdp-saved-parameters.json"
+#define OSDP_SAVED_CREDENTIALS   "osdp-saved-credentials.json"
+#define OSDP_CONFIG_SNAPSHOT     "osdp-config-snapshot.bin"
+#define OO_SNAPSHOT_CONFIG (1) // parameters file
+#define OO_SNAPSHOT_SAVED  (2) // saved parameters and credentials
 #define OSDP_TRACE_FILE       "current.osdpcap"
 #define OSDP_STAT_FILE        "osdp-status.json"
 
@@ -224,6 +229,8 @@
 #define OSDP_CMDB_MFGREP            (1056)
 #define OSDP_CMDB_INPUT_STATUS      (1057)
 #define OSDP_CMDB_REACT             (1058)
+#define OSDP_CMDB_FLEET_TRANSFER    (1059)
+#define OSDP_CMDB_PD_EVENTS         (1060)
 
 #define OSDP_CMD_NOOP         (0)
 
@@ -410,6 +417,69 @@ typedef struct osdp_timer
 #define OSDP_TIMER_IO             (5)
 #define OSDP_TIMER_SERIAL_READ    (6)
 
+// response latency histograms (see oo-latency.c)
+
+#define OSDP_LATENCY_SUB_BITS      (3)
+#define OSDP_LATENCY_SUB_BUCKETS   (1 << OSDP_LATENCY_SUB_BITS)
+#define OSDP_LATENCY_BUCKETS       (192) // up to about 33 seconds
+#define OSDP_LATENCY_COMMANDS_MAX  (32)
+
+typedef struct osdp_latency_histogram
+{
+  unsigned int count;
+  unsigned long long min_usec;
+  unsigned long long max_usec;
+  unsigned long long total_usec;
+  unsigned int bucket [OSDP_LATENCY_BUCKETS];
+} OSDP_LATENCY_HISTOGRAM;
+
+typedef struct osdp_latency_stats
+{
+  int in_use;
+  int command;
+  OSDP_LATENCY_HISTOGRAM first_octet;    // end of transmit to first octet
+  OSDP_LATENCY_HISTOGRAM complete_frame; // end of transmit to whole response
+} OSDP_LATENCY_STATS;
+
+typedef struct osdp_latency_pending
+{
+  int state;
+  int command;
+  struct timespec transmit_done;
+  struct timespec first_octet;
+} OSDP_LATENCY_PENDING;
+#define OSDP_LATENCY_IDLE           (0)
+#define OSDP_LATENCY_AWAITING_OCTET (1)
+#define OSDP_LATENCY_AWAITING_FRAME (2)
+
+#define OO_METRICS_SNAPSHOT_MAX (128*1024)
+#define OO_METRICS_CLIENTS_MAX   (4)    // scrapes answered at once
+#define OO_METRICS_REQUEST_MSEC  (100)  // answer a scraper that sends no request after this
+#define OO_METRICS_DEADLINE_MSEC (2000) // drop a scrape not done by then
+#define OO_METRICS_READING       (1)
+#define OO_METRICS_WRITING       (2)
+
+typedef struct oo_metrics_client
+{
+  int fd; // -1 if the slot is free
+  int state; // OO_METRICS_READING, then OO_METRICS_WRITING
+  struct timespec accepted; // CLOCK_MONOTONIC
+  char request [2048];
+  int request_length;
+  char *response; // header and the snapshot as it was when the request was in
+  int response_length;
+  int response_sent;
+} OO_METRICS_CLIENT;
+
+
+#define OO_SHA256_OCTETS (32)
+typedef struct oo_sha256_ctx
+{
+  unsigned int state [8];
+  unsigned long long length;
+  unsigned char block [64];
+  size_t fill;
+} OO_SHA256_CTX;
 
 typedef struct osdp_context_filetransfer
 {
@@ -418,13 +488,67 @@ typedef struct osdp_context_filetransfer
   unsigned int total_sent;
   unsigned short int current_send_length;
   char filename [1024];
-  FILE *xferf;
+  unsigned char *source; // ACU: file being sent, mapped read-only
+  size_t source_length;
   int state; // state=0 no transfer state=1 transferring state=2 finishing
   int file_transfer_type;
+
+  // fragment plan (see oo_filetransfer_plan)
+  int plan_message_max;
+  int plan_secure;
+  int plan_fragment_size;
+  unsigned int plan_fragments;
+
+  // ACU pacing and fragment size control (see oo_filetransfer_adapt)
+  int adapt_message_max; // message size in use, at most the PD's limit
+  int adapt_clean_run; // fragments acknowledged since the last size change
+  int adapt_crc_errs; // crc_errs when the last fragment went out
+  int adapt_failures; // consecutive fragments that had to be resent
+  int adapt_pending; // a fragment is waiting for pace_until
+  unsigned int acked_offset; // the PD has confirmed everything before this
+  unsigned int retransmits;
+  unsigned long long srtt_usec; // smoothed fragment round trip at this size
+  struct timespec pace_until; // FtDelay from the last osdp_FTSTAT
+  struct timespec fragment_sent;
+  struct timespec started;
+
+  // checkpoint for resuming an interrupted transfer
+  unsigned char source_hash [OO_SHA256_OCTETS]; // ACU: identifies the file
+  unsigned int checkpoint_offset; // ACU: offset last written to the checkpoint
+  unsigned int resumed_offset; // ACU: where this attempt started
+  int checkpoint_discard; // ACU: the PD refused the transfer, start over next time
+
+  // fleet transfer (see oo-fleet.c)
+  int source_shared; // ACU: the mapping belongs to the fleet, do not unmap it
+  int delivered; // ACU: the last transfer sent the whole file
+
+  // PD receive (see oo-receive.c)
+  int receive_fd; // PD: file being received, if receive_open
+  int receive_open;
+  FILE *receive_stream; // PD: pipe to the receive-pipe command, NULL if none
+  OO_SHA256_CTX receive_hash; // PD: everything received so far, in order
+  char receive_sha256 [2*OO_SHA256_OCTETS+1]; // PD: hash of the last complete file
 } OSDP_CONTEXT_FILETRANSFER;
 #define OSDP_XFER_STATE_IDLE         (0)
 #define OSDP_XFER_STATE_TRANSFERRING (1)
 #define OSDP_XFER_STATE_FINISHING    (2)
+#define OO_FT_ADAPT_ACK     (0)
+#define OO_FT_ADAPT_NAK     (1)
+#define OO_FT_ADAPT_CRC     (2)
+#define OO_FT_ADAPT_TIMEOUT (3)
+#define OO_FT_ADAPT_OTHER   (4) // answered with something other than osdp_FTSTAT
+#define OO_FT_MESSAGE_MIN   (64)  // smallest osdp_FILETRANSFER message after backing off
+#define OO_FT_GROW_AFTER    (8)   // clean fragments before trying a larger one
+#define OO_FT_GROW_STEP     (128) // octets added to the message each time it grows
+#define OO_FT_RETRY_MAX     (8)   // consecutive resends before giving up
+#define OO_FT_CHECKPOINT_OCTETS (4096) // acknowledged progress between checkpoints
+#define OO_FT_CHECKPOINT_FILE   "osdp-transfer-%02X.json" // per PD address, ACU side
+#define OO_FT_PARTIAL_FILE      "./incoming_data.partial" // PD side
+#define OO_FLEET_PD_MAX     (32) // PD's in one fleet transfer, transfer and poll-only
+#define OO_FLEET_IDLE       (0)  // polled only
+#define OO_FLEET_ACTIVE     (1)
+#define OO_FLEET_DONE       (2)
+#define OO_FLEET_FAILED     (3)
 //#define OSDP_FILETRANSFER_STATUS_OK           ( 0) // "OK to proceed"
 //#define OSDP_FILETRANSFER_STATUS_UNACCEPTABLE (-3) // "file data unacceptable or malformed"
 
@@ -445,6 +569,31 @@ typedef struct osdp_command_queue
   OSDP_COMMAND cmd;
 } OSDP_COMMAND_QUEUE;
 
+// log levels (see oo_log_levels in oo-logmsg.c)
+//
+// each category has its own level, set from verbosity and then from the
+// "log-levels" setting.  a message at level n is shown if the category's
+// level is n or more; "verbosity > 3" is level 4.  OO_LOG_MAX can be set
+// at build time (e.g. -DOO_LOG_MAX=3) to compile out everything above it.
+// a disabled message is one comparison, its arguments are not evaluated.
+
+#ifndef OO_LOG_MAX
+#define OO_LOG_MAX (255)
+#endif
+#define OO_LOG_IO           (0) // reading and writing the line, tracing
+#define OO_LOG_PARSE        (1) // frame headers, payload dumps
+#define OO_LOG_SECURE       (2) // secure channel keys, cryptograms, MACs
+#define OO_LOG_FILETRANSFER (3)
+#define OO_LOG_CONFORMANCE  (4)
+#define OO_LOG_CATEGORIES   (5)
+
+#define OO_LOG_ON(ctx,category,level) \
+  (((level) <= OO_LOG_MAX) && ((ctx)->log_level [category] >= (level)))
+#define OO_LOG(ctx,category,level,...) \
+  do { if (OO_LOG_ON (ctx, category, level)) fprintf ((ctx)->log, __VA_ARGS__); } while (0)
+#define OO_LOG_DUMP(ctx,category,level,tag,buffer,length) \
+  do { if (OO_LOG_ON (ctx, category, level)) dump_buffer_log (ctx, tag, buffer, length); } while (0)
+
 // poll enable values (see context->enable_poll)
 
 #define OO_POLL_ENABLED (1) // normal polling
@@ -458,6 +607,30 @@ typedef struct osdp_command_queue
 
 #define VERBOSITY_OVERRIDE_1 (0x01)
 
+// line transports (see oo-transport.c)
+
+#define OSDP_TRANSPORT_SERIAL     (0)
+#define OSDP_TRANSPORT_TCP_CLIENT (1)
+#define OSDP_TRANSPORT_TCP_SERVER (2)
+#define OSDP_TRANSPORT_TLS_CLIENT (3)
+#define OSDP_TRANSPORT_TLS_SERVER (4)
+#define OO_TRANSPORT_RETRY_MIN_MSEC (100)  // client reconnect backoff, first
+#define OO_TRANSPORT_RETRY_MAX_MSEC (5000) // and longest
+#define OO_TRANSPORT_OUTPUT_MAX     (32*1024) // stream output waiting for the socket, at most
+
+struct osdp_context;
+typedef struct osdp_transport
+{
+  int transport_type;
+  char *name;
+  int (*t_open) (struct osdp_context *ctx, char *device);
+  int (*t_read) (struct osdp_context *ctx, unsigned char *buffer, int buffer_max);
+  int (*t_write) (struct osdp_context *ctx, unsigned char *buffer, int lth);
+  int (*t_close) (struct osdp_context *ctx);
+  int (*t_pending) (struct osdp_context *ctx); // NULL if nothing is buffered above the fd
+  int (*t_flush) (struct osdp_context *ctx); // NULL if writes are never queued
+} OSDP_TRANSPORT;
+
 typedef struct osdp_context
 {
   int process_lock; // file handle to exclusivity lock
@@ -469,16 +642,17 @@ typedef struct osdp_context
   int enable_secure_channel; // 1=yes, 2=yes and use default, 0=disabled
   int enable_poll; // usuall 1 for enable, 0=disable
   int post_command_action; // for stop-after-filetransfer or stop-after-timeout
-  char fqdn [1024];
-  char log_path [1024];
-  char serial_speed [1024];
   int trace; // 0=disabled 1=enabled
+  int recorder_manual; // 1 to dump the flight recorder only when asked
+  int recorder_frames; // frames the flight recorder keeps, 0 for none
+  int events_sink; // ACU: 1 to take pd-events card and keypad events as such (see oo-events.c)
   int verbosity;
+  int log_level [OO_LOG_CATEGORIES]; // per category, see OO_LOG_ON
   unsigned int verbosity_override;
   int pii_display;
   unsigned char my_guid [128/8];
   int pd_filetransfer_payload;
-  char service_root [1024];
+  int (*receive_sink) (struct osdp_context *ctx, unsigned char *data, int length, unsigned int offset);
 
   OSDP_COMMAND_QUEUE *q;
   int cmd_q_overflow;
@@ -489,9 +663,15 @@ typedef struct osdp_context
   // IO context
   int current_pid;
   int fd;
+  int transport_type; // OSDP_TRANSPORT_...
+  OSDP_TRANSPORT *transport;
   FILE *log;
-  char network_address [1024];
+  FILE *event_log; // binary event log, NULL if not in use (see oo-eventlog.c)
   int listen_sap;
+  int metrics_fd; // listener for the metrics endpoint, -1 if none
+  int monitor_fd; // wakeup from the monitor capture thread, -1 if not running
+  int startup_profile; // report per-phase startup times at the first poll
+  int metrics_port; // TCP port on 127.0.0.1 for metrics, 0 if none
   FILE *report;
   struct termios tio;
 
@@ -499,10 +679,9 @@ typedef struct osdp_context
   int current_menu;
 
   // CP and PD context
-  OSDP_LED_STATE led [OSDP_MAX_LED];
   int pd_address; // the pd to whom we are speaking
+  unsigned char emulate [128/8]; // PD: one bit per address answered, if more than one (see oo-emulator.c)
   int role;
-  char text [OSDP_OFFICIAL_MSG_MAX];
   unsigned char this_message_addr;
 //  unsigned char MFG_oui [3];
   int last_was_processed;
@@ -519,11 +698,11 @@ typedef struct osdp_context
   int capability_max_packet;
   int capability_version;
   int saved_bio_format;
-  char saved_bio_template [8192];
   int saved_bio_type;
   int saved_bio_quality;
 
   int timeout_retries;
+  int response_timeouts; // times timeout_retries ran out waiting for a response
 
   // OSDP protocol context
   unsigned int last_command_sent;
@@ -565,7 +744,6 @@ typedef struct osdp_context
   int card_data_valid; // bits
   int card_format; // 0 for raw, 1 for P/Data/P, 2-0xff invalid
   int creds_a_avail; // octets
-  char credentials_data [1024];
   int bytes_received;
   int bytes_sent;
   int packets_received;
@@ -581,7 +759,6 @@ typedef struct osdp_context
   int seq_bad;
   int pdus_received;
   int pdus_sent;
-  char init_command [1024];
   int cparm;
   int cparm_v;
   unsigned char vendor_code [3];
@@ -590,33 +767,13 @@ typedef struct osdp_context
   unsigned char serial_number [4];
   unsigned char fw_version [3]; //major minor build
 
-  // for multipart messages, in or out
-  char *mmsgbuf;
-
-  // for inbound
-  unsigned short int next_in;
-  unsigned short int total_inbound_multipart;
-
-  // for outbound
-  unsigned short int next_out;
-  unsigned short int total_outbound_multipart;
-  int current_sdu_length;
-
-  // for assembling multipart message.  assumes one context structure
-  // per PD we talk to
-
-  // for transmitting multi-part
-
   int authenticated;
-  char command_path [1024];
   int cmd_hist_counter;
-  char init_parameters_path [1024];
 
   OSDP_OUT_STATE out [16];
 
   int last_raw_read_bits;
   int slow_timer;
-  char last_raw_read_data [1024];
   char last_keyboard_data [8];
 
   OSDP_CONTEXT_FILETRANSFER xferctx;
@@ -630,6 +787,27 @@ typedef struct osdp_context
   int pdcap_select; // 0 for normal 1 for short
   unsigned char raw_reaction_command; // 0 if nothing else the thing to be sent right away.
   int tamper;
+
+  // the bulky fields, kept together at the end.  most of them are set once
+  // at startup or not at all, and away from the counters and protocol state
+  // they don't spread a running instance over more pages and cache lines.
+
+  char fqdn [1024];
+  char log_path [1024];
+  char event_log_path [1024];
+  char log_levels [1024]; // "log-levels" setting, e.g. "secure=9,parse=0"
+  char serial_speed [1024];
+  char receive_pipe [1024]; // PD: command each received file is streamed into
+  char service_root [1024];
+  char network_address [1024];
+  char metrics_socket [1024]; // unix socket path for metrics if no port
+  OSDP_LED_STATE led [OSDP_MAX_LED];
+  char text [OSDP_OFFICIAL_MSG_MAX];
+  char credentials_data [1024];
+  char init_command [1024];
+  char command_path [1024];
+  char init_parameters_path [1024];
+  char last_raw_read_data [1024];
 } OSDP_CONTEXT;
 
 // four different details maintained about a secure channel connection,
@@ -792,11 +970,11 @@ typedef struct osdp_rdr_led_ctl
   unsigned char perm_on_color;
   unsigned char perm_off_color;
 } OSDP_RDR_LED_CTL;
-
-#define OSDP_LED_TEMP_NOP    (0)
-#define OSDP_LED_TEMP_CANCEL (1)
-#define OSDP_LED_TEMP_SET    (2)
-
+
+#define OSDP_LED_TEMP_NOP    (0)
+#define OSDP_LED_TEMP_CANCEL (1)
+#define OSDP_LED_TEMP_SET    (2)
+
 #define OSDP_LED_NOP (0)
 #define OSDP_LED_SET (1)
 #define OSDP_LEDCOLOR_BLACK (0)
@@ -816,6 +994,160 @@ typedef struct osdp_mfg_args
   char c_s_d [2*1024]; // command-specific details
 } OSDP_MFG_ARGS;
 
+// fleet transfer: one file to many PD's on the bus (see oo-fleet.c)
+
+typedef struct oo_fleet_args
+{
+  int file_type;
+  char filename [1024];
+  int count;
+  int address [OO_FLEET_PD_MAX];
+  int transfer [OO_FLEET_PD_MAX]; // 0 to just keep it polled
+} OO_FLEET_ARGS;
+
+typedef struct oo_fleet_pd
+{
+  int address;
+  int state; // OO_FLEET_IDLE etc.
+  int last_percent; // progress last logged
+
+  // per-PD link state, swapped into the context while it is being served
+  int last_command_sent;
+  char last_nak_error;
+  char last_response_received;
+  int last_sequence_received;
+  int last_was_processed;
+  int max_message;
+  int next_sequence;
+  int timeout_retries;
+  struct timespec last_sent;
+  OSDP_CONTEXT_FILETRANSFER xferctx;
+} OO_FLEET_PD;
+
+typedef struct oo_fleet
+{
+  int active;
+  int count;
+  int current; // slot whose link state is in the context
+  OO_FLEET_PD home; // the context's own PD, put back at the end
+  OO_FLEET_PD pd [OO_FLEET_PD_MAX];
+  unsigned char *source;
+  size_t source_length;
+  struct timespec started;
+} OO_FLEET;
+
+// multi-PD emulator: one PD process answering for several addresses (see oo-emulator.c)
+
+typedef struct oo_emulated_pd
+{
+  int address;
+  unsigned int frames; // frames addressed to this PD
+
+  // this PD's state while another PD has the context
+  OSDP_CONTEXT *context;
+  OSDP_PARAMETERS card;
+  unsigned char last_command_received;
+  unsigned short int last_check_value;
+  unsigned char last_message_sent [2048];
+  int last_message_sent_length;
+  unsigned char pending_response;
+  unsigned char pending_response_data [1500];
+  int pending_response_length;
+} OO_EMULATED_PD;
+
+// scheduled PD events for load testing (see oo-events.c)
+
+#define OO_EVENT_CARD       (0)
+#define OO_EVENT_KEYPAD     (1)
+#define OO_EVENT_INPUT      (2)
+#define OO_EVENT_KINDS      (3)
+#define OO_EVENT_ALL        (-1)
+#define OO_EVENT_QUEUE_MAX  (64) // events waiting for a poll, per PD
+#define OO_EVENT_SCRIPT_MAX (64) // schedules in one pd-events command
+#define OO_EVENT_RATE_MAX   (1000000.0) // events per second, one per microsecond
+#define OO_EVENT_CATCHUP_MAX (4096) // periods caught up on in one poll, per kind
+#define OO_EVENT_CARD_BITS  (80) // "OE" and the 64 bit creation time
+#define OO_EVENT_KEYPAD_DIGITS (16) // CR and 15 digits of the creation time
+
+typedef struct oo_event_schedule
+{
+  int address; // -1 for the PD the command went to
+  int kind; // OO_EVENT_CARD etc. or OO_EVENT_ALL
+  int poisson; // 1 for exponential intervals, 0 for fixed
+  double rate; // events per second, 0 to stop
+  int burst; // events at each scheduled time
+  unsigned int count; // events to generate, 0 for no limit
+  unsigned int seed;
+} OO_EVENT_SCHEDULE;
+
+typedef struct oo_event_args
+{
+  int count;
+  OO_EVENT_SCHEDULE schedule [OO_EVENT_SCRIPT_MAX];
+} OO_EVENT_ARGS;
+
+// binary event log (see oo-eventlog.c, record layout in oo-eventlog.h)
+
+#define OO_EVLOG_FRAME        (1) // the ---OSDP Frame line
+#define OO_EVLOG_MESSAGE      (2) // header and Pkt lines for a frame
+#define OO_EVLOG_SEQUENCE     (3) // sequence number mismatch
+#define OO_EVLOG_NAK_RECEIVED (4)
+#define OO_EVLOG_NAK_SENT     (5)
+#define OO_EVLOG_TIMEOUT      (6)
+#define OO_EVLOG_TEXT         (7) // anything else that went through oosdp_log
+#define OO_EVLOG_EVENTS       (8)
+
+#define OO_EVLOG_TIMEOUT_POLL    (0) // retries exceeded while polling
+#define OO_EVLOG_TIMEOUT_WAIT    (1) // secure poll held, waiting for a response
+#define OO_EVLOG_TIMEOUT_EXPIRED (2) // gave up waiting, polling
+
+// flight recorder (see oo-recorder.c)
+
+#define OO_RECORDER_FRAMES  (4096)      // most recent frames kept, at most (see flight-recorder-frames)
+#define OO_RECORDER_FRAME_OCTETS (32)   // octets kept per frame kept (polls and acks are 8 to 16)
+#define OO_RECORDER_OCTETS  (OO_RECORDER_FRAMES*OO_RECORDER_FRAME_OCTETS)
+#define OO_RECORDER_HOLDOFF (10)        // seconds between automatic dumps
+#define OO_RECORDER_IN      (1)
+#define OO_RECORDER_OUT     (2)
+#define OO_RECORDER_NOT_PARSED (-1)     // parse status of a frame a monitor only counted
+
+typedef struct oo_recorder_entry
+{
+  long long captured_nsec; // CLOCK_MONOTONIC
+  unsigned long long start; // where the octets start, counting every octet ever recorded
+  int parse_status;
+  unsigned short int length;
+  unsigned char direction;
+} OO_RECORDER_ENTRY;
+
+typedef struct oo_event_pd
+{
+  OO_EVENT_SCHEDULE schedule [OO_EVENT_KINDS];
+  unsigned long long next_usec [OO_EVENT_KINDS]; // when the next one is due
+  unsigned int generated [OO_EVENT_KINDS];
+  unsigned short int random_state [3];
+  unsigned int inputs; // input states, one bit each, toggled by input events
+  int next_input;
+
+  // generated but not yet sent, oldest first
+  int queue_first;
+  int queue_count;
+  int queue_kind [OO_EVENT_QUEUE_MAX];
+  unsigned long long queue_usec [OO_EVENT_QUEUE_MAX];
+} OO_EVENT_PD;
+
+typedef struct oo_event_stats
+{
+  unsigned int generated [OO_EVENT_KINDS]; // PD
+  unsigned int delivered [OO_EVENT_KINDS]; // PD: sent in a poll response
+  unsigned int dropped [OO_EVENT_KINDS]; // PD: queue was full
+  unsigned int received [OO_EVENT_KINDS]; // ACU
+  OSDP_LATENCY_HISTOGRAM reply [OO_EVENT_KINDS]; // PD: created to sent
+  OSDP_LATENCY_HISTOGRAM end_to_end [OO_EVENT_KINDS]; // ACU: created to received
+  unsigned long long first_usec; // first generated (PD) or received (ACU)
+  unsigned long long last_usec;
+} OO_EVENT_STATS;
+
 typedef struct osdp_mfg_command
 {
   unsigned char vendor_code [3];
@@ -839,6 +1171,7 @@ int m_dump;
 int m_check;
 int mfg_rep_sequence;
 time_t previous_time;
+char saved_bio_template [8192]; // out of the context, it's rarely used
 #endif
 #ifndef _OO_INITIALIZE_
 extern unsigned char OOSDP_MFG_VENDOR_CODE [3];
@@ -850,6 +1183,7 @@ extern int m_dump;
 extern int m_version_minor;
 extern int mfg_rep_sequence;
 extern time_t previous_time;
+extern char saved_bio_template [];
 #endif
 
 #define OOSDP_MFG_PING (1) // sent for testing, expects an MFG-PING-ACK
@@ -885,6 +1219,7 @@ typedef struct __attribute__((packed)) osdp_hdr_filetransfer
   unsigned char FtData;
 } OSDP_HDR_FILETRANSFER;
 #define OSDP_FILETRANSFER_TYPE_OPAQUE (0x01)
+#define OSDP_FILETRANSFER_HEADER_LENGTH (11) // octets before FtData
 
 typedef struct __attribute__((packed)) osdp_hdr_ftstat
 {
@@ -939,6 +1274,69 @@ typedef struct __attribute__((packed)) osdp_multi_hdr_iec
   unsigned char algo_payload; // algo/key in first fragment, start of payload in subsequent fragments
 } OSDP_MULTI_HDR_IEC;
 
+// monitor capture pipeline (see oo-monitor.c)
+
+#define OO_MONITOR_RING    (256) // captured frames waiting to be decoded, a power of 2
+#define OO_MONITOR_GAP_MSEC (50) // a partial frame quiet this long is noise
+typedef struct oo_monitor_frame
+{
+  struct timespec captured; // CLOCK_REALTIME at the first octet
+  int length;
+  unsigned char octets [OSDP_OFFICIAL_MSG_MAX];
+} OO_MONITOR_FRAME;
+typedef struct oo_monitor_framer
+{
+  OO_MONITOR_FRAME frame; // being collected
+  int frame_length; // from the header, 0 until it's seen
+  unsigned int noise; // octets that were not part of any frame
+} OO_MONITOR_FRAMER;
+
+// multipart reassembly and segmentation (see oo-multipart.c)
+
+#define OO_MPART_POOL            (4)     // transactions being reassembled at once
+#define OO_MPART_OCTETS_MAX      (65535) // the total is a 16 bit field
+#define OO_MPART_TIMEOUT_SEC     (10)    // reassembly dropped after this long without a fragment
+#define OO_MPART_MESSAGE_DEFAULT (128)   // message size for fragments if nothing better is known
+#define OO_MPART_FRAGMENT_MIN    (16)    // smallest fragment payload worth sending
+#define OO_MPART_PLAN_MAX        (OO_MPART_OCTETS_MAX + ((OO_MPART_OCTETS_MAX/OO_MPART_FRAGMENT_MIN)+1)*(sizeof(OSDP_MULTI_HDR_IEC)-1))
+#define OO_MPART_IDLE      (0)
+#define OO_MPART_RECEIVING (1)
+#define OO_MPART_COMPLETE  (2) // the caller has the whole payload until oo_mpart_release
+typedef struct oo_mpart
+{
+  int state;
+  int pd; // PD address
+  int command; // command or reply code the fragments arrive in
+  unsigned int total;
+  unsigned int have; // distinct octets received, in whatever order
+  unsigned int fragments;
+  unsigned int duplicates;
+  struct timespec last_fragment;
+  unsigned char map [(OO_MPART_OCTETS_MAX+7)/8]; // octets received
+  unsigned char buffer [OO_MPART_OCTETS_MAX];
+} OO_MPART;
+typedef struct oo_mpart_out
+{
+  int command;
+  int security; // OSDP_SEC_... for send_message_ex
+  unsigned int total;
+  unsigned int fragment_size;
+  unsigned int fragments;
+  unsigned int current; // fragment on the wire (ACU) or to go with the next poll (PD), fragments when done
+  unsigned int resends;
+  int awaiting_reply; // ACU: the multipart reply has not all arrived yet
+  struct timespec started;
+  unsigned char plan [OO_MPART_PLAN_MAX]; // each fragment's header and payload, back to back
+} OO_MPART_OUT;
+typedef struct oo_mpart_stats
+{
+  unsigned int transactions;
+  unsigned int fragments;
+  unsigned int resends;
+  OSDP_LATENCY_HISTOGRAM send;        // first fragment out to last one ACK'd (ACU) or sent (PD)
+  OSDP_LATENCY_HISTOGRAM transaction; // ACU: first fragment out to whole reply in
+} OO_MPART_STATS;
+
 // open-osdp Reply_ID values...
 #define MFGREP_OOSDP_CAKCert (0x01)
 
@@ -1048,6 +1446,21 @@ typedef struct __attribute__((packed)) osdp_multi_hdr_iec
 #define ST_OSDP_CMD_OUT_BAD_5            (100)
 #define ST_OSDP_CMD_OUT_BAD_6            (101)
 #define ST_OSDP_CRC_REQUIRED             (102)
+#define ST_METRICS_SETUP                 (103)
+#define ST_OSDP_TRANSPORT_UNKNOWN        (104)
+#define ST_OSDP_TRANSPORT_OPEN           (105)
+#define ST_OSDP_TLS_SETUP                (106)
+#define ST_OSDP_MULTIPART_HEADER         (107)
+#define ST_OSDP_MULTIPART_CONFLICT       (108)
+#define ST_MONITOR_START                 (109)
+#define ST_OSDPCAP_BAD_RECORD            (110)
+#define ST_SNAPSHOT_STALE                (111)
+#define ST_EMULATE_ADDRESSES             (112)
+#define ST_EVENTS_SCHEDULE               (113)
+#define ST_EVENT_LOG_OPEN                (114)
+#define ST_LOG_LEVELS                    (115)
+#define ST_RECORDER_DUMP                 (116)
+#define ST_OSDP_SEC_BLOCK_LENGTH         (117)
 
 
 int action_osdp_BIOMATCH(OSDP_CONTEXT *ctx, OSDP_MSG *msg);
@@ -1091,21 +1504,110 @@ int enqueue_command (OSDP_CONTEXT *ctx, OSDP_COMMAND *cmd);
 int fasc_n_75_to_string (char * s, long int *sample_1);
 int initialize_osdp (OSDP_CONTEXT *ctx);
 int init_serial (OSDP_CONTEXT *context, char *device);
-int oo_build_genauth(OSDP_CONTEXT *ctx, unsigned char *challenge_payload_buffer, int *payload_length, unsigned char *details, int details_length);
 int oo_bytes_to_hex_string(OSDP_CONTEXT *ctx, unsigned char *bytes, int byte_length, char *hex_string, int hex_string_max);
 int oo_command_setup_out(OSDP_CONTEXT *ctx, json_t *output_command, OSDP_COMMAND *cmd);
 int oo_filetransfer_SDU_offer(OSDP_CONTEXT *ctx);
 int oo_hash_check (OSDP_CONTEXT *ctx, unsigned char *message, int security_block_type, unsigned char *hash, int message_length);
+unsigned long long oo_latency_bucket_floor (int bucket);
+unsigned long long oo_latency_elapsed (struct timespec *start, struct timespec *end);
+void oo_latency_first_octet (OSDP_CONTEXT *ctx);
+void oo_latency_log_summary (OSDP_CONTEXT *ctx);
+OSDP_LATENCY_STATS *oo_latency_lookup (int command);
+unsigned long long oo_latency_percentile (OSDP_LATENCY_HISTOGRAM *h, int percentile);
+void oo_latency_record (OSDP_LATENCY_HISTOGRAM *h, unsigned long long usec);
+void oo_latency_response_complete (OSDP_CONTEXT *ctx, int response);
+void oo_latency_transmit_complete (OSDP_CONTEXT *ctx, int command);
+void oo_latency_write_status (OSDP_CONTEXT *ctx, FILE *sf);
+int oo_emulator_addresses (char *list, unsigned char *map);
+int oo_emulator_command (OSDP_CONTEXT *ctx, char *socket_command);
+int oo_emulator_select (OSDP_CONTEXT *ctx, unsigned char *frame, int length);
+int oo_emulator_start (OSDP_CONTEXT *ctx);
+void oo_emulator_write_status (OSDP_CONTEXT *ctx, FILE *sf);
+int oo_eventlog (OSDP_CONTEXT *ctx, int event, char *fields, ...);
+int oo_eventlog_open (OSDP_CONTEXT *ctx);
+int oo_events_poll (OSDP_CONTEXT *ctx);
+int oo_events_read_schedule (json_t *item, OO_EVENT_SCHEDULE *schedule);
+int oo_events_received (OSDP_CONTEXT *ctx, OSDP_MSG *msg);
+int oo_events_start (OSDP_CONTEXT *ctx, OO_EVENT_ARGS *args);
+void oo_events_write_status (OSDP_CONTEXT *ctx, FILE *sf);
+int oo_fleet_active (void);
+int oo_fleet_background (OSDP_CONTEXT *ctx);
+int oo_fleet_initiate (OSDP_CONTEXT *ctx, OO_FLEET_ARGS *args);
+int oo_fleet_step (OSDP_CONTEXT *ctx);
+void oo_fleet_stop (OSDP_CONTEXT *ctx);
+void oo_fleet_write_status (OSDP_CONTEXT *ctx, FILE *sf);
 int oo_load_parameters(OSDP_CONTEXT *ctx, char *filename);
+int oo_log_levels (OSDP_CONTEXT *ctx);
 char * oo_lookup_nak_text(int nak_code);
+void oo_metrics_expire (OSDP_CONTEXT *ctx);
+int oo_metrics_init (OSDP_CONTEXT *ctx);
+void oo_metrics_select (OSDP_CONTEXT *ctx, fd_set *readfds, fd_set *writefds, int *scount);
+int oo_metrics_serve (OSDP_CONTEXT *ctx, fd_set *readfds, fd_set *writefds);
+int oo_metrics_snapshot (OSDP_CONTEXT *ctx);
 int oo_mfg_reply_action(OSDP_CONTEXT *ctx, OSDP_MSG *msg, OSDP_MFGREP_RESPONSE *mrep);
 int oo_next_sequence (OSDP_CONTEXT *ctx);
 char *oo_osdp_root(OSDP_CONTEXT *ctx, int directory);
+int oo_recorder_check (OSDP_CONTEXT *ctx, int status);
+int oo_recorder_dump (OSDP_CONTEXT *ctx, char *reason, char *path);
+void oo_recorder_frame (OSDP_CONTEXT *ctx, int direction, unsigned char *octets, int length, int parse_status, struct timespec *arrival);
+int oo_recorder_poll (OSDP_CONTEXT *ctx);
+int oo_recorder_start (OSDP_CONTEXT *ctx);
+void oo_recorder_trigger (OSDP_CONTEXT *ctx, char *reason);
+void oo_recorder_write_status (OSDP_CONTEXT *ctx, FILE *sf);
 unsigned char oo_response_address(OSDP_CONTEXT *ctx, unsigned char from_addr);
 int oo_save_parameters(OSDP_CONTEXT *ctx, char *filename, unsigned char *scbk);
 int oo_send_ftstat (OSDP_CONTEXT *ctx, OSDP_HDR_FTSTAT *response);
-int oo_send_next_genauth_fragment(OSDP_CONTEXT *ctx);
+void oo_sha256_final (OO_SHA256_CTX *sha, unsigned char digest [OO_SHA256_OCTETS]);
+void oo_sha256_hex (unsigned char digest [OO_SHA256_OCTETS], char *hex);
+void oo_sha256_init (OO_SHA256_CTX *sha);
+void oo_sha256_update (OO_SHA256_CTX *sha, const unsigned char *data, size_t length);
+int oo_snapshot_begin (OSDP_CONTEXT *ctx, int phase, int *phase_status);
+void oo_snapshot_end (OSDP_CONTEXT *ctx, int phase, int phase_status);
+int oo_snapshot_save (OSDP_CONTEXT *ctx);
+void oo_startup_phase(OSDP_CONTEXT *ctx, char *name);
+void oo_startup_report(OSDP_CONTEXT *ctx, char *name);
+int oo_transport_close (OSDP_CONTEXT *ctx);
+void oo_transport_disconnected (OSDP_CONTEXT *ctx);
+int oo_transport_flush (OSDP_CONTEXT *ctx);
+int oo_transport_lookup (char *name, int *transport_type);
+int oo_transport_open (OSDP_CONTEXT *ctx, char *device);
+int oo_transport_pending (OSDP_CONTEXT *ctx);
+int oo_transport_read (OSDP_CONTEXT *ctx, unsigned char *buffer, int buffer_max);
+int oo_transport_reconnect (OSDP_CONTEXT *ctx, fd_set *readfds, fd_set *writefds);
+void oo_transport_select (OSDP_CONTEXT *ctx, fd_set *readfds, fd_set *writefds, int *scount);
+int oo_transport_write (OSDP_CONTEXT *ctx, unsigned char *buffer, int lth);
 int oo_filetransfer_initiate(OSDP_CONTEXT *context, char *details);
+int oo_filetransfer_map(OSDP_CONTEXT *context, char *filename);
+int oo_filetransfer_paced(OSDP_CONTEXT *ctx);
+int oo_filetransfer_start(OSDP_CONTEXT *context, int file_type);
+int oo_filetransfer_plan(OSDP_CONTEXT *ctx);
+void oo_filetransfer_adapt(OSDP_CONTEXT *ctx, int event);
+int oo_filetransfer_background(OSDP_CONTEXT *ctx);
+int oo_filetransfer_limit(OSDP_CONTEXT *ctx);
+int oo_filetransfer_send_next(OSDP_CONTEXT *ctx);
+void oo_filetransfer_unacked(OSDP_CONTEXT *ctx);
+int oo_filetransfer_checkpoint(OSDP_CONTEXT *ctx, int complete);
+int oo_filetransfer_partial_save(OSDP_CONTEXT *ctx, int file_type);
+int oo_filetransfer_resume(OSDP_CONTEXT *ctx);
+int oo_filetransfer_resume_pd(OSDP_CONTEXT *ctx, unsigned int total_length, unsigned int offset, int file_type);
+int oo_monitor_decode(OSDP_CONTEXT *ctx, OO_MONITOR_FRAME *frame);
+int oo_monitor_drain(OSDP_CONTEXT *ctx);
+int oo_monitor_frame_octet(OO_MONITOR_FRAMER *framer, unsigned char octet, struct timespec *arrival);
+void oo_monitor_frame_reset(OO_MONITOR_FRAMER *framer);
+int oo_monitor_frame_time(struct timespec *captured);
+int oo_monitor_start(OSDP_CONTEXT *ctx);
+void oo_monitor_write_status(OSDP_CONTEXT *ctx, FILE *sf);
+void oo_mpart_log_summary(OSDP_CONTEXT *ctx);
+int oo_mpart_poll(OSDP_CONTEXT *ctx);
+int oo_mpart_receive(OSDP_CONTEXT *ctx, int pd, OSDP_MSG *msg, OO_MPART **whole);
+void oo_mpart_release(OO_MPART *mpart);
+int oo_mpart_send(OSDP_CONTEXT *ctx, int command, unsigned char *payload, int payload_length);
+int oo_mpart_send_next(OSDP_CONTEXT *ctx);
+int oo_mpart_sending(OSDP_CONTEXT *ctx);
+void oo_mpart_write_status(OSDP_CONTEXT *ctx, FILE *sf);
+void oo_receive_close(OSDP_CONTEXT *ctx);
+int oo_receive_open(OSDP_CONTEXT *ctx, unsigned int offset);
+int oo_receive_write(OSDP_CONTEXT *ctx, unsigned char *fragment, int fragment_size, unsigned int offset);
 int oo_write_status (OSDP_CONTEXT *ctx);
 void osdp_array_to_doubleByte (unsigned char a [2], unsigned short int *i);
 void osdp_array_to_quadByte (unsigned char a [4], unsigned int *i);
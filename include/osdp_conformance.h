@@ -320,4 +320,7 @@ int
   osdp_conform_fail
     (char
       *test);
+int
+  osdp_conformance_metrics
+    (void (*emit) (char *line));
 
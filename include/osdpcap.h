@@ -2,13 +2,89 @@
   osdpcap - OSDP Capture format
 */
 
+#include <time.h>
+
 #define OSDP_TRACE_VERSION_1      (1)
 
 #define OSDPCAP_TAG_DATA          "data"
 #define OSDPCAP_TAG_INPUT_OUTPUT  "io"
 #define OSDPCAP_TAG_OSDP_SOURCE   "osdpSource"
+#define OSDPCAP_TAG_PARSE_STATUS  "parseStatus" // flight recorder dumps only
 #define OSDPCAP_TAG_TIME_NSEC     "timeNano"
 #define OSDPCAP_TAG_TIME_SEC      "timeSec"
 #define OSDPCAP_TAG_TRACE_VERSION "osdpTraceVersion"
 
+#define OSDPCAP_IO_UNKNOWN (0)
+#define OSDPCAP_IO_IN      (1)
+#define OSDPCAP_IO_OUT     (2)
+#define OSDPCAP_IO_TRACE   (3)
+
+#define OSDPCAP_RECORD_MAX (2048) // octets in one record's data
+
+// one record (line) of a capture, decoded (see oo-osdpcap.c)
+
+typedef struct osdpcap_record
+{
+  struct timespec captured;
+  int io; // OSDPCAP_IO_...
+  int length;
+  unsigned char octets [OSDPCAP_RECORD_MAX];
+} OSDPCAP_RECORD;
+
+int oo_osdpcap_parse(char *line, OSDPCAP_RECORD *record);
+
+/*
+  sidecar index (capture.osdpcap.idx, see osdpcap-index.c)
+
+  a header, one entry per record in file order, then the buckets.  a bucket
+  is a run of records from a few seconds of capture, with what is in it, so
+  a query skips whole buckets without looking at their records.  native
+  byte order; it is rebuilt if the capture's size or time changes.
+*/
+
+#define OSDPCAP_INDEX_MAGIC      "OSDPIDX1"
+#define OSDPCAP_INDEX_SUFFIX     ".idx"
+#define OSDPCAP_INDEX_BUCKET_SEC (10)
+#define OSDPCAP_INDEX_BUCKET_MAX (4096) // records
+
+#define OSDPCAP_INDEX_REPLY      (0x01)
+#define OSDPCAP_INDEX_SECURE     (0x02)
+#define OSDPCAP_INDEX_BAD_CHECK  (0x04) // CRC or checksum didn't match
+#define OSDPCAP_INDEX_BAD_FRAME  (0x08) // the data isn't one whole frame
+#define OSDPCAP_INDEX_NAK        (0x10)
+
+typedef struct osdpcap_index_header
+{
+  char magic [8];
+  long long capture_size; // when indexed
+  long long capture_mtime;
+  long long buckets_offset;
+  unsigned int records;
+  unsigned int buckets;
+} OSDPCAP_INDEX_HEADER;
+
+typedef struct osdpcap_index_record
+{
+  long long offset; // of the line in the capture
+  long long time_sec;
+  unsigned int time_nsec;
+  unsigned int length; // of the line
+  unsigned char address; // without the reply bit
+  unsigned char code; // command or reply
+  unsigned char flags; // OSDPCAP_INDEX_...
+  unsigned char io;
+  unsigned char reserved [4];
+} OSDPCAP_INDEX_RECORD;
+
+typedef struct osdpcap_index_bucket
+{
+  unsigned int first; // record
+  unsigned int count;
+  long long min_sec;
+  long long max_sec;
+  unsigned char addresses [128/8]; // bit per address seen
+  unsigned char codes [256/8]; // bit per command or reply code seen
+  unsigned char flags; // all the record flags or'd together
+  unsigned char reserved [7];
+} OSDPCAP_INDEX_BUCKET;
 
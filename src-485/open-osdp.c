@@ -37,6 +37,7 @@ extern int pending_response_length;
 #include <sys/stat.h>
 
 
+#include <osdp-tls.h>
 #include <open-osdp.h>
 #include <osdp_conformance.h>
 #include <osdp-local-config.h>
@@ -49,6 +50,7 @@ OSDP_BUFFER osdp_buf;
 OSDP_INTEROP_ASSESSMENT osdp_conformance;
 OSDP_OUT_CMD current_output_command [16];
 OSDP_PARAMETERS p_card;
+extern OSDP_TLS_CONFIG osdp_tls_config;
 char tag [16]; // PD or CP as a string
 char trace_in_buffer [4*OSDP_OFFICIAL_MSG_MAX];
 char trace_out_buffer [4*OSDP_OFFICIAL_MSG_MAX];
@@ -92,31 +94,41 @@ int
 
 { /* initialize */
 
-  char command [3*1024];
+  int i;
 //  pid_t my_pid;
   int status;
 
 
   status = ST_OK;
-  sprintf (command, "rm -f %s", OSDP_LCL_UNIX_SOCKET); system(command); // kill socket for starters
+  (void) unlink (OSDP_LCL_UNIX_SOCKET); // kill socket for starters
   trace_in_buffer [0] = 0;
   trace_out_buffer [0] = 0;
   check_for_command = 0;
 
   if (status EQUALS ST_OK)
   {
-    memset (&context, 0, sizeof (context));
+    // context is a global and starts out zero.  clearing it again would
+    // dirty every page of it whether the fields are ever used or not.
+
+    // --startup-profile reports how long each part of startup took, at the first poll
+
+    for (i=1; i<argc; i++)
+      if (strcmp (argv [i], "--startup-profile") EQUALS 0)
+        context.startup_profile = 1;
+    oo_startup_phase (&context, "start");
     context.last_sequence_received = -1;
     context.current_menu = OSDP_MENU_TOP;
     strcpy (context.init_parameters_path, "open-osdp-params.json");
     strcpy (context.log_path, "osdp.log");
+    strcpy (osdp_tls_config.ca_file, OSDP_LCL_CA_KEYS);
+    strcpy (osdp_tls_config.cert_file, OSDP_LCL_SERVER_CERT);
+    strcpy (osdp_tls_config.key_file, OSDP_LCL_SERVER_KEY);
 //    strcpy(context.service_root, "/opt/osdp-conformance/run");
 
     // if there's an argument it is the config file path
-    if (argc > 1)
-    {
-      strcpy (context.init_parameters_path, argv [1]);
-    };
+    for (i=1; i<argc; i++)
+      if (strcmp (argv [i], "--startup-profile") != 0)
+        strcpy (context.init_parameters_path, argv [i]);
     fprintf(stderr, "OSDP is in startup.  Loading parameters from %s\n", context.init_parameters_path);
 
     status = initialize_osdp (&context);
@@ -141,7 +153,8 @@ int
 
   if (status EQUALS ST_OK)
   {
-    status = init_serial (&context, p_card.filename);
+    status = oo_transport_open (&context, p_card.filename);
+    oo_startup_phase (&context, "transport");
   };
   if (0) //(status EQUALS ST_OK)
   {
@@ -225,7 +238,22 @@ int
           status_socket = listen (ufd, 0);
       };
     };
-    check_serial (&context);
+    if (context.transport_type EQUALS OSDP_TRANSPORT_SERIAL)
+      check_serial (&context);
+    oo_startup_phase (&context, "command socket");
+    (void) oo_metrics_init (&context);
+
+    // a monitor on a serial line hands the line to a capture thread
+    (void) oo_monitor_start (&context);
+
+    // a PD answering for several addresses gets a copy of its state per address
+    status = oo_emulator_start (&context);
+    if (status != ST_OK)
+      done = 1;
+
+    // the flight recorder dumps on SIGUSR1 and when sequence or secure channel goes wrong
+    (void) oo_recorder_start (&context);
+    oo_startup_phase (&context, "metrics, monitor");
   };
   if (0)
   {
@@ -244,13 +272,24 @@ int
     // do a select waiting for RS-485 serial input (or a HUP)
 
     FD_ZERO (&readfds);
-    FD_SET (ufd, &readfds);
-    FD_SET (context.fd, &readfds);
-    if (ufd > context.fd)
-      scount = ufd+1;
-    else
-      scount = context.fd+1;
     FD_ZERO (&writefds);
+    FD_SET (ufd, &readfds);
+    scount = ufd+1;
+
+    // the line, or while a stream transport is down, whatever brings it back
+    oo_transport_select (&context, &readfds, &writefds, &scount);
+
+    // the capture thread reads the line, we hear from it through monitor_fd
+    if (context.monitor_fd != -1)
+    {
+      if (context.fd != -1)
+        FD_CLR (context.fd, &readfds);
+      FD_SET (context.monitor_fd, &readfds);
+      if (context.monitor_fd >= scount)
+        scount = context.monitor_fd+1;
+    };
+    // the metrics listener and any scrapers being answered
+    oo_metrics_select (&context, &readfds, &writefds, &scount);
     FD_ZERO (&exceptfds);
 
     // todo: switch over to OSDP_TIMER_IO and add a tunable parameter.
@@ -258,12 +297,26 @@ int
     timeout.tv_sec = 0;
 //    timeout.tv_nsec = 100000000;
     timeout.tv_nsec = context.timer[OSDP_TIMER_SERIAL_READ].i_nsec;
+
+    // if the transport is holding decoded input don't wait for the descriptor
+    if (oo_transport_pending (&context) > 0)
+      timeout.tv_nsec = 0;
+
+    // the timers have never run on the first pass, don't sit out a read timeout before the first poll
+    if (last_time_check_ex.tv_sec EQUALS 0)
+      timeout.tv_nsec = 0;
 //timeout.tv_nsec=1000; //50000000L;
     // to slow things way down set the select timeout to e.g. half a second:
 
     status_select = pselect (scount, &readfds, &writefds, &exceptfds,
       &timeout, &sigmask);
 
+    if ((status_select >= 0) && (context.fd != -1) && (oo_transport_pending (&context) > 0))
+    {
+      if (!FD_ISSET (context.fd, &readfds))
+        status_select ++;
+      FD_SET (context.fd, &readfds);
+    };
     if (status_select EQUALS -1)
     {
       status = ST_SELECT_ERROR;
@@ -281,6 +334,18 @@ int
         fprintf (stderr, "errno at select error %d\n", errno);
       };
     };
+    (void) oo_recorder_poll (&context);
+    if ((status_select >= 0) && (context.fd EQUALS -1))
+    {
+      (void) oo_transport_reconnect (&context, &readfds, &writefds);
+      if (context.fd != -1)
+        FD_CLR (context.fd, &readfds); // just connected, select didn't look at it
+    };
+
+    // what a stream socket didn't take before goes now it can
+    if ((status_select > 0) && (context.fd != -1))
+      if (FD_ISSET (context.fd, &writefds))
+        (void) oo_transport_flush (&context);
 
     // if there is no I/O activity or the buffer has not even a partial message then process timeouts
     // (defend against noise coming in on the line.)
@@ -288,6 +353,7 @@ int
     if ((status_select EQUALS 0) || (osdp_buf.next EQUALS 0))
     {
       status = ST_OK;
+      oo_metrics_expire (&context);
       if (osdp_timeout (&context, &last_time_check_ex))
       {
         // if timer 0 expired dump the status
@@ -295,6 +361,7 @@ int
           OSDP_TIMER_RESTARTED)
         {
           status = oo_write_status (&context);
+          (void) oo_metrics_snapshot (&context);
         };
 
         // if "the timer" went off, do the background process.
@@ -345,12 +412,22 @@ int
         };       
       };
 
-      if (FD_ISSET (context.fd, &readfds))
+      // frames from the capture thread are decoded here
+
+      if (context.monitor_fd != -1)
+        if (FD_ISSET (context.monitor_fd, &readfds))
+          (void) oo_monitor_drain (&context);
+
+      // a metrics scrape is answered from the cached snapshot
+
+      (void) oo_metrics_serve (&context, &readfds, &writefds);
+
+      if ((context.fd != -1) && FD_ISSET (context.fd, &readfds))
       {
         char buffer [2048];
 //        unsigned char buffer [2];
 
-        status_io = read (context.fd, buffer, 1); //OSDP_OFFICIAL_MSG_MAX); // 1);
+        status_io = oo_transport_read (&context, (unsigned char *)buffer, 1); //OSDP_OFFICIAL_MSG_MAX); // 1);
         if (status_io < 1)
         {
           // continue if it was a serial error
@@ -407,6 +484,11 @@ int
               {
                 context.dropped_octets = context.dropped_octets + osdp_buf.next;
                 osdp_buf.next = 0;
+              }
+              else
+              {
+                // start of a response, time it against the last command sent
+                oo_latency_first_octet (&context);
               };
             };
           }
@@ -452,6 +534,10 @@ if (context.verbosity > 9)
       {
         status = process_command_from_queue(&context);
       };
+
+      // in a fleet transfer the next PD gets the bus as soon as it's free
+      if (status EQUALS ST_OK)
+        status = oo_fleet_step(&context);
     }
     else
     {
@@ -521,8 +607,13 @@ int
       strcat(trace_out_buffer, octet);
     };
   };
-  write (context->fd, buf, lth);
+  oo_transport_write (context, buf, lth);
 
+  // only the tty is waited on.  a stream transport queues what the socket
+  // doesn't take and the event loop sends it when it can (and there's
+  // nowhere to send it while one is reconnecting.)
+  if ((context->fd != -1) && (context->transport_type EQUALS OSDP_TRANSPORT_SERIAL))
+  {
     FD_ZERO (&readfds);
     FD_ZERO (&writefds);
     FD_SET (context->fd, &writefds);
@@ -540,6 +631,7 @@ int
     {
       tmp_waiting++;
     };
+  };
 
   context->bytes_sent = context->bytes_sent + lth;
   
@@ -0,0 +1,904 @@
+/*
+  osdp-conform - run conformance cases in parallel and merge the results
+
+  Usage:
+    osdp-conform [-x open-osdp] [-b osdp-vbus] [-B bus-options] [-d run-directory]
+      [-j jobs] [-s settle-msec] [-v verbosity] suite ...
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+*/
+
+/*
+  a suite is a list of cases.  each case gets its own virtual bus, ACU
+  and PD in <run-directory>/<nnn>-<case>, with its own service root, so
+  the results files, lock, control socket and saved parameters of one case
+  never meet another's.  up to jobs cases run at once.
+
+  suite lines are
+    case <name>
+    acu-settings <json object>    (added to the ACU's open-osdp-params.json)
+    pd-settings <json object>
+    <start-msec> <repeat> <interval-msec> <acu|pd> <command json>
+  and '#' starts a comment.  the command lines are the osdp-bench workload
+  format.  settle-msec after the last command both sides are told to
+  dump-status (which writes results/report.log) and stop.
+
+  the results/<test>-results.json files from every case are then merged,
+  per side, into <run-directory>/merged/acu and merged/pd: a failure
+  anywhere is a failure, otherwise exercised anywhere is exercised.  the
+  merged results are fed through the library's conformance table so the
+  merged report.log is the same report a single instance writes.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+
+#include <jansson.h>
+
+
+#include <open-osdp.h>
+#include <osdp_conformance.h>
+
+
+#define OO_CONFORM_ARGS_MAX    (32)
+#define OO_CONFORM_CASES_MAX   (256)
+#define OO_CONFORM_JOBS_MAX    (64)
+#define OO_CONFORM_RESULTS_MAX (512)
+#define OO_CONFORM_STEPS_MAX   (32)
+
+
+typedef struct oo_conform_step
+{
+  int start_msec;
+  int repeat;
+  int interval_msec;
+  int sent;
+  char target [32];
+  char command [1024];
+} OO_CONFORM_STEP;
+
+typedef struct oo_conform_case
+{
+  char name [64];
+  char directory [1024];
+  char acu_settings [1024];
+  char pd_settings [1024];
+  int step_count;
+  OO_CONFORM_STEP step [OO_CONFORM_STEPS_MAX];
+  pid_t pid; // the runner for this case, while it runs
+  int exit_status;
+  struct timespec started;
+  long msec;
+} OO_CONFORM_CASE;
+
+typedef struct oo_conform_result
+{
+  char test [64];
+  int status; // OCONFORM_...
+  int case_index; // case that decided it
+  int in_table; // written by osdp_test_set_status_ex, so the conformance table knows it
+  char path [3072];
+} OO_CONFORM_RESULT;
+
+
+int check_for_command;
+OSDP_CONTEXT context;
+struct timespec last_time_check_ex;
+OSDP_BUFFER osdp_buf;
+OSDP_INTEROP_ASSESSMENT osdp_conformance;
+OSDP_OUT_CMD current_output_command [16];
+OSDP_PARAMETERS p_card;
+char tag [16];
+char trace_in_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+char trace_out_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+unsigned char last_message_sent [2048];
+int last_message_sent_length;
+unsigned char creds_buffer_a [64*1024];
+int creds_buffer_a_lth;
+int creds_buffer_a_next;
+int creds_buffer_a_remaining;
+
+char *bus_options;
+char *bus_program;
+int case_count;
+OO_CONFORM_CASE cases [OO_CONFORM_CASES_MAX];
+char *osdp_program;
+int settle_msec;
+int verbosity;
+
+
+// the merge never transmits
+
+int
+  send_osdp_data
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buf,
+    int lth)
+
+{ /* send_osdp_data */
+
+  return (ST_OK);
+
+} /* send_osdp_data */
+
+
+long
+  conform_msec_since
+    (struct timespec *start)
+
+{ /* conform_msec_since */
+
+  struct timespec now;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (((now.tv_sec - start->tv_sec) * 1000L) + ((now.tv_nsec - start->tv_nsec) / 1000000L));
+
+} /* conform_msec_since */
+
+
+void
+  conform_sleep_msec
+    (long msec)
+
+{ /* conform_sleep_msec */
+
+  struct timespec t;
+
+
+  t.tv_sec = msec / 1000;
+  t.tv_nsec = (msec % 1000) * 1000000L;
+  (void) nanosleep (&t, NULL);
+
+} /* conform_sleep_msec */
+
+
+/*
+  conform_wait_path - wait for a file or socket to show up
+*/
+
+int
+  conform_wait_path
+    (char *path,
+    long msec)
+
+{ /* conform_wait_path */
+
+  struct timespec start;
+  struct stat st;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  while (lstat (path, &st) != 0)
+  {
+    if (conform_msec_since (&start) > msec)
+      return (-1);
+    conform_sleep_msec (10);
+  };
+  return (0);
+
+} /* conform_wait_path */
+
+
+/*
+  conform_send - deliver a command to an instance's control socket
+*/
+
+int
+  conform_send
+    (char *directory,
+    char *command)
+
+{ /* conform_send */
+
+  struct sockaddr_un addr;
+  int fd;
+  char path [3072];
+  int status;
+
+
+  status = -1;
+  fd = -1;
+  sprintf (path, "%s/open-osdp-control", directory);
+  if (strlen (path) < sizeof (addr.sun_path))
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd != -1)
+  {
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+    if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) EQUALS 0)
+    {
+      if (write (fd, command, strlen (command)) EQUALS strlen (command))
+        status = 0;
+    };
+    close (fd);
+  };
+  return (status);
+
+} /* conform_send */
+
+
+pid_t
+  conform_spawn
+    (char *directory,
+    char *args [])
+
+{ /* conform_spawn */
+
+  int fd;
+  pid_t pid;
+
+
+  pid = fork ();
+  if (pid EQUALS 0)
+  {
+    if (chdir (directory) != 0)
+      exit (1);
+    fd = open ("stdio.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1)
+    {
+      dup2 (fd, 1);
+      dup2 (fd, 2);
+      close (fd);
+    };
+    execv (args [0], args);
+    fprintf (stderr, "osdp-conform: cannot exec %s (%s)\n", args [0], strerror (errno));
+    exit (1);
+  };
+  return (pid);
+
+} /* conform_spawn */
+
+
+/*
+  conform_stop - wait for a process to exit, then make it
+*/
+
+void
+  conform_stop
+    (pid_t pid,
+    long msec)
+
+{ /* conform_stop */
+
+  struct timespec start;
+
+
+  if (pid <= 0)
+    return;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  while (waitpid (pid, NULL, WNOHANG) EQUALS 0)
+  {
+    if (conform_msec_since (&start) > msec)
+    {
+      kill (pid, SIGKILL);
+      (void) waitpid (pid, NULL, 0);
+      break;
+    };
+    conform_sleep_msec (10);
+  };
+
+} /* conform_stop */
+
+
+/*
+  conform_write_settings - an instance's open-osdp-params.json
+
+  the case's settings object, if any, is merged over the defaults.
+*/
+
+int
+  conform_write_settings
+    (char *directory,
+    char *role,
+    char *extra)
+
+{ /* conform_write_settings */
+
+  json_error_t error;
+  json_t *more;
+  char path [2048];
+  json_t *settings;
+  int status;
+  char value [1024];
+
+
+  status = 0;
+  settings = json_object ();
+  json_object_set_new (settings, "role", json_string (role));
+  json_object_set_new (settings, "address", json_string ("0"));
+  sprintf (value, "../vbus-%s", strcmp (role, "ACU") ? "pd-0" : "acu");
+  json_object_set_new (settings, "serial-device", json_string (value));
+  json_object_set_new (settings, "service-root", json_string (directory));
+  sprintf (value, "%d", verbosity);
+  json_object_set_new (settings, "verbosity", json_string (value));
+  if (strlen (extra) > 0)
+  {
+    more = json_loads (extra, 0, &error);
+    if (json_is_object (more))
+      json_object_update (settings, more);
+    else
+      status = -1;
+    if (more != NULL)
+      json_decref (more);
+  };
+  sprintf (path, "%s/open-osdp-params.json", directory);
+  if (status EQUALS 0)
+    status = json_dump_file (settings, path, JSON_INDENT (2));
+  json_decref (settings);
+  return (status);
+
+} /* conform_write_settings */
+
+
+/*
+  conform_run_case - one case, start to finish, in a child process
+
+  returns 0 if both sides came up and wrote a report.
+*/
+
+int
+  conform_run_case
+    (OO_CONFORM_CASE *c)
+
+{ /* conform_run_case */
+
+  pid_t acu_pid;
+  char acu_path [2048];
+  int bus_argc;
+  char *bus_args [OO_CONFORM_ARGS_MAX];
+  pid_t bus_pid;
+  char bus_string [1024];
+  int i;
+  long last_msec;
+  long now;
+  char *osdp_args [3];
+  pid_t pd_pid;
+  char pd_path [2048];
+  char path [3072];
+  struct timespec start;
+  int status;
+  OO_CONFORM_STEP *step;
+
+
+  status = 0;
+  acu_pid = -1;
+  pd_pid = -1;
+  (void) mkdir (c->directory, 0755);
+  sprintf (acu_path, "%s/acu", c->directory);
+  sprintf (pd_path, "%s/pd", c->directory);
+  (void) mkdir (acu_path, 0755);
+  (void) mkdir (pd_path, 0755);
+  if (conform_write_settings (acu_path, "ACU", c->acu_settings) != 0)
+    status = -1;
+  if (conform_write_settings (pd_path, "PD", c->pd_settings) != 0)
+    status = -1;
+  if (status != 0)
+    fprintf (stderr, "osdp-conform: %s: bad settings\n", c->name);
+
+  // bus first, then the PD, then the ACU
+
+  bus_argc = 0;
+  bus_args [bus_argc++] = bus_program;
+  if (bus_options != NULL)
+  {
+    char *token;
+
+    strcpy (bus_string, bus_options);
+    token = strtok (bus_string, " ");
+    while ((token != NULL) && (bus_argc < OO_CONFORM_ARGS_MAX-3))
+    {
+      bus_args [bus_argc++] = token;
+      token = strtok (NULL, " ");
+    };
+  };
+  bus_args [bus_argc++] = c->directory;
+  bus_args [bus_argc++] = "1";
+  bus_args [bus_argc] = NULL;
+  bus_pid = -1;
+  if (status EQUALS 0)
+  {
+    bus_pid = conform_spawn (c->directory, bus_args);
+    sprintf (path, "%s/vbus-acu", c->directory);
+    status = conform_wait_path (path, 5000);
+    if (status != 0)
+      fprintf (stderr, "osdp-conform: %s: virtual bus did not start\n", c->name);
+  };
+  if (status EQUALS 0)
+  {
+    osdp_args [0] = osdp_program;
+    osdp_args [1] = "open-osdp-params.json";
+    osdp_args [2] = NULL;
+    pd_pid = conform_spawn (pd_path, osdp_args);
+    sprintf (path, "%s/open-osdp-control", pd_path);
+    status = conform_wait_path (path, 5000);
+  };
+  if (status EQUALS 0)
+  {
+    acu_pid = conform_spawn (acu_path, osdp_args);
+    sprintf (path, "%s/open-osdp-control", acu_path);
+    status = conform_wait_path (path, 5000);
+  };
+  if (status != 0)
+    fprintf (stderr, "osdp-conform: %s: open-osdp did not start\n", c->name);
+
+  // play the case
+
+  if (status EQUALS 0)
+  {
+    last_msec = 0;
+    for (i=0; i<c->step_count; i++)
+    {
+      step = c->step + i;
+      if (step->start_msec + ((long)(step->repeat-1) * step->interval_msec) > last_msec)
+        last_msec = step->start_msec + ((long)(step->repeat-1) * step->interval_msec);
+    };
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    now = 0;
+    while (now <= last_msec + settle_msec)
+    {
+      for (i=0; i<c->step_count; i++)
+      {
+        step = c->step + i;
+        if ((step->sent < step->repeat) &&
+          (now >= step->start_msec + ((long)(step->sent) * step->interval_msec)))
+        {
+          if (conform_send (strcmp (step->target, "pd") ? acu_path : pd_path, step->command) != 0)
+            fprintf (stderr, "osdp-conform: %s: could not send to %s: %s\n",
+              c->name, step->target, step->command);
+          step->sent ++;
+        };
+      };
+      conform_sleep_msec (5);
+      now = conform_msec_since (&start);
+    };
+
+    // each side writes results/report.log on dump-status
+
+    (void) conform_send (acu_path, "{ \"command\" : \"dump-status\" }");
+    (void) conform_send (pd_path, "{ \"command\" : \"dump-status\" }");
+    sprintf (path, "%s/results/report.log", acu_path);
+    if (conform_wait_path (path, 5000) != 0)
+      status = -1;
+    sprintf (path, "%s/results/report.log", pd_path);
+    if (conform_wait_path (path, 5000) != 0)
+      status = -1;
+    if (status != 0)
+      fprintf (stderr, "osdp-conform: %s: no report\n", c->name);
+  };
+
+  (void) conform_send (acu_path, "{ \"command\" : \"stop\" }");
+  (void) conform_send (pd_path, "{ \"command\" : \"stop\" }");
+  conform_stop (acu_pid, 2000);
+  conform_stop (pd_pid, 2000);
+  if (bus_pid > 0)
+    kill (bus_pid, SIGTERM);
+  conform_stop (bus_pid, 2000);
+  return (status);
+
+} /* conform_run_case */
+
+
+int
+  conform_load_suite
+    (char *path)
+
+{ /* conform_load_suite */
+
+  OO_CONFORM_CASE *c;
+  char line [2048];
+  int offset;
+  char *p;
+  int status;
+  OO_CONFORM_STEP *step;
+  FILE *sf;
+
+
+  status = 0;
+  c = NULL;
+  sf = fopen (path, "r");
+  if (sf EQUALS NULL)
+  {
+    fprintf (stderr, "osdp-conform: cannot open suite %s\n", path);
+    status = -1;
+  };
+  while ((status EQUALS 0) && (fgets (line, sizeof (line), sf) != NULL))
+  {
+    p = strchr (line, '\n');
+    if (p != NULL)
+      *p = 0;
+    if ((line [0] EQUALS '#') || (line [0] EQUALS 0))
+      continue;
+    offset = 0;
+    if (0 EQUALS strncmp (line, "case ", 5))
+    {
+      if (case_count >= OO_CONFORM_CASES_MAX)
+      {
+        fprintf (stderr, "osdp-conform: more than %d cases\n", OO_CONFORM_CASES_MAX);
+        status = -1;
+        break;
+      };
+      c = cases + case_count;
+      memset (c, 0, sizeof (*c));
+      sscanf (line+5, "%63s", c->name);
+      case_count ++;
+    }
+    else if (c EQUALS NULL)
+    {
+      fprintf (stderr, "osdp-conform: %s: \"%s\" before the first case\n", path, line);
+      status = -1;
+    }
+    else if (0 EQUALS strncmp (line, "acu-settings ", 13))
+      snprintf (c->acu_settings, sizeof (c->acu_settings), "%s", line+13);
+    else if (0 EQUALS strncmp (line, "pd-settings ", 12))
+      snprintf (c->pd_settings, sizeof (c->pd_settings), "%s", line+12);
+    else if (c->step_count < OO_CONFORM_STEPS_MAX)
+    {
+      step = c->step + c->step_count;
+      memset (step, 0, sizeof (*step));
+      if (4 EQUALS sscanf (line, "%d %d %d %31s %n", &(step->start_msec), &(step->repeat),
+        &(step->interval_msec), step->target, &offset))
+      {
+        snprintf (step->command, sizeof (step->command), "%s", line+offset);
+        c->step_count ++;
+      }
+      else
+      {
+        fprintf (stderr, "osdp-conform: %s: case %s: cannot read \"%s\"\n", path, c->name, line);
+        status = -1;
+      };
+    };
+  };
+  if (sf != NULL)
+    fclose (sf);
+  return (status);
+
+} /* conform_load_suite */
+
+
+void
+  conform_copy
+    (char *from,
+    char *to)
+
+{ /* conform_copy */
+
+  char buffer [4096];
+  FILE *in;
+  size_t lth;
+  FILE *out;
+
+
+  in = fopen (from, "r");
+  out = fopen (to, "w");
+  while ((in != NULL) && (out != NULL) && ((lth = fread (buffer, 1, sizeof (buffer), in)) > 0))
+    fwrite (buffer, 1, lth, out);
+  if (in != NULL)
+    fclose (in);
+  if (out != NULL)
+    fclose (out);
+
+} /* conform_copy */
+
+
+/*
+  conform_rank - which of two results for the same test wins the merge
+*/
+
+int
+  conform_rank
+    (int test_status)
+
+{ /* conform_rank */
+
+  int rank;
+
+
+  rank = 0;
+  switch (test_status)
+  {
+  case OCONFORM_FAIL:         rank = 4; break;
+  case OCONFORM_EXERCISED:    rank = 3; break;
+  case OCONFORM_EX_GOOD_ONLY: rank = 2; break;
+  case OCONFORM_SKIP:         rank = 1; break;
+  };
+  return (rank);
+
+} /* conform_rank */
+
+
+/*
+  conform_merge - one side's results from every case, into one report
+
+  side is "acu" or "pd".  returns the number of failed tests.
+*/
+
+int
+  conform_merge
+    (char *run_directory,
+    char *side,
+    int role)
+
+{ /* conform_merge */
+
+  char aux [1024];
+  int count;
+  DIR *d;
+  struct dirent *entry;
+  int exercised;
+  int failed;
+  int i;
+  int j;
+  char merged [2048];
+  char path [3072];
+  OO_CONFORM_RESULT *r;
+  static OO_CONFORM_RESULT results [OO_CONFORM_RESULTS_MAX];
+  json_t *root;
+  json_error_t error;
+  int test_status;
+  json_t *value;
+
+
+  count = 0;
+  for (i=0; i<case_count; i++)
+  {
+    sprintf (path, "%s/%s/results", cases [i].directory, side);
+    d = opendir (path);
+    while ((d != NULL) && ((entry = readdir (d)) != NULL))
+    {
+      if (strstr (entry->d_name, "-results.json") EQUALS NULL)
+        continue;
+      sprintf (path, "%s/%s/results/%s", cases [i].directory, side, entry->d_name);
+      root = json_load_file (path, 0, &error);
+      value = json_object_get (root, "test");
+      if (json_is_string (value))
+      {
+        test_status = OCONFORM_UNTESTED;
+        sscanf (json_string_value (json_object_get (root, "test-status")) ? : "0", "%d", &test_status);
+        r = NULL;
+        for (j=0; j<count; j++)
+          if (0 EQUALS strcmp (results [j].test, json_string_value (value)))
+            r = results + j;
+        if ((r EQUALS NULL) && (count < OO_CONFORM_RESULTS_MAX))
+        {
+          r = results + count;
+          count ++;
+          snprintf (r->test, sizeof (r->test), "%s", json_string_value (value));
+          r->status = test_status;
+          r->case_index = i;
+        };
+        if ((r != NULL) && (conform_rank (test_status) > conform_rank (r->status)))
+        {
+          r->status = test_status;
+          r->case_index = i;
+        };
+        if ((r != NULL) && (r->case_index EQUALS i))
+        {
+          r->in_table = (json_object_get (root, "test-description") != NULL);
+          snprintf (r->path, sizeof (r->path), "%s", path);
+        };
+      };
+      if (root != NULL)
+        json_decref (root);
+    };
+    if (d != NULL)
+      closedir (d);
+  };
+
+  // set the merged results in the conformance table and let it write the files and the report
+
+  sprintf (merged, "%s/merged", run_directory);
+  (void) mkdir (merged, 0755);
+  sprintf (merged, "%s/merged/%s", run_directory, side);
+  (void) mkdir (merged, 0755);
+  sprintf (path, "%s/results", merged);
+  (void) mkdir (path, 0755);
+  memset (&osdp_conformance, 0, sizeof (osdp_conformance));
+  strncpy (context.service_root, merged, sizeof (context.service_root)-1);
+  context.role = role;
+  exercised = 0;
+  failed = 0;
+  for (j=0; j<count; j++)
+  {
+    // records the table doesn't list (the capability reports, for one) are copied as they are
+
+    if (results [j].in_table)
+    {
+      sprintf (aux, "\"case\":\"%s\",", cases [results [j].case_index].name);
+      osdp_test_set_status_ex (results [j].test, results [j].status, aux);
+    }
+    else
+    {
+      sprintf (path, "%s/results/%s-results.json", merged, results [j].test);
+      conform_copy (results [j].path, path);
+    };
+    if (results [j].status EQUALS OCONFORM_FAIL)
+    {
+      failed ++;
+      printf ("  %s: %s failed in case %s\n", side, results [j].test, cases [results [j].case_index].name);
+    };
+    if (results [j].status EQUALS OCONFORM_EXERCISED)
+      exercised ++;
+  };
+  dump_conformance (&context, &osdp_conformance);
+  printf ("%s side: %d. tests exercised, %d. failed, report in %s/results/report.log\n",
+    side, exercised, failed, merged);
+  return (failed);
+
+} /* conform_merge */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for osdp-conform */
+
+  OO_CONFORM_CASE *c;
+  int done_count;
+  int failed;
+  int i;
+  int jobs;
+  char log_path [2048];
+  int next;
+  int option;
+  pid_t pid;
+  int running;
+  char *run_directory;
+  struct timespec start;
+  int status;
+  int wait_status;
+
+
+  status = ST_OK;
+  osdp_program = "./open-osdp";
+  bus_program = "../test/bench/osdp-vbus";
+  bus_options = NULL;
+  run_directory = "conform-run";
+  jobs = sysconf (_SC_NPROCESSORS_ONLN);
+  settle_msec = 1000;
+  verbosity = 3;
+  while ((option = getopt (argc, argv, "B:b:d:j:s:v:x:")) != -1)
+  {
+    switch (option)
+    {
+    case 'B': bus_options = optarg; break;
+    case 'b': bus_program = optarg; break;
+    case 'd': run_directory = optarg; break;
+    case 'j': jobs = atoi (optarg); break;
+    case 's': settle_msec = atoi (optarg); break;
+    case 'v': verbosity = atoi (optarg); break;
+    case 'x': osdp_program = optarg; break;
+    default:
+      status = -1;
+      break;
+    };
+  };
+  if ((status != ST_OK) || (optind >= argc))
+  {
+    fprintf (stderr,
+"Usage: osdp-conform [-x open-osdp] [-b osdp-vbus] [-B bus-options] [-d run-directory]\n"
+"         [-j jobs] [-s settle-msec] [-v verbosity] suite ...\n");
+    return (1);
+  };
+  if (jobs < 1)
+    jobs = 1;
+  if (jobs > OO_CONFORM_JOBS_MAX)
+    jobs = OO_CONFORM_JOBS_MAX;
+  signal (SIGPIPE, SIG_IGN);
+
+  // programs are started from inside the case directories, so use absolute paths
+
+  osdp_program = realpath (osdp_program, NULL);
+  bus_program = realpath (bus_program, NULL);
+  if ((osdp_program EQUALS NULL) || (bus_program EQUALS NULL))
+  {
+    fprintf (stderr, "osdp-conform: open-osdp or osdp-vbus not found\n");
+    status = -1;
+  };
+  for (i=optind; (status EQUALS ST_OK) && (i<argc); i++)
+    status = conform_load_suite (argv [i]);
+  if (status EQUALS ST_OK)
+  {
+    (void) mkdir (run_directory, 0755);
+    run_directory = realpath (run_directory, NULL);
+    if (run_directory EQUALS NULL)
+      status = -1;
+  };
+  for (i=0; (status EQUALS ST_OK) && (i<case_count); i++)
+  {
+    char name [64];
+
+    strcpy (name, cases [i].name);
+    snprintf (cases [i].directory, sizeof (cases [i].directory), "%s/%03d-%s", run_directory, i+1, name);
+  };
+
+  // keep up to jobs cases running, each in its own process
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  next = 0;
+  running = 0;
+  done_count = 0;
+  failed = 0;
+  while ((status EQUALS ST_OK) && (done_count < case_count))
+  {
+    while ((running < jobs) && (next < case_count))
+    {
+      c = cases + next;
+      clock_gettime (CLOCK_MONOTONIC, &(c->started));
+      c->pid = fork ();
+      if (c->pid EQUALS 0)
+        exit (conform_run_case (c) EQUALS 0 ? 0 : 1);
+      running ++;
+      next ++;
+    };
+    pid = wait (&wait_status);
+    for (i=0; i<next; i++)
+    {
+      c = cases + i;
+      if ((pid > 0) && (c->pid EQUALS pid))
+      {
+        c->pid = 0;
+        c->exit_status = WIFEXITED (wait_status) ? WEXITSTATUS (wait_status) : -1;
+        c->msec = conform_msec_since (&(c->started));
+        printf ("case %03d %-24s %s %ld.%03ld sec\n", i+1, c->name,
+          (c->exit_status EQUALS 0) ? "done" : "FAILED TO RUN", c->msec/1000, c->msec%1000);
+        fflush (stdout);
+        if (c->exit_status != 0)
+          failed ++;
+        running --;
+        done_count ++;
+      };
+    };
+  };
+
+  // merge each side's results into one report
+
+  if (status EQUALS ST_OK)
+  {
+    memset (&context, 0, sizeof (context));
+    context.verbosity = verbosity;
+    (void) oo_log_levels (&context);
+    sprintf (log_path, "%s/merge.log", run_directory);
+    context.log = fopen (log_path, "w");
+    if (context.log EQUALS NULL)
+      context.log = stderr;
+    strcpy (context.serial_speed, "9600");
+    failed = failed + conform_merge (run_directory, "acu", OSDP_ROLE_ACU);
+    failed = failed + conform_merge (run_directory, "pd", OSDP_ROLE_PD);
+    printf ("%d. cases in %ld. sec with %d. at a time\n",
+      case_count, conform_msec_since (&start) / 1000, jobs);
+  };
+  return ((status EQUALS ST_OK) && (failed EQUALS 0) ? 0 : 1);
+
+} /* main for osdp-conform */
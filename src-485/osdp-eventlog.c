@@ -0,0 +1,639 @@
+/*
+  osdp-eventlog - show a binary event log as the text log would have had it
+
+  Usage:
+    osdp-eventlog [-v verbosity] [-s] [-j summary.json] osdp-events.bin
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+*/
+
+/*
+  each record is turned back into the lines open-osdp would have written
+  to osdp.log, using the same formatting routines, so the output can be
+  diffed against a text log.  what shows depends on the verbosity each
+  record was logged at, as it did live.  -v shows the frames as they would
+  be at that verbosity instead (every frame is in the log whatever the
+  verbosity was); records that are only made at a higher verbosity still
+  show.  times are shown in local time, as open-osdp did, so set
+  TZ if the log came from elsewhere.
+
+  -s writes counts instead of the text: events, frames by command and
+  reply, NAKs by error code, sequence mismatches and timeouts.  -j writes
+  the same counts as JSON.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#include <open-osdp.h>
+#include <osdp_conformance.h>
+#include <oo-eventlog.h>
+
+
+#define OO_EVLOG_VALUES_MAX (16) // fields in one record
+
+
+typedef struct oo_evlog_value
+{
+  int type; // OO_EVLOG_FIELD_...
+  unsigned int value;
+  unsigned char *octets; // 'x' and 's'
+  int length;
+} OO_EVLOG_VALUE;
+
+typedef struct oo_evlog_stats
+{
+  unsigned long long bad_records;
+  unsigned long long commands [256];
+  unsigned long long events [OO_EVLOG_EVENTS];
+  unsigned long long naks_received [256];
+  unsigned long long naks_sent [256];
+  unsigned long long records;
+  unsigned long long replies [256];
+  unsigned long long timeouts [3];
+  long long first_sec;
+  long long last_sec;
+} OO_EVLOG_STATS;
+
+
+int check_for_command;
+OSDP_CONTEXT context;
+struct timespec last_time_check_ex;
+OSDP_BUFFER osdp_buf;
+OSDP_INTEROP_ASSESSMENT osdp_conformance;
+OSDP_OUT_CMD current_output_command [16];
+OSDP_PARAMETERS p_card;
+char tag [16];
+char trace_in_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+char trace_out_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+unsigned char last_message_sent [2048];
+int last_message_sent_length;
+unsigned char creds_buffer_a [64*1024];
+int creds_buffer_a_lth;
+int creds_buffer_a_next;
+int creds_buffer_a_remaining;
+
+OO_EVLOG_STATS evlog_stats;
+static char *evlog_event_name [OO_EVLOG_EVENTS] =
+  { "", "frame", "message", "sequence", "nak-received", "nak-sent", "timeout", "text" };
+
+
+// nothing is sent from here
+
+int
+  send_osdp_data
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buf,
+    int lth)
+
+{ /* send_osdp_data */
+
+  return (ST_OK);
+
+} /* send_osdp_data */
+
+
+/*
+  evlog_fields - split a record's fields into values
+
+  returns the number of values, or -1 if the fields don't add up.
+*/
+
+int
+  evlog_fields
+    (unsigned char *fields,
+    int length,
+    OO_EVLOG_VALUE *values)
+
+{ /* evlog_fields */
+
+  int count;
+  unsigned char *end;
+  unsigned char *f;
+  unsigned short int value_short;
+
+
+  count = 0;
+  f = fields;
+  end = fields + length;
+  while ((f < end) && (count < OO_EVLOG_VALUES_MAX))
+  {
+    memset (values+count, 0, sizeof (values [0]));
+    values [count].type = *(f++);
+    switch (values [count].type)
+    {
+    case OO_EVLOG_FIELD_OCTET:
+      if ((f + 1) > end)
+        return (-1);
+      values [count].value = *(f++);
+      break;
+    case OO_EVLOG_FIELD_SHORT:
+      if ((f + sizeof (value_short)) > end)
+        return (-1);
+      memcpy (&value_short, f, sizeof (value_short));
+      values [count].value = value_short;
+      f = f + sizeof (value_short);
+      break;
+    case OO_EVLOG_FIELD_INT:
+      if ((f + sizeof (values [count].value)) > end)
+        return (-1);
+      memcpy (&(values [count].value), f, sizeof (values [count].value));
+      f = f + sizeof (values [count].value);
+      break;
+    case OO_EVLOG_FIELD_OCTETS:
+    case OO_EVLOG_FIELD_STRING:
+      if ((f + sizeof (value_short)) > end)
+        return (-1);
+      memcpy (&value_short, f, sizeof (value_short));
+      f = f + sizeof (value_short);
+      if ((f + value_short) > end)
+        return (-1);
+      values [count].octets = f;
+      values [count].length = value_short;
+      f = f + value_short;
+      break;
+    default:
+      return (-1);
+    };
+    count ++;
+  };
+  return (count);
+
+} /* evlog_fields */
+
+
+/*
+  evlog_match - the values are what the event should have
+*/
+
+int
+  evlog_match
+    (OO_EVLOG_VALUE *values,
+    int count,
+    char *fields)
+
+{ /* evlog_match */
+
+  int i;
+
+
+  if (count != strlen (fields))
+    return (0);
+  for (i=0; i<count; i++)
+    if (values [i].type != fields [i])
+      return (0);
+  return (1);
+
+} /* evlog_match */
+
+
+/*
+  evlog_render_message - the header and Pkt lines, as osdp_parse_message writes them
+*/
+
+void
+  evlog_render_message
+    (OSDP_CONTEXT *ctx,
+    OO_EVLOG_VALUE *values)
+
+{ /* evlog_render_message */
+
+  char check_tag [64];
+  char cmd_rep_tag [1024];
+  int command;
+  int crc_offset;
+  unsigned char frame [OO_EVLOG_FIELDS_MAX + 2];
+  char log_line [3*1024];
+  OSDP_MSG m;
+  OSDP_HDR *p;
+  char scb_tag [64];
+  int show;
+  char tlogmsg [1024];
+  char tlogmsg2 [1024];
+
+
+  command = values [1].value;
+  if ((values [6].length < (int)sizeof (*p)) || ((ctx->verbosity <= 2) && (values [3].value EQUALS 0)))
+    return;
+
+  // the check octets are put back where the parse found them (one past the frame for a checksum)
+
+  memset (frame, 0, sizeof (frame));
+  memcpy (frame, values [6].octets, values [6].length);
+  crc_offset = values [4].value;
+  if (crc_offset >= values [6].length)
+    crc_offset = 0;
+  frame [crc_offset] = values [5].value & 0xff;
+  frame [crc_offset+1] = values [5].value >> 8;
+  p = (OSDP_HDR *)frame;
+  memset (&m, 0, sizeof (m));
+  m.ptr = frame;
+  m.lth = values [6].length;
+  m.crc_check = frame + crc_offset;
+  m.check_size = 1;
+  if (p->ctrl & 0x04)
+    m.check_size = 2;
+  show = ((command != OSDP_POLL) && (command != OSDP_ACK)) || (ctx->verbosity > 3);
+
+  strcpy (cmd_rep_tag, osdp_command_reply_to_string (command, values [2].value));
+  (void) oosdp_message_header_print (ctx, &m, tlogmsg);
+  if (show)
+  {
+    fprintf (ctx->log, "%s\n", tlogmsg);
+    tlogmsg [0] = 0;
+    if (ctx->verbosity > 3)
+      dump_buffer_log (ctx, "  Raw input: ", m.ptr, m.lth);
+  };
+  sprintf (log_line, "  Pkt %04d Msg %s %s", values [0].value, cmd_rep_tag, tlogmsg);
+  if (p->ctrl & 0x04)
+    sprintf (check_tag, "Check:CRC(%04x)", values [5].value);
+  else
+    strcpy (check_tag, "Check:Cksum");
+  strcpy (scb_tag, "");
+  if (p->ctrl & 0x08)
+    strcpy (scb_tag, "Sec block present;");
+  sprintf (tlogmsg2, " A:%02x Lth:%d. S:%02x %s %s",
+    (0x7F & p->addr), (p->len_msb)*256+(p->len_lsb),
+    p->ctrl & 0x03, check_tag, scb_tag);
+  strcat (log_line, tlogmsg2);
+  if (show)
+    fprintf (ctx->log, "%s\n", log_line);
+
+} /* evlog_render_message */
+
+
+/*
+  evlog_render - one record's lines
+*/
+
+void
+  evlog_render
+    (OSDP_CONTEXT *ctx,
+    int file_role,
+    OO_EVLOG_RECORD *record,
+    OO_EVLOG_VALUE *values)
+
+{ /* evlog_render */
+
+  struct tm cooked_time;
+  char *nak_detail;
+  char *role_tag [] = { "", "ACU", "PD" };
+  time_t time_sec;
+  char address_suffix [1024];
+
+
+  switch (record->event)
+  {
+  case OO_EVLOG_FRAME:
+    if ((file_role EQUALS OSDP_ROLE_MONITOR) || (ctx->verbosity >= values [1].value))
+    {
+      time_sec = record->time_sec;
+      (void) localtime_r (&time_sec, &cooked_time);
+      if (values [0].value EQUALS 1)
+        sprintf (address_suffix, " DestAddr=%02x(hex)", values [2].value);
+      else
+        sprintf (address_suffix, " A=%02x(hex)", values [2].value);
+      fprintf (ctx->log,
+"\n---OSDP %s Frame:%04d%s Timestamp:%04d%02d%02d-%02d%02d%02d (Sec/Nanosec: %09ld %09ld)\n",
+        role_tag [values [0].value % 3], values [3].value, address_suffix,
+        1900+cooked_time.tm_year, 1+cooked_time.tm_mon, cooked_time.tm_mday,
+        cooked_time.tm_hour, cooked_time.tm_min, cooked_time.tm_sec,
+        (long)record->time_sec, (long)record->time_nsec);
+      fprintf (ctx->log, "%.*s", values [4].length, values [4].octets);
+    };
+    break;
+
+  case OO_EVLOG_MESSAGE:
+    evlog_render_message (ctx, values);
+    break;
+
+  case OO_EVLOG_SEQUENCE:
+    fprintf (ctx->log, "DEBUG: bad seq bcount %d 0=%02x 1=%02x 2=%02x 5=%02x 6=%02x\n",
+      values [0].value, values [1].value, values [2].value, values [3].value,
+      values [4].value, values [5].value);
+    fprintf (ctx->log, "***sequence number mismatch got %d expected %d\n",
+      values [6].value, values [7].value);
+    break;
+
+  case OO_EVLOG_NAK_RECEIVED:
+    // the error code was a (signed) char when it was printed
+    if (values [0].value)
+      fprintf (ctx->log, "osdp_NAK: Error Code %02x Data %02x\n", (char)(values [1].value), values [2].value);
+    else
+      fprintf (ctx->log, "osdp_NAK: Error Code %02x\n", (char)(values [1].value));
+    nak_detail = NULL;
+    switch (values [1].value)
+    {
+    case OO_NAK_CHECK_CRC:
+      nak_detail = "  NAK: (1)Bad CRC/Checksum\n";
+      break;
+    case OO_NAK_UNK_CMD:
+      nak_detail = "  NAK: (3)Command not implemented by PD\n";
+      break;
+    case OO_NAK_SEQUENCE:
+      nak_detail = "  NAK: (4)Unexpected sequence number\n";
+      break;
+    case OO_NAK_UNSUP_SECBLK:
+      nak_detail = "  NAK: (5)Security block not accepted.\n";
+      break;
+    case OO_NAK_ENC_REQ:
+      fprintf (ctx->log, "  NAK: (%d)Encryption required.\n", (char)(values [1].value));
+      break;
+    };
+    if (nak_detail != NULL)
+      fprintf (ctx->log, "%s", nak_detail);
+    break;
+
+  case OO_EVLOG_NAK_SENT:
+    if (ctx->verbosity > 3)
+      fprintf (ctx->log, "NAK: response %d.\n", values [0].value);
+    break;
+
+  case OO_EVLOG_TIMEOUT:
+    if (values [0].value EQUALS OO_EVLOG_TIMEOUT_POLL)
+    {
+      if (ctx->verbosity > 3)
+        fprintf (ctx->log, "Timeout while polling, retries (%d) exceeded.)\n", values [1].value);
+    };
+    if (values [0].value EQUALS OO_EVLOG_TIMEOUT_WAIT)
+      fprintf (ctx->log, "Background: waiting for response (%d)\n", values [1].value);
+    if (values [0].value EQUALS OO_EVLOG_TIMEOUT_EXPIRED)
+      fprintf (ctx->log, "Background: timed out waiting for response, polling.\n");
+    break;
+
+  case OO_EVLOG_TEXT:
+    if ((file_role EQUALS OSDP_ROLE_MONITOR) || (ctx->verbosity >= values [0].value))
+      fprintf (ctx->log, "%.*s", values [1].length, values [1].octets);
+    break;
+  };
+
+} /* evlog_render */
+
+
+/*
+  evlog_tally - count what a record was
+*/
+
+void
+  evlog_tally
+    (OO_EVLOG_RECORD *record,
+    OO_EVLOG_VALUE *values)
+
+{ /* evlog_tally */
+
+  evlog_stats.events [record->event] ++;
+  if (evlog_stats.first_sec EQUALS 0)
+    evlog_stats.first_sec = record->time_sec;
+  evlog_stats.last_sec = record->time_sec;
+  switch (record->event)
+  {
+  case OO_EVLOG_MESSAGE:
+    if (values [2].value)
+      evlog_stats.replies [values [1].value & 0xff] ++;
+    else
+      evlog_stats.commands [values [1].value & 0xff] ++;
+    break;
+  case OO_EVLOG_NAK_RECEIVED:
+    evlog_stats.naks_received [values [1].value & 0xff] ++;
+    break;
+  case OO_EVLOG_NAK_SENT:
+    evlog_stats.naks_sent [values [0].value & 0xff] ++;
+    break;
+  case OO_EVLOG_TIMEOUT:
+    evlog_stats.timeouts [values [0].value % 3] ++;
+    break;
+  };
+
+} /* evlog_tally */
+
+
+/*
+  evlog_summary - the counts, as text or JSON
+*/
+
+void
+  evlog_summary
+    (FILE *sf,
+    int json)
+
+{ /* evlog_summary */
+
+  int code;
+  int event;
+  char *separator;
+
+
+  if (!json)
+  {
+    fprintf (sf, "osdp-eventlog: %llu. records, %llu. bad, %lld sec of log\n",
+      evlog_stats.records, evlog_stats.bad_records, evlog_stats.last_sec - evlog_stats.first_sec);
+    for (event=1; event<OO_EVLOG_EVENTS; event++)
+      fprintf (sf, "  %-20s %llu.\n", evlog_event_name [event], evlog_stats.events [event]);
+    for (code=0; code<256; code++)
+      if (evlog_stats.commands [code] > 0)
+        fprintf (sf, "  %-20s %llu.\n", osdp_command_reply_to_string (code, 0), evlog_stats.commands [code]);
+    for (code=0; code<256; code++)
+      if (evlog_stats.replies [code] > 0)
+        fprintf (sf, "  %-20s %llu.\n", osdp_command_reply_to_string (code, 0x80), evlog_stats.replies [code]);
+    for (code=0; code<256; code++)
+      if (evlog_stats.naks_received [code] > 0)
+        fprintf (sf, "  NAK received %02x     %llu.\n", code, evlog_stats.naks_received [code]);
+    for (code=0; code<256; code++)
+      if (evlog_stats.naks_sent [code] > 0)
+        fprintf (sf, "  NAK sent %02x         %llu.\n", code, evlog_stats.naks_sent [code]);
+    fprintf (sf, "  timeouts: poll %llu. waiting %llu. expired %llu.\n",
+      evlog_stats.timeouts [OO_EVLOG_TIMEOUT_POLL], evlog_stats.timeouts [OO_EVLOG_TIMEOUT_WAIT],
+      evlog_stats.timeouts [OO_EVLOG_TIMEOUT_EXPIRED]);
+  }
+  else
+  {
+    fprintf (sf, "{\n  \"records\" : \"%llu\", \"bad-records\" : \"%llu\", \"log-seconds\" : \"%lld\",\n",
+      evlog_stats.records, evlog_stats.bad_records, evlog_stats.last_sec - evlog_stats.first_sec);
+    fprintf (sf, "  \"events\" : {");
+    separator = "";
+    for (event=1; event<OO_EVLOG_EVENTS; event++)
+    {
+      fprintf (sf, "%s \"%s\" : \"%llu\"", separator, evlog_event_name [event], evlog_stats.events [event]);
+      separator = ",";
+    };
+    fprintf (sf, " },\n  \"commands\" : {");
+    separator = "";
+    for (code=0; code<256; code++)
+      if (evlog_stats.commands [code] > 0)
+      {
+        fprintf (sf, "%s \"%02x\" : \"%llu\"", separator, code, evlog_stats.commands [code]);
+        separator = ",";
+      };
+    fprintf (sf, " },\n  \"replies\" : {");
+    separator = "";
+    for (code=0; code<256; code++)
+      if (evlog_stats.replies [code] > 0)
+      {
+        fprintf (sf, "%s \"%02x\" : \"%llu\"", separator, code, evlog_stats.replies [code]);
+        separator = ",";
+      };
+    fprintf (sf, " },\n  \"naks-received\" : {");
+    separator = "";
+    for (code=0; code<256; code++)
+      if (evlog_stats.naks_received [code] > 0)
+      {
+        fprintf (sf, "%s \"%02x\" : \"%llu\"", separator, code, evlog_stats.naks_received [code]);
+        separator = ",";
+      };
+    fprintf (sf, " },\n  \"naks-sent\" : {");
+    separator = "";
+    for (code=0; code<256; code++)
+      if (evlog_stats.naks_sent [code] > 0)
+      {
+        fprintf (sf, "%s \"%02x\" : \"%llu\"", separator, code, evlog_stats.naks_sent [code]);
+        separator = ",";
+      };
+    fprintf (sf, " },\n  \"timeouts\" : { \"poll\" : \"%llu\", \"waiting\" : \"%llu\", \"expired\" : \"%llu\" }\n}\n",
+      evlog_stats.timeouts [OO_EVLOG_TIMEOUT_POLL], evlog_stats.timeouts [OO_EVLOG_TIMEOUT_WAIT],
+      evlog_stats.timeouts [OO_EVLOG_TIMEOUT_EXPIRED]);
+  };
+
+} /* evlog_summary */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for osdp-eventlog */
+
+  int count;
+  unsigned char fields [OO_EVLOG_FIELDS_MAX];
+  OO_EVLOG_HEADER header;
+  FILE *ef;
+  FILE *jf;
+  char *json_path;
+  int level;
+  int option;
+  OO_EVLOG_RECORD record;
+  int status;
+  int summary;
+  OO_EVLOG_VALUE values [OO_EVLOG_VALUES_MAX];
+  int verbosity;
+  static char *wanted [OO_EVLOG_EVENTS] =
+    { "", "bbbus", "ubbbhhx", "ubbbbbbb", "bbb", "b", "bb", "bs" };
+
+
+  status = ST_OK;
+  json_path = NULL;
+  summary = 0;
+  verbosity = -1;
+  while ((option = getopt (argc, argv, "j:sv:")) != -1)
+  {
+    switch (option)
+    {
+    case 'j':
+      json_path = optarg;
+      break;
+    case 's':
+      summary = 1;
+      break;
+    case 'v':
+      verbosity = atoi (optarg);
+      break;
+    default:
+      status = -1;
+      break;
+    };
+  };
+  if ((status != ST_OK) || (optind != (argc-1)))
+  {
+    fprintf (stderr, "Usage: osdp-eventlog [-v verbosity] [-s] [-j summary.json] osdp-events.bin\n");
+    return (1);
+  };
+
+  memset (&context, 0, sizeof (context));
+  context.log = stdout;
+  ef = fopen (argv [optind], "r");
+  if (ef EQUALS NULL)
+  {
+    fprintf (stderr, "osdp-eventlog: cannot open %s\n", argv [optind]);
+    status = ST_EVENT_LOG_OPEN;
+  };
+  if (status EQUALS ST_OK)
+  {
+    if ((1 != fread (&header, sizeof (header), 1, ef)) ||
+      (0 != memcmp (header.magic, OO_EVLOG_MAGIC, sizeof (header.magic))))
+    {
+      fprintf (stderr, "osdp-eventlog: %s is not an event log\n", argv [optind]);
+      status = ST_EVENT_LOG_OPEN;
+    };
+  };
+  if (status EQUALS ST_OK)
+  {
+    context.role = header.role;
+    while (1 EQUALS fread (&record, sizeof (record), 1, ef))
+    {
+      // a record cut short at the end (the writer was killed) is the end
+
+      if ((record.length > sizeof (fields)) ||
+        ((record.length > 0) && (1 != fread (fields, record.length, 1, ef))))
+        break;
+      evlog_stats.records ++;
+      count = evlog_fields (fields, record.length, values);
+      if ((record.event EQUALS 0) || (record.event >= OO_EVLOG_EVENTS) ||
+        !evlog_match (values, count, wanted [record.event]))
+      {
+        evlog_stats.bad_records ++;
+        continue;
+      };
+      evlog_tally (&record, values);
+      if (!summary)
+      {
+        level = record.verbosity;
+        if (verbosity >= 0)
+          level = verbosity;
+        if (level != context.verbosity)
+        {
+          context.verbosity = level;
+          (void) oo_log_levels (&context);
+        };
+        evlog_render (&context, header.role, &record, values);
+      };
+    };
+    fclose (ef);
+
+    if (summary)
+      evlog_summary (stdout, 0);
+    if (json_path != NULL)
+    {
+      jf = fopen (json_path, "w");
+      if (jf != NULL)
+      {
+        evlog_summary (jf, 1);
+        fclose (jf);
+      };
+    };
+  };
+  if (status != ST_OK)
+    return (1);
+  return (0);
+
+} /* main for osdp-eventlog */
+
@@ -0,0 +1,400 @@
+/*
+  osdp-replay - run an osdpcap capture through the monitor decoder offline
+
+  Usage:
+    osdp-replay [-o log] [-e events.bin] [-v verbosity] [-l log-levels] [-r service-root] [-j stats.json] capture.osdpcap ...
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+*/
+
+/*
+  the octets in each record's "data" go through the same framer the
+  monitor's capture thread uses, stamped with the record's time, and each
+  frame through the same parse, log text and conformance marking as a live
+  monitor.  no serial port, lock file, trace file or config is involved.
+  "-" reads the capture from stdin.
+
+  a capture can hold millions of records so the log is flushed at the end
+  rather than per frame.
+
+  the log goes to stdout unless -o says otherwise.  conformance results
+  land in <service-root>/results (default ".") when verbosity is above 0.
+  a summary goes to stderr and, with -j, to a JSON file.
+
+  -e writes the frames to a binary event log instead of as text to the
+  log, as the "event-log" setting does (osdp-eventlog shows it.)
+*/
+
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+#include <open-osdp.h>
+#include <osdp_conformance.h>
+#include <osdpcap.h>
+
+
+#define OO_REPLAY_LOG_BUFFER (1024*1024)
+
+
+typedef struct oo_replay_stats
+{
+  unsigned long long bad_records; // lines without (all) good data
+  unsigned long long commands [256];
+  unsigned long long frames;
+  unsigned long long octets;
+  unsigned long long records;
+  unsigned long long replies [256];
+  unsigned long long secure; // frames with a security control block
+  struct timespec first;
+  struct timespec last;
+} OO_REPLAY_STATS;
+
+
+int check_for_command;
+OSDP_CONTEXT context;
+struct timespec last_time_check_ex;
+OSDP_BUFFER osdp_buf;
+OSDP_INTEROP_ASSESSMENT osdp_conformance;
+OSDP_OUT_CMD current_output_command [16];
+OSDP_PARAMETERS p_card;
+char tag [16];
+char trace_in_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+char trace_out_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+unsigned char last_message_sent [2048];
+int last_message_sent_length;
+unsigned char creds_buffer_a [64*1024];
+int creds_buffer_a_lth;
+int creds_buffer_a_next;
+int creds_buffer_a_remaining;
+
+OO_REPLAY_STATS replay_stats;
+
+
+// a monitor never transmits
+
+int
+  send_osdp_data
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buf,
+    int lth)
+
+{ /* send_osdp_data */
+
+  return (ST_OK);
+
+} /* send_osdp_data */
+
+
+/*
+  replay_tally - count a frame by command or reply
+
+  (the parse counts CRC, checksum, sequence and MAC errors in the context.)
+*/
+
+void
+  replay_tally
+    (OO_MONITOR_FRAME *frame)
+
+{ /* replay_tally */
+
+  int code_offset;
+
+
+  replay_stats.frames ++;
+  replay_stats.octets = replay_stats.octets + frame->length;
+
+  // the command or reply code follows the SCB if there is one
+
+  code_offset = offsetof (OSDP_HDR, command);
+  if (frame->octets [offsetof (OSDP_HDR, ctrl)] & OSDP_CONTROLBIT_SCS)
+  {
+    replay_stats.secure ++;
+    code_offset = code_offset + frame->octets [code_offset];
+  };
+  if (code_offset < frame->length)
+  {
+    if (frame->octets [offsetof (OSDP_HDR, addr)] & 0x80)
+      replay_stats.replies [frame->octets [code_offset]] ++;
+    else
+      replay_stats.commands [frame->octets [code_offset]] ++;
+  };
+
+} /* replay_tally */
+
+
+/*
+  replay_file - feed one capture through the framer and the decoder
+*/
+
+int
+  replay_file
+    (OSDP_CONTEXT *ctx,
+    char *path,
+    OO_MONITOR_FRAMER *framer)
+
+{ /* replay_file */
+
+  FILE *cf;
+  long long gap;
+  int i;
+  char *line;
+  size_t line_size;
+  static OSDPCAP_RECORD record;
+  int status;
+
+
+  status = ST_OK;
+  cf = stdin;
+  if (strcmp (path, "-") != 0)
+    cf = fopen (path, "r");
+  if (cf EQUALS NULL)
+  {
+    fprintf (stderr, "osdp-replay: cannot open %s\n", path);
+    status = ST_OSDP_BAD_TRANSFER_FILE;
+  };
+  line = NULL;
+  line_size = 0;
+  while ((status EQUALS ST_OK) && (getline (&line, &line_size, cf) > 0))
+  {
+    replay_stats.records ++;
+
+    // what there is of a bad record still goes to the framer, as it would off the line
+
+    if (oo_osdpcap_parse (line, &record) != ST_OK)
+      replay_stats.bad_records ++;
+    if (record.length EQUALS 0)
+      continue;
+    if (replay_stats.first.tv_sec EQUALS 0)
+      replay_stats.first = record.captured;
+
+    // same rule as on the line: a frame that stopped part way is not going to finish
+
+    gap = (record.captured.tv_sec - replay_stats.last.tv_sec) * 1000LL +
+      (record.captured.tv_nsec - replay_stats.last.tv_nsec) / 1000000LL;
+    if ((framer->frame.length > 0) && (gap > OO_MONITOR_GAP_MSEC))
+      oo_monitor_frame_reset (framer);
+    replay_stats.last = record.captured;
+
+    for (i=0; i<record.length; i++)
+      if (oo_monitor_frame_octet (framer, record.octets [i], &(record.captured)))
+      {
+        ctx->bytes_received = ctx->bytes_received + framer->frame.length;
+        (void) oo_monitor_decode (ctx, &(framer->frame));
+        replay_tally (&(framer->frame));
+      };
+  };
+  free (line);
+  if ((cf != NULL) && (cf != stdin))
+    fclose (cf);
+  return (status);
+
+} /* replay_file */
+
+
+/*
+  replay_summary - what went by.  to stderr as text, as JSON if asked.
+*/
+
+void
+  replay_summary
+    (OSDP_CONTEXT *ctx,
+    FILE *sf,
+    int json,
+    double elapsed,
+    unsigned int noise)
+
+{ /* replay_summary */
+
+  int code;
+  double rate;
+  char *separator;
+  double span;
+
+
+  rate = 0;
+  if (elapsed > 0)
+    rate = replay_stats.frames / elapsed;
+  span = (replay_stats.last.tv_sec - replay_stats.first.tv_sec) +
+    (replay_stats.last.tv_nsec - replay_stats.first.tv_nsec) / 1e9;
+  if (!json)
+  {
+    fprintf (sf, "osdp-replay: %llu. records, %llu. frames, %llu. octets, %u. noise octets, %.3f sec of capture\n",
+      replay_stats.records, replay_stats.frames, replay_stats.octets, noise, span);
+    fprintf (sf, "  CRC errors %d. checksum errors %d. sequence errors %d. MAC errors %d. secure channel %llu. bad records %llu.\n",
+      ctx->crc_errs, ctx->checksum_errs, ctx->seq_bad, ctx->hash_bad, replay_stats.secure, replay_stats.bad_records);
+    for (code=0; code<256; code++)
+      if (replay_stats.commands [code] > 0)
+        fprintf (sf, "  %-20s %llu.\n", osdp_command_reply_to_string (code, 0), replay_stats.commands [code]);
+    for (code=0; code<256; code++)
+      if (replay_stats.replies [code] > 0)
+        fprintf (sf, "  %-20s %llu.\n", osdp_command_reply_to_string (code, 0x80), replay_stats.replies [code]);
+    fprintf (sf, "  %.3f sec, %.0f frames/sec\n", elapsed, rate);
+  }
+  else
+  {
+    fprintf (sf, "{\n  \"records\" : \"%llu\", \"frames\" : \"%llu\", \"octets\" : \"%llu\", \"noise-octets\" : \"%u\",\n",
+      replay_stats.records, replay_stats.frames, replay_stats.octets, noise);
+    fprintf (sf, "  \"crc-errors\" : \"%d\", \"checksum-errors\" : \"%d\", \"sequence-errors\" : \"%d\", \"mac-errors\" : \"%d\",\n",
+      ctx->crc_errs, ctx->checksum_errs, ctx->seq_bad, ctx->hash_bad);
+    fprintf (sf, "  \"secure\" : \"%llu\", \"bad-records\" : \"%llu\",\n",
+      replay_stats.secure, replay_stats.bad_records);
+    fprintf (sf, "  \"capture-seconds\" : \"%.6f\", \"elapsed-seconds\" : \"%.6f\", \"frames-per-second\" : \"%.0f\",\n",
+      span, elapsed, rate);
+    fprintf (sf, "  \"commands\" : {");
+    separator = "";
+    for (code=0; code<256; code++)
+      if (replay_stats.commands [code] > 0)
+      {
+        fprintf (sf, "%s \"%02x\" : \"%llu\"", separator, code, replay_stats.commands [code]);
+        separator = ",";
+      };
+    fprintf (sf, " },\n  \"replies\" : {");
+    separator = "";
+    for (code=0; code<256; code++)
+      if (replay_stats.replies [code] > 0)
+      {
+        fprintf (sf, "%s \"%02x\" : \"%llu\"", separator, code, replay_stats.replies [code]);
+        separator = ",";
+      };
+    fprintf (sf, " }\n}\n");
+  };
+
+} /* replay_summary */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for osdp-replay */
+
+  double elapsed;
+  static OO_MONITOR_FRAMER framer;
+  int i;
+  char *json_path;
+  FILE *jf;
+  char *log_path;
+  int option;
+  char results_path [sizeof (context.service_root) + 16];
+  struct timespec start;
+  int status;
+  struct timespec stop;
+
+
+  status = ST_OK;
+  json_path = NULL;
+  log_path = NULL;
+  memset (&context, 0, sizeof (context));
+  context.verbosity = 3;
+  strcpy (context.service_root, ".");
+  while ((option = getopt (argc, argv, "e:j:l:o:r:v:")) != -1)
+  {
+    switch (option)
+    {
+    case 'e':
+      strncpy (context.event_log_path, optarg, sizeof (context.event_log_path)-1);
+      break;
+    case 'j':
+      json_path = optarg;
+      break;
+    case 'l':
+      strncpy (context.log_levels, optarg, sizeof (context.log_levels)-1);
+      break;
+    case 'o':
+      log_path = optarg;
+      break;
+    case 'r':
+      strncpy (context.service_root, optarg, sizeof (context.service_root)-1);
+      break;
+    case 'v':
+      context.verbosity = atoi (optarg);
+      break;
+    default:
+      status = -1;
+      break;
+    };
+  };
+  if (status EQUALS ST_OK)
+    status = oo_log_levels (&context);
+  if ((status != ST_OK) || (optind >= argc))
+  {
+    fprintf (stderr, "Usage: osdp-replay [-o log] [-e events.bin] [-v verbosity] [-l log-levels] [-r service-root] [-j stats.json] capture.osdpcap ...\n");
+    return (1);
+  };
+
+  // set up as a monitor, the way initialize_osdp would, minus the port and the files
+
+  context.log = stdout;
+  if (log_path != NULL)
+    context.log = fopen (log_path, "w");
+  if (context.log EQUALS NULL)
+  {
+    fprintf (stderr, "osdp-replay: cannot open log %s\n", log_path);
+    return (1);
+  };
+  (void) setvbuf (context.log, NULL, _IOFBF, OO_REPLAY_LOG_BUFFER);
+  context.role = OSDP_ROLE_MONITOR;
+  strcpy (tag, "MON");
+  context.last_sequence_received = -1;
+  context.current_key_slot = -1;
+  memcpy (context.current_default_scbk, OSDP_SCBK_DEFAULT, sizeof (context.current_default_scbk));
+  context.metrics_fd = -1;
+  context.monitor_fd = -1;
+  osdp_conformance.last_unknown_command = OSDP_POLL;
+  m_check = OSDP_CRC;
+  if (oo_eventlog_open (&context) != ST_OK)
+    return (1);
+  if (context.verbosity > 0)
+  {
+    sprintf (results_path, "%s/results", context.service_root);
+    (void) mkdir (results_path, 0755);
+  };
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i=optind; (status EQUALS ST_OK) && (i<argc); i++)
+    status = replay_file (&context, argv [i], &framer);
+  oo_monitor_frame_reset (&framer);
+  fflush (context.log);
+  if (context.event_log != NULL)
+    fflush (context.event_log);
+  clock_gettime (CLOCK_MONOTONIC, &stop);
+  elapsed = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+  replay_summary (&context, stderr, 0, elapsed, framer.noise);
+  if (json_path != NULL)
+  {
+    jf = fopen (json_path, "w");
+    if (jf != NULL)
+    {
+      replay_summary (&context, jf, 1, elapsed, framer.noise);
+      fclose (jf);
+    };
+  };
+  if (context.log != stdout)
+    fclose (context.log);
+  return (status EQUALS ST_OK ? 0 : 1);
+
+} /* main for osdp-replay */
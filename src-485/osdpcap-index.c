@@ -0,0 +1,585 @@
+/*
+  osdpcap-index - index osdpcap captures and pull records out by time, PD, command
+
+  Usage:
+    osdpcap-index [-f] capture.osdpcap ...
+    osdpcap-index -q [-a address] [-c code] [-C|-R] [-s] [-e class] [-b from] [-t to] [-n] capture.osdpcap
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+*/
+
+/*
+  the index goes next to the capture as capture.osdpcap.idx (layout in
+  osdpcap.h.)  without -q each capture is indexed, unless its index is
+  current (-f rebuilds anyway.)  with -q the index is brought up to date
+  if need be and the records that match everything asked for are written
+  to stdout as they are in the capture, so the output is itself a capture
+  (osdp-replay - decodes it.)
+
+    -a address   PD address, hex
+    -c code      command or reply code, hex (60 is osdp_POLL, 48 osdp_LSTATR)
+    -C, -R       commands only, replies only
+    -s           secure channel only
+    -e class     check (CRC or checksum), frame (not one whole frame), nak, or any
+    -b, -t       from, to.  seconds (timeSec) or YYYYMMDD-HHMMSS local time,
+                 as in the log's Timestamp.
+    -n           just count them
+*/
+
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include <open-osdp.h>
+#include <osdpcap.h>
+
+
+typedef struct osdpcap_query
+{
+  int address; // -1 for any
+  int code; // -1 for any
+  int count_only;
+  int flags_clear; // must not have these
+  int flags_set; // must have all of these
+  int flags_any; // must have one of these, if nonzero
+  long long from_sec;
+  long long to_sec;
+} OSDPCAP_QUERY;
+
+
+/*
+  index_classify - what a record is: address, code and flags
+*/
+
+void
+  index_classify
+    (OSDPCAP_RECORD *record,
+    OSDPCAP_INDEX_RECORD *entry)
+
+{ /* index_classify */
+
+  int code_offset;
+  int frame_length;
+  unsigned char *frame;
+  int length;
+  unsigned short int wire_crc;
+
+
+  entry->address = 0xff;
+  entry->code = 0;
+  entry->flags = 0;
+  entry->io = record->io;
+
+  // the marking octet(s) before SOM are not part of the frame
+
+  frame = record->octets;
+  length = record->length;
+  while ((length > 0) && (*frame EQUALS C_OSDP_MARK))
+  {
+    frame++;
+    length--;
+  };
+  if ((length < (int)sizeof (OSDP_HDR)) || (frame [0] != C_SOM))
+  {
+    entry->flags = OSDPCAP_INDEX_BAD_FRAME;
+    return;
+  };
+  frame_length = frame [2] + 256*frame [3];
+  if (frame_length != length)
+    entry->flags = OSDPCAP_INDEX_BAD_FRAME;
+  entry->address = 0x7f & frame [1];
+  if (frame [1] & 0x80)
+    entry->flags = entry->flags | OSDPCAP_INDEX_REPLY;
+  code_offset = offsetof (OSDP_HDR, command);
+  if (frame [offsetof (OSDP_HDR, ctrl)] & OSDP_CONTROLBIT_SCS)
+  {
+    entry->flags = entry->flags | OSDPCAP_INDEX_SECURE;
+    code_offset = code_offset + frame [code_offset];
+  };
+  if (code_offset < length)
+    entry->code = frame [code_offset];
+  if ((entry->flags & OSDPCAP_INDEX_REPLY) && (entry->code EQUALS OSDP_NAK))
+    entry->flags = entry->flags | OSDPCAP_INDEX_NAK;
+
+  if (!(entry->flags & OSDPCAP_INDEX_BAD_FRAME))
+  {
+    if (frame [offsetof (OSDP_HDR, ctrl)] & OSDP_CONTROLBIT_CRC)
+    {
+      wire_crc = frame [length-2] + 256*frame [length-1];
+      if (fCrcBlk (frame, length-2) != wire_crc)
+        entry->flags = entry->flags | OSDPCAP_INDEX_BAD_CHECK;
+    }
+    else
+    {
+      if (checksum (frame, length-1) != frame [length-1])
+        entry->flags = entry->flags | OSDPCAP_INDEX_BAD_CHECK;
+    };
+  };
+
+} /* index_classify */
+
+
+/*
+  index_build - write capture.idx, one pass over the capture
+*/
+
+int
+  index_build
+    (char *capture_path,
+    char *index_path,
+    struct stat *capture_stat)
+
+{ /* index_build */
+
+  OSDPCAP_INDEX_BUCKET *bucket;
+  int bucket_max;
+  OSDPCAP_INDEX_BUCKET *buckets;
+  FILE *cf;
+  OSDPCAP_INDEX_RECORD entry;
+  OSDPCAP_INDEX_HEADER header;
+  FILE *xf;
+  char *line;
+  ssize_t line_length;
+  size_t line_size;
+  long long offset;
+  static OSDPCAP_RECORD record;
+  int status;
+  char temp_path [4096];
+
+
+  status = ST_OK;
+  bucket = NULL;
+  buckets = NULL;
+  bucket_max = 0;
+  line = NULL;
+  line_size = 0;
+  xf = NULL;
+  memset (&header, 0, sizeof (header));
+  cf = fopen (capture_path, "r");
+  if (cf EQUALS NULL)
+    status = ST_OSDP_BAD_TRANSFER_FILE;
+  if (status EQUALS ST_OK)
+  {
+    // built to the side and renamed, so a query never sees half an index
+
+    snprintf (temp_path, sizeof (temp_path), "%s.new", index_path);
+    xf = fopen (temp_path, "w");
+    if (xf EQUALS NULL)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+  };
+  if (status EQUALS ST_OK)
+    if (fwrite (&header, sizeof (header), 1, xf) != 1)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+
+  offset = 0;
+  while ((status EQUALS ST_OK) && ((line_length = getline (&line, &line_size, cf)) > 0))
+  {
+    memset (&entry, 0, sizeof (entry));
+    (void) oo_osdpcap_parse (line, &record);
+    index_classify (&record, &entry);
+    entry.offset = offset;
+    entry.length = line_length;
+    entry.time_sec = record.captured.tv_sec;
+    entry.time_nsec = record.captured.tv_nsec;
+    offset = offset + line_length;
+
+    // a new bucket every few seconds of capture, or when this one's full
+
+    if ((bucket EQUALS NULL) || (bucket->count EQUALS OSDPCAP_INDEX_BUCKET_MAX) ||
+      (entry.time_sec >= bucket->min_sec + OSDPCAP_INDEX_BUCKET_SEC) || (entry.time_sec < bucket->min_sec))
+    {
+      if (header.buckets EQUALS bucket_max)
+      {
+        bucket_max = 2*bucket_max + 64;
+        buckets = realloc (buckets, bucket_max * sizeof (buckets [0]));
+        if (buckets EQUALS NULL)
+        {
+          status = ST_OSDP_BAD_TRANSFER_SAVE;
+          break;
+        };
+      };
+      bucket = &(buckets [header.buckets]);
+      header.buckets ++;
+      memset (bucket, 0, sizeof (*bucket));
+      bucket->first = header.records;
+      bucket->min_sec = entry.time_sec;
+      bucket->max_sec = entry.time_sec;
+    };
+    bucket->count ++;
+    if (entry.time_sec > bucket->max_sec)
+      bucket->max_sec = entry.time_sec;
+    if (entry.address < 128)
+      bucket->addresses [entry.address/8] |= 1 << (entry.address % 8);
+    bucket->codes [entry.code/8] |= 1 << (entry.code % 8);
+    bucket->flags = bucket->flags | entry.flags;
+
+    if (fwrite (&entry, sizeof (entry), 1, xf) != 1)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+    header.records ++;
+  };
+  if (status EQUALS ST_OK)
+  {
+    memcpy (header.magic, OSDPCAP_INDEX_MAGIC, sizeof (header.magic));
+    header.capture_size = capture_stat->st_size;
+    header.capture_mtime = capture_stat->st_mtime;
+    header.buckets_offset = sizeof (header) + (long long)header.records * sizeof (entry);
+    if (header.buckets > 0)
+      if (fwrite (buckets, sizeof (buckets [0]), header.buckets, xf) != header.buckets)
+        status = ST_OSDP_BAD_TRANSFER_SAVE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    if ((fseek (xf, 0, SEEK_SET) != 0) || (fwrite (&header, sizeof (header), 1, xf) != 1))
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+  };
+  if (xf != NULL)
+    if (fclose (xf) != 0)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+  if (status EQUALS ST_OK)
+    if (rename (temp_path, index_path) != 0)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+  if ((status != ST_OK) && (xf != NULL))
+    (void) unlink (temp_path);
+  if (cf != NULL)
+    fclose (cf);
+  free (buckets);
+  free (line);
+  if (status EQUALS ST_OK)
+    fprintf (stderr, "osdpcap-index: %s: %u. records in %u. buckets\n",
+      capture_path, header.records, header.buckets);
+  else
+    fprintf (stderr, "osdpcap-index: cannot index %s (status %d)\n", capture_path, status);
+  return (status);
+
+} /* index_build */
+
+
+/*
+  index_current - 1 if the index exists and was made from the capture as it is now
+*/
+
+int
+  index_current
+    (char *index_path,
+    struct stat *capture_stat)
+
+{ /* index_current */
+
+  int current;
+  OSDPCAP_INDEX_HEADER header;
+  FILE *xf;
+
+
+  current = 0;
+  xf = fopen (index_path, "r");
+  if (xf != NULL)
+  {
+    if (fread (&header, sizeof (header), 1, xf) EQUALS 1)
+      if ((memcmp (header.magic, OSDPCAP_INDEX_MAGIC, sizeof (header.magic)) EQUALS 0) &&
+        (header.capture_size EQUALS capture_stat->st_size) &&
+        (header.capture_mtime EQUALS capture_stat->st_mtime))
+        current = 1;
+    fclose (xf);
+  };
+  return (current);
+
+} /* index_current */
+
+
+/*
+  index_match - does a record match
+*/
+
+int
+  index_match
+    (OSDPCAP_QUERY *query,
+    int address,
+    int code,
+    int flags,
+    long long time_sec)
+
+{ /* index_match */
+
+  if ((query->address != -1) && (address != query->address))
+    return (0);
+  if ((query->code != -1) && (code != query->code))
+    return (0);
+  if ((flags & query->flags_set) != query->flags_set)
+    return (0);
+  if ((flags & query->flags_clear) != 0)
+    return (0);
+  if ((query->flags_any != 0) && ((flags & query->flags_any) EQUALS 0))
+    return (0);
+  if ((time_sec < query->from_sec) || (time_sec > query->to_sec))
+    return (0);
+  return (1);
+
+} /* index_match */
+
+
+/*
+  index_query - write the records that match to stdout
+*/
+
+int
+  index_query
+    (char *capture_path,
+    char *index_path,
+    OSDPCAP_QUERY *query)
+
+{ /* index_query */
+
+  int address;
+  OSDPCAP_INDEX_BUCKET *bucket;
+  int cf;
+  int code;
+  OSDPCAP_INDEX_RECORD *entry;
+  OSDPCAP_INDEX_HEADER *header;
+  int i;
+  unsigned int j;
+  char *line;
+  size_t line_size;
+  unsigned long long matched;
+  unsigned char *mapped;
+  struct stat index_stat;
+  int status;
+  int xf;
+
+
+  status = ST_OK;
+  matched = 0;
+  line = NULL;
+  line_size = 0;
+  mapped = MAP_FAILED;
+  cf = open (capture_path, O_RDONLY);
+  xf = open (index_path, O_RDONLY);
+  if ((cf < 0) || (xf < 0) || (fstat (xf, &index_stat) != 0) ||
+    (index_stat.st_size < (off_t)sizeof (*header)))
+    status = ST_OSDP_BAD_TRANSFER_FILE;
+  if (status EQUALS ST_OK)
+  {
+    mapped = mmap (NULL, index_stat.st_size, PROT_READ, MAP_PRIVATE, xf, 0);
+    if (mapped EQUALS MAP_FAILED)
+      status = ST_OSDP_BAD_TRANSFER_FILE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    header = (OSDPCAP_INDEX_HEADER *)mapped;
+    if (header->buckets_offset + header->buckets * sizeof (*bucket) > (unsigned long long)index_stat.st_size)
+      status = ST_OSDP_BAD_TRANSFER_FILE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    entry = (OSDPCAP_INDEX_RECORD *)(mapped + sizeof (*header));
+    bucket = (OSDPCAP_INDEX_BUCKET *)(mapped + header->buckets_offset);
+    for (j=0; (status EQUALS ST_OK) && (j<header->buckets); j++, bucket++)
+    {
+      // the bucket says whether anything in it could match
+
+      address = query->address;
+      if ((address != -1) && !(bucket->addresses [address/8] & (1 << (address % 8))))
+        continue;
+      code = query->code;
+      if ((code != -1) && !(bucket->codes [code/8] & (1 << (code % 8))))
+        continue;
+      if ((bucket->flags & query->flags_set) != query->flags_set)
+        continue;
+      if ((query->flags_any != 0) && ((bucket->flags & query->flags_any) EQUALS 0))
+        continue;
+      if ((bucket->max_sec < query->from_sec) || (bucket->min_sec > query->to_sec))
+        continue;
+
+      for (i=bucket->first; i<(int)(bucket->first+bucket->count); i++)
+      {
+        if (!index_match (query, entry [i].address, entry [i].code, entry [i].flags, entry [i].time_sec))
+          continue;
+        matched ++;
+        if (query->count_only)
+          continue;
+        if (entry [i].length > line_size)
+        {
+          line_size = entry [i].length;
+          line = realloc (line, line_size);
+          if (line EQUALS NULL)
+          {
+            status = ST_OSDP_BAD_TRANSFER_FILE;
+            break;
+          };
+        };
+        if (pread (cf, line, entry [i].length, entry [i].offset) != entry [i].length)
+        {
+          status = ST_OSDP_BAD_TRANSFER_FILE;
+          break;
+        };
+        fwrite (line, 1, entry [i].length, stdout);
+      };
+    };
+  };
+  if (query->count_only)
+    printf ("%llu\n", matched);
+  fflush (stdout);
+  if (mapped != MAP_FAILED)
+    (void) munmap (mapped, index_stat.st_size);
+  if (cf >= 0)
+    close (cf);
+  if (xf >= 0)
+    close (xf);
+  free (line);
+  if (status != ST_OK)
+    fprintf (stderr, "osdpcap-index: cannot query %s (status %d)\n", capture_path, status);
+  return (status);
+
+} /* index_query */
+
+
+/*
+  index_time - seconds, or YYYYMMDD-HHMMSS local time
+*/
+
+long long
+  index_time
+    (char *value)
+
+{ /* index_time */
+
+  struct tm broken_down;
+
+
+  if ((strlen (value) EQUALS 15) && (value [8] EQUALS '-'))
+  {
+    memset (&broken_down, 0, sizeof (broken_down));
+    if (strptime (value, "%Y%m%d-%H%M%S", &broken_down) != NULL)
+    {
+      broken_down.tm_isdst = -1;
+      return (mktime (&broken_down));
+    };
+  };
+  return (atoll (value));
+
+} /* index_time */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for osdpcap-index */
+
+  struct stat capture_stat;
+  int force;
+  int i;
+  char index_path [4096];
+  int option;
+  OSDPCAP_QUERY query;
+  int querying;
+  int status;
+
+
+  status = ST_OK;
+  force = 0;
+  querying = 0;
+  memset (&query, 0, sizeof (query));
+  query.address = -1;
+  query.code = -1;
+  query.to_sec = 0x7fffffffffffffffLL;
+  while ((option = getopt (argc, argv, "a:b:c:Ce:fnqRst:")) != -1)
+  {
+    switch (option)
+    {
+    case 'a':
+      query.address = 0x7f & strtol (optarg, NULL, 16);
+      break;
+    case 'b':
+      query.from_sec = index_time (optarg);
+      break;
+    case 'c':
+      query.code = 0xff & strtol (optarg, NULL, 16);
+      break;
+    case 'C':
+      query.flags_clear = query.flags_clear | OSDPCAP_INDEX_REPLY;
+      break;
+    case 'e':
+      if (strcmp (optarg, "check") EQUALS 0)
+        query.flags_any = query.flags_any | OSDPCAP_INDEX_BAD_CHECK;
+      else if (strcmp (optarg, "frame") EQUALS 0)
+        query.flags_any = query.flags_any | OSDPCAP_INDEX_BAD_FRAME;
+      else if (strcmp (optarg, "nak") EQUALS 0)
+        query.flags_any = query.flags_any | OSDPCAP_INDEX_NAK;
+      else if (strcmp (optarg, "any") EQUALS 0)
+        query.flags_any = query.flags_any |
+          OSDPCAP_INDEX_BAD_CHECK | OSDPCAP_INDEX_BAD_FRAME | OSDPCAP_INDEX_NAK;
+      else
+        status = -1;
+      break;
+    case 'f':
+      force = 1;
+      break;
+    case 'n':
+      query.count_only = 1;
+      break;
+    case 'q':
+      querying = 1;
+      break;
+    case 'R':
+      query.flags_set = query.flags_set | OSDPCAP_INDEX_REPLY;
+      break;
+    case 's':
+      query.flags_set = query.flags_set | OSDPCAP_INDEX_SECURE;
+      break;
+    case 't':
+      query.to_sec = index_time (optarg);
+      break;
+    default:
+      status = -1;
+      break;
+    };
+  };
+  if ((status != ST_OK) || (optind >= argc) || (querying && (optind != argc-1)))
+  {
+    fprintf (stderr, "Usage: osdpcap-index [-f] capture.osdpcap ...\n");
+    fprintf (stderr, "       osdpcap-index -q [-a address] [-c code] [-C|-R] [-s] [-e check|frame|nak|any] [-b from] [-t to] [-n] capture.osdpcap\n");
+    return (1);
+  };
+
+  for (i=optind; (status EQUALS ST_OK) && (i<argc); i++)
+  {
+    snprintf (index_path, sizeof (index_path), "%s%s", argv [i], OSDPCAP_INDEX_SUFFIX);
+    if (stat (argv [i], &capture_stat) != 0)
+    {
+      fprintf (stderr, "osdpcap-index: cannot open %s\n", argv [i]);
+      status = ST_OSDP_BAD_TRANSFER_FILE;
+    };
+    if (status EQUALS ST_OK)
+      if (force || !index_current (index_path, &capture_stat))
+        status = index_build (argv [i], index_path, &capture_stat);
+    if ((status EQUALS ST_OK) && querying)
+      status = index_query (argv [i], index_path, &query);
+  };
+  return (status EQUALS ST_OK ? 0 : 1);
+
+} /* main for osdpcap-index */
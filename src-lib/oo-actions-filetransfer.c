@@ -21,6 +21,7 @@
 
 
 #include <memory.h>
+#include <unistd.h>
 
 
 #include <open-osdp.h>
@@ -42,7 +43,6 @@ int
   unsigned int offset;
   OSDP_HDR_FTSTAT response;
   int status;
-  int status_io;
   unsigned char *transfer_fragment;
 
 
@@ -53,23 +53,41 @@ int
   if (status EQUALS ST_OK)
     status = osdp_filetransfer_validate(ctx, filetransfer_message,
       &fragment_size, &offset);
-  (void)oosdp_make_message (OOSDP_MSG_FILETRANSFER, tlogmsg, msg);
-  if (ctx->verbosity > 0)
+  if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 1))
   {
+    (void)oosdp_make_message (OOSDP_MSG_FILETRANSFER, tlogmsg, msg);
     fprintf(ctx->log, "%s\n", tlogmsg);
     fflush(ctx->log);
   };
 // check FtType
-// check FtFragmentSize sane
+
+  // the fragment must be in the frame and must not run past the declared total
+
+  if (status EQUALS ST_OK)
+  {
+    if ((msg->data_length < OSDP_FILETRANSFER_HEADER_LENGTH) ||
+      (fragment_size > msg->data_length - OSDP_FILETRANSFER_HEADER_LENGTH) ||
+      ((unsigned long)offset + fragment_size > ctx->xferctx.total_length))
+    {
+      if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 1))
+        fprintf(ctx->log,
+          "osdp_FILETRANSFER: bad fragment (size %d offset %u, %d octets in frame, total %u)\n",
+          fragment_size, offset, msg->data_length, ctx->xferctx.total_length);
+      status = ST_OSDP_FILEXFER_HEADER;
+    };
+  };
 
   if (status EQUALS ST_OK)
   {
     transfer_fragment = &(filetransfer_message->FtData);
-    if (offset EQUALS 0)
+    if ((offset EQUALS 0) && !(ctx->xferctx.receive_open))
     {
-      ctx->xferctx.xferf = fopen("./incoming_data", "w");
-      if (ctx->xferctx.xferf EQUALS NULL)
-        status = ST_OSDP_BAD_TRANSFER_SAVE;
+      status = oo_receive_open(ctx, 0);
+
+      // note what's being received so an interrupted transfer can resume into it
+
+      if (status EQUALS ST_OK)
+        status = oo_filetransfer_partial_save(ctx, filetransfer_message->FtType);
       if (status != ST_OK)
       {
         // if open of write file failed, send back error and reset
@@ -83,16 +101,17 @@ int
   };
   if (status EQUALS ST_OK)
   {
-    status_io = fwrite(transfer_fragment, sizeof(transfer_fragment[0]),
-      fragment_size, ctx->xferctx.xferf);
-    if (status_io != fragment_size)
+    // written at its own offset so a resend is harmless.  what's acknowledged
+    // is in the file in case the transfer is resumed after a restart.
+
+    if (oo_receive_write(ctx, transfer_fragment, fragment_size, offset) != ST_OK)
     {
       // not same error but need to abort so same status code on the wire
 
       osdp_doubleByte_to_array(OSDP_FTSTAT_ABORT_TRANSFER,
         response.FtStatusDetail);
       status = oo_send_ftstat(ctx, &response);
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 4))
       {
         if (status != ST_OK)
           fprintf(ctx->log, "FTSTAT send for abort returned status %d.\n", status);
@@ -101,15 +120,13 @@ int
     }
     else
     {
-      // update counters
-
-      ctx->xferctx.current_offset = ctx->xferctx.current_offset + fragment_size;
       if (ctx->xferctx.current_offset EQUALS ctx->xferctx.total_length)
       {
+        (void) unlink(OO_FT_PARTIAL_FILE);
         osdp_doubleByte_to_array(OSDP_FTSTAT_PROCESSED,
           response.FtStatusDetail);
         status = oo_send_ftstat(ctx, &response);
-        if (ctx->verbosity > 3)
+        if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 4))
         {
           if (status != ST_OK)
             fprintf(ctx->log, "FTSTAT send at finish returned status %d.\n", status);
@@ -137,18 +154,19 @@ fprintf(stderr, "DEBUG: trimmed offered size to %d.\n", offered_size);
         if (ctx->pd_filetransfer_payload > 0)
         {
           offered_size = ctx->pd_filetransfer_payload;
-fprintf(stderr, "DEBUG: trimmed offered size to  pd_filetransfer_payload (%d.)\n", offered_size);
+          if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 4))
+            fprintf(stderr, "DEBUG: trimmed offered size to  pd_filetransfer_payload (%d.)\n", offered_size);
         };
-        if (ctx->verbosity > 3)
+        if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 4))
           fprintf(ctx->log, "osdp_FTSTAT FTMsgUpdateMax will be %d.\n", offered_size);
 
         osdp_doubleByte_to_array(offered_size, response.FtUpdateMsgMax);
 
-        fprintf(ctx->log, " Sending FTSTAT:Offset %d Total %d CurrentSDU %d OfferedSDU %d\n",
+        OO_LOG (ctx, OO_LOG_FILETRANSFER, 3, " Sending FTSTAT:Offset %d Total %d CurrentSDU %d OfferedSDU %d\n",
           ctx->xferctx.current_offset, ctx->xferctx.total_length, ctx->xferctx.current_send_length,
           offered_size);
 
-        if (ctx->verbosity > 3)
+        if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 4))
         {
           fprintf(stderr, "current_offset : \"%d\n", ctx->xferctx.current_offset);
           fprintf(stderr, "total_length : %d\n", ctx->xferctx.total_length);
@@ -205,7 +223,11 @@ int
   ftstat_message = (OSDP_HDR_FTSTAT *)(msg->data_payload);
 
   status = osdp_ftstat_validate(ctx, ftstat_message);
-  fprintf(ctx->log, "%s\n", tlogmsg); fflush(ctx->log);
+  if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 1))
+  {
+    fprintf(ctx->log, "%s\n", tlogmsg);
+    fflush(ctx->log);
+  };
   if (status EQUALS ST_OSDP_FILEXFER_FINISHING)
   {
     // the filetransfer context was already set to "finishing".
@@ -223,12 +245,12 @@ int
   {
     // if more send more
 
-    if (ctx->verbosity > 9)
+    if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 10))
       fprintf(stderr, "t=%d o=%d\n", ctx->xferctx.total_length, ctx->xferctx.current_offset);
 
     if ((ctx->xferctx.total_length > 0) && (ctx->xferctx.total_length > ctx->xferctx.current_offset))
     {
-      status = osdp_send_filetransfer(ctx);
+      status = oo_filetransfer_send_next(ctx);
     };
 
     if ((ctx->xferctx.total_length EQUALS 0) || (ctx->xferctx.total_length EQUALS ctx->xferctx.current_offset))
@@ -105,13 +105,13 @@ int
 { /* action_osdp_RAW */
 
   int bits;
-  char cmd [16384]; // bigger than hex_details
+  static char cmd [16384]; // bigger than hex_details
   OSDP_COMMAND command_for_later;
-  char details [1024];
+  char details [2*OSDP_OFFICIAL_MSG_MAX+64];
   int display;
   char hex_details [4096];
-  char hstr [1024]; // hex string of raw card data payload
-  char json_blob [1024];
+  char hstr [2*OSDP_OFFICIAL_MSG_MAX+1]; // hex string of raw card data payload
+  char json_blob [2*OSDP_OFFICIAL_MSG_MAX+64];
   unsigned char *raw_data;
   int status;
 
@@ -161,7 +161,12 @@ int
         int octets;
         char tstr [32];
 
+        // no more than the message holds, whatever the bit count says
         octets = (bits+7)/8;
+        if (octets > msg->data_length - 4)
+          octets = msg->data_length - 4;
+        if (octets < 0)
+          octets = 0;
         if (octets > sizeof (ctx->last_raw_read_data))
           octets = sizeof (ctx->last_raw_read_data);
 
@@ -298,11 +303,8 @@ fprintf(stderr, "DEBUG: crauth enqueued\n");
 
   if (0 EQUALS strcmp (ctx->test_in_progress, "060-24-02"))
   {
-    int current_length;
     unsigned char details [OSDP_OFFICIAL_MSG_MAX];
     int details_length;
-    unsigned char payload [OSDP_OFFICIAL_MSG_MAX];
-    int payload_length;
 
 
     memset(details, 0, sizeof(details));
@@ -316,27 +318,15 @@ fprintf(stderr, "DEBUG: crauth enqueued\n");
         ctx->test_details_length = 0;  // it's been consumed.
       };
     };
-    payload_length = sizeof(payload);
-    status = oo_build_genauth(ctx, payload, &payload_length, details, details_length);
-    if (status EQUALS ST_OK)
-    {
-      current_length = 0;
-      status = send_message_ex
-        (ctx, OSDP_GENAUTH, p_card.addr, &current_length, payload_length, payload,
-        OSDP_SEC_SCS_17, 0, NULL);
-fprintf(stderr, "DEBUG: give GENAUTH a chance...\n"); sleep(5);
-    };
+    status = oo_mpart_send(ctx, OSDP_GENAUTH, details, details_length);
   };
 
   // if a crauth-after-raw was requested, do it now.
 
   if (0 EQUALS strcmp (ctx->test_in_progress, "060-25-02"))
   {
-    int current_length;
     unsigned char details [OSDP_OFFICIAL_MSG_MAX];
     int details_length;
-    unsigned char payload [OSDP_OFFICIAL_MSG_MAX];
-    int payload_length;
 
     memset(details, 0, sizeof(details));
     details_length = 270; // estimated null payload ... //sizeof(details);
@@ -350,19 +340,9 @@ fprintf(stderr, "DEBUG: give GENAUTH a chance...\n"); sleep(5);
       };
     };
 
-    // build up the payload.  The SDU looks the same for genauth and crauth so
-    // we can use the same routine and just send a different command.
+    // the payload looks the same for genauth and crauth, just a different command.
 
-    payload_length = sizeof(payload);
-    status = oo_build_genauth(ctx, payload, &payload_length, details, details_length);
-    if (status EQUALS ST_OK)
-    {
-      current_length = 0;
-      status = send_message_ex
-        (ctx, OSDP_CRAUTH, p_card.addr, &current_length, payload_length, payload,
-        OSDP_SEC_SCS_17, 0, NULL);
-fprintf(stderr, "DEBUG: give CRAUTH a chance...\n"); sleep(5);
-    };
+    status = oo_mpart_send(ctx, OSDP_CRAUTH, details, details_length);
   };
 
   return (status);
@@ -59,6 +59,7 @@ int
   unsigned char osdp_com_response_data [5];
   char logmsg [1024];
   OSDP_HDR *p;
+  unsigned int speed;
   int status;
 
 
@@ -67,7 +68,7 @@ int
   from_address = p->addr;
   memset (osdp_com_response_data, 0, sizeof (osdp_com_response_data));
   i = *(1+msg->data_payload) + (*(2+msg->data_payload) << 8) +
-    (*(3+msg->data_payload) << 16) + (*(4+msg->data_payload) << 24);
+    (*(3+msg->data_payload) << 16) + ((unsigned)*(4+msg->data_payload) << 24);
 
   sprintf(logmsg, "COMSET Data Payload %02x %02x%02x%02x%02x %d. 0x%x",
     *(0+msg->data_payload), *(1+msg->data_payload),
@@ -80,11 +81,16 @@ int
     p_card.addr = new_addr;
   fprintf (ctx->log, "PD Address set to %02x\n", p_card.addr);
 
+  // address then the speed, 4 octets LSB first
+
   osdp_com_response_data [0] = p_card.addr;
+  speed = i;
   if (OSDP_LOCK_SPEED)
-    *(unsigned long int *)(osdp_com_response_data+1) = 9600; // hard-code to 9600 BPS
-  else
-    *(unsigned long int *)(osdp_com_response_data+1) = i;
+    speed = 9600; // hard-code to 9600 BPS
+  osdp_com_response_data [1] = 0xff & speed;
+  osdp_com_response_data [2] = 0xff & (speed >> 8);
+  osdp_com_response_data [3] = 0xff & (speed >> 16);
+  osdp_com_response_data [4] = 0xff & (speed >> 24);
 
   status = ST_OK;
 
@@ -104,7 +110,8 @@ int
       fprintf(ctx->log, "OSDP_COMSET received, setting addr to %02x speed to %s.\n",
         p_card.addr, ctx->serial_speed);
     (void)oo_save_parameters(ctx, OSDP_SAVED_PARAMETERS, NULL);
-    status = init_serial (ctx, p_card.filename);
+    if (ctx->transport_type EQUALS OSDP_TRANSPORT_SERIAL)
+      status = init_serial (ctx, p_card.filename);
   };
 
   // send the response to the ACU
@@ -128,14 +135,14 @@ int
 
 { /* action_osdp_MFGERRR */
 
-  char cmd [2*8192];
+  static char cmd [2*8192];
   int count;
   FILE *f;
   int i;
   OSDP_HDR *oh;
-  char payload [8192];
+  static char payload [8192];
   int status;
-  char tmp1 [8192];
+  static char tmp1 [8192];
 
 
   status = ST_OK;
@@ -167,7 +174,10 @@ int
     ctx->pd_address,
     ctx->vendor_code [0], ctx->vendor_code [1], ctx->vendor_code [2], payload);
   {
-    f = fopen("/opt/osdp-conformance/run/ACU/osdp-mfg-error.json", "w");
+    char path [1024];
+
+    sprintf(path, "%s/ACU/osdp-mfg-error.json", oo_osdp_root(ctx, OO_DIR_RUN));
+    f = fopen(path, "w");
     if (f != NULL)\
     {
       fprintf(f, "%s\n", cmd);
@@ -381,6 +391,10 @@ int
 
   // i.e. we GOT a poll
   osdp_test_set_status(OOC_SYMBOL_cmd_poll, OCONFORM_EXERCISED);
+  oo_startup_report (ctx, "first poll received");
+
+  // a scheduled event (see oo-events.c) that is due becomes this poll's response
+  status = oo_events_poll (ctx);
 
   /*
     poll response can be many things.  we do one and then return, which
@@ -401,6 +415,17 @@ int
     };
   };
 
+  // if a multipart reply is part way out the poll gets the next fragment
+
+  if (!done)
+  {
+    if (oo_mpart_sending(ctx))
+    {
+      done = 1;
+      status = oo_mpart_send_next(ctx);
+    };
+  };
+
   // return BUSY if requested
 
   if (!done)
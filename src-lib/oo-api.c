@@ -91,13 +91,22 @@ int
   int status;
 
 
-  status = read_command (&context, &cmd, socket_command);
+  // with several PD's emulated the command goes to the one it names
+  status = oo_emulator_command (ctx, socket_command);
+  if (status EQUALS ST_OK)
+    status = read_command (&context, &cmd, socket_command);
   if (status EQUALS ST_OK)
   {
     status = process_command(cmd.command, &context, cmd.details_length, cmd.details_param_1, (char *)cmd.details);
     if (ctx->verbosity > 3)
       fprintf(stderr, "DEBUG: q %d\n", ctx->q [0].status);
   };
+
+  // a PD carries out a queued command right away, so that with several PD's
+  // emulated it is done by the PD it named before another one is addressed.
+  if ((status EQUALS ST_OK) && (ctx->role EQUALS OSDP_ROLE_PD))
+    while ((status EQUALS ST_OK) && (ctx->q [0].status != 0))
+      status = process_command_from_queue (ctx);
   if (status != ST_OK)
     fprintf (stderr, "process_current_command: status %d\n",
       status);
@@ -117,6 +126,7 @@ int
 { /* process_command_from_queue */
 
   OSDP_COMMAND *cmd;
+  int depth;
   OSDP_COMMAND extracted;
   int status;
 //  int waiting;
@@ -141,11 +151,15 @@ fflush(stderr);
     memcpy(&extracted, &(ctx->q [0].cmd), sizeof(extracted));
     cmd = &extracted;
 
-    // move all commands up one position
-    memcpy(ctx->q, ctx->q+1, (OSDP_COMMAND_QUEUE_SIZE-1)*sizeof(ctx->q [0]));
+    // move the commands behind it up one position.  only the occupied
+    // entries, moving the whole 256K queue touched all of it every time.
+    depth = 1;
+    while ((depth < OSDP_COMMAND_QUEUE_SIZE) && (ctx->q [depth].status != 0))
+      depth++;
+    memmove(ctx->q, ctx->q+1, (depth-1)*sizeof(ctx->q [0]));
 
-    // noop out the last queue entry
-    ctx->q [OSDP_COMMAND_QUEUE_SIZE-1].status = 0;
+    // noop out the entry that was last
+    ctx->q [depth-1].status = 0;
 
     if (ctx->verbosity > 3)
     {
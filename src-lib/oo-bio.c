@@ -238,7 +238,7 @@ int
     sprintf(octet, "%02x", msg->data_payload [6+i]);
     strcat(template_string, octet);
   };
-  credsf = fopen("osdp-saved-credentials.json", "w");
+  credsf = fopen(OSDP_SAVED_CREDENTIALS, "w");
   if (credsf != NULL)
   {
     char credentials_string [4096];
@@ -48,8 +48,12 @@ int
   char current_command [1024];
   char current_options [1024];
   int details_update;
+  OO_EVENT_ARGS *event_args;
+  OO_FLEET_ARGS *fleet_args;
+  int fleet_list;
+  char *fleet_pd;
   int i;
-  char json_string [16384];
+  static char json_string [16384];
   OSDP_MFG_ARGS *mfg_args;
   char octet [4];
   int octet_value;
@@ -183,15 +187,15 @@ int
     strcpy((char *)(cmd->details+4), "0000000000000000"); // 8 bytes of hex zeroes as default
     cmd->details_length = 13;  // 8 bytes zeroes(hex string) and 4 header
 
-    if (strlen(ctx->saved_bio_template) > 0)
+    if (strlen(saved_bio_template) > 0)
     {
       cmd->details_length = 4;
       cmd->details [0] = 0; // reader 0
       cmd->details [1] = ctx->saved_bio_type;
       cmd->details [2] = ctx->saved_bio_format;
       cmd->details [3] = ctx->saved_bio_quality;
-      strcpy((char *)(cmd->details+cmd->details_length), (char *)(ctx->saved_bio_template));
-      cmd->details_length = 4 + 1 + strlen(ctx->saved_bio_template);
+      strcpy((char *)(cmd->details+cmd->details_length), saved_bio_template);
+      cmd->details_length = 4 + 1 + strlen(saved_bio_template);
     };
 
     value = json_object_get (root, "reader");
@@ -1059,6 +1063,98 @@ int
     };
   };
 
+  // command fleet-transfer
+  // arguments: file, file-type as for transfer, pd-addresses (decimal,
+  // comma separated) to send to and poll-addresses to keep polled.
+
+  if (status EQUALS ST_OK)
+  {
+    if (0 EQUALS strcmp (current_command, "fleet-transfer"))
+    {
+      cmd->command = OSDP_CMDB_FLEET_TRANSFER;
+      fleet_args = (OO_FLEET_ARGS *)(cmd->details);
+      fleet_args->file_type = OSDP_FILETRANSFER_TYPE_OPAQUE;
+
+      parameter = json_object_get (root, "file");
+      if (json_is_string (parameter))
+        strcpy (fleet_args->filename, json_string_value (parameter));
+
+      parameter = json_object_get (root, "file-type");
+      if (json_is_string (parameter))
+      {
+        sscanf(json_string_value(parameter), "%x", &i);
+        fleet_args->file_type = i;
+      };
+
+      for (fleet_list=0; fleet_list<2; fleet_list++)
+      {
+        parameter = json_object_get (root, fleet_list ? "poll-addresses" : "pd-addresses");
+        if (json_is_string (parameter))
+        {
+          strcpy (vstr, json_string_value (parameter));
+          fleet_pd = strtok (vstr, ",");
+          while ((fleet_pd != NULL) && (fleet_args->count < OO_FLEET_PD_MAX))
+          {
+            if (1 EQUALS sscanf (fleet_pd, "%d", &i))
+            {
+              fleet_args->address [fleet_args->count] = i;
+              fleet_args->transfer [fleet_args->count] = !fleet_list;
+              fleet_args->count ++;
+            };
+            fleet_pd = strtok (NULL, ",");
+          };
+        };
+      };
+      status = enqueue_command(ctx, cmd);
+      cmd->command = OSDP_CMD_NOOP;
+    };
+  };
+
+  // command pd-events
+  // arguments: a schedule (event, rate, distribution, burst, count, seed,
+  // pd) or script, a file holding a JSON array of them.  see oo-events.c
+
+  if (status EQUALS ST_OK)
+  {
+    if (0 EQUALS strcmp (current_command, "pd-events"))
+    {
+      cmd->command = OSDP_CMDB_PD_EVENTS;
+      event_args = (OO_EVENT_ARGS *)(cmd->details);
+      cmd->details_length = sizeof (*event_args);
+
+      parameter = json_object_get (root, "script");
+      if (json_is_string (parameter))
+      {
+        json_t *script;
+
+        script = json_load_file (json_string_value (parameter), 0, &status_json);
+        if (!json_is_array (script))
+        {
+          fprintf (ctx->log, "pd-events: script %s is not a JSON array\n", json_string_value (parameter));
+          status = ST_EVENTS_SCHEDULE;
+        };
+        for (i=0; (status EQUALS ST_OK) && (i<json_array_size (script)) && (i<OO_EVENT_SCRIPT_MAX); i++)
+        {
+          status = oo_events_read_schedule (json_array_get (script, i), &(event_args->schedule [i]));
+          event_args->count ++;
+        };
+        if (script != NULL)
+          json_decref (script);
+      }
+      else
+      {
+        status = oo_events_read_schedule (root, &(event_args->schedule [0]));
+        event_args->count = 1;
+      };
+      if (status EQUALS ST_EVENTS_SCHEDULE)
+        fprintf (ctx->log, "pd-events: schedule refused (event, rate 0 to %.0f, burst 1 or more, pd)\n",
+          OO_EVENT_RATE_MAX);
+      if (status EQUALS ST_OK)
+        status = enqueue_command(ctx, cmd);
+      cmd->command = OSDP_CMD_NOOP;
+    };
+  };
+
   // command dump_status
 
   if (status EQUALS ST_OK)
@@ -1071,6 +1167,22 @@ int
     };
   }; 
 
+  // command flight-recorder - write the flight recorder out as osdpcap now
+  // arg file - optional, where to write it (default osdp-flight-<time>-command.osdpcap)
+
+  if (status EQUALS ST_OK)
+  {
+    if (0 EQUALS strcmp (current_command, "flight-recorder"))
+    {
+      cmd->command = OSDP_CMD_NOOP; // nothing other than what's here so no-op
+      value = json_object_get (root, "file");
+      if (json_is_string (value))
+        (void) oo_recorder_dump (ctx, "command", (char *)json_string_value (value));
+      else
+        (void) oo_recorder_dump (ctx, "command", NULL);
+    };
+  }; 
+
   /*
     command "genauth"
 
@@ -1651,6 +1763,12 @@ int
         else
           ctx->trace = 0; // turn off tracing (should be stricter about low-order bit.)
       };
+
+      // optional "log-levels", as the setting (e.g. "secure=9")
+      value = json_object_get (root, "log-levels");
+      if (json_is_string (value))
+        strncpy (ctx->log_levels, json_string_value (value), sizeof (ctx->log_levels)-1);
+      (void) oo_log_levels (ctx);
     };
   }; 
 
@@ -53,6 +53,7 @@ typedef struct osdp_conformance_test
   int test_for_xpm;
   int test_for_transparent;
   char *description;
+  int written; // status in the results file, plus 1.  0 if not written yet.
 } OSDP_CONFORMANCE_TEST;
 
 OSDP_CONFORMANCE_TEST
@@ -1021,6 +1022,43 @@ OSDP_SCORE_COUNTERS
 } /* osdp_report */
 
 
+/*
+  osdp_conformance_metrics - emit per-test status as OpenMetrics samples
+
+  each line is handed to the caller's emit routine.
+*/
+
+int
+  osdp_conformance_metrics
+    (void (*emit) (char *line))
+
+{ /* osdp_conformance_metrics */
+
+  int duplicate;
+  int i;
+  int j;
+  char line [1024];
+
+
+  for (i=0; test_control [i].name != NULL; i++)
+  {
+    // some tests appear twice in the table, report each once
+    duplicate = 0;
+    for (j=0; j<i; j++)
+      if (0 EQUALS strcmp (test_control [j].name, test_control [i].name))
+        duplicate = 1;
+    if (!duplicate)
+    {
+      sprintf (line, "osdp_conformance_test_status{test=\"%s\"} %d\n",
+        test_control [i].name, *(test_control [i].conformance));
+      (*emit) (line);
+    };
+  };
+  return (ST_OK);
+
+} /* osdp_conformance_metrics */
+
+
 int
   osdp_test_set_status
     (char *test,
@@ -1036,7 +1074,7 @@ int
 
 
   status = ST_OK;
-  if (context.verbosity > 0)
+  if (OO_LOG_ON (&context, OO_LOG_CONFORMANCE, 1))
   {
     idx = 0;
     done = 0;
@@ -1055,9 +1093,18 @@ int
       if (strcmp (test_control [idx].name, test) EQUALS 0)
     {
       *(test_control [idx].conformance) = test_status;
-      sprintf(results_filename, "%s/results/%s-results.json",
-        context.service_root, test);
-      rf = fopen(results_filename, "w");
+
+      // every frame marks a few tests.  the results file only needs writing when the status moves.
+
+      rf = NULL;
+      if (test_control [idx].written != test_status+1)
+      {
+        sprintf(results_filename, "%s/results/%s-results.json",
+          context.service_root, test);
+        rf = fopen(results_filename, "w");
+        if (rf EQUALS NULL)
+          fprintf(context.log, "Error writing results for %s\n", test);
+      };
       if (rf)
       {
         time_t current_time;
@@ -1072,10 +1119,7 @@ int
         fprintf(rf, " \"test-time\":\"%s\",\"test-description\":\"%s\"}\n",
           test_time, test_control [idx].description);
         fclose(rf);
-      }
-      else
-      {
-        fprintf(context.log, "Error writing results for %s\n", test);
+        test_control [idx].written = test_status+1;
       };
       done = 1;
     };
@@ -1119,7 +1163,7 @@ int
 
   if (test_status EQUALS OCONFORM_FAIL)
   {
-    if (context.verbosity > 3)
+    if (OO_LOG_ON (&context, OO_LOG_CONFORMANCE, 4))
       fprintf(context.log, "test %s FAILED\n", test);
   };
 
@@ -1128,7 +1172,7 @@ int
   done = 0;
   while (!done)
   {
-    if (context.verbosity > 9)
+    if (OO_LOG_ON (&context, OO_LOG_CONFORMANCE, 10))
     {
       fprintf(context.log, "osdp_test_set_status: checking %d.\n", idx);
       fflush(context.log);
@@ -1166,6 +1210,7 @@ int
           fprintf(rf, "%s", aux);
         fprintf(rf, "\"_\":\"_\"}\n");
         fclose(rf);
+        test_control [idx].written = 0; // the aux details go if the plain status is written after this
       }
       else
       {
@@ -81,3 +81,30 @@ unsigned short int
   return nCrc;
 }
 
+
+// the checksum lives here with the CRC so a frame can be checked without the rest of the library
+
+unsigned char
+  checksum
+    (unsigned char
+      *msg,
+    int
+      length)
+{
+  unsigned char
+    checksum;
+  int
+    i;
+  int
+    whole_checksum;
+
+
+  whole_checksum = 0;
+  for (i=0; i<length; i++)
+  {
+    whole_checksum = whole_checksum + msg [i];
+    checksum = ~(0xff & whole_checksum)+1;
+  };
+  return (checksum);
+
+} /* checksum */
@@ -0,0 +1,426 @@
+/*
+  oo-emulator - one PD process answering for many addresses on the bus
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  a PD is one OSDP_CONTEXT plus a handful of globals (the card, the last
+  message sent for retries, the pending reply, the retry detection values.)
+  with "emulate-addresses" set the process keeps a copy of all of that per
+  address and, as each frame comes off the bus, swaps in the PD it is
+  addressed to.  the framer, the event loop, the transport and the
+  counters stay with the process; everything else (sequence, secure
+  channel, LED/output/input state, card and keypad data) is per PD.
+
+  a frame for the configuration address goes to the lowest emulated PD.
+  frames for addresses not emulated are left to the active PD, which
+  ignores them as usual.
+
+  there is one saved parameters file and one incoming_data file, shared
+  by all the PD's.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include <jansson.h>
+
+
+#include <open-osdp.h>
+
+
+extern unsigned char last_command_received;
+extern unsigned short int last_check_value;
+extern unsigned char last_message_sent [2048];
+extern int last_message_sent_length;
+extern OSDP_PARAMETERS p_card;
+extern unsigned char pending_response;
+extern unsigned char pending_response_data [1500];
+extern int pending_response_length;
+static int oo_emulator_active; // address whose state is in the context
+static int oo_emulator_count;
+static OO_EMULATED_PD *oo_emulated [OSDP_CONFIGURATION_ADDRESS];
+static int oo_emulator_first;
+
+
+/*
+  oo_emulator_share - carry the process-wide fields over into a PD's context
+
+  the bus, the event loop, the command queue, the timers and the counters
+  belong to the process, not to whichever PD was last addressed.
+*/
+
+static void
+  oo_emulator_share
+    (OSDP_CONTEXT *to,
+    OSDP_CONTEXT *from)
+
+{ /* oo_emulator_share */
+
+  to->process_lock = from->process_lock;
+  to->keep_results = from->keep_results;
+  to->post_command_action = from->post_command_action;
+  to->trace = from->trace;
+  to->verbosity = from->verbosity;
+  memcpy (to->log_level, from->log_level, sizeof (to->log_level));
+  to->verbosity_override = from->verbosity_override;
+  to->q = from->q;
+  to->cmd_q_overflow = from->cmd_q_overflow;
+
+  to->current_pid = from->current_pid;
+  to->fd = from->fd;
+  to->transport_type = from->transport_type;
+  to->transport = from->transport;
+  to->log = from->log;
+  to->listen_sap = from->listen_sap;
+  to->metrics_fd = from->metrics_fd;
+  to->monitor_fd = from->monitor_fd;
+  to->startup_profile = from->startup_profile;
+  to->metrics_port = from->metrics_port;
+  to->report = from->report;
+  memcpy (&(to->tio), &(from->tio), sizeof (to->tio));
+  to->current_menu = from->current_menu;
+
+  to->timer_count = from->timer_count;
+  memcpy (to->timer, from->timer, sizeof (to->timer));
+  to->last_errno = from->last_errno;
+  to->slow_timer = from->slow_timer;
+
+  to->bytes_received = from->bytes_received;
+  to->bytes_sent = from->bytes_sent;
+  to->packets_received = from->packets_received;
+  to->acu_polls = from->acu_polls;
+  to->pd_acks = from->pd_acks;
+  to->sent_naks = from->sent_naks;
+  to->dropped_octets = from->dropped_octets;
+  to->crc_errs = from->crc_errs;
+  to->checksum_errs = from->checksum_errs;
+  to->hash_ok = from->hash_ok;
+  to->hash_bad = from->hash_bad;
+  to->retries = from->retries;
+  to->seq_bad = from->seq_bad;
+  to->pdus_received = from->pdus_received;
+  to->pdus_sent = from->pdus_sent;
+
+} /* oo_emulator_share */
+
+
+static void
+  oo_emulator_load
+    (OSDP_CONTEXT *ctx,
+    OO_EMULATED_PD *pd)
+
+{ /* oo_emulator_load */
+
+  oo_emulator_share (pd->context, ctx);
+  memcpy (ctx, pd->context, sizeof (*ctx));
+  memcpy (&p_card, &(pd->card), sizeof (p_card));
+  last_command_received = pd->last_command_received;
+  last_check_value = pd->last_check_value;
+  last_message_sent_length = pd->last_message_sent_length;
+  memcpy (last_message_sent, pd->last_message_sent, last_message_sent_length);
+  pending_response = pd->pending_response;
+  pending_response_length = pd->pending_response_length;
+  memcpy (pending_response_data, pd->pending_response_data, pending_response_length);
+  oo_emulator_active = pd->address;
+
+} /* oo_emulator_load */
+
+
+static void
+  oo_emulator_save
+    (OSDP_CONTEXT *ctx,
+    OO_EMULATED_PD *pd)
+
+{ /* oo_emulator_save */
+
+  memcpy (pd->context, ctx, sizeof (*ctx));
+  memcpy (&(pd->card), &p_card, sizeof (pd->card));
+  pd->last_command_received = last_command_received;
+  pd->last_check_value = last_check_value;
+  pd->last_message_sent_length = last_message_sent_length;
+  memcpy (pd->last_message_sent, last_message_sent, last_message_sent_length);
+  pd->pending_response = pending_response;
+  pd->pending_response_length = pending_response_length;
+  memcpy (pd->pending_response_data, pending_response_data, pending_response_length);
+
+} /* oo_emulator_save */
+
+
+/*
+  oo_emulator_switch - give the context to another emulated PD
+*/
+
+static void
+  oo_emulator_switch
+    (OSDP_CONTEXT *ctx,
+    int address)
+
+{ /* oo_emulator_switch */
+
+  if (address != oo_emulator_active)
+  {
+    oo_emulator_save (ctx, oo_emulated [oo_emulator_active]);
+    oo_emulator_load (ctx, oo_emulated [address]);
+    if (ctx->verbosity > 3)
+      fprintf (ctx->log, "Emulator: PD %02X now active\n", address);
+  };
+
+} /* oo_emulator_switch */
+
+
+/*
+  oo_emulator_addresses - parse an "emulate-addresses" value
+
+  the list is decimal addresses and ranges, e.g. "1-32" or "1,5,10-12".
+  returns the number of addresses, or -1 if the list is malformed.
+*/
+
+int
+  oo_emulator_addresses
+    (char *list,
+    unsigned char *map)
+
+{ /* oo_emulator_addresses */
+
+  int count;
+  int first;
+  int i;
+  int last;
+  char *p;
+
+
+  count = 0;
+  memset (map, 0, 128/8);
+  p = list;
+  while (*p != 0)
+  {
+    first = strtol (p, &p, 10);
+    last = first;
+    if (*p EQUALS '-')
+      last = strtol (p+1, &p, 10);
+    if ((first < 0) || (last < first) || (last >= OSDP_CONFIGURATION_ADDRESS))
+      return (-1);
+    for (i=first; i<=last; i++)
+    {
+      if (!(map [i/8] & (1 << (i%8))))
+        count++;
+      map [i/8] = map [i/8] | (1 << (i%8));
+    };
+    while ((*p EQUALS ',') || (*p EQUALS ' '))
+      p++;
+    if ((*p != 0) && ((*p < '0') || (*p > '9')))
+      return (-1);
+  };
+  return (count);
+
+} /* oo_emulator_addresses */
+
+
+/*
+  oo_emulator_command - point a socket command at the PD it names
+
+  a command with a "pd" member (decimal address) is carried out by that
+  PD; without one it goes to whichever PD was last addressed.
+*/
+
+int
+  oo_emulator_command
+    (OSDP_CONTEXT *ctx,
+    char *socket_command)
+
+{ /* oo_emulator_command */
+
+  int address;
+  json_error_t error;
+  json_t *root;
+  int status;
+  json_t *value;
+
+
+  status = ST_OK;
+  if (oo_emulator_count EQUALS 0)
+    return (status);
+
+  root = json_loads (socket_command, 0, &error);
+  if (root != NULL)
+  {
+    value = json_object_get (root, "pd");
+    if (json_is_string (value))
+    {
+      address = -1;
+      sscanf (json_string_value (value), "%d", &address);
+      if ((address >= 0) && (address < OSDP_CONFIGURATION_ADDRESS) && (oo_emulated [address] != NULL))
+        oo_emulator_switch (ctx, address);
+      else
+      {
+        fprintf (ctx->log, "Emulator: command for PD %s, not emulated\n", json_string_value (value));
+        status = ST_EMULATE_ADDRESSES;
+      };
+    };
+    json_decref (root);
+  };
+  return (status);
+
+} /* oo_emulator_command */
+
+
+/*
+  oo_emulator_select - swap in the PD an incoming frame is addressed to
+
+  called with what has arrived of the frame so far, before it is parsed.
+  replies (high bit set) are not for any of our PD's.
+*/
+
+int
+  oo_emulator_select
+    (OSDP_CONTEXT *ctx,
+    unsigned char *frame,
+    int length)
+
+{ /* oo_emulator_select */
+
+  int address;
+
+
+  if ((oo_emulator_count > 0) && (length > 1) && (frame [0] EQUALS C_SOM))
+  {
+    if (!(frame [1] & 0x80))
+    {
+      address = frame [1];
+      if (address EQUALS OSDP_CONFIGURATION_ADDRESS)
+        address = oo_emulator_first;
+      if (oo_emulated [address] != NULL)
+      {
+        oo_emulator_switch (ctx, address);
+
+        // count it once, when all of it is here
+        if ((length > 3) && (length EQUALS (frame [2] + 256*frame [3])))
+          oo_emulated [address]->frames ++;
+      };
+    };
+  };
+  return (ST_OK);
+
+} /* oo_emulator_select */
+
+
+/*
+  oo_emulator_start - set up a context image for each emulated address
+
+  called once the configuration is loaded.  each PD starts as a copy of
+  the configured one, with its own address.  the lowest address ends up
+  in the context.
+*/
+
+int
+  oo_emulator_start
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_emulator_start */
+
+  int address;
+  OO_EMULATED_PD *pd;
+  int status;
+
+
+  status = ST_OK;
+  if (ctx->role != OSDP_ROLE_PD)
+    return (status);
+
+  oo_emulator_first = -1;
+  for (address=0; (status EQUALS ST_OK) && (address<OSDP_CONFIGURATION_ADDRESS); address++)
+  {
+    if (ctx->emulate [address/8] & (1 << (address%8)))
+    {
+      pd = calloc (1, sizeof (*pd));
+      if (pd != NULL)
+        pd->context = malloc (sizeof (*(pd->context)));
+      if ((pd EQUALS NULL) || (pd->context EQUALS NULL))
+        status = ST_EMULATE_ADDRESSES;
+      if (status EQUALS ST_OK)
+      {
+        pd->address = address;
+        memcpy (pd->context, ctx, sizeof (*ctx));
+        pd->context->pd_address = address;
+        memcpy (&(pd->card), &p_card, sizeof (pd->card));
+        pd->card.addr = address;
+        oo_emulated [address] = pd;
+        oo_emulator_count ++;
+        if (oo_emulator_first EQUALS -1)
+          oo_emulator_first = address;
+      };
+    };
+  };
+  if ((status EQUALS ST_OK) && (oo_emulator_count > 0))
+  {
+    oo_emulator_load (ctx, oo_emulated [oo_emulator_first]);
+    fprintf (ctx->log, "Emulator: answering for %d. PD's, first %02X\n",
+      oo_emulator_count, oo_emulator_first);
+  };
+  return (status);
+
+} /* oo_emulator_start */
+
+
+/*
+  oo_emulator_write_status - add the emulated PD's to the status file
+
+  emits an "emulator" member (followed by a comma) into the open JSON
+  object, if more than one PD is being emulated.
+*/
+
+void
+  oo_emulator_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_emulator_write_status */
+
+  int address;
+  int first;
+  OSDP_CONTEXT *pd_ctx;
+
+
+  if (oo_emulator_count > 0)
+  {
+    fprintf (sf, "\"emulator\" : { \"active\" : \"%02X\", \"count\" : \"%d\", \"pd\" : [",
+      oo_emulator_active, oo_emulator_count);
+    first = 1;
+    for (address=0; address<OSDP_CONFIGURATION_ADDRESS; address++)
+    {
+      if (oo_emulated [address] != NULL)
+      {
+        pd_ctx = oo_emulated [address]->context;
+        if (address EQUALS oo_emulator_active)
+          pd_ctx = ctx;
+        fprintf (sf,
+"%s\n  { \"address\" : \"%02X\", \"frames\" : \"%u\", \"sequence\" : \"%d\", \"secure-channel\" : \"%d\" }",
+          first ? "" : ",", address, oo_emulated [address]->frames,
+          pd_ctx->last_sequence_received, pd_ctx->secure_channel_use [OO_SCU_ENAB]);
+        first = 0;
+      };
+    };
+    fprintf (sf, "\n] },\n");
+  };
+
+} /* oo_emulator_write_status */
@@ -0,0 +1,206 @@
+/*
+  oo-eventlog - binary event log for the per-frame and error paths
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  with "event-log" set the frame lines (---OSDP Frame, SOM ADDR=..., Pkt
+  ...), sequence mismatches, NAKs, poll timeouts and whatever else goes
+  through oosdp_log are written here as records instead of as text to
+  osdp.log.  a record is the event, the time and the values the text was
+  made from; nothing is formatted.  every frame is recorded whatever the
+  verbosity, with the verbosity at the time, so osdp-eventlog can show
+  the text as it would have been (or at another verbosity) and count
+  things exactly.  the rest of the log is still text in osdp.log.
+
+  the file is buffered and flushed once a second; what is in the buffer
+  at exit goes out with the exit.
+*/
+
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#include <open-osdp.h>
+#include <oo-eventlog.h>
+
+
+#define OO_EVLOG_BUFFER (64*1024)
+
+static char oo_evlog_buffer [OO_EVLOG_BUFFER];
+static time_t oo_evlog_flushed;
+
+
+/*
+  oo_eventlog - write one event
+
+  fields is one OO_EVLOG_FIELD_... character per value.  an 'x' takes a
+  pointer and a length, the others take an int (or a char * for 's'.)
+  a record that would be too long has its last values cut short.
+*/
+
+int
+  oo_eventlog
+    (OSDP_CONTEXT *ctx,
+    int event,
+    char *fields,
+    ...)
+
+{ /* oo_eventlog */
+
+  va_list args;
+  struct timespec captured;
+  char *f;
+  int length;
+  unsigned char *octets;
+  unsigned char record [sizeof (OO_EVLOG_RECORD) + OO_EVLOG_FIELDS_MAX];
+  OO_EVLOG_RECORD *r;
+  int status;
+  unsigned char *v;
+  unsigned int value;
+  unsigned short int value_short;
+
+
+  status = ST_OK;
+  if (ctx->event_log EQUALS NULL)
+    return (status);
+
+  // stamped like oosdp_log does: a monitored frame by when it came off the line
+
+  if (!oo_monitor_frame_time (&captured))
+    clock_gettime (CLOCK_REALTIME, &captured);
+
+  r = (OO_EVLOG_RECORD *)record;
+  r->event = event;
+  r->verbosity = ctx->verbosity;
+  r->time_sec = captured.tv_sec;
+  r->time_nsec = captured.tv_nsec;
+  v = record + sizeof (*r);
+
+  va_start (args, fields);
+  for (f=fields; *f != 0; f++)
+  {
+    // room for the type and the length or value in any case
+
+    if ((v + 5) > (record + sizeof (record)))
+      break;
+    *(v++) = *f;
+    switch (*f)
+    {
+    case OO_EVLOG_FIELD_OCTET:
+      *(v++) = (unsigned char)va_arg (args, int);
+      break;
+    case OO_EVLOG_FIELD_SHORT:
+      value_short = (unsigned short int)va_arg (args, int);
+      memcpy (v, &value_short, sizeof (value_short));
+      v = v + sizeof (value_short);
+      break;
+    case OO_EVLOG_FIELD_INT:
+      value = va_arg (args, unsigned int);
+      memcpy (v, &value, sizeof (value));
+      v = v + sizeof (value);
+      break;
+    case OO_EVLOG_FIELD_OCTETS:
+    case OO_EVLOG_FIELD_STRING:
+      if (*f EQUALS OO_EVLOG_FIELD_OCTETS)
+      {
+        octets = va_arg (args, unsigned char *);
+        length = va_arg (args, int);
+      }
+      else
+      {
+        octets = (unsigned char *)va_arg (args, char *);
+        length = strlen ((char *)octets);
+      };
+      if (length < 0)
+        length = 0;
+      if (length > (record + sizeof (record) - (v + 2)))
+        length = record + sizeof (record) - (v + 2);
+      value_short = length;
+      memcpy (v, &value_short, sizeof (value_short));
+      v = v + sizeof (value_short);
+      memcpy (v, octets, length);
+      v = v + length;
+      break;
+    default:
+      v--; // not a field type, leave it out
+      break;
+    };
+  };
+  va_end (args);
+  r->length = v - (record + sizeof (*r));
+
+  if (1 != fwrite (record, v - record, 1, ctx->event_log))
+    status = ST_EVENT_LOG_OPEN;
+  if (captured.tv_sec != oo_evlog_flushed)
+  {
+    fflush (ctx->event_log);
+    oo_evlog_flushed = captured.tv_sec;
+  };
+  return (status);
+
+} /* oo_eventlog */
+
+
+/*
+  oo_eventlog_open - start the event log named in event_log_path
+
+  settings can be read more than once; the log is only started the first time.
+*/
+
+int
+  oo_eventlog_open
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_eventlog_open */
+
+  OO_EVLOG_HEADER header;
+  int status;
+
+
+  status = ST_OK;
+  if ((ctx->event_log != NULL) || (strlen (ctx->event_log_path) EQUALS 0))
+    return (status);
+
+  ctx->event_log = fopen (ctx->event_log_path, "w");
+  if (ctx->event_log EQUALS NULL)
+  {
+    fprintf (stderr, "event log %s could not be opened\n", ctx->event_log_path);
+    status = ST_EVENT_LOG_OPEN;
+  };
+  if (status EQUALS ST_OK)
+  {
+    (void) setvbuf (ctx->event_log, oo_evlog_buffer, _IOFBF, sizeof (oo_evlog_buffer));
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, OO_EVLOG_MAGIC, sizeof (header.magic));
+    header.role = ctx->role;
+    header.pid = getpid ();
+    header.started_sec = time (NULL);
+    if (1 != fwrite (&header, sizeof (header), 1, ctx->event_log))
+      status = ST_EVENT_LOG_OPEN;
+    fflush (ctx->event_log);
+  };
+  return (status);
+
+} /* oo_eventlog_open */
+
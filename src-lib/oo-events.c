@@ -0,0 +1,511 @@
+/*
+  oo-events - scheduled card, keypad and input events for load testing
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  the pd-events command sets up, per PD address and per kind of event, a
+  rate (fixed intervals or Poisson arrivals), a burst size and a count.
+  there's no timer: when a poll comes in for the PD every event that has
+  come due since the last poll is queued, stamped with the time it was
+  due, and the oldest one goes out as the poll response through the usual
+  action_osdp_POLL replies (the card data, or a pending osdp_KEYPAD or
+  osdp_ISTATR.)  an event that finds the queue full is dropped and counted.
+
+  card and keypad events carry their creation time (CLOCK_MONOTONIC, so
+  the ACU must be on the same host, as it is on a virtual bus.)  the ACU
+  recognizes them, records event-to-receipt latency and skips the action
+  routines, which would otherwise run a shell per event.  an osdp_RAW is
+  80 bits: "OE" and the time in microseconds, most significant first.  an
+  osdp_KEYPAD is 16 keys: # (0x0D) and the low 15 decimal digits of the
+  time.  input events toggle one input at a time and are only timed at
+  the PD (creation to response sent.)  the ACU only looks for these with
+  the "pd-events-sink" setting; otherwise every osdp_RAW and osdp_KEYPAD
+  goes to the action routines as always.
+*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#include <open-osdp.h>
+
+
+#define OO_EVENT_KEYPAD_MODULUS (1000000000000000ULL) // 15 digits
+
+extern unsigned char pending_response;
+extern unsigned char pending_response_data [1500];
+extern int pending_response_length;
+extern OSDP_PARAMETERS p_card;
+static OO_EVENT_PD *oo_event_pd [OSDP_CONFIGURATION_ADDRESS+1];
+static OO_EVENT_STATS oo_event_stats;
+static char *oo_event_name [] = { "card", "keypad", "input" };
+
+
+static unsigned long long
+  oo_events_now
+    (void)
+
+{ /* oo_events_now */
+
+  struct timespec now;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (((unsigned long long)now.tv_sec * 1000000ULL) + (now.tv_nsec / 1000));
+
+} /* oo_events_now */
+
+
+/*
+  oo_events_interval - microseconds to the next scheduled time
+
+  never 0, so the schedule always moves on.
+*/
+
+static unsigned long long
+  oo_events_interval
+    (OO_EVENT_PD *pd,
+    OO_EVENT_SCHEDULE *schedule)
+
+{ /* oo_events_interval */
+
+  unsigned long long interval;
+  double seconds;
+
+
+  seconds = 1.0 / schedule->rate;
+  if (schedule->poisson)
+    seconds = -log (1.0 - erand48 (pd->random_state)) / schedule->rate;
+  interval = (unsigned long long)(seconds * 1000000.0);
+  if (interval < 1)
+    interval = 1;
+  return (interval);
+
+} /* oo_events_interval */
+
+
+/*
+  oo_events_generate - queue everything that has come due for this PD
+
+  at most OO_EVENT_CATCHUP_MAX periods per kind are caught up on in one
+  poll.  if the PD is further behind than that (it wasn't polled for a
+  while) the rest are dropped and the schedule starts again from now.
+*/
+
+static void
+  oo_events_generate
+    (OSDP_CONTEXT *ctx,
+    OO_EVENT_PD *pd,
+    unsigned long long now)
+
+{ /* oo_events_generate */
+
+  int b;
+  int kind;
+  int periods;
+  OO_EVENT_SCHEDULE *schedule;
+  int slot;
+
+
+  for (kind=0; kind<OO_EVENT_KINDS; kind++)
+  {
+    schedule = &(pd->schedule [kind]);
+    periods = 0;
+    while ((schedule->rate > 0.0) && (pd->next_usec [kind] <= now))
+    {
+      if (periods >= OO_EVENT_CATCHUP_MAX)
+      {
+        unsigned long long skipped;
+
+        // generated, but dropped without being queued (and no more than the count allows)
+        skipped = schedule->burst * (1 + (now - pd->next_usec [kind]) / oo_events_interval (pd, schedule));
+        if ((schedule->count > 0) && (skipped >= (schedule->count - pd->generated [kind])))
+        {
+          skipped = schedule->count - pd->generated [kind];
+          schedule->rate = 0.0;
+          fprintf (ctx->log, "Events: PD %02X %s schedule done, %u. generated\n",
+            p_card.addr, oo_event_name [kind], schedule->count);
+        };
+        oo_event_stats.generated [kind] = oo_event_stats.generated [kind] + skipped;
+        oo_event_stats.dropped [kind] = oo_event_stats.dropped [kind] + skipped;
+        pd->generated [kind] = pd->generated [kind] + skipped;
+        pd->next_usec [kind] = now + oo_events_interval (pd, schedule);
+        break;
+      };
+      periods ++;
+      for (b=0; (b<schedule->burst) && (schedule->rate > 0.0); b++)
+      {
+        if (pd->queue_count < OO_EVENT_QUEUE_MAX)
+        {
+          slot = (pd->queue_first + pd->queue_count) % OO_EVENT_QUEUE_MAX;
+          pd->queue_kind [slot] = kind;
+          pd->queue_usec [slot] = pd->next_usec [kind];
+          pd->queue_count ++;
+        }
+        else
+          oo_event_stats.dropped [kind] ++;
+        oo_event_stats.generated [kind] ++;
+        if (oo_event_stats.first_usec EQUALS 0)
+          oo_event_stats.first_usec = pd->next_usec [kind];
+        oo_event_stats.last_usec = pd->next_usec [kind];
+        pd->generated [kind] ++;
+
+        if ((schedule->count > 0) && (pd->generated [kind] >= schedule->count))
+        {
+          schedule->rate = 0.0;
+          fprintf (ctx->log, "Events: PD %02X %s schedule done, %u. generated\n",
+            p_card.addr, oo_event_name [kind], pd->generated [kind]);
+        };
+      };
+      pd->next_usec [kind] = pd->next_usec [kind] + oo_events_interval (pd, schedule);
+    };
+  };
+
+} /* oo_events_generate */
+
+
+/*
+  oo_events_poll - called as the PD answers a poll
+
+  queues the events that are due and, if no other response is already
+  waiting, sets up the oldest one to be the response to this poll.
+*/
+
+int
+  oo_events_poll
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_events_poll */
+
+  unsigned long long created;
+  int i;
+  int inputs;
+  int kind;
+  unsigned long long now;
+  OO_EVENT_PD *pd;
+  int status;
+
+
+  status = ST_OK;
+  pd = oo_event_pd [p_card.addr & OSDP_CONFIGURATION_ADDRESS];
+  if (pd EQUALS NULL)
+    return (status);
+
+  now = oo_events_now ();
+  oo_events_generate (ctx, pd, now);
+  if ((pd->queue_count > 0) && (pending_response_length EQUALS 0) && (ctx->card_data_valid EQUALS 0))
+  {
+    kind = pd->queue_kind [pd->queue_first];
+    created = pd->queue_usec [pd->queue_first];
+    pd->queue_first = (pd->queue_first + 1) % OO_EVENT_QUEUE_MAX;
+    pd->queue_count --;
+
+    switch (kind)
+    {
+    case OO_EVENT_CARD:
+      ctx->card_format = 0;
+      ctx->card_data_valid = OO_EVENT_CARD_BITS;
+      ctx->creds_a_avail = OO_EVENT_CARD_BITS/8;
+      ctx->credentials_data [0] = 'O';
+      ctx->credentials_data [1] = 'E';
+      for (i=0; i<8; i++)
+        ctx->credentials_data [2+i] = 0xff & (created >> (8*(7-i)));
+      break;
+
+    case OO_EVENT_KEYPAD:
+      pending_response_data [0] = 0; // reader 0
+      pending_response_data [1] = OO_EVENT_KEYPAD_DIGITS;
+      pending_response_data [2] = 0x0d;
+      sprintf ((char *)(pending_response_data+3), "%015llu", created % OO_EVENT_KEYPAD_MODULUS);
+      pending_response_length = 2 + OO_EVENT_KEYPAD_DIGITS;
+      pending_response = OSDP_KEYPAD;
+      break;
+
+    case OO_EVENT_INPUT:
+      inputs = ctx->configured_inputs;
+      if (inputs < 1)
+        inputs = 1;
+      if (inputs > 32)
+        inputs = 32;
+      pd->inputs = pd->inputs ^ (1 << (pd->next_input % inputs));
+      pd->next_input = (pd->next_input + 1) % inputs;
+      for (i=0; i<inputs; i++)
+        pending_response_data [i] = 1 & (pd->inputs >> i);
+      pending_response_length = inputs;
+      pending_response = OSDP_ISTATR;
+      break;
+    };
+    oo_event_stats.delivered [kind] ++;
+    oo_latency_record (&(oo_event_stats.reply [kind]), now - created);
+  };
+  return (status);
+
+} /* oo_events_poll */
+
+
+/*
+  oo_events_read_schedule - fill in a schedule from a command or script entry
+
+  members are "event" (card, keypad, input or all), "rate" (events per
+  second, 0 to stop, at most OO_EVENT_RATE_MAX), "distribution" (fixed or poisson), "burst", "count",
+  "seed" and "pd" (decimal address), all strings.
+*/
+
+int
+  oo_events_read_schedule
+    (json_t *item,
+    OO_EVENT_SCHEDULE *schedule)
+
+{ /* oo_events_read_schedule */
+
+  int i;
+  int status;
+  json_t *value;
+
+
+  status = ST_OK;
+  memset (schedule, 0, sizeof (*schedule));
+  schedule->address = -1;
+  schedule->kind = OO_EVENT_CARD;
+  schedule->burst = 1;
+  schedule->seed = 1;
+
+  value = json_object_get (item, "event");
+  if (json_is_string (value))
+  {
+    schedule->kind = -2;
+    if (0 EQUALS strcmp (json_string_value (value), "all"))
+      schedule->kind = OO_EVENT_ALL;
+    for (i=0; i<OO_EVENT_KINDS; i++)
+      if (0 EQUALS strcmp (json_string_value (value), oo_event_name [i]))
+        schedule->kind = i;
+    if (schedule->kind EQUALS -2)
+      status = ST_EVENTS_SCHEDULE;
+  };
+  value = json_object_get (item, "rate");
+  if (json_is_string (value))
+    sscanf (json_string_value (value), "%lf", &(schedule->rate));
+  value = json_object_get (item, "distribution");
+  if (json_is_string (value))
+    if (0 EQUALS strcmp (json_string_value (value), "poisson"))
+      schedule->poisson = 1;
+  value = json_object_get (item, "burst");
+  if (json_is_string (value))
+    sscanf (json_string_value (value), "%d", &(schedule->burst));
+  value = json_object_get (item, "count");
+  if (json_is_string (value))
+    sscanf (json_string_value (value), "%u", &(schedule->count));
+  value = json_object_get (item, "seed");
+  if (json_is_string (value))
+    sscanf (json_string_value (value), "%u", &(schedule->seed));
+  value = json_object_get (item, "pd");
+  if (json_is_string (value))
+    sscanf (json_string_value (value), "%d", &(schedule->address));
+
+  if ((schedule->rate < 0.0) || (schedule->rate > OO_EVENT_RATE_MAX) || (schedule->burst < 1) ||
+    (schedule->address < -1) || (schedule->address >= OSDP_CONFIGURATION_ADDRESS))
+    status = ST_EVENTS_SCHEDULE;
+  return (status);
+
+} /* oo_events_read_schedule */
+
+
+/*
+  oo_events_received - ACU: count and time an event from a PD
+
+  returns 1 if the osdp_RAW or osdp_KEYPAD was a scheduled event, in which
+  case the caller need do nothing more with it.  always 0 unless the ACU
+  has "pd-events-sink" set, so real reads are never taken for events.
+*/
+
+int
+  oo_events_received
+    (OSDP_CONTEXT *ctx,
+    OSDP_MSG *msg)
+
+{ /* oo_events_received */
+
+  unsigned long long created;
+  int i;
+  int kind;
+  unsigned long long latency;
+  unsigned long long now;
+  unsigned char *p;
+
+
+  if (!ctx->events_sink)
+    return (0);
+  kind = -1;
+  created = 0;
+  p = msg->data_payload;
+  now = oo_events_now ();
+  latency = 0;
+  if ((msg->msg_cmd EQUALS OSDP_RAW) && (msg->data_length >= 4+(OO_EVENT_CARD_BITS/8)) &&
+    (p [2] EQUALS OO_EVENT_CARD_BITS) && (p [3] EQUALS 0) && (p [4] EQUALS 'O') && (p [5] EQUALS 'E'))
+  {
+    kind = OO_EVENT_CARD;
+    for (i=0; i<8; i++)
+      created = (created << 8) | p [6+i];
+    if (now > created)
+      latency = now - created;
+  };
+  if ((msg->msg_cmd EQUALS OSDP_KEYPAD) && (msg->data_length >= 2+OO_EVENT_KEYPAD_DIGITS) &&
+    (p [1] EQUALS OO_EVENT_KEYPAD_DIGITS) && (p [2] EQUALS 0x0d))
+  {
+    kind = OO_EVENT_KEYPAD;
+    for (i=0; i<OO_EVENT_KEYPAD_DIGITS-1; i++)
+    {
+      if ((p [3+i] < '0') || (p [3+i] > '9'))
+        kind = -1;
+      created = (10 * created) + (p [3+i] - '0');
+    };
+    latency = ((now % OO_EVENT_KEYPAD_MODULUS) + OO_EVENT_KEYPAD_MODULUS - created) % OO_EVENT_KEYPAD_MODULUS;
+  };
+
+  if (kind >= 0)
+  {
+    oo_event_stats.received [kind] ++;
+    oo_latency_record (&(oo_event_stats.end_to_end [kind]), latency);
+    if (oo_event_stats.first_usec EQUALS 0)
+      oo_event_stats.first_usec = now;
+    oo_event_stats.last_usec = now;
+    if (ctx->verbosity > 3)
+      fprintf (ctx->log, "Events: %s event from PD %02X, %llu. usec\n",
+        oo_event_name [kind], msg->ptr [1] & OSDP_CONFIGURATION_ADDRESS, latency);
+  };
+  return (kind >= 0);
+
+} /* oo_events_received */
+
+
+/*
+  oo_events_start - put the schedules from a pd-events command in place
+*/
+
+int
+  oo_events_start
+    (OSDP_CONTEXT *ctx,
+    OO_EVENT_ARGS *args)
+
+{ /* oo_events_start */
+
+  int address;
+  int i;
+  int kind;
+  unsigned long long now;
+  OO_EVENT_PD *pd;
+  OO_EVENT_SCHEDULE *schedule;
+  int status;
+
+
+  status = ST_OK;
+  now = oo_events_now ();
+  for (i=0; (status EQUALS ST_OK) && (i<args->count); i++)
+  {
+    schedule = &(args->schedule [i]);
+    address = schedule->address;
+    if (address EQUALS -1)
+      address = p_card.addr & OSDP_CONFIGURATION_ADDRESS;
+    pd = oo_event_pd [address];
+    if (pd EQUALS NULL)
+    {
+      pd = calloc (1, sizeof (*pd));
+      if (pd EQUALS NULL)
+        status = ST_EVENTS_SCHEDULE;
+      oo_event_pd [address] = pd;
+    };
+    for (kind=0; (status EQUALS ST_OK) && (kind<OO_EVENT_KINDS); kind++)
+    {
+      if ((schedule->kind EQUALS kind) || (schedule->kind EQUALS OO_EVENT_ALL))
+      {
+        memcpy (&(pd->schedule [kind]), schedule, sizeof (pd->schedule [kind]));
+        pd->schedule [kind].address = address;
+        pd->generated [kind] = 0;
+        pd->random_state [0] = 0x330e;
+        pd->random_state [1] = 0xffff & schedule->seed;
+        pd->random_state [2] = 0xffff & ((schedule->seed >> 16) + address);
+        pd->next_usec [kind] = now;
+        if (schedule->rate > 0.0)
+        {
+          if (schedule->poisson)
+            pd->next_usec [kind] = now + oo_events_interval (pd, schedule);
+          fprintf (ctx->log, "Events: PD %02X %s %.3f/sec %s burst %d count %u\n",
+            address, oo_event_name [kind], schedule->rate,
+            schedule->poisson ? "poisson" : "fixed", schedule->burst, schedule->count);
+        }
+        else
+          fprintf (ctx->log, "Events: PD %02X %s stopped\n", address, oo_event_name [kind]);
+      };
+    };
+  };
+  return (status);
+
+} /* oo_events_start */
+
+
+/*
+  oo_events_write_status - add the event counts and latencies to the status file
+
+  emits an "events" member (followed by a comma) into the open JSON object,
+  if any events were generated or received.  "per-sec" is events per
+  second from the first to the last one generated (PD) or received (ACU.)
+*/
+
+void
+  oo_events_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_events_write_status */
+
+  unsigned long long elapsed;
+  OSDP_LATENCY_HISTOGRAM *h;
+  int kind;
+  unsigned int total;
+
+
+  if (oo_event_stats.first_usec EQUALS 0)
+    return;
+
+  elapsed = oo_event_stats.last_usec - oo_event_stats.first_usec;
+  total = 0;
+  for (kind=0; kind<OO_EVENT_KINDS; kind++)
+    total = total + oo_event_stats.generated [kind] + oo_event_stats.received [kind];
+  fprintf (sf, "\"events\" : { \"per-sec\" : \"%.1f\"",
+    (elapsed > 0) ? ((double)total * 1000000.0 / (double)elapsed) : 0.0);
+  for (kind=0; kind<OO_EVENT_KINDS; kind++)
+  {
+    h = &(oo_event_stats.reply [kind]);
+    if (ctx->role EQUALS OSDP_ROLE_ACU)
+      h = &(oo_event_stats.end_to_end [kind]);
+    fprintf (sf,
+",\n  \"%s\" : { \"generated\" : \"%u\", \"delivered\" : \"%u\", \"dropped\" : \"%u\", \"received\" : \"%u\", \"%s\" : { \"count\" : \"%u\", \"min\" : \"%llu\", \"max\" : \"%llu\", \"p50\" : \"%llu\", \"p99\" : \"%llu\" } }",
+      oo_event_name [kind], oo_event_stats.generated [kind], oo_event_stats.delivered [kind],
+      oo_event_stats.dropped [kind], oo_event_stats.received [kind],
+      (ctx->role EQUALS OSDP_ROLE_ACU) ? "end-to-end" : "reply",
+      h->count, h->min_usec, h->max_usec, oo_latency_percentile (h, 50), oo_latency_percentile (h, 99));
+  };
+  fprintf (sf, " },\n");
+
+} /* oo_events_write_status */
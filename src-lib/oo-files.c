@@ -23,8 +23,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 
 #include <osdp-tls.h>
@@ -32,6 +35,7 @@
 #include <osdp_conformance.h>
 
 
+extern OSDP_BUFFER osdp_buf;
 extern OSDP_PARAMETERS p_card;
 
 
@@ -49,13 +53,36 @@ int
 
 { /* oo_filetransfer_initiate */
 
-  int current_length;
-  OSDP_HDR_FILETRANSFER *file_transfer;
-  int size_to_read;
   int status;
-  int status_io;
-  int transfer_send_size;
-  static unsigned char xfer_buffer [OSDP_BUF_MAX];
+
+
+  status = oo_filetransfer_map (context, 1+details);
+  if (status EQUALS ST_OK)
+    status = oo_filetransfer_start (context, details [0]);
+  if (status EQUALS ST_OK)
+    status = osdp_send_filetransfer (context);
+  return(status);
+
+} /* oo_filetransfer_initiate */
+
+
+/*
+  oo_filetransfer_map - open the file to be sent and map it
+
+  the file is mapped read-only for the length of the transfer and each
+  fragment is taken straight from the mapping.  an empty filename means
+  the default data file.  an empty file is refused (ST_OSDP_BAD_TRANSFER_FILE.)
+*/
+int
+  oo_filetransfer_map
+  (OSDP_CONTEXT *context,
+  char *filename)
+
+{ /* oo_filetransfer_map */
+
+  struct stat datafile_status;
+  int fd;
+  int status;
 
 
   status = ST_OK;
@@ -63,224 +90,708 @@ int
   // find and open file
 
   strcpy(context->xferctx.filename, "./osdp_data_file");
-  if (strlen (1+details) > 0)
-    strcpy(context->xferctx.filename, 1+details);
+  if (strlen (filename) > 0)
+    strcpy(context->xferctx.filename, filename);
 
   fprintf(context->log, "  File transfer: file %s\n",
     context->xferctx.filename);
 
-  context->xferctx.xferf = fopen (context->xferctx.filename, "r");
-  if (context->xferctx.xferf EQUALS NULL)
+  fd = open (context->xferctx.filename, O_RDONLY);
+  if (fd EQUALS -1)
   {
     fprintf(context->log, "  local open failed, errno %d\n", errno);
-          strcpy(context->xferctx.filename, "/opt/osdp-conformance/etc/osdp_data_file");
-          context->xferctx.xferf = fopen (context->xferctx.filename, "r");
-          if (context->xferctx.xferf EQUALS NULL)
-          {
-            fprintf(context->log, "SEND: data file not found (checked %s as last resort)\n",
-              context->xferctx.filename);
-            status = ST_OSDP_BAD_TRANSFER_FILE;
-          }
-          else 
-            if (context->verbosity > 3)
-              fprintf(stderr, "data file is /opt/osdp-conformance/etc/osdp_data_file\n");
-        }
-        else
+    strcpy(context->xferctx.filename, "/opt/osdp-conformance/etc/osdp_data_file");
+    fd = open (context->xferctx.filename, O_RDONLY);
+    if (fd EQUALS -1)
+    {
+      fprintf(context->log, "SEND: data file not found (checked %s as last resort)\n",
+        context->xferctx.filename);
+      status = ST_OSDP_BAD_TRANSFER_FILE;
+    }
+    else
+      if (context->verbosity > 3)
+        fprintf(stderr, "data file is /opt/osdp-conformance/etc/osdp_data_file\n");
+  }
+  else
+  {
+    if (context->verbosity > 3)
+    {
+      fprintf(context->log, "  File transfer: Data file is %s\n",
+        context->xferctx.filename);
+    };
+  };
+
+  if (status EQUALS ST_OK)
+  {
+    (void) fstat (fd, &datafile_status);
+    fprintf(context->log,
+      "  FIle transfer: data file %s size %d.\n",
+      context->xferctx.filename, (int)datafile_status.st_size);
+    context->xferctx.total_length = datafile_status.st_size;
+
+    // an empty file has no fragments to send (and nothing to map), so it isn't sent at all.
+
+    context->xferctx.source = NULL;
+    context->xferctx.source_shared = 0;
+    context->xferctx.source_length = datafile_status.st_size;
+    if (context->xferctx.source_length EQUALS 0)
+    {
+      fprintf(context->log, "SEND: %s is empty, not transferred\n",
+        context->xferctx.filename);
+      status = ST_OSDP_BAD_TRANSFER_FILE;
+    };
+    if (status EQUALS ST_OK)
+    {
+      context->xferctx.source = mmap (NULL, context->xferctx.source_length,
+        PROT_READ, MAP_PRIVATE, fd, 0);
+      if (context->xferctx.source EQUALS MAP_FAILED)
+      {
+        fprintf(context->log, "SEND: cannot map %s, errno %d\n",
+          context->xferctx.filename, errno);
+        context->xferctx.source = NULL;
+        status = ST_OSDP_BAD_TRANSFER_FILE;
+      }
+      else
+      {
+        OO_SHA256_CTX sha;
+
+        (void) madvise (context->xferctx.source, context->xferctx.source_length, MADV_SEQUENTIAL);
+
+        // the hash identifies the file if the transfer has to be resumed
+
+        oo_sha256_init (&sha);
+        oo_sha256_update (&sha, context->xferctx.source, context->xferctx.source_length);
+        oo_sha256_final (&sha, context->xferctx.source_hash);
+        if (context->verbosity > 2)
         {
-          if (context->verbosity > 3)
-          {
-            fprintf(context->log, "  File transfer: Data file is %s\n",
-              context->xferctx.filename);
-          };
+          char hash_hex [2*OO_SHA256_OCTETS+1];
+
+          oo_sha256_hex (context->xferctx.source_hash, hash_hex);
+          fprintf(context->log, "  File transfer: %s is %u. octets, SHA-256 %s\n",
+            context->xferctx.filename, (unsigned int)(context->xferctx.source_length), hash_hex);
         };
+      };
+    };
+  };
+  if (fd != -1)
+    close (fd); // the mapping stays valid
+  return (status);
 
-        if (status EQUALS ST_OK)
-        {
-          struct stat datafile_status;
+} /* oo_filetransfer_map */
+
+
+/*
+  oo_filetransfer_start - set up the context to send the mapped file
+
+  picks up a checkpoint if there is one and lays out the fragments.
+  the caller sends the first one.
+*/
+int
+  oo_filetransfer_start
+  (OSDP_CONTEXT *context,
+  int file_type)
+
+{ /* oo_filetransfer_start */
+
+  int status;
+
+
+  status = ST_OK;
+  if (status EQUALS ST_OK)
+  {
+    context->xferctx.file_transfer_type = file_type;
+    context->xferctx.current_offset = 0;
+    context->xferctx.total_sent = 0;
+    context->xferctx.delivered = 0;
 
-          stat(context->xferctx.filename, &datafile_status);
-          fprintf(context->log,
-            "  FIle transfer: data file %s size %d.\n",
-            context->xferctx.filename, (int)datafile_status.st_size);
-          context->xferctx.total_length = datafile_status.st_size;
-          context->xferctx.current_offset = 0; // should be set already but just in case.
+    if (context->pd_cap.rec_max > 0)
+    {
+      if (context->max_message EQUALS 0)
+      {
+        context->max_message = context->pd_cap.rec_max;
+      };
+    };
+    if (context->max_message EQUALS 0)
+    {
+      context->max_message = 128;
+      fprintf(stderr, "max message unset, setting it to 128\n");
+      context->xferctx.current_send_length = context->max_message;
+    };
 
-          // set up the osdp_FILETRANSFER command.  structure uses 'xfer_buffer' as it's data area.
+    // lay out the fragments
+
+    context->xferctx.plan_message_max = 0;
+    context->xferctx.checkpoint_offset = 0;
+    context->xferctx.checkpoint_discard = 0;
+    (void) oo_filetransfer_resume (context);
+    context->xferctx.adapt_message_max = 0;
+    context->xferctx.adapt_clean_run = 0;
+    context->xferctx.adapt_failures = 0;
+    context->xferctx.adapt_pending = 0;
+    context->xferctx.acked_offset = context->xferctx.current_offset;
+    context->xferctx.resumed_offset = context->xferctx.current_offset;
+    context->xferctx.retransmits = 0;
+    context->xferctx.srtt_usec = 0;
+    memset (&(context->xferctx.pace_until), 0, sizeof (context->xferctx.pace_until));
+    clock_gettime (CLOCK_MONOTONIC, &(context->xferctx.started));
+    (void) oo_filetransfer_plan (context);
+
+    if (context->verbosity > 3)
+      fprintf (stderr, "Initiating File Transfer\n");
+    context->xferctx.state = OSDP_XFER_STATE_TRANSFERRING;
+  };
+  return(status);
 
-          memset (xfer_buffer, 0, sizeof(xfer_buffer));
-          file_transfer = (OSDP_HDR_FILETRANSFER *)xfer_buffer;
+} /* oo_filetransfer_start */
 
-          // file type is first octet of details.  save it in the context for later use.
 
-          file_transfer->FtType = details [0];
-          context->xferctx.file_transfer_type = file_transfer->FtType;
+/*
+  oo_filetransfer_limit - largest osdp_FILETRANSFER message the PD accepts
+*/
 
-          // load data from file starting at msg->FtData
+int
+  oo_filetransfer_limit
+    (OSDP_CONTEXT *ctx)
 
-          if (context->pd_cap.rec_max > 0)
-          {
-            if (context->max_message EQUALS 0)
-            {
-              context->max_message = context->pd_cap.rec_max;
-            };
-          };
-          if (context->max_message EQUALS 0)
-          {
-            context->max_message = 128;
-            fprintf(stderr, "max message unset, setting it to 128\n");
-            context->xferctx.current_send_length = context->max_message;
-          };
-          size_to_read = context->max_message;
+{ /* oo_filetransfer_limit */
 
-          // wimp out and restrict transfer, got my math wrong somewhere...
-          if (size_to_read > 1000)
-          {
-            fprintf(context->log, "Limiting filetransfer read size to %d (was %d)\n", 1000, size_to_read);
-            size_to_read = 1000;
-          };
+  int message_max;
 
-          // adjust for header, crc, secure channel
 
-          size_to_read = size_to_read - 6 - 2;
+  message_max = ctx->max_message;
+  if (ctx->xferctx.current_send_length)
+    message_max = ctx->xferctx.current_send_length;
+  if (message_max > OSDP_OFFICIAL_MSG_MAX)
+    message_max = OSDP_OFFICIAL_MSG_MAX;
+  return (message_max);
 
-// if it's checksum use -1 not -2.
+} /* oo_filetransfer_limit */
 
-          if (context->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
-            size_to_read = size_to_read - 2 - 4; //scs header, mac
 
-          size_to_read = size_to_read + 1 - sizeof(OSDP_HDR_FILETRANSFER);
-          if (context->verbosity > 3)
-            fprintf(context->log, "Reading %d. from file to start.\n", size_to_read);
-          memset(&(file_transfer->FtData), 0, size_to_read);
-          status_io = fread (&(file_transfer->FtData), sizeof (unsigned char), size_to_read, context->xferctx.xferf);
+/*
+  oo_filetransfer_plan - work out the fragment size for the transfer
 
-          // if what's left is less than allowed size, adjust
+  the largest osdp_FILETRANSFER that fits the PD's receive size (rec_max
+  from osdp_PDCAP, or an FtUpdateMsgMax it sent since) is computed once and
+  only recomputed if the message size or secure channel state changes.
+  if the line has forced a smaller message (see oo_filetransfer_adapt)
+  that is used instead.  returns the number of FtData octets per fragment.
+*/
 
-          if (status_io < size_to_read)
-            size_to_read = status_io;
+int
+  oo_filetransfer_plan
+    (OSDP_CONTEXT *ctx)
 
-          context->xferctx.total_sent = size_to_read;
-          osdp_doubleByte_to_array(size_to_read, file_transfer->FtFragmentSize);
-          osdp_quadByte_to_array(context->xferctx.total_length, file_transfer->FtSizeTotal);
-          osdp_quadByte_to_array(context->xferctx.current_offset, file_transfer->FtOffset); 
+{ /* oo_filetransfer_plan */
 
-          if (context->verbosity > 3)
-            fprintf (stderr, "Initiating File Transfer\n");
+  int available;
+  int message_max;
+  int secure;
 
-    // send the first chunk.
 
-    context->xferctx.state = OSDP_XFER_STATE_TRANSFERRING;
-    current_length = 0;
-    transfer_send_size = size_to_read;
-    transfer_send_size = transfer_send_size - 1 + sizeof (*file_transfer);
-    status = send_message_ex(context, OSDP_FILETRANSFER, p_card.addr, &current_length,
-      transfer_send_size, (unsigned char *)file_transfer, OSDP_SEC_SCS_17, 0, NULL);
+  message_max = oo_filetransfer_limit (ctx);
+  if ((ctx->xferctx.adapt_message_max > 0) && (ctx->xferctx.adapt_message_max < message_max))
+    message_max = ctx->xferctx.adapt_message_max;
+  secure = (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL);
 
-    // after the send update the current offset
-    context->xferctx.current_offset = context->xferctx.current_offset + size_to_read;
+  if ((message_max != ctx->xferctx.plan_message_max) || (secure != ctx->xferctx.plan_secure))
+  {
+    // header (som, addr, len, ctrl, cmd) and crc.
+    // if it's checksum it's 1 not 2 but a spare octet does no harm.
+
+    available = message_max - 6 - 2;
+
+    // secure channel adds the scs header and mac, and the payload is
+    // padded (always by at least one octet) to whole cipher blocks
+
+    if (secure)
+    {
+      available = available - 2 - 4;
+      available = ((available / OSDP_KEY_OCTETS) * OSDP_KEY_OCTETS) - 1;
+    };
+    available = available + 1 - sizeof(OSDP_HDR_FILETRANSFER);
+    if (available < 1)
+      available = 1;
+
+    ctx->xferctx.plan_message_max = message_max;
+    ctx->xferctx.plan_secure = secure;
+    ctx->xferctx.plan_fragment_size = available;
+    ctx->xferctx.plan_fragments = 0;
+    if (ctx->xferctx.total_length > ctx->xferctx.current_offset)
+      ctx->xferctx.plan_fragments =
+        (ctx->xferctx.total_length - ctx->xferctx.current_offset + available - 1) / available;
+    if (ctx->verbosity > 3)
+      fprintf(ctx->log,
+        "  File transfer: message max %d.%s fragment %d. remaining fragments %u.\n",
+        message_max, secure ? " (secure)" : "", available, ctx->xferctx.plan_fragments);
   };
-  return(status);
+  return (ctx->xferctx.plan_fragment_size);
 
-} /* oo_filetransfer_initiate */
+} /* oo_filetransfer_plan */
+
+
+/*
+  oo_filetransfer_adapt - adjust the fragment size to what the line carries
+
+  called at the ACU when a fragment was acknowledged (OO_FT_ADAPT_ACK) or
+  was lost to a NAK, a bad response CRC or a response timeout.  a loss
+  halves the message size and rewinds to the last acknowledged offset so
+  the next send repeats it.  after OO_FT_GROW_AFTER clean fragments whose
+  round trip stayed steady the message grows by OO_FT_GROW_STEP, back up to
+  the PD's limit.
+*/
+
+void
+  oo_filetransfer_adapt
+    (OSDP_CONTEXT *ctx,
+    int event)
+
+{ /* oo_filetransfer_adapt */
+
+  int limit;
+  struct timespec now;
+  unsigned long long rtt_usec;
+  OSDP_CONTEXT_FILETRANSFER *xfer;
+
+
+  xfer = &(ctx->xferctx);
+  limit = oo_filetransfer_limit (ctx);
+  if ((xfer->adapt_message_max EQUALS 0) || (xfer->adapt_message_max > limit))
+    xfer->adapt_message_max = limit;
+
+  if (event EQUALS OO_FT_ADAPT_ACK)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    rtt_usec = oo_latency_elapsed (&(xfer->fragment_sent), &now);
+    xfer->acked_offset = xfer->current_offset;
+    if (xfer->acked_offset >= xfer->checkpoint_offset + OO_FT_CHECKPOINT_OCTETS)
+      (void) oo_filetransfer_checkpoint (ctx, 0);
+    xfer->adapt_failures = 0;
+    xfer->adapt_clean_run ++;
+
+    // a round trip well over the running average means the line is
+    // struggling at this size; hold off growing.
+
+    if ((xfer->srtt_usec > 0) && (rtt_usec > 2 * xfer->srtt_usec))
+      xfer->adapt_clean_run = 0;
+    if (xfer->srtt_usec EQUALS 0)
+      xfer->srtt_usec = rtt_usec;
+    else
+      xfer->srtt_usec = (7 * xfer->srtt_usec + rtt_usec) / 8;
 
+    if ((xfer->adapt_clean_run >= OO_FT_GROW_AFTER) && (xfer->adapt_message_max < limit))
+    {
+      xfer->adapt_message_max = xfer->adapt_message_max + OO_FT_GROW_STEP;
+      if (xfer->adapt_message_max > limit)
+        xfer->adapt_message_max = limit;
+      xfer->adapt_clean_run = 0;
+      xfer->srtt_usec = 0;
+      if (ctx->verbosity > 3)
+        fprintf(ctx->log, "  File transfer: message size raised to %d.\n", xfer->adapt_message_max);
+    };
+  }
+  else
+  {
+    xfer->retransmits ++;
+    xfer->adapt_failures ++;
+    xfer->adapt_clean_run = 0;
+    xfer->srtt_usec = 0;
+    xfer->adapt_message_max = xfer->adapt_message_max / 2;
+    if (xfer->adapt_message_max < OO_FT_MESSAGE_MIN)
+      xfer->adapt_message_max = OO_FT_MESSAGE_MIN;
+
+    // whatever went out after the last acknowledgement goes again.
+
+    xfer->current_offset = xfer->acked_offset;
+    xfer->total_sent = xfer->acked_offset;
+    xfer->adapt_pending = 1;
+    fprintf(ctx->log,
+      "  File transfer: fragment lost (%s), resending from %u. message size %d.\n",
+      (event EQUALS OO_FT_ADAPT_NAK) ? "nak" :
+        ((event EQUALS OO_FT_ADAPT_CRC) ? "crc" :
+        ((event EQUALS OO_FT_ADAPT_OTHER) ? "not ftstat" : "timeout")),
+      xfer->acked_offset, xfer->adapt_message_max);
+  };
+
+} /* oo_filetransfer_adapt */
+
+
+/*
+  oo_filetransfer_background - ACU file transfer housekeeping on the timer
+
+  sends a fragment that was held back for FtDelay or for a resend, and
+  notices when the PD never answered a fragment.  polling is off during a
+  transfer so nothing else would.
+*/
 
 int
-  zoo_filetransfer_initate
-    (OSDP_CONTEXT *context)
+  oo_filetransfer_background
+    (OSDP_CONTEXT *ctx)
 
-{ /* oo_filetransfer_initiate */
+{ /* oo_filetransfer_background */
 
-  int current_length;
-  struct stat datafile_status;
-  OSDP_HDR_FILETRANSFER *file_transfer;
-  int size_to_read;
+  int active;
   int status;
-  int status_io;
-  int transfer_send_size;
-  static unsigned char xfer_buffer [OSDP_BUF_MAX];
-
-
-// context is set up, initiate file transfer.
-// requires figuring out max SDU.
-
-          stat(context->xferctx.filename, &datafile_status);
-          fprintf(context->log,
-            "  FIle transfer: data file %s size %d.\n",
-            context->xferctx.filename, (int)datafile_status.st_size);
-          context->xferctx.total_length = datafile_status.st_size;
-          context->xferctx.current_offset = 0; // should be set already but just in case.
-
-          memset (xfer_buffer, 0, sizeof(xfer_buffer));
-          file_transfer = (OSDP_HDR_FILETRANSFER *)xfer_buffer;
-
-          // load data from file starting at msg->FtData
-
-          if (context->pd_cap.rec_max > 0)
-          {
-            if (context->max_message EQUALS 0)
-            {
-              context->max_message = context->pd_cap.rec_max;
-            };
-          };
-          if (context->max_message EQUALS 0)
-          {
-            context->max_message = 128;
-            fprintf(stderr, "max message unset, setting it to 128\n");
-            context->xferctx.current_send_length = context->max_message;
-          };
-          size_to_read = context->max_message;
-
-          // wimp out and restrict transfer, got my math wrong somewhere...
-          if (size_to_read > 1000)
-          {
-            fprintf(context->log, "Limiting filetransfer read size to %d (was %d)\n", 1000, size_to_read);
-            size_to_read = 1000;
-          };
-
-          // adjust for header, crc, secure channel
-
-          size_to_read = size_to_read - 6 - 2;
-
-// if it's checksum use -1 not -2.
-
-          if (context->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
-            size_to_read = size_to_read - 2 - 4; //scs header, mac
-
-          size_to_read = size_to_read + 1 - sizeof(OSDP_HDR_FILETRANSFER);
-          if (context->verbosity > 3)
-            fprintf(context->log, "Reading %d. from file to start.\n", size_to_read);
-          memset(&(file_transfer->FtData), 0, size_to_read);
-          status_io = fread (&(file_transfer->FtData), sizeof (unsigned char), size_to_read, context->xferctx.xferf);
-
-          // if what's left is less than allowed size, adjust
-
-          if (status_io < size_to_read)
-            size_to_read = status_io;
-
-          file_transfer->FtType = context->xferctx.file_transfer_type;
-          context->xferctx.total_sent = size_to_read;
-          osdp_doubleByte_to_array(size_to_read, file_transfer->FtFragmentSize);
-          osdp_quadByte_to_array(context->xferctx.total_length, file_transfer->FtSizeTotal);
-          osdp_quadByte_to_array(context->xferctx.current_offset, file_transfer->FtOffset); 
-
-          if (context->verbosity > 3)
-            fprintf (stderr, "Initiating File Transfer\n");
-
-          context->xferctx.state = OSDP_XFER_STATE_TRANSFERRING;
-          current_length = 0;
-          transfer_send_size = size_to_read;
-          transfer_send_size = transfer_send_size - 1 + sizeof (*file_transfer);
-fprintf(stderr, "xfer size %d.\n", transfer_send_size);
-          status = send_message_ex(context, OSDP_FILETRANSFER, p_card.addr, &current_length,
-            transfer_send_size, (unsigned char *)file_transfer,
-          OSDP_SEC_SCS_17, 0, NULL);
+  int waiting;
 
-          // after the send update the current offset
-          context->xferctx.current_offset = context->xferctx.current_offset + size_to_read;
 
-  return(status);
+  status = ST_OK;
+  active = (ctx->role EQUALS OSDP_ROLE_ACU) && (ctx->xferctx.total_length > 0) &&
+    (ctx->xferctx.state EQUALS OSDP_XFER_STATE_TRANSFERRING);
+
+  // hold off while something is outstanding.  if it never gets an answer
+  // and it was a fragment, resend it.
+
+  waiting = !(ctx->last_was_processed) && (ctx->timeout_retries > 0);
+  if (active && waiting)
+  {
+    ctx->timeout_retries --;
+    if (ctx->timeout_retries EQUALS 0)
+    {
+      waiting = 0;
+      ctx->response_timeouts ++;
+
+      // whatever partial frame is sitting in the input buffer is not
+      // going to be completed.  drop it so the next response parses.
+
+      if (osdp_buf.next > 0)
+      {
+        ctx->dropped_octets = ctx->dropped_octets + osdp_buf.next;
+        osdp_buf.next = 0;
+      };
+      if ((ctx->last_command_sent EQUALS OSDP_FILETRANSFER) && !(ctx->xferctx.adapt_pending))
+      {
+        if (ctx->crc_errs != ctx->xferctx.adapt_crc_errs)
+          oo_filetransfer_adapt (ctx, OO_FT_ADAPT_CRC);
+        else
+          oo_filetransfer_adapt (ctx, OO_FT_ADAPT_TIMEOUT);
+      };
+    };
+  };
+  if (active && (ctx->xferctx.adapt_failures > OO_FT_RETRY_MAX))
+  {
+    fprintf(ctx->log, "  File transfer: abandoned at offset %u. after %d. resends\n",
+      ctx->xferctx.acked_offset, OO_FT_RETRY_MAX);
+    osdp_wrapup_filetransfer (ctx);
+    ctx->xferctx.state = OSDP_XFER_STATE_IDLE;
+    active = 0;
+  };
+  if (active && !waiting)
+    oo_filetransfer_unacked (ctx);
+  if (active && !waiting && ctx->xferctx.adapt_pending)
+    status = oo_filetransfer_send_next (ctx);
+
+  // the response timer stops when it fires.  keep it going so this gets
+  // called again for the next retry or the end of FtDelay.
+
+  if (active && (waiting || ctx->xferctx.adapt_pending))
+    (void) osdp_timer_start (ctx, OSDP_TIMER_RESPONSE);
+  return (status);
+
+} /* oo_filetransfer_background */
 
-} /* oo_filetransfer_initiate */
+
+/*
+  oo_filetransfer_send_next - send the next fragment unless FtDelay says wait
+
+  if the PD asked for a delay the fragment is left pending and
+  oo_filetransfer_background sends it once the delay is over.
+*/
+
+int
+  oo_filetransfer_send_next
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_filetransfer_send_next */
+
+  int status;
+
+
+  status = ST_OK;
+
+  // in a fleet transfer oo_fleet_step decides which PD goes next
+
+  if (oo_filetransfer_paced (ctx) || oo_fleet_active ())
+  {
+    ctx->xferctx.adapt_pending = 1;
+  }
+  else
+  {
+    ctx->xferctx.adapt_pending = 0;
+    status = osdp_send_filetransfer (ctx);
+  };
+  return (status);
+
+} /* oo_filetransfer_send_next */
+
+
+/*
+  oo_filetransfer_unacked - resend a fragment that got some other answer
+
+  a fragment is acknowledged with osdp_FTSTAT or refused with osdp_NAK.
+  if the PD answered something else (after restarting its sequence
+  numbers it may send osdp_LSTATR) the fragment is treated as lost, or
+  nothing would ever send the next one.
+*/
+
+void
+  oo_filetransfer_unacked
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_filetransfer_unacked */
+
+  if ((ctx->role EQUALS OSDP_ROLE_ACU) && (ctx->xferctx.total_length > 0) &&
+    (ctx->xferctx.state EQUALS OSDP_XFER_STATE_TRANSFERRING) &&
+    (ctx->last_was_processed) && !(ctx->xferctx.adapt_pending) &&
+    (ctx->last_command_sent EQUALS OSDP_FILETRANSFER) &&
+    (ctx->xferctx.current_offset > ctx->xferctx.acked_offset))
+    oo_filetransfer_adapt (ctx, OO_FT_ADAPT_OTHER);
+
+} /* oo_filetransfer_unacked */
+
+
+/*
+  oo_filetransfer_paced - 1 if the PD's FtDelay has not run out yet
+*/
+
+int
+  oo_filetransfer_paced
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_filetransfer_paced */
+
+  struct timespec now;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec < ctx->xferctx.pace_until.tv_sec) ||
+    ((now.tv_sec EQUALS ctx->xferctx.pace_until.tv_sec) && (now.tv_nsec < ctx->xferctx.pace_until.tv_nsec)));
+
+} /* oo_filetransfer_paced */
+
+
+/*
+  oo_filetransfer_checkpoint - record (or clear) ACU transfer progress
+
+  the checkpoint names the file, its size and SHA-256 and the last offset
+  the PD acknowledged.  one file per PD address.  complete=1 removes it.
+*/
+
+int
+  oo_filetransfer_checkpoint
+    (OSDP_CONTEXT *ctx,
+    int complete)
+
+{ /* oo_filetransfer_checkpoint */
+
+  char checkpoint_file [1024];
+  char hash_hex [2*OO_SHA256_OCTETS+1];
+  FILE *cf;
+  char temp_file [1024+8];
+  int status;
+
+
+  status = ST_OK;
+  sprintf (checkpoint_file, OO_FT_CHECKPOINT_FILE, p_card.addr);
+  if (complete || (ctx->xferctx.acked_offset EQUALS 0))
+  {
+    (void) unlink (checkpoint_file);
+  }
+  else
+  {
+    // write it aside and rename so an interruption here leaves the old one
+
+    sprintf (temp_file, "%s.new", checkpoint_file);
+    oo_sha256_hex (ctx->xferctx.source_hash, hash_hex);
+    cf = fopen (temp_file, "w");
+    if (cf EQUALS NULL)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+    if (status EQUALS ST_OK)
+    {
+      fprintf (cf, "{\n  \"#\" : \"file transfer checkpoint\",\n");
+      fprintf (cf, "  \"pd-address\" : \"%02X\",\n", p_card.addr);
+      fprintf (cf, "  \"file\" : \"%s\",\n", ctx->xferctx.filename);
+      fprintf (cf, "  \"size\" : \"%u\",\n", ctx->xferctx.total_length);
+      fprintf (cf, "  \"sha256\" : \"%s\",\n", hash_hex);
+      fprintf (cf, "  \"offset\" : \"%u\",\n", ctx->xferctx.acked_offset);
+      fprintf (cf, "  \"_#\" : \"-\"\n}\n");
+      fclose (cf);
+      if (rename (temp_file, checkpoint_file) != 0)
+        status = ST_OSDP_BAD_TRANSFER_SAVE;
+    };
+    if (status EQUALS ST_OK)
+    {
+      ctx->xferctx.checkpoint_offset = ctx->xferctx.acked_offset;
+      if (ctx->verbosity > 3)
+        fprintf (ctx->log, "  File transfer: checkpoint at %u.\n", ctx->xferctx.acked_offset);
+    };
+  };
+  return (status);
+
+} /* oo_filetransfer_checkpoint */
+
+
+/*
+  oo_filetransfer_resume - pick up where an interrupted transfer stopped
+
+  if this PD's checkpoint is for the same file (size and SHA-256) the
+  transfer starts at the offset it records.  otherwise it starts at 0.
+*/
+
+int
+  oo_filetransfer_resume
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_filetransfer_resume */
+
+  char checkpoint_file [1024];
+  char hash_hex [2*OO_SHA256_OCTETS+1];
+  unsigned int offset;
+  json_t *root;
+  unsigned int size;
+  int status;
+  json_error_t status_json;
+  json_t *value;
+
+
+  status = ST_OSDP_FILEXFER_SKIP;
+  offset = 0;
+  size = 0;
+  sprintf (checkpoint_file, OO_FT_CHECKPOINT_FILE, p_card.addr);
+  root = json_load_file (checkpoint_file, 0, &status_json);
+  if (root != NULL)
+  {
+    oo_sha256_hex (ctx->xferctx.source_hash, hash_hex);
+    value = json_object_get (root, "sha256");
+    if (json_is_string (value))
+      if (0 EQUALS strcmp (hash_hex, json_string_value (value)))
+        status = ST_OK;
+    value = json_object_get (root, "size");
+    if (json_is_string (value))
+      sscanf (json_string_value (value), "%u", &size);
+    value = json_object_get (root, "offset");
+    if (json_is_string (value))
+      sscanf (json_string_value (value), "%u", &offset);
+    json_decref (root);
+  };
+  if (status EQUALS ST_OK)
+    if ((size != ctx->xferctx.total_length) || (offset >= ctx->xferctx.total_length))
+      status = ST_OSDP_FILEXFER_SKIP;
+  if (status EQUALS ST_OK)
+  {
+    fprintf (ctx->log, "  File transfer: resuming %s at offset %u. of %u.\n",
+      ctx->xferctx.filename, offset, size);
+    ctx->xferctx.current_offset = offset;
+    ctx->xferctx.total_sent = offset;
+    ctx->xferctx.checkpoint_offset = offset;
+  };
+  return (status);
+
+} /* oo_filetransfer_resume */
+
+
+/*
+  oo_filetransfer_partial_save - PD notes the transfer ./incoming_data holds
+*/
+
+int
+  oo_filetransfer_partial_save
+    (OSDP_CONTEXT *ctx,
+    int file_type)
+
+{ /* oo_filetransfer_partial_save */
+
+  FILE *pf;
+  int status;
+
+
+  status = ST_OK;
+  pf = fopen (OO_FT_PARTIAL_FILE, "w");
+  if (pf EQUALS NULL)
+    status = ST_OSDP_BAD_TRANSFER_SAVE;
+  if (status EQUALS ST_OK)
+  {
+    fprintf (pf, "{\n  \"#\" : \"partially received file transfer\",\n");
+    fprintf (pf, "  \"size\" : \"%u\",\n", ctx->xferctx.total_length);
+    fprintf (pf, "  \"type\" : \"%02X\",\n", file_type);
+    fprintf (pf, "  \"_#\" : \"-\"\n}\n");
+    fclose (pf);
+  };
+  return (status);
+
+} /* oo_filetransfer_partial_save */
+
+
+/*
+  oo_filetransfer_resume_pd - PD accepts a transfer starting at a non-zero offset
+
+  allowed if ./incoming_data is the partial file of a transfer of the same
+  size and type and holds at least offset octets.  anything past offset is
+  dropped and the transfer carries on from there.
+*/
+
+int
+  oo_filetransfer_resume_pd
+    (OSDP_CONTEXT *ctx,
+    unsigned int total_length,
+    unsigned int offset,
+    int file_type)
+
+{ /* oo_filetransfer_resume_pd */
+
+  struct stat partial_status;
+  unsigned int partial_size;
+  int partial_type;
+  json_t *root;
+  int status;
+  json_error_t status_json;
+  json_t *value;
+
+
+  status = ST_OSDP_FILEXFER_SKIP;
+  partial_size = 0;
+  partial_type = -1;
+  root = json_load_file (OO_FT_PARTIAL_FILE, 0, &status_json);
+  if (root != NULL)
+  {
+    value = json_object_get (root, "size");
+    if (json_is_string (value))
+      sscanf (json_string_value (value), "%u", &partial_size);
+    value = json_object_get (root, "type");
+    if (json_is_string (value))
+      sscanf (json_string_value (value), "%x", &partial_type);
+    json_decref (root);
+    if ((partial_size EQUALS total_length) && (partial_type EQUALS file_type))
+      status = ST_OK;
+  };
+  if (status EQUALS ST_OK)
+  {
+    status = ST_OSDP_FILEXFER_SKIP;
+    if (stat ("./incoming_data", &partial_status) EQUALS 0)
+      if (partial_status.st_size >= offset)
+        status = ST_OK;
+  };
+  if (status EQUALS ST_OK)
+  {
+    ctx->xferctx.total_length = total_length;
+    status = oo_receive_open (ctx, offset);
+    if (status != ST_OK)
+      ctx->xferctx.total_length = 0;
+  };
+  if (status EQUALS ST_OK)
+  {
+    ctx->xferctx.current_offset = offset;
+    fprintf (ctx->log, "  File transfer: resuming receive at offset %u. of %u.\n",
+      offset, total_length);
+  }
+  else
+  {
+    fprintf (ctx->log, "  File transfer: cannot resume at offset %u. (status %d)\n",
+      offset, status);
+  };
+  return (status);
+
+} /* oo_filetransfer_resume_pd */
 
 
 int oo_filetransfer_SDU_offer
@@ -361,6 +872,7 @@ int
 
 { /* osdp_filetransfer_validate */
 
+  int resend;
   unsigned int total_length_claimed;
   int status;
 
@@ -373,21 +885,32 @@ int
   osdp_array_to_quadByte(ftmsg->FtOffset, offset);
   osdp_array_to_doubleByte(ftmsg->FtFragmentSize, fragsize);
 
+  // a resend of data already received (the ACU missed our osdp_FTSTAT)
+  // is accepted.  the caller only stores what is past current_offset.
+
+  resend = (ctx->xferctx.total_length > 0) && (*offset < ctx->xferctx.current_offset);
+
+  // a transfer that starts part way in resumes into the partial file
+
+  if ((ctx->xferctx.total_length EQUALS 0) && (*offset > 0))
+    status = oo_filetransfer_resume_pd(ctx, total_length_claimed, *offset, ftmsg->FtType);
+
   // if there's a transfer in progress, a new one is bad.
 
-  if (ctx->xferctx.total_length && (*offset EQUALS 0))
+  if (ctx->xferctx.total_length && (*offset EQUALS 0) && !resend)
     status = ST_OSDP_FILEXFER_ALREADY;
 
   // message offset must match expected
 
-  if (ctx->xferctx.current_offset != *offset)
-    status = ST_OSDP_FILEXFER_SKIP;
+  if ((ctx->xferctx.current_offset != *offset) && !resend)
+    if (status EQUALS ST_OK)
+      status = ST_OSDP_FILEXFER_SKIP;
 
   if (status EQUALS ST_OK)
   {
     // the message with offset zero gets to declare the total size.
 
-    if (*offset EQUALS 0)
+    if ((*offset EQUALS 0) && !resend)
       ctx->xferctx.total_length = total_length_claimed;
   };
 
@@ -437,21 +960,12 @@ int
   {
   case OSDP_FTSTAT_OK:
 
-    // if it's ok and there's a delay then pause right here.
-
+    // the fragment arrived.  if there's a delay the next one waits for it
+    // (see oo_filetransfer_send_next) rather than stopping everything here.
 
-// DEBUG: fixme: MS_IN_NS blew up.  1000l*1000l maybe?
-
-#define MS_IN_NS (1000*1000)
-delay_nsec = filetransfer_delay;
-delay_nsec = delay_nsec * 1000;
-delay_nsec = delay_nsec * 1000;
-//    delay_nsec = filetransfer_delay * MS_IN_NS;
-    if (delay_nsec > 999999999)
-    {
-      delay_sec = delay_nsec/1000000000;
-      delay_nsec = delay_nsec - (delay_sec * 1000000000);
-    };
+    if (ctx->role EQUALS OSDP_ROLE_ACU)
+      oo_filetransfer_adapt (ctx, OO_FT_ADAPT_ACK);
+    clock_gettime (CLOCK_MONOTONIC, &(ctx->xferctx.pace_until));
     if (filetransfer_delay > 0)
     {
       // delay likely at front and certainly not at the end.
@@ -459,10 +973,11 @@ delay_nsec = delay_nsec * 1000;
 
       osdp_test_set_status(OOC_SYMBOL_ftstat_dly_init, OCONFORM_EXERCISED);
 
-      delay_time.tv_sec = delay_sec;
-      delay_time.tv_nsec = delay_nsec;
-      fprintf(ctx->log, "  Filetransfer: FTSTAT is `OK`, sleep delay %ld %ld\n", delay_time.tv_sec, delay_time.tv_nsec);
-      (void) nanosleep(&delay_time, NULL);
+      delay_nsec = ctx->xferctx.pace_until.tv_nsec + (filetransfer_delay % 1000) * 1000000;
+      ctx->xferctx.pace_until.tv_sec = ctx->xferctx.pace_until.tv_sec + (filetransfer_delay / 1000) +
+        (delay_nsec / 1000000000);
+      ctx->xferctx.pace_until.tv_nsec = delay_nsec % 1000000000;
+      fprintf(ctx->log, "  Filetransfer: FTSTAT is `OK`, delay %d ms\n", filetransfer_delay);
     };
 
     // if there's something there treat it like a transfer in progress
@@ -492,12 +1007,14 @@ delay_nsec = delay_nsec * 1000;
 
   case OSDP_FTSTAT_ABORT_TRANSFER:
     fprintf(ctx->log, "PD aborted transfer\n");
+    ctx->xferctx.checkpoint_discard = 1;
     // stop transfer if there is an error.
     status = ST_OSDP_FILEXFER_WRAPUP;
     break;
 
   case OSDP_FTSTAT_DATA_UNACCEPTABLE:
     fprintf(ctx->log, "PD reports 'data unacceptable'\n");
+    ctx->xferctx.checkpoint_discard = 1;
     // stop transfer if there is an error.
     status = ST_OSDP_FILEXFER_WRAPUP;
     break;
@@ -511,6 +1028,8 @@ delay_nsec = delay_nsec * 1000;
 
   case OSDP_FTSTAT_PROCESSED:
     fprintf(ctx->log, "FTSTAT Detail: %02x (\"processed\")\n", filetransfer_status);
+    if (ctx->role EQUALS OSDP_ROLE_ACU)
+      oo_filetransfer_adapt (ctx, OO_FT_ADAPT_ACK);
     ctx->xferctx.state = OSDP_XFER_STATE_TRANSFERRING;
 
     if (ctx->xferctx.total_sent EQUALS ctx->xferctx.total_length)
@@ -541,6 +1060,7 @@ delay_nsec = delay_nsec * 1000;
 
   case OSDP_FTSTAT_UNRECOGNIZED:
     fprintf(ctx->log, "PD did not recognize file\n");
+    ctx->xferctx.checkpoint_discard = 1;
     // stop transfer if there is an error.
     status = ST_OSDP_FILEXFER_WRAPUP;
     break;
@@ -565,6 +1085,11 @@ delay_nsec = delay_nsec * 1000;
     osdp_array_to_doubleByte(ftstat->FtUpdateMsgMax, &new_size);
     if (new_size != 0)
     {
+      // if the PD raised its limit and we're not backed off go straight to it
+
+      if ((new_size > oo_filetransfer_limit (ctx)) &&
+        (ctx->xferctx.adapt_message_max EQUALS oo_filetransfer_limit (ctx)))
+        ctx->xferctx.adapt_message_max = new_size;
       ctx->xferctx.current_send_length = new_size;
       if (ctx->verbosity > 3)
         fprintf(ctx->log,  "DEBUG: updated send to %d.\n", ctx->xferctx.current_send_length);
@@ -590,15 +1115,45 @@ void
 
   fflush(ctx->log);
   if (ctx->verbosity > 3)
-    fprintf(stderr, "DEBUG: osdp_wrapup_filetransfer xferf %lx\n", (unsigned long)(ctx->xferctx.xferf));
-  if (ctx->xferctx.xferf != NULL)
+    fprintf(stderr, "DEBUG: osdp_wrapup_filetransfer receiving %d\n", ctx->xferctx.receive_open);
+  if (ctx->xferctx.receive_open)
   {
-    fclose(ctx->xferctx.xferf);
+    oo_receive_close(ctx);
     fprintf(ctx->log, "closing transferred file\n");
-    ctx->xferctx.xferf = NULL;
+  };
+  if (ctx->xferctx.source != NULL)
+  {
+    // keep the checkpoint unless the whole file went or the PD refused it
+
+    (void) oo_filetransfer_checkpoint (ctx,
+      (ctx->xferctx.current_offset EQUALS ctx->xferctx.total_length) || ctx->xferctx.checkpoint_discard);
+    if (!(ctx->xferctx.source_shared))
+      (void) munmap (ctx->xferctx.source, ctx->xferctx.source_length);
+    ctx->xferctx.source = NULL;
+    ctx->xferctx.source_length = 0;
   };
   fprintf(ctx->log, "  File transfer: finished, total length was %d.\n",
     ctx->xferctx.total_length);
+  if (ctx->xferctx.total_length > 0)
+    ctx->xferctx.delivered = (ctx->xferctx.current_offset EQUALS ctx->xferctx.total_length) &&
+      !(ctx->xferctx.checkpoint_discard);
+  if ((ctx->role EQUALS OSDP_ROLE_ACU) && (ctx->xferctx.started.tv_sec != 0))
+  {
+    struct timespec now;
+    unsigned long long elapsed_usec;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    elapsed_usec = oo_latency_elapsed (&(ctx->xferctx.started), &now);
+    if (elapsed_usec EQUALS 0)
+      elapsed_usec = 1;
+    fprintf(ctx->log,
+      "  File transfer: %u. octets sent in %llu.%03llu sec, goodput %llu. octets/sec, %u. resends, message size %d.\n",
+      ctx->xferctx.current_offset - ctx->xferctx.resumed_offset,
+      elapsed_usec / 1000000, (elapsed_usec / 1000) % 1000,
+      ((unsigned long long)(ctx->xferctx.current_offset - ctx->xferctx.resumed_offset) * 1000000) / elapsed_usec,
+      ctx->xferctx.retransmits, ctx->xferctx.adapt_message_max);
+    memset (&(ctx->xferctx.started), 0, sizeof (ctx->xferctx.started));
+  };
   ctx->xferctx.current_offset = 0;
   ctx->xferctx.total_length = 0;
 
@@ -657,7 +1212,7 @@ fprintf(ctx->log, "restoring key %s\n", new_key);
   };
 
   // also load saved credentials.
-  saved_parameters_root = json_load_file("osdp-saved-credentials.json", 0, &status_json);
+  saved_parameters_root = json_load_file(OSDP_SAVED_CREDENTIALS, 0, &status_json);
 
   value = json_object_get(saved_parameters_root, "bio-format");
   if (json_is_string (value))
@@ -670,7 +1225,7 @@ fprintf(ctx->log, "restoring key %s\n", new_key);
   value = json_object_get(saved_parameters_root, "bio-template");
   if (json_is_string (value))
   {
-    strcpy(ctx->saved_bio_template, json_string_value(value));
+    strcpy(saved_bio_template, json_string_value(value));
   };
 
   value = json_object_get(saved_parameters_root, "bio-type");
@@ -742,6 +1297,13 @@ int
 } /* oo_save_parameters */
 
 
+/*
+  osdp_send_filetransfer - send the next osdp_FILETRANSFER
+
+  the fragment comes from the mapped file; it is copied once, in behind
+  the header, and that is the payload handed to send_message_ex.
+*/
+
 int
   osdp_send_filetransfer
     (OSDP_CONTEXT *ctx)
@@ -750,11 +1312,10 @@ int
 
   int current_length;
   OSDP_HDR_FILETRANSFER *ft;
-  int size_to_read;
+  int size_to_send;
   int status;
-  int status_io;
   int transfer_send_size;
-  unsigned char xfer_buffer [OSDP_BUF_MAX];
+  static unsigned char xfer_buffer [OSDP_OFFICIAL_MSG_MAX];
 
 
   status = ST_OK;
@@ -765,7 +1326,6 @@ int
       ctx->xferctx.total_length);
   if (status EQUALS ST_OK)
   {
-    memset (xfer_buffer, 0, sizeof(xfer_buffer));
     ft = (OSDP_HDR_FILETRANSFER *)xfer_buffer;
 
     // if we're finishing up send a benign message
@@ -784,63 +1344,45 @@ int
     }
     else
     {
-      // load data from file starting at msg->FtData
+      size_to_send = oo_filetransfer_plan (ctx);
+      if (ctx->xferctx.current_offset + size_to_send > ctx->xferctx.total_length)
+        size_to_send = ctx->xferctx.total_length - ctx->xferctx.current_offset;
+      if ((ctx->xferctx.source EQUALS NULL) || (size_to_send <= 0))
+        status = ST_OSDP_FILEXFER_READ;
 
-      if (ctx->xferctx.current_send_length)
-      {
-        size_to_read = ctx->xferctx.current_send_length;
-        //fprintf(stderr, "DEBUG: size to read %d.\n", ctx->xferctx.current_send_length);
-      }
-      else
+      if (status EQUALS ST_OK)
       {
-        size_to_read = ctx->max_message;
-      };
-
-    // adjust for header, crc
-    size_to_read = size_to_read - 6 - 2;
-// if it's checksum use -1 not -2.
-
-    if (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
-      size_to_read = size_to_read - 2 - 4; //scs header, mac
-
-    size_to_read = size_to_read + 1 - sizeof(OSDP_HDR_FILETRANSFER);
-    status_io = fread (&(ft->FtData), sizeof (unsigned char), size_to_read,
-      ctx->xferctx.xferf);
-    if (status_io > 0)
-      size_to_read = status_io;
-    if (status_io <= 0)
-      status = ST_OSDP_FILEXFER_READ;
-
-    if (status EQUALS ST_OK)
-    {
+        memcpy (&(ft->FtData), ctx->xferctx.source + ctx->xferctx.current_offset, size_to_send);
 
-      // update what we've sent
+        // update what we've sent
 
-      ctx->xferctx.total_sent = ctx->xferctx.total_sent + size_to_read;
+        ctx->xferctx.total_sent = ctx->xferctx.total_sent + size_to_send;
 
-      // load data length into FtSizeTotal (little-endian)
-      osdp_quadByte_to_array(ctx->xferctx.total_length, ft->FtSizeTotal);
+        // load data length into FtSizeTotal (little-endian)
+        osdp_quadByte_to_array(ctx->xferctx.total_length, ft->FtSizeTotal);
 
-      ft->FtType = ctx->xferctx.file_transfer_type;
+        ft->FtType = ctx->xferctx.file_transfer_type;
 
-      osdp_doubleByte_to_array(size_to_read, ft->FtFragmentSize);
-      osdp_quadByte_to_array(ctx->xferctx.current_offset, ft->FtOffset);
+        osdp_doubleByte_to_array(size_to_send, ft->FtFragmentSize);
+        osdp_quadByte_to_array(ctx->xferctx.current_offset, ft->FtOffset);
 
-      transfer_send_size = size_to_read;
-      transfer_send_size = transfer_send_size - 1 + sizeof (*ft);
-      current_length = 0;
-      if (ctx->verbosity > 3)
-        fprintf(ctx->log, "osdp_FILETRANSFER: sending %d. bytes\n", transfer_send_size);
-      status = send_message_ex(ctx, OSDP_FILETRANSFER, p_card.addr, &current_length,
-        transfer_send_size, (unsigned char *)ft,
-        OSDP_SEC_SCS_17, 0, NULL);
+        transfer_send_size = size_to_send;
+        transfer_send_size = transfer_send_size - 1 + sizeof (*ft);
+        current_length = 0;
+        if (ctx->verbosity > 3)
+          fprintf(ctx->log, "osdp_FILETRANSFER: sending %d. bytes\n", transfer_send_size);
+        clock_gettime (CLOCK_MONOTONIC, &(ctx->xferctx.fragment_sent));
+        ctx->xferctx.adapt_crc_errs = ctx->crc_errs;
+        status = send_message_ex(ctx, OSDP_FILETRANSFER, p_card.addr, &current_length,
+          transfer_send_size, (unsigned char *)ft,
+          OSDP_SEC_SCS_17, 0, NULL);
 
-      // after the send update the current offset
-      ctx->xferctx.current_offset = ctx->xferctx.current_offset + size_to_read;
+        // after the send update the current offset
+        ctx->xferctx.current_offset = ctx->xferctx.current_offset + size_to_send;
 
-      // we're transferring.  set the state to show that
-      ctx->xferctx.state = OSDP_XFER_STATE_TRANSFERRING;
-    };
+        // we're transferring.  set the state to show that
+        ctx->xferctx.state = OSDP_XFER_STATE_TRANSFERRING;
+      };
     }; // end else real filetransfer
   };
   return (status);
@@ -865,7 +1407,7 @@ int
   char statfile [3072];
   int status;
   char tag [1024];
-  char val [1024];
+  char val [2*1024+1]; // hex of last_raw_read_data
 
 
   status = ST_OK;
@@ -890,6 +1432,7 @@ int
     fprintf(sf, "{");
     fprintf(sf, "\"mmt\" : \"%d\",", osdp_conformance.conforming_messages);
     fprintf(sf, "\"retries\" : \"%d\",", ctx->retries);
+    fprintf(sf, "\"response-timeouts\" : \"%d\",", ctx->response_timeouts);
     fprintf(sf, "\"role\" : \"%d\",", ctx->role);
     if (strlen (ctx->text) > 0)
       fprintf(sf,"\"text\" : \"%s\",", ctx->text);
@@ -965,7 +1508,7 @@ int
     fprintf(sf, "\"current_offset\" : \"%d\",\n", ctx->xferctx.current_offset);
     fprintf(sf, "\"current_send_length\" : \"%d\",\n", ctx->xferctx.current_send_length);
     fprintf(sf, "\"last_update_timeT\" : \"%ld\",\n", current_time);
-    for (i=0; i<(7+ctx->last_raw_read_bits)/8; i++)
+    for (i=0; (i<(7+ctx->last_raw_read_bits)/8) && (i<sizeof (ctx->last_raw_read_data)); i++)
     {
       sprintf (val+(2*i), "%02x", ctx->last_raw_read_data [i]);
     };
@@ -973,6 +1516,7 @@ int
     fprintf(sf, "\"serial_number\":\"%02X%02X%02X%02X\",\n",
       ctx->serial_number [0], ctx->serial_number [1], ctx->serial_number [2], ctx->serial_number [3]);
     fprintf(sf, "\"total_length\" : \"%d\",\n", ctx->xferctx.total_length);
+    fprintf(sf, "\"receive-sha256\" : \"%s\",\n", ctx->xferctx.receive_sha256);
 
     fprintf(sf,
 " \"acu-polls\" : \"%d\",", ctx->acu_polls);
@@ -988,6 +1532,13 @@ int
 " \"pd-naks\" : \"%d\",", ctx->sent_naks);
     fprintf (sf,
 "\"hash-ok\" : \"%d\", \"hash-bad\" : \"%d\",\n", ctx->hash_ok, ctx->hash_bad);
+    oo_latency_write_status (ctx, sf);
+    oo_mpart_write_status (ctx, sf);
+    oo_monitor_write_status (ctx, sf);
+    oo_fleet_write_status (ctx, sf);
+    oo_emulator_write_status (ctx, sf);
+    oo_events_write_status (ctx, sf);
+    oo_recorder_write_status (ctx, sf);
     fprintf(sf, "\"_#\" : \"_end\" ");
     fprintf(sf, "}\n");
 
@@ -0,0 +1,523 @@
+/*
+  oo-fleet - send one file to many PD's on the bus
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  the ACU talks to one PD at a time: the address, sequence numbers, the
+  "awaiting a response" state and the file transfer context all live in
+  the OSDP_CONTEXT.  a fleet transfer keeps a copy of those per PD and
+  swaps them in whenever the bus is free, so the regular file transfer
+  code (fragment sizing, resends, FtDelay, checkpoints) runs unchanged for
+  each PD.  the file is mapped once and every PD is sent fragments from
+  that one mapping.
+
+  each time the previous command was answered (or timed out) the next PD
+  in turn gets its next fragment.  PD's that are not being sent anything
+  right now (poll-only, finished, or waiting out an FtDelay) are polled
+  every OO_FLEET_POLL_MSEC so they stay online.
+
+  cleartext only; secure channel state is not kept per PD.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+
+#include <open-osdp.h>
+
+
+#define OO_FLEET_POLL_MSEC (200)
+
+extern OSDP_BUFFER osdp_buf;
+extern OSDP_PARAMETERS p_card;
+static OO_FLEET oo_fleet;
+
+
+static void
+  oo_fleet_load
+    (OSDP_CONTEXT *ctx,
+    OO_FLEET_PD *pd)
+
+{ /* oo_fleet_load */
+
+  p_card.addr = pd->address;
+  ctx->pd_address = pd->address;
+  ctx->last_command_sent = pd->last_command_sent;
+  ctx->last_nak_error = pd->last_nak_error;
+  ctx->last_response_received = pd->last_response_received;
+  ctx->last_sequence_received = pd->last_sequence_received;
+  ctx->last_was_processed = pd->last_was_processed;
+  ctx->max_message = pd->max_message;
+  ctx->next_sequence = pd->next_sequence;
+  ctx->timeout_retries = pd->timeout_retries;
+  memcpy (&(ctx->xferctx), &(pd->xferctx), sizeof (ctx->xferctx));
+
+} /* oo_fleet_load */
+
+
+static void
+  oo_fleet_save
+    (OSDP_CONTEXT *ctx,
+    OO_FLEET_PD *pd)
+
+{ /* oo_fleet_save */
+
+  pd->last_command_sent = ctx->last_command_sent;
+  pd->last_nak_error = ctx->last_nak_error;
+  pd->last_response_received = ctx->last_response_received;
+  pd->last_sequence_received = ctx->last_sequence_received;
+  pd->last_was_processed = ctx->last_was_processed;
+  pd->max_message = ctx->max_message;
+  pd->next_sequence = ctx->next_sequence;
+  pd->timeout_retries = ctx->timeout_retries;
+  memcpy (&(pd->xferctx), &(ctx->xferctx), sizeof (pd->xferctx));
+
+} /* oo_fleet_save */
+
+
+/*
+  oo_fleet_finish - put the context back the way it was before the fleet
+*/
+
+static void
+  oo_fleet_finish
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_fleet_finish */
+
+  int delivered;
+  unsigned long long elapsed_usec;
+  int failed;
+  int i;
+  struct timespec now;
+
+
+  delivered = 0;
+  failed = 0;
+  for (i=0; i<oo_fleet.count; i++)
+  {
+    if (oo_fleet.pd [i].state EQUALS OO_FLEET_DONE)
+      delivered ++;
+    if (oo_fleet.pd [i].state EQUALS OO_FLEET_FAILED)
+      failed ++;
+
+    // the ACU's own PD carries on from where the fleet left its sequence
+
+    if (oo_fleet.pd [i].address EQUALS oo_fleet.home.address)
+    {
+      memcpy (&(oo_fleet.home), &(oo_fleet.pd [i]), sizeof (oo_fleet.home));
+      memset (&(oo_fleet.home.xferctx), 0, sizeof (oo_fleet.home.xferctx));
+    };
+  };
+  if (oo_fleet.source != NULL)
+    (void) munmap (oo_fleet.source, oo_fleet.source_length);
+  oo_fleet.source = NULL;
+  oo_fleet_load (ctx, &(oo_fleet.home));
+  oo_fleet.active = 0;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  elapsed_usec = oo_latency_elapsed (&(oo_fleet.started), &now);
+  fprintf (ctx->log,
+    "Fleet transfer: finished, %d. PD's done, %d. failed, %llu.%03llu sec.\n",
+    delivered, failed, elapsed_usec / 1000000, (elapsed_usec / 1000) % 1000);
+
+} /* oo_fleet_finish */
+
+
+/*
+  oo_fleet_progress - note where a PD's transfer got to
+
+  logs each 10% step and marks the PD done or failed once its transfer
+  has been wrapped up.
+*/
+
+static void
+  oo_fleet_progress
+    (OSDP_CONTEXT *ctx,
+    OO_FLEET_PD *pd)
+
+{ /* oo_fleet_progress */
+
+  int percent;
+
+
+  if (pd->state EQUALS OO_FLEET_ACTIVE)
+  {
+    if (pd->xferctx.total_length EQUALS 0)
+    {
+      pd->state = OO_FLEET_FAILED;
+      if (pd->xferctx.delivered)
+        pd->state = OO_FLEET_DONE;
+      fprintf (ctx->log, "Fleet transfer: PD %02X %s at %u. of %u. octets, %u. resends\n",
+        pd->address, (pd->state EQUALS OO_FLEET_DONE) ? "done" : "failed",
+        pd->xferctx.acked_offset, (unsigned int)oo_fleet.source_length, pd->xferctx.retransmits);
+    }
+    else
+    {
+      percent = (int)(((unsigned long long)(pd->xferctx.acked_offset) * 100) / pd->xferctx.total_length);
+      if (percent >= pd->last_percent + 10)
+      {
+        pd->last_percent = percent - (percent % 10);
+        fprintf (ctx->log, "Fleet transfer: PD %02X %d%% (%u. of %u. octets) message size %d.\n",
+          pd->address, percent, pd->xferctx.acked_offset, pd->xferctx.total_length,
+          pd->xferctx.adapt_message_max);
+      };
+    };
+  };
+
+} /* oo_fleet_progress */
+
+
+int
+  oo_fleet_active
+    (void)
+
+{ /* oo_fleet_active */
+
+  return (oo_fleet.active);
+
+} /* oo_fleet_active */
+
+
+/*
+  oo_fleet_background - response timeouts for the PD being served
+
+  fragments time out in oo_filetransfer_background; this covers the polls
+  (and FINISHING idle messages) the fleet sends, since background's own
+  polling is off during a fleet transfer.
+*/
+
+int
+  oo_fleet_background
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_fleet_background */
+
+  int transferring;
+  int waiting;
+
+
+  if (oo_fleet.active)
+  {
+    transferring = (ctx->xferctx.total_length > 0) &&
+      (ctx->xferctx.state EQUALS OSDP_XFER_STATE_TRANSFERRING);
+    waiting = !(ctx->last_was_processed) && (ctx->timeout_retries > 0);
+    if (waiting && !transferring)
+    {
+      ctx->timeout_retries --;
+      if (ctx->timeout_retries EQUALS 0)
+      {
+        ctx->response_timeouts ++;
+        waiting = 0;
+        if (ctx->verbosity > 3)
+          fprintf (ctx->log, "Fleet transfer: PD %02X did not answer\n", p_card.addr);
+      };
+    };
+
+    // the response timer stops when it fires, keep it going until this is sorted out
+
+    if (waiting)
+      (void) osdp_timer_start (ctx, OSDP_TIMER_RESPONSE);
+  };
+  return (ST_OK);
+
+} /* oo_fleet_background */
+
+
+/*
+  oo_fleet_initiate - start sending a file to a list of PD's
+
+  PD's listed with transfer set to 0 are polled but not sent the file.
+  if the ACU's own PD is in the list it picks up its link state from the
+  context and gives it back at the end.
+*/
+
+int
+  oo_fleet_initiate
+    (OSDP_CONTEXT *ctx,
+    OO_FLEET_ARGS *args)
+
+{ /* oo_fleet_initiate */
+
+  int i;
+  OSDP_CONTEXT_FILETRANSFER mapped;
+  OO_FLEET_PD *pd;
+  char *refused;
+  int status;
+  int transfers;
+
+
+  status = ST_OK;
+  refused = NULL;
+  transfers = 0;
+  for (i=0; i<args->count; i++)
+    if (args->transfer [i])
+      transfers ++;
+  if (transfers EQUALS 0)
+    refused = "no PD's to send to";
+  if (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
+    refused = "secure channel is active";
+  if (oo_fleet.active || (ctx->xferctx.total_length > 0))
+    refused = "a transfer is already under way";
+  if (ctx->role != OSDP_ROLE_ACU)
+    refused = "not an ACU";
+  if (refused != NULL)
+    fprintf (ctx->log, "Fleet transfer: refused, %s.\n", refused);
+
+  if (refused EQUALS NULL)
+  {
+    memset (&oo_fleet, 0, sizeof (oo_fleet));
+    oo_fleet.home.address = p_card.addr;
+    oo_fleet_save (ctx, &(oo_fleet.home));
+    status = oo_filetransfer_map (ctx, args->filename);
+    if (status EQUALS ST_OK)
+    {
+      oo_fleet.source = ctx->xferctx.source;
+      oo_fleet.source_length = ctx->xferctx.source_length;
+      memcpy (&mapped, &(ctx->xferctx), sizeof (mapped));
+      mapped.source_shared = 1;
+    };
+  };
+  if ((refused EQUALS NULL) && (status EQUALS ST_OK))
+  {
+    oo_fleet.count = args->count;
+    for (i=0; i<oo_fleet.count; i++)
+    {
+      pd = &(oo_fleet.pd [i]);
+      if (args->address [i] EQUALS oo_fleet.home.address)
+        memcpy (pd, &(oo_fleet.home), sizeof (*pd));
+      else
+      {
+        pd->last_sequence_received = -1;
+        pd->last_was_processed = 1;
+        pd->max_message = oo_fleet.home.max_message;
+      };
+      pd->address = args->address [i];
+      pd->state = OO_FLEET_IDLE;
+      memset (&(pd->xferctx), 0, sizeof (pd->xferctx));
+      if (args->transfer [i])
+      {
+        memcpy (&(pd->xferctx), &mapped, sizeof (pd->xferctx));
+        oo_fleet_load (ctx, pd);
+        if (status EQUALS ST_OK)
+          status = oo_filetransfer_start (ctx, args->file_type);
+        ctx->xferctx.adapt_pending = 1;
+        oo_fleet_save (ctx, pd);
+        pd->state = OO_FLEET_ACTIVE;
+      };
+    };
+    oo_fleet.current = 0;
+    oo_fleet_load (ctx, &(oo_fleet.pd [0]));
+    clock_gettime (CLOCK_MONOTONIC, &(oo_fleet.started));
+    oo_fleet.active = 1;
+    fprintf (ctx->log, "Fleet transfer: %s (%u. octets) to %d. PD's, %d. more polled\n",
+      mapped.filename, (unsigned int)oo_fleet.source_length, transfers, oo_fleet.count - transfers);
+  };
+  return (status);
+
+} /* oo_fleet_initiate */
+
+
+/*
+  oo_fleet_step - if the bus is free, send the next PD its next message
+
+  called from the ACU main loop.  the PD that was being served is saved,
+  then the PD's after it are offered the bus in turn: a pending fragment
+  goes first, otherwise a poll if it has not heard from the ACU for
+  OO_FLEET_POLL_MSEC.
+*/
+
+int
+  oo_fleet_step
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_fleet_step */
+
+  int active;
+  int busy;
+  int current_length;
+  int i;
+  int next;
+  struct timespec now;
+  OO_FLEET_PD *pd;
+  int send_fragment;
+  int status;
+
+
+  status = ST_OK;
+  busy = 0;
+  if (oo_fleet.active)
+  {
+    // osdp_awaiting_response is no help here, it does not wait for a PD
+    // that has never answered.
+
+    if (!(ctx->last_was_processed))
+    {
+      // still waiting for an answer
+
+      if (ctx->timeout_retries > 0)
+        busy = 1;
+      else
+      {
+        // it timed out.  what's in the buffer is not going to be completed.
+
+        if (osdp_buf.next > 0)
+        {
+          ctx->dropped_octets = ctx->dropped_octets + osdp_buf.next;
+          osdp_buf.next = 0;
+        };
+      };
+    };
+  };
+  if (oo_fleet.active && !busy)
+  {
+    oo_filetransfer_unacked (ctx);
+    pd = &(oo_fleet.pd [oo_fleet.current]);
+    oo_fleet_save (ctx, pd);
+    oo_fleet_progress (ctx, pd);
+    active = 0;
+    for (i=0; i<oo_fleet.count; i++)
+      if (oo_fleet.pd [i].state EQUALS OO_FLEET_ACTIVE)
+        active ++;
+    if (active EQUALS 0)
+      oo_fleet_finish (ctx);
+  };
+  if (oo_fleet.active && !busy)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    next = -1;
+    send_fragment = 0;
+    for (i=1; (i<=oo_fleet.count) && (next EQUALS -1); i++)
+    {
+      pd = &(oo_fleet.pd [(oo_fleet.current + i) % oo_fleet.count]);
+      if ((pd->state EQUALS OO_FLEET_ACTIVE) &&
+        ((now.tv_sec > pd->xferctx.pace_until.tv_sec) ||
+        ((now.tv_sec EQUALS pd->xferctx.pace_until.tv_sec) && (now.tv_nsec >= pd->xferctx.pace_until.tv_nsec))))
+      {
+        if (pd->xferctx.adapt_pending)
+          send_fragment = 1;
+
+        // a PD that said FINISHING gets the idle osdp_FILETRANSFER instead of a poll
+
+        if ((pd->xferctx.state EQUALS OSDP_XFER_STATE_FINISHING) &&
+          (oo_latency_elapsed (&(pd->last_sent), &now) >= 1000 * OO_FLEET_POLL_MSEC))
+          send_fragment = 1;
+      };
+      if (send_fragment || (oo_latency_elapsed (&(pd->last_sent), &now) >= 1000 * OO_FLEET_POLL_MSEC))
+        next = (oo_fleet.current + i) % oo_fleet.count;
+    };
+    if (next >= 0)
+    {
+      oo_fleet.current = next;
+      pd = &(oo_fleet.pd [next]);
+      oo_fleet_load (ctx, pd);
+      pd->last_sent = now;
+      if (send_fragment)
+      {
+        ctx->xferctx.adapt_pending = 0;
+        status = osdp_send_filetransfer (ctx);
+      }
+      else
+      {
+        current_length = 0;
+        status = send_message_ex (ctx, OSDP_POLL, p_card.addr, &current_length,
+          0, NULL, OSDP_SEC_SCS_17, 0, NULL);
+      };
+    };
+  };
+  return (status);
+
+} /* oo_fleet_step */
+
+
+/*
+  oo_fleet_stop - wrap up every PD's transfer so each leaves a checkpoint
+*/
+
+void
+  oo_fleet_stop
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_fleet_stop */
+
+  int i;
+
+
+  if (oo_fleet.active)
+  {
+    oo_fleet_save (ctx, &(oo_fleet.pd [oo_fleet.current]));
+    for (i=0; i<oo_fleet.count; i++)
+    {
+      if ((oo_fleet.pd [i].state EQUALS OO_FLEET_ACTIVE) && (oo_fleet.pd [i].xferctx.total_length > 0))
+      {
+        oo_fleet_load (ctx, &(oo_fleet.pd [i]));
+        osdp_wrapup_filetransfer (ctx);
+        oo_fleet_save (ctx, &(oo_fleet.pd [i]));
+        oo_fleet_progress (ctx, &(oo_fleet.pd [i]));
+      };
+    };
+    oo_fleet_finish (ctx);
+  };
+
+} /* oo_fleet_stop */
+
+
+/*
+  oo_fleet_write_status - add the fleet transfer to the status file
+
+  emits a "fleet" member (followed by a comma) into the open JSON object,
+  if there has been a fleet transfer.
+*/
+
+void
+  oo_fleet_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_fleet_write_status */
+
+  int i;
+  OO_FLEET_PD *pd;
+  static char *state_name [] = { "poll", "active", "done", "failed" };
+  OSDP_CONTEXT_FILETRANSFER *xfer;
+
+
+  if (oo_fleet.count > 0)
+  {
+    fprintf (sf, "\"fleet\" : { \"active\" : \"%d\", \"size\" : \"%u\", \"pd\" : [",
+      oo_fleet.active, (unsigned int)oo_fleet.source_length);
+    for (i=0; i<oo_fleet.count; i++)
+    {
+      pd = &(oo_fleet.pd [i]);
+      xfer = &(pd->xferctx);
+      if (oo_fleet.active && (i EQUALS oo_fleet.current))
+        xfer = &(ctx->xferctx);
+      fprintf (sf,
+"%s\n  { \"address\" : \"%02X\", \"state\" : \"%s\", \"offset\" : \"%u\", \"resends\" : \"%u\", \"message-size\" : \"%d\" }",
+        (i EQUALS 0) ? "" : ",", pd->address, state_name [pd->state],
+        xfer->acked_offset, xfer->retransmits, xfer->adapt_message_max);
+    };
+    fprintf (sf, "\n] },\n");
+  };
+
+} /* oo_fleet_write_status */
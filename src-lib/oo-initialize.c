@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <time.h>
@@ -35,7 +36,6 @@
 #include <osdp_conformance.h>
 
 
-char multipart_message_buffer_1 [64*1024];
 extern OSDP_INTEROP_ASSESSMENT osdp_conformance;
 extern OSDP_PARAMETERS p_card;
 extern unsigned char *last_message_sent;
@@ -43,6 +43,144 @@ extern int last_message_sent_length;
 
 OSDP_COMMAND_QUEUE osdp_command_queue [OSDP_COMMAND_QUEUE_SIZE];
 
+#define OO_STARTUP_PHASES_MAX (32)
+typedef struct oo_startup_phase
+{
+  char *name;
+  struct timespec at;
+} OO_STARTUP_PHASE;
+static OO_STARTUP_PHASE oo_startup [OO_STARTUP_PHASES_MAX];
+static int oo_startup_count;
+
+
+/*
+  oo_clear_directory - remove the files in a directory (what "rm -f" of everything in it did)
+
+  dot files and subdirectories are left alone.
+*/
+
+static void
+  oo_clear_directory
+    (char *path)
+
+{ /* oo_clear_directory */
+
+  DIR *d;
+  struct dirent *entry;
+
+
+  d = opendir (path);
+  if (d != NULL)
+  {
+    while ((entry = readdir (d)) != NULL)
+    {
+      if (entry->d_name [0] EQUALS '.')
+        continue;
+      if (entry->d_type EQUALS DT_DIR)
+        continue;
+      (void) unlinkat (dirfd (d), entry->d_name, 0);
+    };
+    closedir (d);
+  };
+
+} /* oo_clear_directory */
+
+
+/*
+  oo_make_directory - create a directory and any missing parents (what "mkdir -p" did)
+*/
+
+static void
+  oo_make_directory
+    (char *path)
+
+{ /* oo_make_directory */
+
+  char partial [3072];
+  char *p;
+
+
+  strncpy (partial, path, sizeof (partial)-1);
+  partial [sizeof (partial)-1] = 0;
+
+  // the usual case is it's all there already
+
+  if (mkdir (partial, 0777) EQUALS 0)
+    return;
+  if (errno EQUALS EEXIST)
+    return;
+  for (p=partial+1; *p != 0; p++)
+  {
+    if (*p EQUALS '/')
+    {
+      *p = 0;
+      (void) mkdirat (AT_FDCWD, partial, 0777);
+      *p = '/';
+    };
+  };
+  (void) mkdirat (AT_FDCWD, partial, 0777);
+
+} /* oo_make_directory */
+
+
+/*
+  oo_startup_phase - note that a phase of startup is done (for --startup-profile)
+*/
+
+void
+  oo_startup_phase
+    (OSDP_CONTEXT *ctx,
+    char *name)
+
+{ /* oo_startup_phase */
+
+  if ((ctx->startup_profile) && (oo_startup_count < OO_STARTUP_PHASES_MAX))
+  {
+    oo_startup [oo_startup_count].name = name;
+    clock_gettime (CLOCK_MONOTONIC, &(oo_startup [oo_startup_count].at));
+    oo_startup_count ++;
+  };
+
+} /* oo_startup_phase */
+
+
+/*
+  oo_startup_report - last phase.  print how long each took and stop profiling.
+*/
+
+void
+  oo_startup_report
+    (OSDP_CONTEXT *ctx,
+    char *name)
+
+{ /* oo_startup_report */
+
+  struct timespec cpu;
+  int i;
+  double since_start;
+  double since_previous;
+
+
+  if (!(ctx->startup_profile))
+    return;
+  oo_startup_phase (ctx, name);
+  ctx->startup_profile = 0;
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &cpu);
+  fprintf (stderr, "Startup profile (msec)\n");
+  for (i=1; i<oo_startup_count; i++)
+  {
+    since_start = (oo_startup [i].at.tv_sec - oo_startup [0].at.tv_sec) * 1000.0 +
+      (oo_startup [i].at.tv_nsec - oo_startup [0].at.tv_nsec) / 1000000.0;
+    since_previous = (oo_startup [i].at.tv_sec - oo_startup [i-1].at.tv_sec) * 1000.0 +
+      (oo_startup [i].at.tv_nsec - oo_startup [i-1].at.tv_nsec) / 1000000.0;
+    fprintf (stderr, "  %-32s %9.3f %9.3f\n", oo_startup [i].name, since_previous, since_start);
+    if (ctx->log != NULL)
+      fprintf (ctx->log, "Startup: %-32s %9.3f %9.3f msec\n", oo_startup [i].name, since_previous, since_start);
+  };
+  fprintf (stderr, "  %-32s %9.3f (including exec)\n", "cpu", cpu.tv_sec * 1000.0 + cpu.tv_nsec / 1000000.0);
+
+} /* oo_startup_report */
+
 int
   init_serial
     (OSDP_CONTEXT *ctx,
@@ -64,6 +202,7 @@ int
       ctx->init_command, device);
     sprintf (command, ctx->init_command, device);
     system (command);
+    oo_startup_phase (ctx, "init-command");
   };
   if (ctx->fd != -1)
   {
@@ -222,6 +361,7 @@ int
     if (status_io EQUALS -1)
       status = ST_OSDP_EXCLUSIVITY_FAILED;
   };
+  oo_startup_phase (context, "log and lock");
 
   // initialize the trace file to empty
 
@@ -231,18 +371,22 @@ int
     if (tf)
       fclose(tf);
   };
+  oo_startup_phase (context, "trace file");
 
 
   if (status EQUALS ST_OK)
   {
     osdp_conformance.last_unknown_command = OSDP_POLL;
-    context->mmsgbuf = multipart_message_buffer_1;
     memset (&p_card, 0, sizeof (p_card));
 
     context->verbosity = 3;
+    (void) oo_log_levels (context);
 
     context->q = osdp_command_queue;
     context->enable_poll = OO_POLL_ENABLED;
+    context->metrics_fd = -1;
+    context->monitor_fd = -1;
+    context->recorder_frames = OO_RECORDER_FRAMES;
 
     context->current_key_slot = -1;
     memcpy(context->current_default_scbk, OSDP_SCBK_DEFAULT, sizeof(context->current_default_scbk));
@@ -321,6 +465,7 @@ int
     last_message_sent_length = 0;
 
   }; // status ok after lock 
+  oo_startup_phase (context, "defaults");
 
   if (status EQUALS ST_OK)
   {
@@ -333,15 +478,15 @@ int
       try to get configuration from configuration file open_osdp.cfg
     */
     status = read_config (context);
-    sprintf(command, "mkdir -p %s/results", context->service_root);
-    system(command);
-    sprintf(command, "mkdir -p %s/run", context->service_root);
-    system(command);
+    (void) oo_eventlog_open (context);
+    oo_startup_phase (context, "config");
+    sprintf(command, "%s/results", context->service_root);
+    oo_make_directory (command);
     if (!(context->keep_results))
-    {
-      sprintf(command, "rm -f %s/results/*", context->service_root);
-      system(command);
-    };
+      oo_clear_directory (command);
+    sprintf(command, "%s/run", context->service_root);
+    oo_make_directory (command);
+    oo_startup_phase (context, "directories");
     if (context->verbosity > 4)
     {
       m_dump = 1;
@@ -477,7 +622,11 @@ int
       };
     };
 
-    status = oo_load_parameters(context, OSDP_SAVED_PARAMETERS);
+    if (oo_snapshot_begin (context, OO_SNAPSHOT_SAVED, &status) != ST_OK)
+    {
+      status = oo_load_parameters(context, OSDP_SAVED_PARAMETERS);
+      oo_snapshot_end (context, OO_SNAPSHOT_SAVED, status);
+    };
     if (status != ST_OK)
     {
       fprintf(context->log, "Problem loading saved parameters (%d)\n", status);
@@ -488,6 +637,8 @@ int
       fprintf(context->log, "Saved parameters loaded.\n");
     };
   }; // NOT monitor mode
+  (void) oo_snapshot_save (context);
+  oo_startup_phase (context, "role, creds, saved parameters");
 
   // we are ready to party.  "last was processed"
   if (status EQUALS ST_OK)
@@ -495,6 +646,7 @@ int
 
   if (status EQUALS ST_OK)
     status = oo_write_status (context);
+  oo_startup_phase (context, "status file");
   if (status != ST_OK)
     fprintf(stderr, "OSDP initialization failed (%d.)\n", status);
   return (status);
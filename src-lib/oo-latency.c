@@ -0,0 +1,413 @@
+/*
+  oo-latency - per-command response latency histograms
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  the ACU notes when a command finished transmitting.  the first octet of
+  the answer and the complete (parsed) answer are each timed against that
+  and tallied in a log-bucketed histogram for the command.  buckets are
+  linear below OSDP_LATENCY_SUB_BUCKETS microseconds then
+  OSDP_LATENCY_SUB_BUCKETS buckets per power of two above that,
+  so resolution is about 12% at any scale.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+#include <open-osdp.h>
+
+
+OSDP_LATENCY_STATS osdp_latency [OSDP_LATENCY_COMMANDS_MAX];
+OSDP_LATENCY_PENDING osdp_latency_pending;
+
+
+/*
+  oo_latency_bucket - bucket index for a value in microseconds
+*/
+
+int
+  oo_latency_bucket
+    (unsigned long long usec)
+
+{ /* oo_latency_bucket */
+
+  int bucket;
+  int msb;
+  unsigned long long v;
+
+
+  if (usec < OSDP_LATENCY_SUB_BUCKETS)
+    return ((int)usec);
+
+  msb = 0;
+  v = usec;
+  while (v > 1)
+  {
+    v = v >> 1;
+    msb++;
+  };
+  bucket = ((msb - OSDP_LATENCY_SUB_BITS + 1) * OSDP_LATENCY_SUB_BUCKETS) +
+    (int)(usec >> (msb - OSDP_LATENCY_SUB_BITS)) - OSDP_LATENCY_SUB_BUCKETS;
+  if (bucket >= OSDP_LATENCY_BUCKETS)
+    bucket = OSDP_LATENCY_BUCKETS - 1;
+  return (bucket);
+
+} /* oo_latency_bucket */
+
+
+/*
+  oo_latency_bucket_floor - lowest value (microseconds) that lands in a bucket
+*/
+
+unsigned long long
+  oo_latency_bucket_floor
+    (int bucket)
+
+{ /* oo_latency_bucket_floor */
+
+  int msb;
+  int sub;
+
+
+  if (bucket < 2*OSDP_LATENCY_SUB_BUCKETS)
+    return ((unsigned long long)bucket);
+  msb = (bucket / OSDP_LATENCY_SUB_BUCKETS) + OSDP_LATENCY_SUB_BITS - 1;
+  sub = bucket % OSDP_LATENCY_SUB_BUCKETS;
+  return (((unsigned long long)(OSDP_LATENCY_SUB_BUCKETS + sub)) <<
+    (msb - OSDP_LATENCY_SUB_BITS));
+
+} /* oo_latency_bucket_floor */
+
+
+/*
+  oo_latency_lookup - find (or claim) the stats slot for a command code.
+
+  returns NULL if all the slots are in use.
+*/
+
+OSDP_LATENCY_STATS *
+  oo_latency_lookup
+    (int command)
+
+{ /* oo_latency_lookup */
+
+  int i;
+  OSDP_LATENCY_STATS *ls;
+
+
+  ls = NULL;
+  for (i=0; (i<OSDP_LATENCY_COMMANDS_MAX) && (ls EQUALS NULL); i++)
+  {
+    if (osdp_latency [i].in_use)
+    {
+      if (osdp_latency [i].command EQUALS command)
+        ls = &(osdp_latency [i]);
+    }
+    else
+    {
+      osdp_latency [i].in_use = 1;
+      osdp_latency [i].command = command;
+      ls = &(osdp_latency [i]);
+    };
+  };
+  return (ls);
+
+} /* oo_latency_lookup */
+
+
+/*
+  oo_latency_percentile - value (microseconds) at a given percentile
+
+  answers with the floor of the bucket the percentile lands in.
+*/
+
+unsigned long long
+  oo_latency_percentile
+    (OSDP_LATENCY_HISTOGRAM *h,
+    int percentile)
+
+{ /* oo_latency_percentile */
+
+  int i;
+  unsigned long long running;
+  unsigned long long target;
+
+
+  if (h->count EQUALS 0)
+    return (0);
+  target = ((unsigned long long)(h->count) * percentile + 99) / 100;
+  if (target < 1)
+    target = 1;
+  running = 0;
+  for (i=0; i<OSDP_LATENCY_BUCKETS; i++)
+  {
+    running = running + h->bucket [i];
+    if (running >= target)
+      return (oo_latency_bucket_floor (i));
+  };
+  return (h->max_usec);
+
+} /* oo_latency_percentile */
+
+
+/*
+  oo_latency_record - add one sample to a histogram
+*/
+
+void
+  oo_latency_record
+    (OSDP_LATENCY_HISTOGRAM *h,
+    unsigned long long usec)
+
+{ /* oo_latency_record */
+
+  if ((h->count EQUALS 0) || (usec < h->min_usec))
+    h->min_usec = usec;
+  if (usec > h->max_usec)
+    h->max_usec = usec;
+  h->count ++;
+  h->total_usec = h->total_usec + usec;
+  h->bucket [oo_latency_bucket (usec)] ++;
+
+} /* oo_latency_record */
+
+
+/*
+  oo_latency_elapsed - microseconds from start to end
+*/
+
+unsigned long long
+  oo_latency_elapsed
+    (struct timespec *start,
+    struct timespec *end)
+
+{ /* oo_latency_elapsed */
+
+  long long usec;
+
+
+  usec = ((long long)(end->tv_sec - start->tv_sec) * 1000000LL) +
+    ((end->tv_nsec - start->tv_nsec) / 1000);
+  if (usec < 0)
+    usec = 0;
+  return ((unsigned long long)usec);
+
+} /* oo_latency_elapsed */
+
+
+/*
+  oo_latency_transmit_complete - a command just went out on the wire
+
+  called by the send routines (ACU only) after the whole PDU was written.
+*/
+
+void
+  oo_latency_transmit_complete
+    (OSDP_CONTEXT *ctx,
+    int command)
+
+{ /* oo_latency_transmit_complete */
+
+  if (ctx->role EQUALS OSDP_ROLE_ACU)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &(osdp_latency_pending.transmit_done));
+    osdp_latency_pending.command = command;
+    osdp_latency_pending.state = OSDP_LATENCY_AWAITING_OCTET;
+  };
+
+} /* oo_latency_transmit_complete */
+
+
+/*
+  oo_latency_first_octet - the first octet (a SOM) of a response arrived
+*/
+
+void
+  oo_latency_first_octet
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_latency_first_octet */
+
+  if (osdp_latency_pending.state EQUALS OSDP_LATENCY_AWAITING_OCTET)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &(osdp_latency_pending.first_octet));
+    osdp_latency_pending.state = OSDP_LATENCY_AWAITING_FRAME;
+  };
+
+} /* oo_latency_first_octet */
+
+
+/*
+  oo_latency_response_complete - a whole response was received and parsed
+
+  tallies both intervals against the command that was outstanding.
+*/
+
+void
+  oo_latency_response_complete
+    (OSDP_CONTEXT *ctx,
+    int response)
+
+{ /* oo_latency_response_complete */
+
+  struct timespec frame_done;
+  OSDP_LATENCY_STATS *ls;
+
+
+  if (osdp_latency_pending.state EQUALS OSDP_LATENCY_AWAITING_FRAME)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &frame_done);
+    ls = oo_latency_lookup (osdp_latency_pending.command);
+    if (ls != NULL)
+    {
+      oo_latency_record (&(ls->first_octet),
+        oo_latency_elapsed (&(osdp_latency_pending.transmit_done), &(osdp_latency_pending.first_octet)));
+      oo_latency_record (&(ls->complete_frame),
+        oo_latency_elapsed (&(osdp_latency_pending.transmit_done), &frame_done));
+      if (ctx->verbosity > 9)
+        fprintf (ctx->log, "latency: cmd %02x resp %02x first-octet %llu frame %llu usec\n",
+          osdp_latency_pending.command, response,
+          oo_latency_elapsed (&(osdp_latency_pending.transmit_done), &(osdp_latency_pending.first_octet)),
+          oo_latency_elapsed (&(osdp_latency_pending.transmit_done), &frame_done));
+    };
+  };
+  osdp_latency_pending.state = OSDP_LATENCY_IDLE;
+
+} /* oo_latency_response_complete */
+
+
+/*
+  oo_latency_log_summary - dump the histograms to the log
+*/
+
+void
+  oo_latency_log_summary
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_latency_log_summary */
+
+  int b;
+  OSDP_LATENCY_HISTOGRAM *h;
+  int i;
+  int j;
+  char tlogmsg [1024];
+
+
+  for (i=0; i<OSDP_LATENCY_COMMANDS_MAX; i++)
+  {
+    if (osdp_latency [i].in_use)
+    {
+      for (j=0; j<2; j++)
+      {
+        h = &(osdp_latency [i].first_octet);
+        if (j EQUALS 1)
+          h = &(osdp_latency [i].complete_frame);
+        if (h->count > 0)
+        {
+          sprintf (tlogmsg,
+" Latency %-17s %-5s n %6u min %7llu p50 %7llu p90 %7llu p99 %7llu max %7llu usec\n",
+            osdp_command_reply_to_string (osdp_latency [i].command, 0),
+            (j EQUALS 0) ? "octet" : "frame",
+            h->count, h->min_usec,
+            oo_latency_percentile (h, 50), oo_latency_percentile (h, 90),
+            oo_latency_percentile (h, 99), h->max_usec);
+          (void) oosdp_log (ctx, OSDP_LOG_STRING | OSDP_LOG_NOTIMESTAMP, 1, tlogmsg);
+
+          // at higher verbosity dump the nonzero buckets too
+          if (ctx->verbosity > 3)
+          {
+            for (b=0; b<OSDP_LATENCY_BUCKETS; b++)
+              if (h->bucket [b] > 0)
+                fprintf (ctx->log, "   >=%llu usec: %u\n",
+                  oo_latency_bucket_floor (b), h->bucket [b]);
+          };
+        };
+      };
+    };
+  };
+
+} /* oo_latency_log_summary */
+
+
+/*
+  oo_latency_write_status - add the latency histograms to the status file
+
+  emits a "latency" member (followed by a comma) into the open JSON object.
+  buckets are listed sparsely as "floor-usec" : count.
+*/
+
+void
+  oo_latency_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_latency_write_status */
+
+  int b;
+  int first_bucket;
+  int first_cmd;
+  OSDP_LATENCY_HISTOGRAM *h;
+  int i;
+  int j;
+
+
+  fprintf (sf, "\"latency\" : {");
+  first_cmd = 1;
+  for (i=0; i<OSDP_LATENCY_COMMANDS_MAX; i++)
+  {
+    if (osdp_latency [i].in_use)
+    {
+      if (!first_cmd)
+        fprintf (sf, ",");
+      first_cmd = 0;
+      fprintf (sf, "\n  \"%02x\" : { \"command\" : \"%s\"",
+        osdp_latency [i].command,
+        osdp_command_reply_to_string (osdp_latency [i].command, 0));
+      for (j=0; j<2; j++)
+      {
+        h = &(osdp_latency [i].first_octet);
+        if (j EQUALS 1)
+          h = &(osdp_latency [i].complete_frame);
+        fprintf (sf,
+",\n    \"%s\" : { \"count\" : \"%u\", \"min\" : \"%llu\", \"max\" : \"%llu\", \"total\" : \"%llu\", \"p50\" : \"%llu\", \"p99\" : \"%llu\", \"buckets\" : {",
+          (j EQUALS 0) ? "first-octet" : "complete-frame",
+          h->count, h->min_usec, h->max_usec, h->total_usec,
+          oo_latency_percentile (h, 50), oo_latency_percentile (h, 99));
+        first_bucket = 1;
+        for (b=0; b<OSDP_LATENCY_BUCKETS; b++)
+        {
+          if (h->bucket [b] > 0)
+          {
+            fprintf (sf, "%s\"%llu\":\"%u\"", first_bucket ? "" : ",",
+              oo_latency_bucket_floor (b), h->bucket [b]);
+            first_bucket = 0;
+          };
+        };
+        fprintf (sf, "} }");
+      };
+      fprintf (sf, " }");
+    };
+  };
+  fprintf (sf, "},\n");
+
+} /* oo_latency_write_status */
@@ -138,7 +138,7 @@ int
   int scb_present;
   char *score_text;
   char *sec_block;
-  char tlogmsg [30000];
+  static char tlogmsg [30000]; // static, not a 30K frame under everything this calls
   char tmps [1024];
   char tmpstr [2*1024];
   char tmpstr2 [3*1024];
@@ -538,7 +538,7 @@ int
 
       dumpcount = 0;
       // unwind the headers so we have the osdp_MFGREP payload in hand...
-      memset(tlogmsg, 0, sizeof(tlogmsg));
+      tlogmsg [0] = 0;
       msg = (OSDP_MSG *) aux;
       oh = (OSDP_HDR *)(msg->ptr);
       count = oh->len_lsb + (oh->len_msb << 8);
@@ -848,8 +848,10 @@ int
 
 { /* oosdp_log */
 
-  time_t current_raw_time;
+  static struct tm cooked_time;
+  static time_t cooked_time_second;
   struct tm *current_cooked_time;
+  int from_capture;
   int llogtype;
   char *role_tag;
   int status;
@@ -857,6 +859,7 @@ int
 
 
   status = ST_OK;
+  from_capture = 0;
 
   // dump the trace buffer before creating the log message
 #ifdef PREV_TRACE
@@ -876,15 +879,40 @@ int
     role_tag = "PD";
     llogtype = OSDP_LOG_STRING;
   };
+
+  // with an event log the values go there and osdp-eventlog makes the text
+
+  if (context->event_log != NULL)
+  {
+    // the frame's tag is 1 for ACU, 2 for PD, 0 for none
+
+    if (llogtype EQUALS OSDP_LOG_STRING)
+      status = oo_eventlog (context, OO_EVLOG_FRAME, "bbbus",
+        (*role_tag EQUALS 'A') ? 1 : ((*role_tag EQUALS 'P') ? 2 : 0), level,
+        context->this_message_addr, context->packets_received, message);
+    else
+      status = oo_eventlog (context, OO_EVLOG_TEXT, "bs", level, message);
+    return (status);
+  };
   if (llogtype == OSDP_LOG_STRING)
   {
     char address_suffix [1024];
     struct timespec
       current_time_fine;
 
-    clock_gettime (CLOCK_REALTIME, &current_time_fine);
-    (void) time (&current_raw_time);
-    current_cooked_time = localtime (&current_raw_time);
+    // a monitored frame is stamped with when it came off the line, not when it got decoded
+
+    from_capture = oo_monitor_frame_time (&current_time_fine);
+    if (!from_capture)
+      clock_gettime (CLOCK_REALTIME, &current_time_fine);
+
+    // the broken-down time only changes once a second
+    if ((cooked_time_second EQUALS 0) || (current_time_fine.tv_sec != cooked_time_second))
+    {
+      cooked_time_second = current_time_fine.tv_sec;
+      (void) localtime_r (&cooked_time_second, &cooked_time);
+    };
+    current_cooked_time = &cooked_time;
 if (strcmp ("ACU", role_tag)==0)
   sprintf (address_suffix, " DestAddr=%02x(hex)", context->this_message_addr);
 else
@@ -901,7 +929,10 @@ else
   if (context->role == OSDP_ROLE_MONITOR)
   {
     fprintf (context->log, "%s%s", timestamp, message);
-    fflush (context->log);
+
+    // a batch of captured frames is flushed once, by whoever fed them in
+    if (!from_capture)
+      fflush (context->log);
   }
   else
     if (context->verbosity >= level)
@@ -914,3 +945,63 @@ else
 
 } /* oosdp_log */
 
+
+
+/*
+  oo_log_levels - set the per-category log levels
+
+  every category starts at the verbosity; "log-levels" then sets
+  categories by name, e.g. "secure=9,parse=0".  called whenever the
+  verbosity changes.
+*/
+
+int
+  oo_log_levels
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_log_levels */
+
+  int category;
+  int i;
+  int level;
+  static char *names [OO_LOG_CATEGORIES] =
+    { "io", "parse", "secure", "filetransfer", "conformance" };
+  char name [1024];
+  char *p;
+  int status;
+
+
+  status = ST_OK;
+  for (i=0; i<OO_LOG_CATEGORIES; i++)
+    ctx->log_level [i] = ctx->verbosity;
+
+  p = ctx->log_levels;
+  while ((status EQUALS ST_OK) && (*p != 0))
+  {
+    name [0] = 0;
+    level = 0;
+    if (2 != sscanf (p, " %1023[a-z] = %d", name, &level))
+      status = ST_LOG_LEVELS;
+    if (status EQUALS ST_OK)
+    {
+      category = -1;
+      for (i=0; i<OO_LOG_CATEGORIES; i++)
+        if (0 EQUALS strcmp (name, names [i]))
+          category = i;
+      if (category EQUALS -1)
+        status = ST_LOG_LEVELS;
+      else
+        ctx->log_level [category] = level;
+    };
+    p = strchr (p, ',');
+    if (p EQUALS NULL)
+      break;
+    p++;
+  };
+  if (status != ST_OK)
+    fprintf (stderr, "log-levels \"%s\" not understood (categories: io parse secure filetransfer conformance)\n",
+      ctx->log_levels);
+  return (status);
+
+} /* oo_log_levels */
+
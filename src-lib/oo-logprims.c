@@ -328,7 +328,7 @@ int
 
 
   status = ST_OK;
-  if (ctx->verbosity > 8)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 9))
   {
     strcpy (tlogmsg, prefix_message);
     for (i=0; i<OSDP_KEY_OCTETS; i++)
@@ -361,6 +361,11 @@ int
   status = oosdp_make_message (OOSDP_MSG_PKT_STATS, tlogmsg, NULL);
   if (status == ST_OK)
     status = oosdp_log (ctx, OSDP_LOG_STRING, 1, tlogmsg);
+  if (status == ST_OK)
+  {
+    oo_latency_log_summary (ctx);
+    oo_mpart_log_summary (ctx);
+  };
   return (ST_OK);
 
 } /* osdp_log_summary */
@@ -409,29 +414,38 @@ void
 
 { /* osdp_trace_dump */
 
+  int from_capture;
   struct timespec current_time_fine;
   FILE *tf;
 
 
   // if verbosity is not 'quiet' OR tracing was explicitly enabled
 
-  if ((ctx->verbosity > 0) || (ctx->trace))
+  if ((OO_LOG_ON (ctx, OO_LOG_IO, 1)) || (ctx->trace))
   {
-    fflush(ctx->log);
-    if (ctx->verbosity > 9)
+    // captured frames are flushed a batch at a time by whoever is feeding them in
+    from_capture = oo_monitor_frame_time (&current_time_fine);
+    if (!from_capture)
+      fflush(ctx->log);
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
     {
       fprintf(stderr, "DEBUG: penab %d olen %d ilen %d\n",
         print_enable, (int)strlen(trace_out_buffer), (int)strlen(trace_in_buffer));
     }
 
-    clock_gettime (CLOCK_REALTIME, &current_time_fine);
-    if (ctx->verbosity > 9)
+    if (!from_capture)
+      clock_gettime (CLOCK_REALTIME, &current_time_fine);
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
     {
       fprintf(ctx->log, "DEBUG: osdp_trace_dump fetched current time ol=%d il=%d\n",
         (int)strlen(trace_out_buffer), (int)strlen(trace_in_buffer));
       fflush(ctx->log);
     };
-    tf = fopen(OSDP_TRACE_FILE, "a+");
+    // initialize_osdp created the trace file.  only open it with something to add.
+
+    tf = NULL;
+    if ((strlen(trace_out_buffer) > 0) || (strlen(trace_in_buffer) > 0))
+      tf = fopen(OSDP_TRACE_FILE, "a+");
     if (tf)
     {
       char *tag;
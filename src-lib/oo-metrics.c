@@ -0,0 +1,607 @@
+/*
+  oo-metrics - OpenMetrics (Prometheus) text endpoint
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  the endpoint is optional.  it is enabled by "metrics-port" (TCP, bound
+  to 127.0.0.1) or "metrics-socket" (a unix socket path) in the settings.
+
+  the text is rendered into a cached snapshot on the statistics timer so
+  answering a scrape is an accept, a read of the request and a write of the
+  snapshot.  nothing here waits: up to OO_METRICS_CLIENTS_MAX scrapers are
+  kept in the event loop's select, each read or written only when select
+  says it's ready.  the answer is a copy of the snapshot taken when the
+  request is in, so a refresh doesn't change it halfway.  a scraper that
+  sends no request is answered after OO_METRICS_REQUEST_MSEC, and one that
+  isn't done after OO_METRICS_DEADLINE_MSEC is dropped (see
+  oo_metrics_expire, called from the timer pass.)
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+
+#include <open-osdp.h>
+#include <osdp_conformance.h>
+
+
+extern OSDP_BUFFER osdp_buf;
+extern OSDP_LATENCY_STATS osdp_latency [OSDP_LATENCY_COMMANDS_MAX];
+char *oo_metrics_snapshot_text;
+int oo_metrics_snapshot_length;
+static OO_METRICS_CLIENT oo_metrics_clients [OO_METRICS_CLIENTS_MAX];
+
+// latency histogram boundaries reported, in microseconds
+unsigned long long oo_metrics_latency_le [] =
+  { 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+    1000000, 2000000, 5000000, 0 };
+
+
+/*
+  oo_metrics_append - printf into the snapshot buffer, guarding overflow
+*/
+
+void
+  oo_metrics_append
+    (char *line)
+
+{ /* oo_metrics_append */
+
+  int lth;
+
+
+  lth = strlen (line);
+  if ((oo_metrics_snapshot_length + lth) < OO_METRICS_SNAPSHOT_MAX)
+  {
+    memcpy (oo_metrics_snapshot_text+oo_metrics_snapshot_length, line, lth+1);
+    oo_metrics_snapshot_length = oo_metrics_snapshot_length + lth;
+  };
+
+} /* oo_metrics_append */
+
+
+/*
+  oo_metrics_counter - emit one counter family with a single sample
+*/
+
+void
+  oo_metrics_counter
+    (char *name,
+    char *help,
+    long long value)
+
+{ /* oo_metrics_counter */
+
+  char line [1024];
+
+
+  sprintf (line, "# TYPE %s counter\n# HELP %s %s\n%s_total %lld\n",
+    name, name, help, name, value);
+  oo_metrics_append (line);
+
+} /* oo_metrics_counter */
+
+
+/*
+  oo_metrics_gauge - emit one gauge family with a single sample
+*/
+
+void
+  oo_metrics_gauge
+    (char *name,
+    char *help,
+    long long value)
+
+{ /* oo_metrics_gauge */
+
+  char line [1024];
+
+
+  sprintf (line, "# TYPE %s gauge\n# HELP %s %s\n%s %lld\n",
+    name, name, help, name, value);
+  oo_metrics_append (line);
+
+} /* oo_metrics_gauge */
+
+
+/*
+  oo_metrics_init - set up the listener if one was configured
+*/
+
+int
+  oo_metrics_init
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_metrics_init */
+
+  int i;
+  struct sockaddr_in inet_sock;
+  int one;
+  int sfd;
+  int status;
+  int status_socket;
+  struct sockaddr_un unix_sock;
+
+
+  status = ST_OK;
+  ctx->metrics_fd = -1;
+  sfd = -1;
+  for (i=0; i<OO_METRICS_CLIENTS_MAX; i++)
+    oo_metrics_clients [i].fd = -1;
+  if ((ctx->metrics_port EQUALS 0) && (strlen (ctx->metrics_socket) EQUALS 0))
+    return (ST_OK);
+
+  oo_metrics_snapshot_text = malloc (OO_METRICS_SNAPSHOT_MAX);
+  if (oo_metrics_snapshot_text EQUALS NULL)
+    status = ST_METRICS_SETUP;
+  if (status EQUALS ST_OK)
+  {
+    oo_metrics_snapshot_text [0] = 0;
+    oo_metrics_snapshot_length = 0;
+    if (ctx->metrics_port > 0)
+    {
+      sfd = socket (AF_INET, SOCK_STREAM, 0);
+      if (sfd EQUALS -1)
+        status = ST_METRICS_SETUP;
+      if (status EQUALS ST_OK)
+      {
+        one = 1;
+        (void) setsockopt (sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        memset (&inet_sock, 0, sizeof (inet_sock));
+        inet_sock.sin_family = AF_INET;
+        inet_sock.sin_port = htons (ctx->metrics_port);
+        inet_sock.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        status_socket = bind (sfd, (struct sockaddr *)&inet_sock, sizeof (inet_sock));
+        if (status_socket EQUALS -1)
+          status = ST_METRICS_SETUP;
+      };
+    }
+    else
+    {
+      sfd = socket (AF_UNIX, SOCK_STREAM, 0);
+      if (sfd EQUALS -1)
+        status = ST_METRICS_SETUP;
+      if (status EQUALS ST_OK)
+      {
+        memset (&unix_sock, 0, sizeof (unix_sock));
+        unix_sock.sun_family = AF_UNIX;
+        strncpy (unix_sock.sun_path, ctx->metrics_socket, sizeof (unix_sock.sun_path)-1);
+        unlink (unix_sock.sun_path);
+        status_socket = bind (sfd, (struct sockaddr *)&unix_sock, sizeof (unix_sock));
+        if (status_socket EQUALS -1)
+          status = ST_METRICS_SETUP;
+      };
+    };
+  };
+  if (status EQUALS ST_OK)
+  {
+    status_socket = fcntl (sfd, F_SETFL, fcntl (sfd, F_GETFL, 0) | O_NONBLOCK);
+    if (status_socket != -1)
+      status_socket = listen (sfd, 4);
+    if (status_socket EQUALS -1)
+      status = ST_METRICS_SETUP;
+  };
+  if (status EQUALS ST_OK)
+  {
+    ctx->metrics_fd = sfd;
+    if (ctx->metrics_port > 0)
+      fprintf (ctx->log, "Metrics endpoint http://127.0.0.1:%d/metrics\n", ctx->metrics_port);
+    else
+      fprintf (ctx->log, "Metrics endpoint on unix socket %s\n", ctx->metrics_socket);
+    status = oo_metrics_snapshot (ctx);
+  }
+  else
+  {
+    // the endpoint is optional.  complain and carry on without it.
+    fprintf (ctx->log, "Metrics endpoint setup failed (errno %d), disabled.\n", errno);
+    if (sfd != -1)
+      close (sfd);
+    status = ST_OK;
+  };
+  return (status);
+
+} /* oo_metrics_init */
+
+
+/*
+  oo_metrics_drop - close a scraper and free its slot
+
+  why is NULL if the answer went out in full.
+*/
+
+static void
+  oo_metrics_drop
+    (OSDP_CONTEXT *ctx,
+    OO_METRICS_CLIENT *client,
+    char *why)
+
+{ /* oo_metrics_drop */
+
+  if (why != NULL)
+    if (ctx->verbosity > 3)
+      fprintf (ctx->log, "metrics scrape dropped (%s) at %d of %d octets\n",
+        why, client->response_sent, client->response_length);
+  close (client->fd);
+  if (client->response != NULL)
+    free (client->response);
+  memset (client, 0, sizeof (*client));
+  client->fd = -1;
+
+} /* oo_metrics_drop */
+
+
+/*
+  oo_metrics_answer - start writing the answer to a scraper
+
+  the header and a copy of the snapshot as it is now.
+*/
+
+static void
+  oo_metrics_answer
+    (OSDP_CONTEXT *ctx,
+    OO_METRICS_CLIENT *client)
+
+{ /* oo_metrics_answer */
+
+  char header [1024];
+  int lth;
+
+
+  if ((ctx->verbosity > 9) && (client->request_length > 0))
+    fprintf (ctx->log, "metrics scrape (%d octets of request)\n", client->request_length);
+  sprintf (header,
+"HTTP/1.0 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+    oo_metrics_snapshot_length);
+  lth = strlen (header);
+  client->response = malloc (lth + oo_metrics_snapshot_length);
+  if (client->response EQUALS NULL)
+  {
+    oo_metrics_drop (ctx, client, "out of memory");
+    return;
+  };
+  memcpy (client->response, header, lth);
+  memcpy (client->response+lth, oo_metrics_snapshot_text, oo_metrics_snapshot_length);
+  client->response_length = lth + oo_metrics_snapshot_length;
+  client->response_sent = 0;
+  client->state = OO_METRICS_WRITING;
+
+} /* oo_metrics_answer */
+
+
+/*
+  oo_metrics_expire - answer or drop scrapers that have been waited on long enough
+
+  called from the timer pass of the event loop.
+*/
+
+void
+  oo_metrics_expire
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_metrics_expire */
+
+  long long age_msec;
+  OO_METRICS_CLIENT *client;
+  int i;
+  struct timespec now;
+
+
+  if (ctx->metrics_fd EQUALS -1)
+    return;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  for (i=0; i<OO_METRICS_CLIENTS_MAX; i++)
+  {
+    client = oo_metrics_clients + i;
+    if (client->fd != -1)
+    {
+      age_msec = (now.tv_sec - client->accepted.tv_sec) * 1000LL +
+        (now.tv_nsec - client->accepted.tv_nsec) / 1000000LL;
+      if (age_msec >= OO_METRICS_DEADLINE_MSEC)
+        oo_metrics_drop (ctx, client, "too slow");
+      else
+      {
+        // the request may never come (a bare connect), answer anyway
+        if ((client->state EQUALS OO_METRICS_READING) && (age_msec >= OO_METRICS_REQUEST_MSEC))
+          oo_metrics_answer (ctx, client);
+      };
+    };
+  };
+
+} /* oo_metrics_expire */
+
+
+/*
+  oo_metrics_select - add the listener and the scrapers to the event loop's select
+
+  a scraper is waited on for reading until its request is in, then for
+  writing until it has the answer.  scount is raised to cover them.
+*/
+
+void
+  oo_metrics_select
+    (OSDP_CONTEXT *ctx,
+    fd_set *readfds,
+    fd_set *writefds,
+    int *scount)
+
+{ /* oo_metrics_select */
+
+  int busy;
+  OO_METRICS_CLIENT *client;
+  int i;
+
+
+  if (ctx->metrics_fd EQUALS -1)
+    return;
+
+  // while every slot is busy the next scraper waits in the listen queue
+  busy = 0;
+  for (i=0; i<OO_METRICS_CLIENTS_MAX; i++)
+  {
+    client = oo_metrics_clients + i;
+    if (client->fd != -1)
+    {
+      busy++;
+      if (client->state EQUALS OO_METRICS_READING)
+        FD_SET (client->fd, readfds);
+      else
+        FD_SET (client->fd, writefds);
+      if (client->fd >= *scount)
+        *scount = client->fd+1;
+    };
+  };
+  if (busy < OO_METRICS_CLIENTS_MAX)
+  {
+    FD_SET (ctx->metrics_fd, readfds);
+    if (ctx->metrics_fd >= *scount)
+      *scount = ctx->metrics_fd+1;
+  };
+
+} /* oo_metrics_select */
+
+
+/*
+  oo_metrics_serve - accept scrapers and move along the ones select found ready
+
+  called from the event loop after select.  whatever was asked for, the
+  answer is the snapshot.  the request is read to its blank line (or the
+  scraper's end of it, or a full buffer) first so the close does not reset
+  the connection.
+*/
+
+int
+  oo_metrics_serve
+    (OSDP_CONTEXT *ctx,
+    fd_set *readfds,
+    fd_set *writefds)
+
+{ /* oo_metrics_serve */
+
+  int cfd;
+  OO_METRICS_CLIENT *client;
+  int i;
+  int status_io;
+
+
+  if (ctx->metrics_fd EQUALS -1)
+    return (ST_OK);
+  for (i=0; i<OO_METRICS_CLIENTS_MAX; i++)
+  {
+    client = oo_metrics_clients + i;
+    if (client->fd EQUALS -1)
+      continue;
+    if ((client->state EQUALS OO_METRICS_READING) && FD_ISSET (client->fd, readfds))
+    {
+      status_io = read (client->fd, client->request+client->request_length,
+        sizeof (client->request)-1-client->request_length);
+      if (status_io > 0)
+      {
+        client->request_length = client->request_length + status_io;
+        client->request [client->request_length] = 0;
+        if ((strstr (client->request, "\r\n\r\n") != NULL) || (strstr (client->request, "\n\n") != NULL) ||
+          (client->request_length EQUALS (int)sizeof (client->request)-1))
+          oo_metrics_answer (ctx, client);
+      }
+      else
+      {
+        if (status_io EQUALS 0)
+          oo_metrics_answer (ctx, client); // it's done sending
+        else
+          if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            oo_metrics_drop (ctx, client, "read failed");
+      };
+    }
+    else
+    {
+      if ((client->state EQUALS OO_METRICS_WRITING) && FD_ISSET (client->fd, writefds))
+      {
+        status_io = write (client->fd, client->response+client->response_sent,
+          client->response_length-client->response_sent);
+        if (status_io > 0)
+        {
+          client->response_sent = client->response_sent + status_io;
+          if (client->response_sent EQUALS client->response_length)
+            oo_metrics_drop (ctx, client, NULL);
+        }
+        else
+          if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            oo_metrics_drop (ctx, client, "write failed");
+      };
+    };
+  };
+
+  if (FD_ISSET (ctx->metrics_fd, readfds))
+  {
+    for (i=0; i<OO_METRICS_CLIENTS_MAX; i++)
+      if (oo_metrics_clients [i].fd EQUALS -1)
+        break;
+    if (i < OO_METRICS_CLIENTS_MAX)
+    {
+      cfd = accept (ctx->metrics_fd, NULL, NULL);
+      if (cfd != -1)
+      {
+        (void) fcntl (cfd, F_SETFL, fcntl (cfd, F_GETFL, 0) | O_NONBLOCK);
+        client = oo_metrics_clients + i;
+        memset (client, 0, sizeof (*client));
+        client->fd = cfd;
+        client->state = OO_METRICS_READING;
+        clock_gettime (CLOCK_MONOTONIC, &(client->accepted));
+      };
+    };
+  };
+  return (ST_OK);
+
+} /* oo_metrics_serve */
+
+
+/*
+  oo_metrics_snapshot - render the metrics text into the cache
+*/
+
+int
+  oo_metrics_snapshot
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_metrics_snapshot */
+
+  int b;
+  unsigned long long cumulative;
+  OSDP_LATENCY_HISTOGRAM *h;
+  int i;
+  int j;
+  int k;
+  char line [2048];
+  int queue_depth;
+  extern OSDP_INTEROP_ASSESSMENT osdp_conformance;
+  char *role_tag;
+
+
+  if (oo_metrics_snapshot_text EQUALS NULL)
+    return (ST_OK);
+  oo_metrics_snapshot_text [0] = 0;
+  oo_metrics_snapshot_length = 0;
+
+  role_tag = "PD";
+  if (ctx->role EQUALS OSDP_ROLE_ACU)
+    role_tag = "ACU";
+  if (ctx->role EQUALS OSDP_ROLE_MONITOR)
+    role_tag = "MON";
+  sprintf (line,
+"# TYPE osdp_exerciser info\n# HELP osdp_exerciser Exerciser identity\nosdp_exerciser_info{role=\"%s\",speed=\"%s\",version=\"%d.%d-%d\"} 1\n",
+    role_tag, ctx->serial_speed,
+    OSDP_VERSION_MAJOR, OSDP_VERSION_MINOR, OSDP_VERSION_BUILD);
+  oo_metrics_append (line);
+
+  // counters
+
+  oo_metrics_counter ("osdp_octets_received", "Octets read from the line", ctx->bytes_received);
+  oo_metrics_counter ("osdp_octets_sent", "Octets written to the line", ctx->bytes_sent);
+  oo_metrics_counter ("osdp_octets_dropped", "Octets discarded as noise", ctx->dropped_octets);
+  oo_metrics_counter ("osdp_packets_received", "Frames received", ctx->packets_received);
+  oo_metrics_counter ("osdp_pdus_received", "PDUs received", ctx->pdus_received);
+  oo_metrics_counter ("osdp_pdus_sent", "PDUs sent", ctx->pdus_sent);
+  oo_metrics_counter ("osdp_acu_polls", "osdp_POLL commands", ctx->acu_polls);
+  oo_metrics_counter ("osdp_pd_acks", "osdp_ACK responses", ctx->pd_acks);
+  oo_metrics_counter ("osdp_naks_sent", "osdp_NAK responses sent", ctx->sent_naks);
+  oo_metrics_counter ("osdp_crc_errors", "CRC errors", ctx->crc_errs);
+  oo_metrics_counter ("osdp_checksum_errors", "Checksum errors", ctx->checksum_errs);
+  oo_metrics_counter ("osdp_hash_ok", "Secure channel MAC checks passed", ctx->hash_ok);
+  oo_metrics_counter ("osdp_hash_bad", "Secure channel MAC checks failed", ctx->hash_bad);
+  oo_metrics_counter ("osdp_retries", "Retries detected at the PD", ctx->retries);
+  oo_metrics_counter ("osdp_response_timeouts", "Responses given up on by the ACU", ctx->response_timeouts);
+  oo_metrics_counter ("osdp_sequence_errors", "Bad sequence numbers", ctx->seq_bad);
+  oo_metrics_counter ("osdp_buffer_overflows", "Receive buffer overflows", osdp_buf.overflow);
+  oo_metrics_counter ("osdp_conforming_messages", "Conforming messages", osdp_conformance.conforming_messages);
+
+  // gauges
+
+  queue_depth = 0;
+  if (ctx->q != NULL)
+    for (i=0; i<OSDP_COMMAND_QUEUE_SIZE; i++)
+      if (ctx->q [i].status != 0)
+        queue_depth++;
+  oo_metrics_gauge ("osdp_command_queue_depth", "Queued commands", queue_depth);
+  oo_metrics_gauge ("osdp_command_queue_overflow", "Command queue overflow flag", ctx->cmd_q_overflow);
+  oo_metrics_gauge ("osdp_secure_channel_use", "Secure channel state (see OO_SCU_ENAB)",
+    ctx->secure_channel_use [OO_SCU_ENAB]);
+  oo_metrics_gauge ("osdp_secure_channel_install_mode", "Secure channel install mode",
+    ctx->secure_channel_use [OO_SCU_INST]);
+  oo_metrics_gauge ("osdp_secure_channel_key_slot", "Current key slot (-1 for none)", ctx->current_key_slot);
+  oo_metrics_gauge ("osdp_filetransfer_offset", "File transfer current offset", ctx->xferctx.current_offset);
+  oo_metrics_gauge ("osdp_filetransfer_length", "File transfer total length", ctx->xferctx.total_length);
+
+  // latency histograms, one series per command and phase
+
+  oo_metrics_append (
+"# TYPE osdp_response_latency_seconds histogram\n# HELP osdp_response_latency_seconds End of transmit to response\n");
+  for (i=0; i<OSDP_LATENCY_COMMANDS_MAX; i++)
+  {
+    if (osdp_latency [i].in_use)
+    {
+      for (j=0; j<2; j++)
+      {
+        char labels [256];
+
+        h = &(osdp_latency [i].first_octet);
+        if (j EQUALS 1)
+          h = &(osdp_latency [i].complete_frame);
+        sprintf (labels, "command=\"%s\",phase=\"%s\"",
+          osdp_command_reply_to_string (osdp_latency [i].command, 0),
+          (j EQUALS 0) ? "first_octet" : "complete_frame");
+
+        // a fine bucket counts toward a boundary once its whole range is below it
+        for (k=0; oo_metrics_latency_le [k] != 0; k++)
+        {
+          cumulative = 0;
+          for (b=0; b<OSDP_LATENCY_BUCKETS-1; b++)
+            if (oo_latency_bucket_floor (b+1) <= oo_metrics_latency_le [k])
+              cumulative = cumulative + h->bucket [b];
+          sprintf (line, "osdp_response_latency_seconds_bucket{%s,le=\"%g\"} %llu\n",
+            labels, oo_metrics_latency_le [k] / 1000000.0, cumulative);
+          oo_metrics_append (line);
+        };
+        sprintf (line,
+"osdp_response_latency_seconds_bucket{%s,le=\"+Inf\"} %u\nosdp_response_latency_seconds_count{%s} %u\nosdp_response_latency_seconds_sum{%s} %.6f\n",
+          labels, h->count, labels, h->count, labels, h->total_usec / 1000000.0);
+        oo_metrics_append (line);
+      };
+    };
+  };
+
+  // conformance status per test
+
+  oo_metrics_append (
+"# TYPE osdp_conformance_test_status gauge\n# HELP osdp_conformance_test_status 0 untested 1 exercised 2 good-only 3 fail 4 skip\n");
+  (void) osdp_conformance_metrics (oo_metrics_append);
+
+  oo_metrics_append ("# EOF\n");
+  return (ST_OK);
+
+} /* oo_metrics_snapshot */
@@ -71,7 +71,10 @@ int
     mfg->vendor_code [0], mfg->vendor_code [1], mfg->vendor_code [2], mfg_command, payload);
   {
     FILE *f;
-    f = fopen("/opt/osdp-conformance/run/ACU/osdp-mfg-response.json", "w");
+    char path [1024];
+
+    sprintf(path, "%s/ACU/osdp-mfg-response.json", oo_osdp_root(ctx, OO_DIR_RUN));
+    f = fopen(path, "w");
     if (f != NULL)\
     {
       fprintf(f, "%s\n", cmd);
@@ -130,34 +133,51 @@ int action_osdp_NAK
           nak_code, nak_data);
         system(cmd);
 
-        fprintf (context->log, "%s\n", tlogmsg);
+        if (context->event_log != NULL)
+          (void) oo_eventlog (context, OO_EVLOG_NAK_RECEIVED, "bbb", (count > 1), nak_code, nak_data);
+        else
+          fprintf (context->log, "%s\n", tlogmsg);
         switch(*(0+msg->data_payload))
         {
 //not yet displayed: OO_NAK_COMMAND_LENGTH OO_NAK_BIO_TYPE_UNSUPPORTED OO_NAK_BIO_FMT_UNSUPPORTED OO_NAK_CMD_UNABLE
         case OO_NAK_CHECK_CRC:
-          fprintf(context->log, "  NAK: (1)Bad CRC/Checksum\n");
+          if (context->event_log EQUALS NULL)
+            fprintf(context->log, "  NAK: (1)Bad CRC/Checksum\n");
           break;
         case OO_NAK_UNK_CMD:
-          fprintf(context->log, "  NAK: (3)Command not implemented by PD\n");
+          if (context->event_log EQUALS NULL)
+            fprintf(context->log, "  NAK: (3)Command not implemented by PD\n");
           break;
         case OO_NAK_SEQUENCE:
-          fprintf(context->log, "  NAK: (4)Unexpected sequence number\n");
+          if (context->event_log EQUALS NULL)
+            fprintf(context->log, "  NAK: (4)Unexpected sequence number\n");
           context->seq_bad ++;
             // hopefully not double counted, works in monitor mode
           context->next_sequence = 0; // reset sequence due to NAK
+          oo_recorder_trigger (context, "nak-sequence");
           break;
         case OO_NAK_UNSUP_SECBLK:
-          fprintf(context->log, "  NAK: (5)Security block not accepted.\n");
+          if (context->event_log EQUALS NULL)
+            fprintf(context->log, "  NAK: (5)Security block not accepted.\n");
+          oo_recorder_trigger (context, "nak-security");
           break;
         case OO_NAK_ENC_REQ:
           // drop out of secure channel and in fact reset the sequence number
 
-          fprintf(context->log, "  NAK: (%d)Encryption required.\n", nak_code);
+          if (context->event_log EQUALS NULL)
+            fprintf(context->log, "  NAK: (%d)Encryption required.\n", nak_code);
           osdp_reset_secure_channel(context);
           context->next_sequence = 0; 
+          oo_recorder_trigger (context, "nak-security");
           break;
         };
       };
+
+      // a NAK'd fragment is resent (and smaller)
+
+      if ((context->last_command_sent EQUALS OSDP_FILETRANSFER) &&
+        (context->xferctx.state EQUALS OSDP_XFER_STATE_TRANSFERRING))
+        oo_filetransfer_adapt (context, OO_FT_ADAPT_NAK);
       osdp_test_set_status(OOC_SYMBOL_rep_nak, OCONFORM_EXERCISED);
       if (nak_code EQUALS 3) 
         osdp_test_set_status(OOC_SYMBOL_resp_nak_3, OCONFORM_EXERCISED);
@@ -219,22 +239,27 @@ int action_osdp_NAK
 // assumes it was a perm on command
 #define LP_ON (12)
 
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_AMBER)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_amber, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_BLACK)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_black, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_BLUE)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_blue, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_CYAN)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_cyan, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_GREEN)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_green, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_MAGENTA)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_magenta, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_RED)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_red, OCONFORM_FAIL);
-        if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_WHITE)
-          osdp_test_set_status(OOC_SYMBOL_cmd_led_white, OCONFORM_FAIL);
+        // only an LED command's NAK says anything about the LED colors.
+
+        if (context->last_command_sent EQUALS OSDP_LED)
+        {
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_AMBER)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_amber, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_BLACK)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_black, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_BLUE)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_blue, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_CYAN)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_cyan, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_GREEN)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_green, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_MAGENTA)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_magenta, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_RED)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_red, OCONFORM_FAIL);
+          if (context->test_details [LP_ON] EQUALS OSDP_LEDCOLOR_WHITE)
+            osdp_test_set_status(OOC_SYMBOL_cmd_led_white, OCONFORM_FAIL);
+        };
 
         // if the PD NAK'd an OSTAT that is a fail.  The initiator of the OSTAT is responsible for only
         // using it if output support declared.
@@ -0,0 +1,443 @@
+/*
+  oo-monitor - capture thread and decode pipeline for monitor mode
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  in monitor mode on a serial line a capture thread owns the descriptor.
+  it reads whatever octets are there, finds the frames (SOM, then the
+  length) and puts each one with the time its first octet arrived in a
+  ring.  only the capture thread moves the head and only the event loop
+  moves the tail, so the ring needs no lock.  the capture thread pokes a
+  pipe when it puts a frame in an empty ring; the event loop selects on
+  that instead of the line.
+
+  the capture thread pauses briefly after each read so octets arrive in
+  batches rather than one wakeup apiece.  the arrival of each octet is
+  worked back from the end of the batch at the line speed.
+
+  the event loop takes frames off in batches and runs each through the
+  usual parse, which does the decoding, the log text and the trace.  if
+  nothing wants text (verbosity 0 and no trace) frames are only counted.
+*/
+
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#include <open-osdp.h>
+extern OSDP_BUFFER osdp_buf;
+
+
+#define OO_MONITOR_BATCH_USEC (2000) // pause after each read to let octets collect
+#define OO_MONITOR_READ_MAX    (2048)
+
+
+static OO_MONITOR_FRAMER oo_monitor_framer; // capture thread: frame being collected
+static OO_MONITOR_FRAME oo_monitor_ring [OO_MONITOR_RING];
+static unsigned int oo_monitor_head; // next slot the capture thread fills
+static unsigned int oo_monitor_tail; // next slot the event loop decodes
+static OO_MONITOR_FRAME *oo_monitor_decoding; // frame being parsed, for its timestamp
+static int oo_monitor_wake [2];
+static unsigned int oo_monitor_frames;
+static unsigned int oo_monitor_overruns;
+
+
+/*
+  oo_monitor_put - a whole frame was seen, queue it for the event loop
+*/
+
+static void
+  oo_monitor_put
+    (OO_MONITOR_FRAME *frame)
+
+{ /* oo_monitor_put */
+
+  unsigned int head;
+  unsigned int tail;
+
+
+  head = oo_monitor_head;
+  tail = __atomic_load_n (&oo_monitor_tail, __ATOMIC_ACQUIRE);
+  if ((head - tail) >= OO_MONITOR_RING)
+  {
+    // the decoder fell behind.  better to lose this frame than stall the line.
+
+    __atomic_add_fetch (&oo_monitor_overruns, 1, __ATOMIC_RELAXED);
+  }
+  else
+  {
+    memcpy (&(oo_monitor_ring [head % OO_MONITOR_RING]), frame,
+      offsetof (OO_MONITOR_FRAME, octets) + frame->length);
+    __atomic_store_n (&oo_monitor_head, head+1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch (&oo_monitor_frames, 1, __ATOMIC_RELAXED);
+
+    // if the event loop had taken everything before this one it may be
+    // asleep.  (it stores the tail before it looks at the head, so one
+    // side or the other sees the frame.)
+
+    if (__atomic_load_n (&oo_monitor_tail, __ATOMIC_SEQ_CST) EQUALS head)
+      (void) write (oo_monitor_wake [1], "F", 1);
+  };
+
+} /* oo_monitor_put */
+
+
+/*
+  oo_monitor_frame_octet - one octet, into the frame being collected
+
+  returns 1 when that octet finished a frame.  the frame stays in
+  framer->frame until the next octet is offered.  used on the line by the
+  capture thread and on capture files by osdp-replay.
+*/
+
+int
+  oo_monitor_frame_octet
+    (OO_MONITOR_FRAMER *framer,
+    unsigned char octet,
+    struct timespec *arrival)
+
+{ /* oo_monitor_frame_octet */
+
+  unsigned char held [3];
+  int i;
+
+
+  if ((framer->frame_length > 0) && (framer->frame.length EQUALS framer->frame_length))
+    oo_monitor_frame_reset (framer);
+  if (framer->frame.length EQUALS 0)
+  {
+    // hunting for SOM
+
+    if (octet != C_SOM)
+    {
+      if (octet != C_OSDP_MARK)
+        __atomic_add_fetch (&(framer->noise), 1, __ATOMIC_RELAXED);
+      return (0);
+    };
+    framer->frame.captured = *arrival;
+  };
+  framer->frame.octets [framer->frame.length] = octet;
+  framer->frame.length ++;
+  if (framer->frame.length EQUALS 4)
+  {
+    framer->frame_length = framer->frame.octets [2] + 256*framer->frame.octets [3];
+
+    // a length that can't be right means that SOM was noise.  hunt again in what followed it.
+
+    if ((framer->frame_length < (int)(sizeof (OSDP_HDR) + 1)) ||
+      (framer->frame_length > OSDP_OFFICIAL_MSG_MAX))
+    {
+      __atomic_add_fetch (&(framer->noise), 1, __ATOMIC_RELAXED);
+      memcpy (held, framer->frame.octets+1, sizeof (held));
+      framer->frame.length = 0;
+      framer->frame_length = 0;
+      for (i=0; i<(int)sizeof (held); i++)
+        (void) oo_monitor_frame_octet (framer, held [i], arrival);
+    };
+  };
+  return ((framer->frame_length > 0) && (framer->frame.length EQUALS framer->frame_length));
+
+} /* oo_monitor_frame_octet */
+
+
+/*
+  oo_monitor_frame_reset - drop a partial frame (the line went quiet part way through)
+*/
+
+void
+  oo_monitor_frame_reset
+    (OO_MONITOR_FRAMER *framer)
+
+{ /* oo_monitor_frame_reset */
+
+  if ((framer->frame_length EQUALS 0) || (framer->frame.length < framer->frame_length))
+    __atomic_add_fetch (&(framer->noise), framer->frame.length, __ATOMIC_RELAXED);
+  framer->frame.length = 0;
+  framer->frame_length = 0;
+
+} /* oo_monitor_frame_reset */
+
+
+/*
+  oo_monitor_capture - capture thread.  frames octets off the line into the ring.
+*/
+
+static void *
+  oo_monitor_capture
+    (void *arg)
+
+{ /* oo_monitor_capture */
+
+  long long back;
+  struct timespec arrival;
+  unsigned char buffer [OO_MONITOR_READ_MAX];
+  OSDP_CONTEXT *ctx;
+  long long gathered;
+  int i;
+  long long last_read;
+  int length;
+  long long now;
+  struct timespec now_real;
+  long long octet_nsec;
+  struct timespec pause;
+  fd_set readfds;
+  int speed;
+  int status_select;
+  struct timeval timeout;
+
+
+  ctx = (OSDP_CONTEXT *)arg;
+  octet_nsec = 0;
+  speed = atoi (ctx->serial_speed);
+  if (speed > 0)
+    octet_nsec = 10000000000LL / speed; // start, 8 data, stop
+  pause.tv_sec = 0;
+  pause.tv_nsec = 1000 * OO_MONITOR_BATCH_USEC;
+  last_read = 0;
+  while (1)
+  {
+    FD_ZERO (&readfds);
+    FD_SET (ctx->fd, &readfds);
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 1000 * OO_MONITOR_GAP_MSEC;
+    status_select = select (ctx->fd+1, &readfds, NULL, NULL, &timeout);
+    if (status_select < 0)
+    {
+      if (errno != EINTR)
+        break;
+      continue;
+    };
+
+    // a frame that stopped part way is not going to finish
+
+    if (status_select EQUALS 0)
+    {
+      oo_monitor_frame_reset (&oo_monitor_framer);
+      continue;
+    };
+    length = read (ctx->fd, buffer, sizeof (buffer));
+    clock_gettime (CLOCK_REALTIME, &now_real);
+    now = now_real.tv_sec * 1000000000LL + now_real.tv_nsec;
+
+    // the octets can't have been arriving for longer than it's been since the last read
+
+    gathered = now - last_read;
+    for (i=0; i<length; i++)
+    {
+      back = (length-1-i) * octet_nsec;
+      if (back > gathered)
+        back = gathered;
+      arrival.tv_sec = (now - back) / 1000000000LL;
+      arrival.tv_nsec = (now - back) % 1000000000LL;
+      if (oo_monitor_frame_octet (&oo_monitor_framer, buffer [i], &arrival))
+        oo_monitor_put (&(oo_monitor_framer.frame));
+    };
+    last_read = now;
+    if (length > 0)
+      (void) nanosleep (&pause, NULL);
+  };
+  return (NULL);
+
+} /* oo_monitor_capture */
+
+
+/*
+  oo_monitor_decode - run one captured frame through the usual parse, with its capture time
+*/
+
+int
+  oo_monitor_decode
+    (OSDP_CONTEXT *ctx,
+    OO_MONITOR_FRAME *frame)
+
+{ /* oo_monitor_decode */
+
+  int status;
+
+
+  memcpy (osdp_buf.buf, frame->octets, frame->length);
+  osdp_buf.next = frame->length;
+  oo_monitor_decoding = frame;
+  status = process_osdp_input (&osdp_buf);
+  oo_monitor_decoding = NULL;
+  osdp_buf.next = 0;
+  return (status);
+
+} /* oo_monitor_decode */
+
+
+/*
+  oo_monitor_drain - decode (or just count) the frames the capture thread has queued
+*/
+
+int
+  oo_monitor_drain
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_monitor_drain */
+
+  int count;
+  char discard [64];
+  int decode;
+  OO_MONITOR_FRAME *frame;
+  unsigned int head;
+  unsigned int tail;
+
+
+  if (ctx->monitor_fd EQUALS -1)
+    return (ST_OK);
+
+  // empty the pipe first so a frame put in after the ring is seen empty wakes us again
+
+  while (read (ctx->monitor_fd, discard, sizeof (discard)) > 0)
+  {
+  };
+  decode = (ctx->verbosity > 0) || (ctx->trace);
+  count = 0;
+  tail = oo_monitor_tail;
+  head = __atomic_load_n (&oo_monitor_head, __ATOMIC_SEQ_CST);
+  while ((tail != head) && (count < OO_MONITOR_RING))
+  {
+    frame = &(oo_monitor_ring [tail % OO_MONITOR_RING]);
+    ctx->bytes_received = ctx->bytes_received + frame->length;
+    if (decode)
+      (void) oo_monitor_decode (ctx, frame);
+    else
+    {
+      // not decoded, but the flight recorder still gets it
+      oo_recorder_frame (ctx, OO_RECORDER_IN, frame->octets, frame->length, OO_RECORDER_NOT_PARSED, &(frame->captured));
+      ctx->packets_received ++;
+    };
+    tail ++;
+    count ++;
+    __atomic_store_n (&oo_monitor_tail, tail, __ATOMIC_SEQ_CST);
+    if (tail EQUALS head)
+      head = __atomic_load_n (&oo_monitor_head, __ATOMIC_SEQ_CST);
+  };
+
+  // a ring's worth at a time so timers and commands still get a turn.  come straight back for the rest.
+
+  if (tail != head)
+    (void) write (oo_monitor_wake [1], "F", 1);
+  return (ST_OK);
+
+} /* oo_monitor_drain */
+
+
+/*
+  oo_monitor_frame_time - when the frame being decoded arrived
+
+  returns 0 (and leaves captured alone) if no captured frame is being decoded.
+*/
+
+int
+  oo_monitor_frame_time
+    (struct timespec *captured)
+
+{ /* oo_monitor_frame_time */
+
+  if (oo_monitor_decoding EQUALS NULL)
+    return (0);
+  *captured = oo_monitor_decoding->captured;
+  return (1);
+
+} /* oo_monitor_frame_time */
+
+
+/*
+  oo_monitor_start - start the capture thread (monitor on a serial line only)
+
+  if it can't be started the event loop reads the line itself as before.
+*/
+
+int
+  oo_monitor_start
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_monitor_start */
+
+  pthread_t capture_thread;
+  int status;
+
+
+  status = ST_OK;
+  if ((ctx->role != OSDP_ROLE_MONITOR) || (ctx->transport_type != OSDP_TRANSPORT_SERIAL))
+    return (ST_OK);
+
+  if (pipe (oo_monitor_wake) != 0)
+    status = ST_MONITOR_START;
+  if (status EQUALS ST_OK)
+  {
+    (void) fcntl (oo_monitor_wake [0], F_SETFL, fcntl (oo_monitor_wake [0], F_GETFL, 0) | O_NONBLOCK);
+    (void) fcntl (oo_monitor_wake [1], F_SETFL, fcntl (oo_monitor_wake [1], F_GETFL, 0) | O_NONBLOCK);
+    if (pthread_create (&capture_thread, NULL, oo_monitor_capture, ctx) != 0)
+    {
+      close (oo_monitor_wake [0]);
+      close (oo_monitor_wake [1]);
+      status = ST_MONITOR_START;
+    };
+  };
+  if (status EQUALS ST_OK)
+  {
+    (void) pthread_detach (capture_thread);
+    ctx->monitor_fd = oo_monitor_wake [0];
+    if (ctx->verbosity > 3)
+      fprintf (ctx->log, "Monitor: capture thread started, ring of %d frames\n", OO_MONITOR_RING);
+  }
+  else
+  {
+    fprintf (ctx->log, "Monitor: capture thread not started (errno %d), reading the line directly\n", errno);
+  };
+  return (status);
+
+} /* oo_monitor_start */
+
+
+/*
+  oo_monitor_write_status - add the capture counters to the status file
+
+  emits a "monitor" member (followed by a comma) if the capture thread is running.
+*/
+
+void
+  oo_monitor_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_monitor_write_status */
+
+  if (ctx->monitor_fd != -1)
+    fprintf (sf,
+"\"monitor\" : { \"frames\" : \"%u\", \"overruns\" : \"%u\", \"noise-octets\" : \"%u\", \"queued\" : \"%u\" },\n",
+      __atomic_load_n (&oo_monitor_frames, __ATOMIC_RELAXED),
+      __atomic_load_n (&oo_monitor_overruns, __ATOMIC_RELAXED),
+      __atomic_load_n (&(oo_monitor_framer.noise), __ATOMIC_RELAXED),
+      __atomic_load_n (&oo_monitor_head, __ATOMIC_ACQUIRE) - oo_monitor_tail);
+
+} /* oo_monitor_write_status */
@@ -0,0 +1,598 @@
+/*
+  oo-multipart - reassembly and segmentation of multipart commands and replies
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  osdp_GENAUTH, osdp_CRAUTH and their replies, and osdp_PIVDATAR, carry
+  the payload in fragments, each with the whole size, its offset and its
+  length (OSDP_MULTI_HDR_IEC.)
+
+  inbound, fragments are collected in a slot from a small pool keyed by PD
+  address and command.  a map of the octets received so far lets fragments
+  arrive in any order; a fragment that brings nothing new is a duplicate,
+  one that disagrees with what's already there is a conflict and the
+  transaction is dropped.  a slot that hears nothing for
+  OO_MPART_TIMEOUT_SEC is given back.
+
+  outbound, one payload at a time is cut to fit the message size.  all
+  the fragments (multipart header and payload) are laid out once, up
+  front, so each send is just a pointer into the plan.  in secure channel
+  the encryption and MAC still happen per message in send_message_ex; the
+  MAC chains on the last R-MAC so the next one can't be computed before
+  the ACK for this one arrives.
+
+  the ACU sends the next fragment as soon as the PD ACK's the last one.
+  an ACK to anything else (a poll after the fragment timed out) gets the
+  same fragment again.  the PD sends the next fragment as the answer to
+  each poll, and the ACU polls again as soon as a fragment of a reply
+  arrives rather than waiting for the poll timer.
+
+  each transaction is timed from the first fragment out: until the last
+  one is ACK'd (or sent, on the PD) and, on the ACU, until the whole reply
+  is in.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+#include <open-osdp.h>
+extern OSDP_PARAMETERS p_card;
+
+
+static OO_MPART oo_mpart_pool [OO_MPART_POOL];
+static OO_MPART_OUT oo_mpart_out;
+static OO_MPART_STATS oo_mpart_stats;
+
+
+/*
+  oo_mpart_expire - give back slots that have been quiet too long
+*/
+
+static void
+  oo_mpart_expire
+    (OSDP_CONTEXT *ctx,
+    struct timespec *now)
+
+{ /* oo_mpart_expire */
+
+  int i;
+  OO_MPART *m;
+
+
+  for (i=0; i<OO_MPART_POOL; i++)
+  {
+    m = &(oo_mpart_pool [i]);
+    if (m->state EQUALS OO_MPART_RECEIVING)
+      if ((now->tv_sec - m->last_fragment.tv_sec) > OO_MPART_TIMEOUT_SEC)
+      {
+        fprintf(ctx->log, "  Multipart: PD %02X cmd %02X timed out with %u. of %u. octets\n",
+          m->pd, m->command, m->have, m->total);
+        m->state = OO_MPART_IDLE;
+      };
+  };
+
+} /* oo_mpart_expire */
+
+
+/*
+  oo_mpart_finish - once the last fragment is out, time the send
+*/
+
+static void
+  oo_mpart_finish
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_mpart_finish */
+
+  unsigned long long elapsed;
+  struct timespec now;
+
+
+  if ((oo_mpart_out.fragments > 0) && (oo_mpart_out.current EQUALS oo_mpart_out.fragments))
+  {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = oo_latency_elapsed (&(oo_mpart_out.started), &now);
+    oo_latency_record (&(oo_mpart_stats.send), elapsed);
+    oo_mpart_stats.fragments = oo_mpart_stats.fragments + oo_mpart_out.fragments;
+    oo_mpart_stats.resends = oo_mpart_stats.resends + oo_mpart_out.resends;
+    if (ctx->verbosity > 2)
+      fprintf(ctx->log, "  Multipart: cmd %02X sent, %u. octets in %u. fragments (%u. resent) in %llu usec\n",
+        oo_mpart_out.command, oo_mpart_out.total, oo_mpart_out.fragments, oo_mpart_out.resends, elapsed);
+    oo_mpart_out.fragments = 0;
+    oo_mpart_out.current = 0;
+  };
+
+} /* oo_mpart_finish */
+
+
+/*
+  oo_mpart_log_summary - outbound multipart timing, to the log
+*/
+
+void
+  oo_mpart_log_summary
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_mpart_log_summary */
+
+  OSDP_LATENCY_HISTOGRAM *h;
+  int j;
+  char tlogmsg [1024];
+
+
+  for (j=0; j<2; j++)
+  {
+    h = &(oo_mpart_stats.send);
+    if (j EQUALS 1)
+      h = &(oo_mpart_stats.transaction);
+    if (h->count > 0)
+    {
+      sprintf (tlogmsg,
+" Multipart %-11s n %6u min %7llu p50 %7llu p90 %7llu p99 %7llu max %7llu usec\n",
+        (j EQUALS 0) ? "send" : "transaction",
+        h->count, h->min_usec,
+        oo_latency_percentile (h, 50), oo_latency_percentile (h, 90),
+        oo_latency_percentile (h, 99), h->max_usec);
+      (void) oosdp_log (ctx, OSDP_LOG_STRING | OSDP_LOG_NOTIMESTAMP, 1, tlogmsg);
+    };
+  };
+  if (oo_mpart_stats.transactions > 0)
+  {
+    sprintf (tlogmsg, " Multipart %u. transactions, %u. fragments, %u. resent\n",
+      oo_mpart_stats.transactions, oo_mpart_stats.fragments, oo_mpart_stats.resends);
+    (void) oosdp_log (ctx, OSDP_LOG_STRING | OSDP_LOG_NOTIMESTAMP, 1, tlogmsg);
+  };
+
+} /* oo_mpart_log_summary */
+
+
+/*
+  oo_mpart_poll - ACU: ask for the next fragment of a multipart reply now
+
+  only when normal polling is on; a fleet transfer does its own polling.
+*/
+
+int
+  oo_mpart_poll
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_mpart_poll */
+
+  int current_length;
+  unsigned char sec_blk [1];
+  int status;
+
+
+  status = ST_OK;
+  if ((ctx->role EQUALS OSDP_ROLE_ACU) && (ctx->enable_poll EQUALS OO_POLL_ENABLED) &&
+    !oo_fleet_active ())
+  {
+    current_length = 0;
+    if (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
+    {
+      sec_blk [0] = 0;
+      status = send_secure_message (ctx, OSDP_POLL, p_card.addr,
+        &current_length, 0, NULL, OSDP_SEC_SCS_15, 0, sec_blk);
+    }
+    else
+    {
+      status = send_message_ex (ctx, OSDP_POLL, p_card.addr, &current_length,
+        0, NULL, OSDP_SEC_SCS_17, 0, NULL);
+    };
+  };
+  return (status);
+
+} /* oo_mpart_poll */
+
+
+/*
+  oo_mpart_receive - add one fragment of a multipart command or reply
+
+  *whole is set once the last missing octets arrive.  the caller processes
+  whole->buffer (whole->total octets) and then calls oo_mpart_release.
+  until then *whole is NULL and the fragment is simply accepted.
+*/
+
+int
+  oo_mpart_receive
+    (OSDP_CONTEXT *ctx,
+    int pd,
+    OSDP_MSG *msg,
+    OO_MPART **whole)
+
+{ /* oo_mpart_receive */
+
+  int conflict;
+  unsigned long long elapsed;
+  unsigned int fresh;
+  unsigned int fragment_length;
+  OSDP_MULTI_HDR_IEC *hdr;
+  int i;
+  OO_MPART *m;
+  struct timespec now;
+  unsigned int o;
+  unsigned int offset;
+  unsigned char *payload;
+  int status;
+  unsigned int total;
+
+
+  status = ST_OK;
+  *whole = NULL;
+  m = NULL;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  oo_mpart_expire(ctx, &now);
+
+  hdr = (OSDP_MULTI_HDR_IEC *)(msg->data_payload);
+  payload = &(hdr->algo_payload);
+  total = hdr->total_msb*256 + hdr->total_lsb;
+  offset = hdr->offset_msb*256 + hdr->offset_lsb;
+  fragment_length = hdr->data_len_msb*256 + hdr->data_len_lsb;
+  if (msg->data_length < (int)(sizeof(*hdr) - 1))
+    status = ST_OSDP_MULTIPART_HEADER;
+  if (status EQUALS ST_OK)
+  {
+    if ((total EQUALS 0) || ((offset + fragment_length) > total) ||
+      (fragment_length > (msg->data_length - (sizeof(*hdr) - 1))))
+      status = ST_OSDP_MULTIPART_HEADER;
+  };
+  if (status != ST_OK)
+    fprintf(ctx->log, "  Multipart: PD %02X cmd %02X bad header (total %u. offset %u. length %u. in %d.)\n",
+      pd, msg->msg_cmd, total, offset, fragment_length, msg->data_length);
+
+  // the PD answers the last fragment of a command with the first of its reply, not an ACK
+
+  if ((status EQUALS ST_OK) && (ctx->role EQUALS OSDP_ROLE_ACU) && oo_mpart_sending(ctx))
+  {
+    if (ctx->last_command_sent EQUALS oo_mpart_out.command)
+    {
+      oo_mpart_out.current ++;
+      oo_mpart_finish(ctx);
+    };
+  };
+
+  // find the transaction.  a different total means the sender started over.
+
+  if (status EQUALS ST_OK)
+  {
+    for (i=0; i<OO_MPART_POOL; i++)
+      if ((oo_mpart_pool [i].state EQUALS OO_MPART_RECEIVING) &&
+        (oo_mpart_pool [i].pd EQUALS pd) && (oo_mpart_pool [i].command EQUALS msg->msg_cmd))
+        m = &(oo_mpart_pool [i]);
+    if (m != NULL)
+      if (m->total != total)
+      {
+        fprintf(ctx->log, "  Multipart: PD %02X cmd %02X restarted (total was %u. now %u.)\n",
+          pd, m->command, m->total, total);
+        m->state = OO_MPART_IDLE;
+        m = NULL;
+      };
+    if (m EQUALS NULL)
+    {
+      for (i=0; (i<OO_MPART_POOL) && (m EQUALS NULL); i++)
+        if (oo_mpart_pool [i].state EQUALS OO_MPART_IDLE)
+          m = &(oo_mpart_pool [i]);
+      if (m EQUALS NULL)
+      {
+        fprintf(ctx->log, "  Multipart: no free slot for PD %02X cmd %02X\n", pd, msg->msg_cmd);
+        status = ST_BAD_MULTIPART_BUF;
+      }
+      else
+      {
+        m->state = OO_MPART_RECEIVING;
+        m->pd = pd;
+        m->command = msg->msg_cmd;
+        m->total = total;
+        m->have = 0;
+        m->fragments = 0;
+        m->duplicates = 0;
+        memset(m->map, 0, (total+7)/8);
+      };
+    };
+  };
+
+  // take whatever is new.  octets already here must match.
+
+  if (status EQUALS ST_OK)
+  {
+    conflict = 0;
+    fresh = 0;
+    for (o=offset; o<(offset+fragment_length); o++)
+    {
+      if (m->map [o/8] & (1 << (o%8)))
+      {
+        if (m->buffer [o] != payload [o-offset])
+          conflict = 1;
+      }
+      else
+      {
+        m->buffer [o] = payload [o-offset];
+        m->map [o/8] = m->map [o/8] | (1 << (o%8));
+        fresh ++;
+      };
+    };
+    m->last_fragment = now;
+    m->fragments ++;
+    m->have = m->have + fresh;
+    if (conflict)
+    {
+      fprintf(ctx->log, "  Multipart: PD %02X cmd %02X fragment at %u. conflicts with data already received, dropped\n",
+        pd, m->command, offset);
+      m->state = OO_MPART_IDLE;
+      status = ST_OSDP_MULTIPART_CONFLICT;
+    }
+    else
+    {
+      if ((fresh EQUALS 0) && (fragment_length > 0))
+        m->duplicates ++;
+      if (ctx->verbosity > 3)
+        fprintf(ctx->log, "  Multipart: PD %02X cmd %02X offset %u. length %u. now %u. of %u.%s\n",
+          pd, m->command, offset, fragment_length, m->have, m->total,
+          ((fresh EQUALS 0) && (fragment_length > 0)) ? " (duplicate)" : "");
+      if (m->have EQUALS m->total)
+      {
+        if (ctx->verbosity > 2)
+          fprintf(ctx->log, "  Multipart: PD %02X cmd %02X complete, %u. octets in %u. fragments, %u. duplicates\n",
+            pd, m->command, m->total, m->fragments, m->duplicates);
+        m->state = OO_MPART_COMPLETE;
+        *whole = m;
+
+        // on the ACU this is the answer to what was sent
+        if ((ctx->role EQUALS OSDP_ROLE_ACU) && oo_mpart_out.awaiting_reply)
+        {
+          oo_mpart_out.awaiting_reply = 0;
+          elapsed = oo_latency_elapsed (&(oo_mpart_out.started), &now);
+          oo_latency_record (&(oo_mpart_stats.transaction), elapsed);
+          if (ctx->verbosity > 2)
+            fprintf(ctx->log, "  Multipart: cmd %02X answered in %llu usec\n",
+              oo_mpart_out.command, elapsed);
+        };
+      };
+    };
+  };
+  return (status);
+
+} /* oo_mpart_receive */
+
+
+void
+  oo_mpart_release
+    (OO_MPART *mpart)
+
+{ /* oo_mpart_release */
+
+  if (mpart != NULL)
+    mpart->state = OO_MPART_IDLE;
+
+} /* oo_mpart_release */
+
+
+/*
+  oo_mpart_send_fragment - send the current fragment straight out of the plan
+
+  the PD moves on as soon as it's sent; the ACU waits for the ACK.
+*/
+
+static int
+  oo_mpart_send_fragment
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_mpart_send_fragment */
+
+  int current_length;
+  unsigned int fragment_length;
+  unsigned char *fragment;
+  unsigned int offset;
+  int status;
+
+
+  offset = oo_mpart_out.current * oo_mpart_out.fragment_size;
+  fragment_length = oo_mpart_out.total - offset;
+  if (fragment_length > oo_mpart_out.fragment_size)
+    fragment_length = oo_mpart_out.fragment_size;
+  fragment = oo_mpart_out.plan +
+    oo_mpart_out.current * (sizeof(OSDP_MULTI_HDR_IEC) - 1 + oo_mpart_out.fragment_size);
+
+  current_length = 0;
+  status = send_message_ex(ctx, oo_mpart_out.command, p_card.addr, &current_length,
+    sizeof(OSDP_MULTI_HDR_IEC) - 1 + fragment_length, fragment, oo_mpart_out.security, 0, NULL);
+  if (ctx->role EQUALS OSDP_ROLE_PD)
+    oo_mpart_out.current ++;
+  return (status);
+
+} /* oo_mpart_send_fragment */
+
+
+/*
+  oo_mpart_send - send payload as a multipart command (ACU) or reply (PD)
+
+  the first fragment goes now.  the rest follow from oo_mpart_send_next.
+*/
+
+int
+  oo_mpart_send
+    (OSDP_CONTEXT *ctx,
+    int command,
+    unsigned char *payload,
+    int payload_length)
+
+{ /* oo_mpart_send */
+
+  unsigned int fragment_length;
+  OSDP_MULTI_HDR_IEC *hdr;
+  unsigned int i;
+  int message_max;
+  unsigned int offset;
+  int room;
+  int status;
+
+
+  status = ST_OK;
+  if ((payload_length < 1) || (payload_length > OO_MPART_OCTETS_MAX))
+    status = ST_OSDP_UNSUPPORTED_AUTH_PAYLOAD;
+  if (status EQUALS ST_OK)
+  {
+    // the fragment has to fit the other side's message size, less framing and the multipart header
+
+    message_max = OO_MPART_MESSAGE_DEFAULT;
+    if ((ctx->role EQUALS OSDP_ROLE_ACU) && (ctx->max_message > 0))
+      message_max = ctx->max_message;
+    if (message_max > OSDP_OFFICIAL_MSG_MAX)
+      message_max = OSDP_OFFICIAL_MSG_MAX;
+    room = message_max - (1+1+2+1+1+2); // SOM, Addr, Len, CTL, command, CRC
+
+    // in secure channel leave room for the security block and MAC, and the
+    // payload is padded to whole AES blocks with at least one octet of padding.
+
+    if (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
+    {
+      room = room - (2+4);
+      room = ((room / OSDP_KEY_OCTETS) * OSDP_KEY_OCTETS) - 1;
+    };
+    room = room - (sizeof(OSDP_MULTI_HDR_IEC) - 1);
+    if (room < OO_MPART_FRAGMENT_MIN)
+      status = ST_OSDP_UNSUPPORTED_AUTH_PAYLOAD;
+  };
+  if (status EQUALS ST_OK)
+  {
+    memset(&oo_mpart_out, 0, sizeof(oo_mpart_out) - sizeof(oo_mpart_out.plan));
+    oo_mpart_out.command = command;
+    oo_mpart_out.security = OSDP_SEC_SCS_17;
+    if (ctx->role EQUALS OSDP_ROLE_PD)
+      oo_mpart_out.security = OSDP_SEC_SCS_18;
+    oo_mpart_out.total = payload_length;
+    oo_mpart_out.fragment_size = room;
+    oo_mpart_out.fragments = (payload_length + room - 1) / room;
+
+    // lay out every fragment now.  fragment i starts at i*(header+fragment_size) in the plan.
+
+    for (i=0; i<oo_mpart_out.fragments; i++)
+    {
+      offset = i * oo_mpart_out.fragment_size;
+      fragment_length = oo_mpart_out.total - offset;
+      if (fragment_length > oo_mpart_out.fragment_size)
+        fragment_length = oo_mpart_out.fragment_size;
+      hdr = (OSDP_MULTI_HDR_IEC *)(oo_mpart_out.plan +
+        i * (sizeof(*hdr) - 1 + oo_mpart_out.fragment_size));
+      hdr->total_lsb = oo_mpart_out.total & 0xff;
+      hdr->total_msb = (oo_mpart_out.total & 0xff00) >> 8;
+      hdr->offset_lsb = offset & 0xff;
+      hdr->offset_msb = (offset & 0xff00) >> 8;
+      hdr->data_len_lsb = fragment_length & 0xff;
+      hdr->data_len_msb = (fragment_length & 0xff00) >> 8;
+      memcpy(&(hdr->algo_payload), payload+offset, fragment_length);
+    };
+    oo_mpart_out.awaiting_reply = (ctx->role EQUALS OSDP_ROLE_ACU);
+    oo_mpart_stats.transactions ++;
+    clock_gettime(CLOCK_MONOTONIC, &(oo_mpart_out.started));
+    if (ctx->verbosity > 3)
+      fprintf(ctx->log, "  Multipart: sending cmd %02X, %d. octets in %u. fragments of %u.\n",
+        command, payload_length, oo_mpart_out.fragments, oo_mpart_out.fragment_size);
+    status = oo_mpart_send_fragment(ctx);
+    oo_mpart_finish(ctx);
+  };
+  return (status);
+
+} /* oo_mpart_send */
+
+
+/*
+  oo_mpart_send_next - carry on with the payload being sent
+
+  the ACU calls this when an ACK arrives, the PD when it's polled.
+*/
+
+int
+  oo_mpart_send_next
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_mpart_send_next */
+
+  int status;
+
+
+  status = ST_OK;
+  if (oo_mpart_sending(ctx))
+  {
+    // the ACU moves on only when the ACK is for the fragment itself
+
+    if (ctx->role EQUALS OSDP_ROLE_ACU)
+    {
+      if (ctx->last_command_sent EQUALS oo_mpart_out.command)
+        oo_mpart_out.current ++;
+      else
+        oo_mpart_out.resends ++;
+    };
+    if (oo_mpart_out.current < oo_mpart_out.fragments)
+      status = oo_mpart_send_fragment(ctx);
+  };
+  oo_mpart_finish(ctx);
+  return (status);
+
+} /* oo_mpart_send_next */
+
+
+int
+  oo_mpart_sending
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_mpart_sending */
+
+  return (oo_mpart_out.current < oo_mpart_out.fragments);
+
+} /* oo_mpart_sending */
+
+
+/*
+  oo_mpart_write_status - add the outbound multipart timing to the status file
+
+  emits a "multipart" member (followed by a comma) into the open JSON object.
+*/
+
+void
+  oo_mpart_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_mpart_write_status */
+
+  OSDP_LATENCY_HISTOGRAM *h;
+  int j;
+
+
+  fprintf (sf, "\"multipart\" : { \"transactions\" : \"%u\", \"fragments\" : \"%u\", \"resends\" : \"%u\"",
+    oo_mpart_stats.transactions, oo_mpart_stats.fragments, oo_mpart_stats.resends);
+  for (j=0; j<2; j++)
+  {
+    h = &(oo_mpart_stats.send);
+    if (j EQUALS 1)
+      h = &(oo_mpart_stats.transaction);
+    fprintf (sf,
+",\n  \"%s\" : { \"count\" : \"%u\", \"min\" : \"%llu\", \"max\" : \"%llu\", \"total\" : \"%llu\", \"p50\" : \"%llu\", \"p99\" : \"%llu\" }",
+      (j EQUALS 0) ? "send" : "transaction",
+      h->count, h->min_usec, h->max_usec, h->total_usec,
+      oo_latency_percentile (h, 50), oo_latency_percentile (h, 99));
+  };
+  fprintf (sf, " },\n");
+
+} /* oo_mpart_write_status */
@@ -0,0 +1,177 @@
+/*
+  oo-osdpcap - read osdpcap (v1) capture records
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  a capture can hold millions of records so lines are picked apart by hand
+  rather than with jansson.  osdpcap v1 is one flat JSON object per line
+  and that is all this understands.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+
+
+#include <open-osdp.h>
+#include <osdpcap.h>
+
+
+/*
+  oo_osdpcap_field - find "tag" : in a record and return what follows, past any opening quote
+*/
+
+static char *
+  oo_osdpcap_field
+    (char *line,
+    char *field_tag)
+
+{ /* oo_osdpcap_field */
+
+  char *p;
+  int tag_length;
+
+
+  tag_length = strlen (field_tag);
+  p = line;
+  while ((p = strchr (p, '"')) != NULL)
+  {
+    p++;
+    if ((strncmp (p, field_tag, tag_length) EQUALS 0) && (p [tag_length] EQUALS '"'))
+    {
+      p = p + tag_length + 1;
+      while ((*p EQUALS ' ') || (*p EQUALS '\t') || (*p EQUALS ':'))
+        p++;
+      if (*p EQUALS '"')
+        p++;
+      return (p);
+    };
+
+    // step over the rest of this string so a value is never taken for a tag
+
+    p = strchr (p, '"');
+    if (p EQUALS NULL)
+      break;
+    p++;
+  };
+  return (NULL);
+
+} /* oo_osdpcap_field */
+
+
+static long long
+  oo_osdpcap_number
+    (char *p)
+
+{ /* oo_osdpcap_number */
+
+  long long value;
+
+
+  value = 0;
+  if (p != NULL)
+    while ((*p >= '0') && (*p <= '9'))
+    {
+      value = 10*value + (*p - '0');
+      p++;
+    };
+  return (value);
+
+} /* oo_osdpcap_number */
+
+
+static int
+  oo_osdpcap_nibble
+    (char c)
+
+{ /* oo_osdpcap_nibble */
+
+  if ((c >= '0') && (c <= '9'))
+    return (c - '0');
+  if ((c >= 'a') && (c <= 'f'))
+    return (10 + c - 'a');
+  if ((c >= 'A') && (c <= 'F'))
+    return (10 + c - 'A');
+  return (-1);
+
+} /* oo_osdpcap_nibble */
+
+
+/*
+  oo_osdpcap_parse - one line of a capture into a record
+
+  returns ST_OSDPCAP_BAD_RECORD if there's no data or it isn't hex.
+  the octets before the bad one are still in the record.
+*/
+
+int
+  oo_osdpcap_parse
+    (char *line,
+    OSDPCAP_RECORD *record)
+
+{ /* oo_osdpcap_parse */
+
+  int hi;
+  int lo;
+  char *p;
+  int status;
+
+
+  status = ST_OK;
+  record->length = 0;
+  record->captured.tv_sec = oo_osdpcap_number (oo_osdpcap_field (line, OSDPCAP_TAG_TIME_SEC));
+  record->captured.tv_nsec = oo_osdpcap_number (oo_osdpcap_field (line, OSDPCAP_TAG_TIME_NSEC));
+  record->io = OSDPCAP_IO_UNKNOWN;
+  p = oo_osdpcap_field (line, OSDPCAP_TAG_INPUT_OUTPUT);
+  if (p != NULL)
+  {
+    if (strncmp (p, "in", 2) EQUALS 0)
+      record->io = OSDPCAP_IO_IN;
+    if (strncmp (p, "out", 3) EQUALS 0)
+      record->io = OSDPCAP_IO_OUT;
+    if (strncmp (p, "trace", 5) EQUALS 0)
+      record->io = OSDPCAP_IO_TRACE;
+  };
+  p = oo_osdpcap_field (line, OSDPCAP_TAG_DATA);
+  if (p EQUALS NULL)
+    status = ST_OSDPCAP_BAD_RECORD;
+  while ((status EQUALS ST_OK) && (*p != 0) && (*p != '"'))
+  {
+    if (*p EQUALS ' ')
+    {
+      p++;
+      continue;
+    };
+    hi = oo_osdpcap_nibble (p [0]);
+    lo = -1;
+    if (hi >= 0)
+      lo = oo_osdpcap_nibble (p [1]);
+    if ((lo < 0) || (record->length >= OSDPCAP_RECORD_MAX))
+      status = ST_OSDPCAP_BAD_RECORD;
+    if (status EQUALS ST_OK)
+    {
+      record->octets [record->length] = (hi << 4) | lo;
+      record->length ++;
+      p = p + 2;
+    };
+  };
+  return (status);
+
+} /* oo_osdpcap_parse */
@@ -108,6 +108,10 @@ int
       msg_lth = p->len_lsb + (256*p->len_msb);
       if (msg_lth > OSDP_OFFICIAL_MSG_MAX)
         status = ST_MSG_TOO_LONG;
+
+      // a length too short to hold the header would never be consumed and would wedge the buffer
+      if (msg_lth < (m->check_size+sizeof (OSDP_HDR)))
+        status = ST_MSG_BAD_SOM;
       if (status EQUALS ST_OK)
       {
         hashable_length = msg_lth;
@@ -142,6 +146,24 @@ int
     if (p->som != C_SOM)
       status = ST_MSG_BAD_SOM;
   };
+  if ((status EQUALS ST_OK) && ((p->ctrl) & 0x08))
+  {
+    int mac_length;
+
+    // the security block, the command, the MAC (if there is one) and the check all have to fit in the frame
+
+    sec_blk_length = (unsigned)*(m->ptr + 5);
+    sec_block_type = (unsigned)*(m->ptr + 6);
+    mac_length = 0;
+    if ((sec_block_type >= OSDP_SEC_SCS_15) && (sec_block_type <= OSDP_SEC_SCS_18))
+      mac_length = 4;
+    if ((sec_blk_length < 2) || ((5 + sec_blk_length + 1 + mac_length + m->check_size) > msg_lth))
+    {
+      fprintf (context->log, "security block does not fit: length %d. type %02x frame %d.\n",
+        sec_blk_length, sec_block_type, msg_lth);
+      status = ST_OSDP_SEC_BLOCK_LENGTH;
+    };
+  };
   if (status EQUALS ST_OK)
   {
     // first few fields are always in same place
@@ -155,7 +177,7 @@ int
     msg_sqn = (p->ctrl) & 0x03;
 
     m->sequence = msg_sqn;
-    if (context->verbosity > 9)
+    if (OO_LOG_ON (context, OO_LOG_PARSE, 10))
     {
       if (m->sequence EQUALS 0)
         fprintf(stderr, "DEBUG: sequence was zero\n");
@@ -173,24 +195,6 @@ int
     }
     else
     {
-      tlogmsg[0] = 0;
-      sprintf(tlogmsg2, "Msg (Secure): ");
-      strcat(tlogmsg, tlogmsg2);
-      for (i=0; i<16; i++)
-      {
-        sprintf(tlogmsg2, "%02x", (m->ptr)[i]);
-        strcat(tlogmsg, tlogmsg2);
-        if (3 == (i % 4))
-          if (i != 15)
-          {
-            sprintf(tlogmsg2, "-");
-            strcat(tlogmsg, tlogmsg2);
-          };
-      };
-      strcat(tlogmsg, "\n");
-      tlogmsg [0] = 0;
-      tlogmsg2 [0] = 0;
-
       // packet is SOM, ADDR, LEN_LSB, LEN_MSB, CTRL (5 bytes) and then...
 
       // sec_blk_length -
@@ -217,8 +221,6 @@ int
 
       // whole thing less 5 hdr less 1 cmd less sec blk less 2 crc
       msg_data_length = msg_data_length - 6 - sec_blk_length - 2;
-
-      fflush (stdout);fflush (stderr);
     };
 
     // extract the command
@@ -234,13 +236,19 @@ fflush(context->log);
     m->data_payload = m->cmd_payload + 1;
 
     // if it wasn't a poll or an ack report the secure header if there is one
-    if ((m->msg_cmd != OSDP_POLL) && (m->msg_cmd != OSDP_ACK))
-      fprintf (context->log, "%s", tlogmsg);
+    if (msg_scb && OO_LOG_ON (context, OO_LOG_SECURE, 10) &&
+      (m->msg_cmd != OSDP_POLL) && (m->msg_cmd != OSDP_ACK))
+    {
+      fprintf (context->log, "Msg (Secure): ");
+      for (i=0; i<16; i++)
+        fprintf (context->log, "%02x%s", (m->ptr)[i], ((3 == (i % 4)) && (i != 15)) ? "-" : "");
+      fprintf (context->log, "\n");
+    };
 
     // display it.  Unless it's a poll/ack or filetransfer/ftstat.  or verbosity is high enough.
 
     display = 0;
-    if (context->verbosity > 4)
+    if (OO_LOG_ON (context, OO_LOG_PARSE, 5))
       display = 1;
     if ((m->msg_cmd != OSDP_POLL) && (m->msg_cmd != OSDP_ACK))
     {
@@ -271,7 +279,7 @@ fflush(context->log);
 if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
   display = 1;
 
-    if (context->verbosity > 9)
+    if (OO_LOG_ON (context, OO_LOG_SECURE, 10))
     {
       if (p->ctrl & 0x08)
       {
@@ -286,7 +294,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
     {
       if ((m->msg_cmd != OSDP_POLL) && (m->msg_cmd != OSDP_ACK))
         display = 1;
-      if (context->verbosity > 3)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
         display = 1;
     };
     if (display)
@@ -364,7 +372,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
           "***Status %d Unknown command? (%02x), default msg_data_length was %d\n",
           status, returned_hdr->command, msg_data_length);
 
-    if (context->verbosity > 8)
+    if (OO_LOG_ON (context, OO_LOG_PARSE, 9))
     {
       fprintf(context->log, "osdp_parse_message: command %02x\n", returned_hdr->command);
     };
@@ -377,7 +385,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
         // it's not for another PD
         m->data_payload = m->cmd_payload + 1;
         msg_data_length = 0;
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
           strcpy (tlogmsg2, "\?\?\?");
 
         // if we don't recognize the command/reply code it fails 2-15-1
@@ -389,7 +397,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_ACURXSIZE");
       osdp_test_set_status(OOC_SYMBOL_cmd_acurxsize, OCONFORM_EXERCISED);
       break;
@@ -398,7 +406,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_BIOMATCH");
       osdp_test_set_status(OOC_SYMBOL_cmd_biomatch, OCONFORM_EXERCISED);
       break;
@@ -407,7 +415,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_BIOREAD");
       osdp_test_set_status(OOC_SYMBOL_cmd_bioread, OCONFORM_EXERCISED);
       break;
@@ -415,7 +423,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
     case OSDP_BUSY:
       m->data_payload = NULL;
       msg_data_length = 0;
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_BUSY");
       osdp_test_set_status(OOC_SYMBOL_resp_busy, OCONFORM_EXERCISED);
       break;
@@ -424,7 +432,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_FTSTAT");
       break;
 
@@ -432,7 +440,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_NAK");
       break;
 
@@ -440,7 +448,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_BUZ");
       break;
 
@@ -448,7 +456,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_CAP");
       break;
 
@@ -456,14 +464,14 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_COM");
       break;
 
     case OSDP_COMSET:
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = 5;
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_COMSET");
       break;
 
@@ -471,14 +479,14 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_ID");
       break;
 
     case OSDP_ISTAT:
       m->data_payload = NULL;
       msg_data_length = 0;
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_ISTAT");
       break;
 
@@ -486,7 +494,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_ISTATR");
       break;
 
@@ -494,7 +502,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_KEEEPACTIVE");
       break;
 
@@ -502,7 +510,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_KEYPAD");
       break;
 
@@ -510,7 +518,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_LED");
       break;
 
@@ -518,7 +526,7 @@ if (m->msg_cmd EQUALS OSDP_FILETRANSFER)
 fprintf(stderr, "lstat 1000\n");
       m->data_payload = NULL;
       msg_data_length = 0;
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_LSTAT");
       break;
 
@@ -526,7 +534,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_LSTATR");
       break;
 
@@ -534,7 +542,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_MFGERRR");
       break;
 
@@ -543,14 +551,14 @@ fprintf(stderr, "lstat 1000\n");
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6;
       msg_data_length = msg_data_length - m->check_size; // 1 for checksum 2 for CRC
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_MFGREP");
       break;
 
     case OSDP_OSTAT:
       m->data_payload = NULL;
       msg_data_length = 0;
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_OSTAT");
       break;
 
@@ -558,7 +566,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_OSTATR");
       break;
 
@@ -566,7 +574,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_OUT");
       break;
 
@@ -574,7 +582,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_PDCAP");
       osdp_test_set_status(OOC_SYMBOL_cmd_cap, OCONFORM_EXERCISED);
       osdp_test_set_status(OOC_SYMBOL_rep_device_capas, OCONFORM_EXERCISED);
@@ -585,7 +593,7 @@ fprintf(stderr, "lstat 1000\n");
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
 
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_PDID");
 
       // if we had sent an osdp_ID then that worked.
@@ -597,7 +605,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_PIVDATA");
       osdp_test_set_status(OOC_SYMBOL_cmd_pivdata, OCONFORM_EXERCISED);
       break;
@@ -606,7 +614,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_PIVDATAR");
 //      osdp_test_set_status(OOC_SYMBOL_resp_pivdatar, OCONFORM_EXERCISED);
       break;
@@ -615,14 +623,14 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_RAW");
       break;
 
     case OSDP_RSTAT:
       m->data_payload = NULL;
       msg_data_length = 0;
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_RSTAT");
       break;
 
@@ -635,7 +643,7 @@ fprintf(stderr, "lstat 1000\n");
       // if this is in response to an RSTAT then mark that too.
       if (context->last_command_sent EQUALS OSDP_RSTAT)
         osdp_test_set_status(OOC_SYMBOL_cmd_rstat, OCONFORM_EXERCISED);
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_RSTATR");
       break;
 
@@ -643,7 +651,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_TEXT");
       break;
 
@@ -651,7 +659,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_XRD");
       break;
 
@@ -659,7 +667,7 @@ fprintf(stderr, "lstat 1000\n");
       m->data_payload = m->cmd_payload + 1;
       msg_data_length = p->len_lsb + (p->len_msb << 8);
       msg_data_length = msg_data_length - 6 - 2; // less hdr,cmnd, crc/chk
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         strcpy (tlogmsg2, "osdp_XWR");
       break;
     };
@@ -721,7 +729,7 @@ fprintf(stderr, "lstat 1000\n");
 
       if ((parsed_crc != wire_crc) || (m_check EQUALS OSDP_CHECKSUM))
       {
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         {
           fprintf(context->log, "Bad CRC: Got %04x Expected %04x\n",
             wire_crc, parsed_crc);
@@ -753,7 +761,7 @@ fprintf(stderr, "lstat 1000\n");
 
       wire_cksum = (unsigned char)*(m->lth -1 + m->ptr);
 
-      if (context->verbosity > 99)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 100))
       {
         fprintf (stderr, "pck %04x wck %04x\n",
           parsed_cksum, wire_cksum);
@@ -796,7 +804,7 @@ status = ST_OK; // tolerate checksum error and continue
       if (!rcv_seq)
         rcv_seq = 1;
 
-      if (context->verbosity > 9)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 10))
         fprintf(stderr, "DEBUG: wire seq %d. rcv seq %d. next seq %d.\n",
           wire_sequence, rcv_seq, context->next_sequence);
       bad = 0;
@@ -826,15 +834,21 @@ status = ST_OK; // tolerate checksum error and continue
         {
           if (wire_sequence != 0)
           {
-fprintf(context->log,
-"DEBUG: bad seq bcount %d 0=%02x 1=%02x 2=%02x 5=%02x 6=%02x\n",
-            osdp_buf.next,
-            osdp_buf.buf [0], osdp_buf.buf [1], osdp_buf.buf [2],
-            osdp_buf.buf [5], osdp_buf.buf [6]);
-
-            fprintf(context->log, "***sequence number mismatch got %d expected %d\n", msg_sqn, context->next_sequence);
+            if (context->event_log != NULL)
+              (void) oo_eventlog (context, OO_EVLOG_SEQUENCE, "ubbbbbbb",
+                osdp_buf.next, osdp_buf.buf [0], osdp_buf.buf [1], osdp_buf.buf [2],
+                osdp_buf.buf [5], osdp_buf.buf [6], msg_sqn, context->next_sequence);
+            else
+            {
+              fprintf(context->log,
+                "DEBUG: bad seq bcount %d 0=%02x 1=%02x 2=%02x 5=%02x 6=%02x\n",
+                osdp_buf.next,
+                osdp_buf.buf [0], osdp_buf.buf [1], osdp_buf.buf [2],
+                osdp_buf.buf [5], osdp_buf.buf [6]);
+              fprintf(context->log, "***sequence number mismatch got %d expected %d\n", msg_sqn, context->next_sequence);
+            };
             status = ST_OSDP_BAD_SEQUENCE;
-            if (context->verbosity > 3)
+            if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
               fprintf(stderr, "nak bad seq: wire addr %d my addr %d %d\n", p->addr, p_card.addr, context->pd_address);
             context->seq_bad++;
 
@@ -851,7 +865,7 @@ fprintf(context->log,
     {
       if ((p_card.addr != (0x7f & p->addr)) && (p->addr != OSDP_CONFIGURATION_ADDRESS))
       {
-        if (context->verbosity > 3)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
           fprintf (stderr, "addr mismatch for: %02x me: %02x\n",
             p->addr, p_card.addr);
         status = ST_NOT_MY_ADDR;
@@ -879,14 +893,27 @@ fprintf(context->log,
         };
         if (status != ST_OK)
         {
-          if (context->verbosity > 3)
-            fprintf(context->log,
-              "  ..Secure Channel Hash check failed (%d).\n", status);
+          OO_LOG (context, OO_LOG_SECURE, 4,
+            "  ..Secure Channel Hash check failed (%d).\n", status);
         };
       }; 
     };
 
-    if ((context->verbosity > 2) || (m_dump > 0))
+    // with an event log every frame is recorded as it came, at any verbosity, and not formatted
+
+    if (context->event_log != NULL)
+    {
+      int crc_offset;
+
+      crc_offset = m->crc_check - m->ptr;
+      if ((crc_offset < 0) || (crc_offset + 1 >= m->lth))
+        crc_offset = 0;
+      (void) oo_eventlog (context, OO_EVLOG_MESSAGE, "ubbbhhx",
+        context->packets_received, returned_hdr->command, m->direction, m_dump,
+        crc_offset, *(1+m->ptr+crc_offset) << 8 | *(m->ptr+crc_offset), m->ptr, m->lth);
+    }
+    else
+    if ((OO_LOG_ON (context, OO_LOG_PARSE, 3)) || (m_dump > 0))
     {
       char cmd_rep_tag [1024];
       char log_line [3*1024]; // 'cause contents could be 1k already
@@ -900,12 +927,11 @@ fprintf(context->log,
       (void)oosdp_message_header_print(context, m, tlogmsg);
       if (((returned_hdr->command != OSDP_POLL) &&
         (returned_hdr->command != OSDP_ACK)) ||
-        (context->verbosity > 3))
+        (OO_LOG_ON (context, OO_LOG_PARSE, 4)))
       {
         fprintf (context->log, "%s\n", tlogmsg);
         tlogmsg [0] = 0;
-        if (context->verbosity > 3)
-          dump_buffer_log(context, "  Raw input: ", m->ptr, m->lth);
+        OO_LOG_DUMP (context, OO_LOG_PARSE, 4, "  Raw input: ", m->ptr, m->lth);
       };
 
       sprintf (log_line, "  Pkt %04d Msg %s %s", context->packets_received, cmd_rep_tag, tlogmsg);
@@ -931,7 +957,7 @@ fprintf(context->log,
       strcat (log_line, tlogmsg2);
       if (((returned_hdr->command != OSDP_POLL) &&
         (returned_hdr->command != OSDP_ACK)) ||
-        (context->verbosity > 3))
+        (OO_LOG_ON (context, OO_LOG_PARSE, 4)))
       {
         fprintf (context->log, "%s\n", log_line);
         fflush (context->log);
@@ -950,7 +976,7 @@ fprintf(context->log,
     if (context->role EQUALS OSDP_ROLE_PD)
     {
       // for the PD, go ahead and dump the trace buffers now.
-      if (context->verbosity > 3)
+      if (OO_LOG_ON (context, OO_LOG_IO, 4))
         osdp_trace_dump(context, 1);
       else
         osdp_trace_dump(context, 0);
@@ -958,18 +984,17 @@ fprintf(context->log,
     if (context->role EQUALS OSDP_ROLE_MONITOR)
     {
       int i;
-      char temps [4096];
-      char octet_string [1024];
+      char *t;
 
-      temps[0] = 0;
-      for (i=0; i<m->lth; i++)
+      // the frame in hex is only wanted for the trace
+      if (context->trace & 1)
       {
-        sprintf(octet_string, " %02x", *(m->ptr+i));
-        strcat(temps, octet_string);
+        t = trace_in_buffer;
+        for (i=0; (i<m->lth) && (i<OSDP_OFFICIAL_MSG_MAX); i++)
+          t = t + sprintf(t, " %02x", *(m->ptr+i));
+        *t = 0;
       };
-      if (context->trace & 1)
-        strcpy(trace_in_buffer, temps);
-      if (context->verbosity > 3)
+      if (OO_LOG_ON (context, OO_LOG_IO, 4))
         osdp_trace_dump(context, 1);
       else
         osdp_trace_dump(context, 0);
@@ -984,7 +1009,7 @@ fprintf(context->log,
 
   if (status EQUALS ST_OSDP_BAD_SEQUENCE)
   {
-    if (context->verbosity > 3)
+    if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
       fprintf(context->log, "  ...accepting bad sequence as a response\n");
     context->last_was_processed = 1;
   };
@@ -995,7 +1020,7 @@ fprintf(context->log,
     (status != ST_NOT_MY_ADDR))
   {
     // if parse failed report the status code
-    if ((context->verbosity > 3) && (status != ST_MONITOR_ONLY))
+    if ((OO_LOG_ON (context, OO_LOG_PARSE, 4)) && (status != ST_MONITOR_ONLY))
     {
       fflush (context->log);
       fprintf (context->log,
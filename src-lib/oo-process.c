@@ -31,7 +31,7 @@
 
 extern OSDP_CONTEXT context;
 extern unsigned char last_command_received;
-extern unsigned int last_check_value;
+extern unsigned short int last_check_value;
 extern OSDP_BUFFER osdp_buf;
 extern OSDP_INTEROP_ASSESSMENT osdp_conformance;
 extern OSDP_PARAMETERS p_card;
@@ -54,7 +54,6 @@ int
   int nak_not_msg;
   OSDP_HDR parsed_msg;
   int status;
-  OSDP_BUFFER temp_buffer;
 
 
   memset (&msg, 0, sizeof (msg));
@@ -62,10 +61,25 @@ int
 
   msg.lth = osdp_buf->next;
   msg.ptr = osdp_buf->buf;
+
+  // a PD emulating several addresses answers as the one this is addressed to
+  (void) oo_emulator_select (&context, osdp_buf->buf, osdp_buf->next);
   status = osdp_parse_message (&context, context.role, &msg, &parsed_msg);
   if (msg.crc_check)
     current_check_value = *(unsigned short int *)(msg.crc_check);
-  if (context.verbosity > 9)
+
+  // a whole frame (or a bad one) goes in the flight recorder, stray octets don't
+  if ((status != ST_MSG_TOO_SHORT) && (status != ST_MSG_BAD_SOM))
+  {
+    int frame_length;
+
+    frame_length = osdp_buf->next;
+    if (frame_length >= 4)
+      if (((osdp_buf->buf [2] | (osdp_buf->buf [3] << 8)) > 0) && ((osdp_buf->buf [2] | (osdp_buf->buf [3] << 8)) <= frame_length))
+        frame_length = osdp_buf->buf [2] | (osdp_buf->buf [3] << 8);
+    oo_recorder_frame (&context, OO_RECORDER_IN, osdp_buf->buf, frame_length, status, NULL);
+  };
+  if (OO_LOG_ON (&context, OO_LOG_IO, 10))
     fprintf(context.log, "osdp_parse_message status was %d. last-cmd %02x parsed-cmd %02x last-check %04x current-check %04x\n",
       status, last_command_received, parsed_msg.command, last_check_value, current_check_value);
   if (status EQUALS ST_OK)
@@ -82,7 +96,8 @@ int
   /*
     if it didn't look right to the parser, dump it and let the retry process handle it.
   */
-  if ((status EQUALS ST_MSG_TOO_LONG) || (status EQUALS ST_MSG_BAD_SOM))
+  if ((status EQUALS ST_MSG_TOO_LONG) || (status EQUALS ST_MSG_BAD_SOM) ||
+    (status EQUALS ST_OSDP_SEC_BLOCK_LENGTH))
   {
     context.dropped_octets = context.dropped_octets + osdp_buf->next;
     osdp_buf->next = 0;
@@ -104,7 +119,7 @@ int
       if (msg.check_size EQUALS 1)
         current_check_value = 0xff & current_check_value; // crc is 2 bytes checksum is the low order byte
 
-      if (context.verbosity > 3)
+      if (OO_LOG_ON (&context, OO_LOG_IO, 4))
         fprintf(context.log,
           "  NAK: last-cmd %02x last-seq %d last-checkval %04x cur-checkval %04x next seq %d\n",
           last_command_received, context.last_sequence_received, last_check_value, current_check_value, context.next_sequence);
@@ -123,7 +138,7 @@ int
         else
           context.next_sequence --;
         context.retries ++;
-        if (context.verbosity > 3)
+        if (OO_LOG_ON (&context, OO_LOG_IO, 4))
           fprintf(context.log, "DEBUG: retry %d. in progress, don't NAK it. old s %d s %d\n", context.retries, old_s, context.next_sequence);
         fflush(context.log);
 
@@ -151,7 +166,7 @@ int
         fprintf(context.log, "  NAK: Bad hash, sending NAK %d\n", OO_NAK_ENC_REQ);
         break;
       case ST_OSDP_BAD_SEQUENCE:
-        if (context.verbosity > 3)
+        if (OO_LOG_ON (&context, OO_LOG_IO, 4))
         {
           fprintf(context.log, "bad sequence ctx addr %d msg addr %d\n", context.pd_address, parsed_msg.addr);
         };
@@ -169,8 +184,11 @@ int
       if (send_response)
       {
         char cmd [3072];
-        if (context.verbosity > 3)
-          fprintf(context.log, "NAK: response %d.\n", osdp_nak_response [0]);
+        if (context.event_log != NULL)
+          (void) oo_eventlog (&context, OO_EVLOG_NAK_SENT, "b", osdp_nak_response [0]);
+        else
+          if (OO_LOG_ON (&context, OO_LOG_IO, 4))
+            fprintf(context.log, "NAK: response %d.\n", osdp_nak_response [0]);
         (void)send_message_ex(&context,
           OSDP_NAK, p_card.addr, &current_length,
           1, osdp_nak_response, OSDP_SEC_NOT_SCS, 0, NULL);
@@ -187,7 +205,7 @@ int
       };
     };
   };
-  if (context.verbosity > 9)
+  if (OO_LOG_ON (&context, OO_LOG_IO, 10))
   {
     if (status != ST_MSG_TOO_SHORT)
     {
@@ -202,7 +220,7 @@ int
     // the message was good.  update conformance status.
     osdp_test_set_status(OOC_SYMBOL_multibyte_data_encoding, OCONFORM_EXERCISED);
 
-    if (context.verbosity > 9)
+    if (OO_LOG_ON (&context, OO_LOG_IO, 10))
     {
       int i;
       fprintf (stderr, "Parsing input (%d. bytes):\n",
@@ -215,6 +233,7 @@ int
       fprintf (stderr, "\n");
     };
     status = process_osdp_message (&context, &msg);
+    (void) oo_recorder_check (&context, status); // e.g. a cryptogram that doesn't decrypt
     fflush(context.log);
   };
 
@@ -315,27 +334,11 @@ int
   {
     int length;
     length = (parsed_msg.len_msb << 8) + parsed_msg.len_lsb;
-    memcpy (temp_buffer.buf, osdp_buf->buf+length, osdp_buf->next-length);
-    temp_buffer.next = osdp_buf->next-length;
-    memcpy (osdp_buf->buf, temp_buffer.buf, temp_buffer.next);
-    osdp_buf->next = temp_buffer.next;
+    memmove (osdp_buf->buf, osdp_buf->buf+length, osdp_buf->next-length);
+    osdp_buf->next = osdp_buf->next-length;
     if (status != ST_OK)
       // if we experienced an error we just reset things and continue
       status = ST_SERIAL_IN;
-{
-  int i;
-  char new_trace_buffer [3*1024];
-  char tmps [1024];
-
-  new_trace_buffer [0] = 0;
-  for (i=0; i<length; i++)
-  {
-    sprintf(tmps, " %02x", osdp_buf->buf[i]);
-    strcat(new_trace_buffer, tmps);
-  };
-  strcat(new_trace_buffer, "\n");
-//fprintf(stderr, "DEBUG: new trace buffer %s\n", new_trace_buffer);
-}
   };
   if (0) //(status EQUALS ST_OK)
   {
@@ -354,7 +357,7 @@ int
 
     // print trace to log if verbose
 
-    if (context.verbosity > 3)
+    if (OO_LOG_ON (&context, OO_LOG_IO, 4))
       osdp_trace_dump(&context, 1);
     else
       osdp_trace_dump(&context, 0);
@@ -379,7 +382,6 @@ int
   int i;
   char octet [1024];
   int status;
-  char temp_buffer [2048];
 
 
   status = ST_OK;
@@ -388,17 +390,16 @@ int
     status = ST_OSDP_BAD_INPUT_COUNT;
   if (buffer_input_length > 0)
   {
-    if (ctx->verbosity > 9)
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
       fprintf(ctx->log, "stream contained %4d octets\n", buffer_input_length);
     for (i=0; i<buffer_input_length; i++)
     {
-fflush(ctx->log);
       ctx->bytes_received++;
       if (ctx->trace & 1)
       {
         sprintf(octet, " %02x", buffer [i]);
         strcat(trace_in_buffer, octet);
- if (context.verbosity > 9) { fprintf(stderr, "DEBUG: trace in now %s\n", trace_in_buffer); };
+ if (OO_LOG_ON (&context, OO_LOG_IO, 10)) { fprintf(stderr, "DEBUG: trace in now %s\n", trace_in_buffer); };
       };
 
       status = ST_SERIAL_IN;
@@ -420,8 +421,7 @@ fprintf(stderr, "DEBUG: drop %02x next was %d dropped before %d\n",
           osdp_buf.next --;
           if (osdp_buf.next > 1)
           {
-            memcpy(temp_buffer, osdp_buf.buf+1, osdp_buf.next);
-            memcpy(osdp_buf.buf, temp_buffer, osdp_buf.next);
+            memmove(osdp_buf.buf, osdp_buf.buf+1, osdp_buf.next);
           };
         };
       }
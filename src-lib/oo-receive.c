@@ -0,0 +1,250 @@
+/*
+  oo-receive - PD side file transfer receive
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  fragments land in ./incoming_data with pwrite at their own offset, so a
+  resent fragment just rewrites the same octets.  the space for the whole
+  file is reserved up front without changing the file size, so the size
+  still says how much has arrived (that's what a resume checks.)
+
+  the octets past current_offset are new.  they go through a running
+  SHA-256 and, if configured, to the receive-pipe command and the
+  receive_sink callback, always in order.  a resumed transfer replays the
+  part already on disk first so the hash and the consumer see the whole
+  file.
+*/
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+
+#include <open-osdp.h>
+
+
+#define OO_RECEIVE_REPLAY_OCTETS (64*1024)
+
+
+static void
+  oo_receive_deliver
+    (OSDP_CONTEXT *ctx,
+    unsigned char *data,
+    int length,
+    unsigned int offset)
+
+{ /* oo_receive_deliver */
+
+  int status_io;
+
+
+  oo_sha256_update (&(ctx->xferctx.receive_hash), data, length);
+  if (ctx->xferctx.receive_stream != NULL)
+  {
+    status_io = write (fileno (ctx->xferctx.receive_stream), data, length);
+    if (status_io != length)
+    {
+      // the consumer went away.  the file itself is still received.
+
+      fprintf (ctx->log, "  File transfer: receive-pipe write failed at offset %u. (errno %d), no longer streaming\n",
+        offset, errno);
+      (void) pclose (ctx->xferctx.receive_stream);
+      ctx->xferctx.receive_stream = NULL;
+    };
+  };
+  if (ctx->receive_sink != NULL)
+    (void) (*(ctx->receive_sink)) (ctx, data, length, offset);
+
+} /* oo_receive_deliver */
+
+
+/*
+  oo_receive_close - stop receiving.  the hash is final if the whole file arrived.
+
+  the sink is called with length 0 at the end of a complete file.
+*/
+
+void
+  oo_receive_close
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_receive_close */
+
+  int complete;
+  unsigned char digest [OO_SHA256_OCTETS];
+
+
+  if (ctx->xferctx.receive_open)
+  {
+    complete = (ctx->xferctx.total_length > 0) &&
+      (ctx->xferctx.current_offset EQUALS ctx->xferctx.total_length);
+    if (complete)
+    {
+      oo_sha256_final (&(ctx->xferctx.receive_hash), digest);
+      oo_sha256_hex (digest, ctx->xferctx.receive_sha256);
+      fprintf (ctx->log, "  File transfer: received %u. octets, SHA-256 %s\n",
+        ctx->xferctx.total_length, ctx->xferctx.receive_sha256);
+      if (ctx->receive_sink != NULL)
+        (void) (*(ctx->receive_sink)) (ctx, NULL, 0, ctx->xferctx.total_length);
+    }
+    else
+    {
+      fprintf (ctx->log, "  File transfer: receive stopped at offset %u. of %u.\n",
+        ctx->xferctx.current_offset, ctx->xferctx.total_length);
+    };
+    close (ctx->xferctx.receive_fd);
+    ctx->xferctx.receive_open = 0;
+    if (ctx->xferctx.receive_stream != NULL)
+    {
+      (void) pclose (ctx->xferctx.receive_stream);
+      ctx->xferctx.receive_stream = NULL;
+    };
+  };
+
+} /* oo_receive_close */
+
+
+/*
+  oo_receive_open - open ./incoming_data to receive xferctx.total_length octets from offset
+
+  offset 0 starts a new file.  otherwise the first offset octets are what
+  an earlier attempt received; anything after that is dropped.
+*/
+
+int
+  oo_receive_open
+    (OSDP_CONTEXT *ctx,
+    unsigned int offset)
+
+{ /* oo_receive_open */
+
+  static unsigned char buffer [OO_RECEIVE_REPLAY_OCTETS];
+  int flags;
+  int length;
+  unsigned int replayed;
+  int status;
+
+
+  status = ST_OK;
+  flags = O_RDWR | O_CREAT;
+  if (offset EQUALS 0)
+    flags = flags | O_TRUNC;
+  ctx->xferctx.receive_fd = open ("./incoming_data", flags, 0644);
+  if (ctx->xferctx.receive_fd < 0)
+    status = ST_OSDP_BAD_TRANSFER_SAVE;
+  if (status EQUALS ST_OK)
+  {
+    if (ftruncate (ctx->xferctx.receive_fd, offset) != 0)
+    {
+      close (ctx->xferctx.receive_fd);
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+    };
+  };
+  if (status EQUALS ST_OK)
+  {
+    ctx->xferctx.receive_open = 1;
+    ctx->xferctx.receive_sha256 [0] = 0;
+    oo_sha256_init (&(ctx->xferctx.receive_hash));
+
+    // reserving the space is only an optimization
+
+    if (ctx->xferctx.total_length > offset)
+      if (fallocate (ctx->xferctx.receive_fd, FALLOC_FL_KEEP_SIZE, offset,
+        ctx->xferctx.total_length - offset) != 0)
+        if (OO_LOG_ON (ctx, OO_LOG_FILETRANSFER, 4))
+          fprintf (ctx->log, "  File transfer: could not preallocate %u. octets (errno %d)\n",
+            ctx->xferctx.total_length - offset, errno);
+
+    if (ctx->receive_pipe [0] != 0)
+    {
+      // a consumer that exits early must not take the PD down with it
+
+      signal (SIGPIPE, SIG_IGN);
+      ctx->xferctx.receive_stream = popen (ctx->receive_pipe, "w");
+      if (ctx->xferctx.receive_stream EQUALS NULL)
+        fprintf (ctx->log, "  File transfer: cannot start receive-pipe %s\n", ctx->receive_pipe);
+    };
+  };
+  replayed = 0;
+  while ((status EQUALS ST_OK) && (replayed < offset))
+  {
+    length = sizeof (buffer);
+    if (length > (offset - replayed))
+      length = offset - replayed;
+    if (pread (ctx->xferctx.receive_fd, buffer, length, replayed) != length)
+    {
+      oo_receive_close (ctx);
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+    };
+    if (status EQUALS ST_OK)
+    {
+      oo_receive_deliver (ctx, buffer, length, replayed);
+      replayed = replayed + length;
+    };
+  };
+  return (status);
+
+} /* oo_receive_open */
+
+
+/*
+  oo_receive_write - store a fragment at its offset and advance current_offset past it
+
+  the fragment may start before current_offset (a resend.)
+*/
+
+int
+  oo_receive_write
+    (OSDP_CONTEXT *ctx,
+    unsigned char *fragment,
+    int fragment_size,
+    unsigned int offset)
+
+{ /* oo_receive_write */
+
+  unsigned int skip;
+  int status;
+
+
+  status = ST_OK;
+  if (!(ctx->xferctx.receive_open))
+    status = ST_OSDP_BAD_TRANSFER_SAVE;
+  if (status EQUALS ST_OK)
+  {
+    if (pwrite (ctx->xferctx.receive_fd, fragment, fragment_size, offset) != fragment_size)
+      status = ST_OSDP_BAD_TRANSFER_SAVE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    skip = ctx->xferctx.current_offset - offset;
+    if (skip < (unsigned int)fragment_size)
+    {
+      oo_receive_deliver (ctx, fragment + skip, fragment_size - skip, ctx->xferctx.current_offset);
+      ctx->xferctx.current_offset = offset + fragment_size;
+    };
+  };
+  return (status);
+
+} /* oo_receive_write */
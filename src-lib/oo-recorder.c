@@ -0,0 +1,404 @@
+/*
+  oo-recorder - flight recorder, the most recent frames in and out
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  every frame read or written goes in a fixed ring, whatever the
+  verbosity or trace setting: the time (CLOCK_MONOTONIC), the direction,
+  the octets and what osdp_parse_message said about it.  the ring is
+  OO_RECORDER_FRAMES entries and the octets go in OO_RECORDER_OCTETS of
+  their own, both static, so recording is a clock read and a copy; no
+  allocation, no I/O.  an entry whose octets have since been written
+  over is left out of a dump.
+
+  both rings are written all the way round, so all of them ends up in
+  memory.  open-osdp uses the first flight-recorder-frames entries and
+  OO_RECORDER_FRAME_OCTETS octets per entry (0 records nothing), so a host
+  with many PD's can keep less.
+
+  the ring is dumped as osdpcap (with a parseStatus member per record)
+  on the flight-recorder command, on SIGUSR1, and on its own when a
+  frame is out of sequence or secure channel fails (a NAK for sequence or
+  security from the PD, a bad MAC, a bad cryptogram), at most once every
+  OO_RECORDER_HOLDOFF seconds.
+
+  there is one writer, the thread that reads and writes the line, and
+  the dump is done by that thread too (the signal handler only sets a
+  flag for oo_recorder_poll), so there is nothing to lock and recording
+  never waits.
+*/
+
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+#include <open-osdp.h>
+#include <osdpcap.h>
+
+
+static OO_RECORDER_ENTRY oo_recorder_ring [OO_RECORDER_FRAMES];
+static unsigned char oo_recorder_octets [OO_RECORDER_OCTETS];
+static unsigned int oo_recorder_kept = OO_RECORDER_FRAMES; // entries in use
+static unsigned int oo_recorder_octets_kept = OO_RECORDER_OCTETS; // octets in use
+static unsigned long long oo_recorder_frames; // recorded, ever
+static unsigned long long oo_recorder_octets_total; // recorded, ever
+static int oo_recorder_armed; // automatic dumps and SIGUSR1, open-osdp only
+static time_t oo_recorder_last_automatic;
+static volatile sig_atomic_t oo_recorder_signalled;
+static unsigned int oo_recorder_dumps;
+static char oo_recorder_last_path [1024];
+static char oo_recorder_last_reason [64];
+
+
+static void
+  oo_recorder_signal
+    (int signal_number)
+
+{ /* oo_recorder_signal */
+
+  oo_recorder_signalled = 1;
+
+} /* oo_recorder_signal */
+
+
+/*
+  oo_recorder_check - dump if this status is one the recorder is kept for
+
+  returns 1 if it was.
+*/
+
+int
+  oo_recorder_check
+    (OSDP_CONTEXT *ctx,
+    int status)
+
+{ /* oo_recorder_check */
+
+  char *reason;
+
+
+  reason = NULL;
+  switch (status)
+  {
+  case ST_OSDP_BAD_SEQUENCE:
+    reason = "bad-sequence";
+    break;
+  case ST_OSDP_SC_BAD_HASH:
+    reason = "bad-mac";
+    break;
+  case ST_OSDP_CHLNG_DECRYPT:
+  case ST_OSDP_SCRYPT_DECRYPT:
+  case ST_OSDP_SC_WRONG_STATE:
+  case ST_OSDP_SC_DECRYPT_NOT_PADDED:
+  case ST_OSDP_SC_DECRYPT_LTH_2:
+  case ST_OSDP_SEC_BLOCK_LENGTH:
+    reason = "secure-channel";
+    break;
+  };
+  if (reason EQUALS NULL)
+    return (0);
+  oo_recorder_trigger (ctx, reason);
+  return (1);
+
+} /* oo_recorder_check */
+
+
+/*
+  oo_recorder_dump - write what's in the ring as osdpcap
+
+  path NULL or empty makes a name from the time and the reason, in the
+  current directory (where the trace goes.)
+*/
+
+int
+  oo_recorder_dump
+    (OSDP_CONTEXT *ctx,
+    char *reason,
+    char *path)
+
+{ /* oo_recorder_dump */
+
+  struct tm cooked;
+  OO_RECORDER_ENTRY *e;
+  unsigned long long first;
+  int i;
+  char *io_tag;
+  unsigned long long n;
+  struct timespec now_monotonic;
+  struct timespec now_real;
+  long long offset_nsec;
+  char path_made [1024];
+  FILE *rf;
+  int status;
+  long long when_nsec;
+  unsigned int written;
+
+
+  status = ST_OK;
+  if ((path EQUALS NULL) || (*path EQUALS 0))
+  {
+    time_t now;
+
+    now = time (NULL);
+    (void) localtime_r (&now, &cooked);
+    snprintf (path_made, sizeof (path_made), "osdp-flight-%04d%02d%02d-%02d%02d%02d-%s.osdpcap",
+      1900+cooked.tm_year, 1+cooked.tm_mon, cooked.tm_mday,
+      cooked.tm_hour, cooked.tm_min, cooked.tm_sec, reason);
+    path = path_made;
+  };
+  rf = fopen (path, "w");
+  if (rf EQUALS NULL)
+  {
+    fprintf (ctx->log, "flight recorder: %s could not be written\n", path);
+    status = ST_RECORDER_DUMP;
+  };
+  if (status EQUALS ST_OK)
+  {
+    // entries are monotonic; osdpcap wants the time of day
+
+    clock_gettime (CLOCK_REALTIME, &now_real);
+    clock_gettime (CLOCK_MONOTONIC, &now_monotonic);
+    offset_nsec = (now_real.tv_sec - now_monotonic.tv_sec) * 1000000000LL +
+      (now_real.tv_nsec - now_monotonic.tv_nsec);
+
+    first = 0;
+    if (oo_recorder_frames > oo_recorder_kept)
+      first = oo_recorder_frames - oo_recorder_kept;
+    written = 0;
+    for (n=first; n<oo_recorder_frames; n++)
+    {
+      e = &(oo_recorder_ring [n % oo_recorder_kept]);
+
+      // the octets of the oldest may have been written over since
+      if ((oo_recorder_octets_total - e->start) > oo_recorder_octets_kept)
+        continue;
+      when_nsec = e->captured_nsec + offset_nsec;
+      io_tag = (e->direction EQUALS OO_RECORDER_OUT) ? "out" : "in";
+      if (ctx->role EQUALS OSDP_ROLE_MONITOR)
+        io_tag = "trace";
+      fprintf (rf, "{ \"%s\" : \"%010lld\", \"%s\" : \"%09lld\", \"%s\" : \"%s\", \"%s\" : \"",
+        OSDPCAP_TAG_TIME_SEC, when_nsec / 1000000000LL,
+        OSDPCAP_TAG_TIME_NSEC, when_nsec % 1000000000LL,
+        OSDPCAP_TAG_INPUT_OUTPUT, io_tag, OSDPCAP_TAG_DATA);
+      for (i=0; i<e->length; i++)
+        fprintf (rf, " %02x", oo_recorder_octets [(e->start + i) % oo_recorder_octets_kept]);
+      fprintf (rf,
+"\", \"%s\":\"%d\", \"%s\":\"libosdp-conformance %d.%d-%d\", \"%s\":\"%d\" }\n",
+        OSDPCAP_TAG_TRACE_VERSION, OSDP_TRACE_VERSION_1,
+        OSDPCAP_TAG_OSDP_SOURCE, OSDP_VERSION_MAJOR, OSDP_VERSION_MINOR, OSDP_VERSION_BUILD,
+        OSDPCAP_TAG_PARSE_STATUS, e->parse_status);
+      written ++;
+    };
+    if (fclose (rf) != 0)
+      status = ST_RECORDER_DUMP;
+    oo_recorder_dumps ++;
+    strncpy (oo_recorder_last_path, path, sizeof (oo_recorder_last_path)-1);
+    strncpy (oo_recorder_last_reason, reason, sizeof (oo_recorder_last_reason)-1);
+    fprintf (ctx->log, "flight recorder: %u. frames to %s (%s)\n", written, path, reason);
+    fflush (ctx->log);
+  };
+  return (status);
+
+} /* oo_recorder_dump */
+
+
+/*
+  oo_recorder_frame - put one frame in the ring
+
+  arrival is when it came off the line (CLOCK_REALTIME, as the monitor's
+  capture thread stamps frames), NULL for now.
+*/
+
+void
+  oo_recorder_frame
+    (OSDP_CONTEXT *ctx,
+    int direction,
+    unsigned char *octets,
+    int length,
+    int parse_status,
+    struct timespec *arrival)
+
+{ /* oo_recorder_frame */
+
+  struct timespec captured;
+  OO_RECORDER_ENTRY *e;
+  long long late_nsec;
+  struct timespec now_monotonic;
+  struct timespec now_real;
+  unsigned int offset;
+  unsigned int part;
+
+
+  if ((length <= 0) || (oo_recorder_kept EQUALS 0))
+    return;
+  if (length > OSDPCAP_RECORD_MAX)
+    length = OSDPCAP_RECORD_MAX;
+  if (length > oo_recorder_octets_kept)
+    length = oo_recorder_octets_kept;
+  e = &(oo_recorder_ring [oo_recorder_frames % oo_recorder_kept]);
+  clock_gettime (CLOCK_MONOTONIC, &now_monotonic);
+  e->captured_nsec = now_monotonic.tv_sec * 1000000000LL + now_monotonic.tv_nsec;
+
+  // a frame being decoded by a monitor arrived a little while ago
+
+  if (arrival EQUALS NULL)
+    if (oo_monitor_frame_time (&captured))
+      arrival = &captured;
+  if (arrival != NULL)
+  {
+    clock_gettime (CLOCK_REALTIME, &now_real);
+    late_nsec = (now_real.tv_sec - arrival->tv_sec) * 1000000000LL + (now_real.tv_nsec - arrival->tv_nsec);
+    if (late_nsec > 0)
+      e->captured_nsec = e->captured_nsec - late_nsec;
+  };
+  e->start = oo_recorder_octets_total;
+  e->length = length;
+  e->direction = direction;
+  e->parse_status = parse_status;
+
+  // the octets go in at the end of the last frame's, around the end if need be
+
+  offset = oo_recorder_octets_total % oo_recorder_octets_kept;
+  part = length;
+  if (part > (oo_recorder_octets_kept - offset))
+    part = oo_recorder_octets_kept - offset;
+  memcpy (oo_recorder_octets + offset, octets, part);
+  if (part < length)
+    memcpy (oo_recorder_octets, octets + part, length - part);
+  oo_recorder_octets_total = oo_recorder_octets_total + length;
+  oo_recorder_frames ++;
+
+  // a frame the parser rejected for sequence or secure channel dumps it all (this one included)
+  (void) oo_recorder_check (ctx, parse_status);
+
+} /* oo_recorder_frame */
+
+
+/*
+  oo_recorder_poll - dump if SIGUSR1 came in.  called from the event loop.
+*/
+
+int
+  oo_recorder_poll
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_recorder_poll */
+
+  int status;
+
+
+  status = ST_OK;
+  if (oo_recorder_signalled)
+  {
+    oo_recorder_signalled = 0;
+    status = oo_recorder_dump (ctx, "signal", NULL);
+  };
+  return (status);
+
+} /* oo_recorder_poll */
+
+
+/*
+  oo_recorder_start - size the ring, take SIGUSR1 and allow automatic dumps
+
+  frames are recorded anyway (osdp-replay and the fuzz harness record
+  too, in the whole ring) but only open-osdp dumps.
+*/
+
+int
+  oo_recorder_start
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_recorder_start */
+
+  struct sigaction action;
+  int status;
+
+
+  status = ST_OK;
+
+  // a different size starts the ring over
+  if ((unsigned int)(ctx->recorder_frames) != oo_recorder_kept)
+  {
+    oo_recorder_kept = ctx->recorder_frames;
+    oo_recorder_octets_kept = oo_recorder_kept * OO_RECORDER_FRAME_OCTETS;
+    oo_recorder_frames = 0;
+    oo_recorder_octets_total = 0;
+  };
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = oo_recorder_signal;
+  sigemptyset (&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction (SIGUSR1, &action, NULL) != 0)
+    status = ST_RECORDER_DUMP;
+  oo_recorder_armed = 1;
+  return (status);
+
+} /* oo_recorder_start */
+
+
+/*
+  oo_recorder_trigger - an automatic dump, unless one was just done
+*/
+
+void
+  oo_recorder_trigger
+    (OSDP_CONTEXT *ctx,
+    char *reason)
+
+{ /* oo_recorder_trigger */
+
+  time_t now;
+
+
+  if ((!oo_recorder_armed) || (ctx->recorder_manual))
+    return;
+  now = time (NULL);
+  if ((oo_recorder_last_automatic != 0) && ((now - oo_recorder_last_automatic) < OO_RECORDER_HOLDOFF))
+    return;
+  oo_recorder_last_automatic = now;
+  (void) oo_recorder_dump (ctx, reason, NULL);
+
+} /* oo_recorder_trigger */
+
+
+/*
+  oo_recorder_write_status - add the flight recorder to the status file
+
+  emits a "flight-recorder" member (followed by a comma) into the open JSON object.
+*/
+
+void
+  oo_recorder_write_status
+    (OSDP_CONTEXT *ctx,
+    FILE *sf)
+
+{ /* oo_recorder_write_status */
+
+  fprintf (sf,
+"\"flight-recorder\" : { \"frames\" : \"%llu\", \"octets\" : \"%llu\", \"dumps\" : \"%u\", \"last-dump\" : \"%s\", \"last-reason\" : \"%s\" },\n",
+    oo_recorder_frames, oo_recorder_octets_total, oo_recorder_dumps,
+    oo_recorder_last_path, oo_recorder_last_reason);
+
+} /* oo_recorder_write_status */
+
@@ -82,7 +82,7 @@ int
       ccrypt_payload = (OSDP_SC_CCRYPT *)(msg->data_payload);
       client_cryptogram = ccrypt_payload-> cryptogram;
       // decrypt the client cryptogram (validate header, RND.A, collect RND.B)
-if (ctx->verbosity > 8)
+if (OO_LOG_ON (ctx, OO_LOG_SECURE, 9))
 {
   int i;
   fprintf (stderr, "s_enc: ");
@@ -199,7 +199,7 @@ int
       sizeof(osdp_nak_response_data), osdp_nak_response_data);
     ctx->sent_naks ++;
     osdp_test_set_status(OOC_SYMBOL_rep_nak, OCONFORM_EXERCISED);
-    if (ctx->verbosity > 2)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 3))
     {
       fprintf (ctx->log, "NAK(5): osdp_CHLNG but Secure Channel disabled\n");
     };
@@ -226,7 +226,7 @@ int
         1, osdp_nak_response_data);
       ctx->sent_naks ++;
       osdp_test_set_status(OOC_SYMBOL_rep_nak, OCONFORM_EXERCISED);
-      if (ctx->verbosity > 2)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 3))
       {
         fprintf (ctx->log, "NAK: SCBK not initialized\n");
       };
@@ -418,7 +418,7 @@ int
       AES_ctx_set_iv (&aes_context_s_enc, iv);
       AES_CBC_decrypt_buffer (&aes_context_s_enc,
         server_cryptogram, sizeof (server_cryptogram));
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       {
         dump_buffer_log(ctx,
 "SrvCgram:",
@@ -444,7 +444,7 @@ int
       {
         sec_blk [0] = 0xff; // FAIL
         ctx->conformance_fail_next_rmac_i = 0;
-        if (ctx->verbosity > 2)
+        if (OO_LOG_ON (ctx, OO_LOG_SECURE, 3))
           fprintf(ctx->log, "Conformance test: RMAC_I responding with error.\n");
       };
 
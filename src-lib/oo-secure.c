@@ -67,15 +67,14 @@ int
 
 
   status = ST_OK;
-  if (ctx->verbosity > 9)
-    dump_buffer_log(ctx, "whole msg for msg-auth:", msg_to_send, msg_lth);
+  OO_LOG_DUMP (ctx, OO_LOG_SECURE, 10, "whole msg for msg-auth:", msg_to_send, msg_lth);
   memset(hashbuffer, 0, sizeof(hashbuffer));
   memset(padded_block, 0, sizeof(padded_block));
   part1_block_length = 0;
   last_part1_block_offset = 0;
   current_lth = msg_lth;
 
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
     fprintf(ctx->log,
       "calculating MAC for message of length %d.\n", msg_lth);
 
@@ -85,7 +84,7 @@ int
   if (status EQUALS ST_OK)
   {
     memcpy(last_iv, ctx->last_calculated_in_mac, sizeof(last_iv));
-    if (ctx->verbosity > 8)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 9))
     {
       dump_buffer_log(ctx, "S-MAC1 at osdp_calculate_secure_channel_mac:",
         ctx->s_mac1, OSDP_KEY_OCTETS);
@@ -99,7 +98,7 @@ int
       part1_block_length = (msg_lth/OSDP_KEY_OCTETS)*OSDP_KEY_OCTETS;
       last_part1_block_offset = part1_block_length - OSDP_KEY_OCTETS;
       memcpy(hashbuffer, msg_to_send, part1_block_length);
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       {
         dump_buffer_log(ctx, (char *)"msg-auth part 1 input:",
           hashbuffer, part1_block_length);
@@ -116,7 +115,7 @@ int
     memcpy(padded_block, msg_to_send+part1_block_length,
       msg_lth-part1_block_length);
     osdp_sc_pad(padded_block, current_lth);
-    if (ctx->verbosity > 8)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 9))
     {
       dump_buffer_log(ctx, (char *)"IV for last block in mac",
         last_iv, sizeof(last_iv));
@@ -131,8 +130,7 @@ int
     AES_ctx_set_iv (&aes_context_mac2, last_iv);
     memcpy (hashbuffer, padded_block, OSDP_KEY_OCTETS);
     AES_CBC_encrypt_buffer(&aes_context_mac2, hashbuffer, OSDP_KEY_OCTETS);
-    if (ctx->verbosity > 8)
-      dump_buffer_log(ctx, "last block encrypted for MAC:", hashbuffer, OSDP_KEY_OCTETS);
+    OO_LOG_DUMP (ctx, OO_LOG_SECURE, 9, "last block encrypted for MAC:", hashbuffer, OSDP_KEY_OCTETS);
 
     // this MAC is saved as the last sent MAC
 
@@ -150,7 +148,7 @@ int
     unsigned char hashbuffer [OSDP_KEY_OCTETS];
 
     osdp_pad_message(padded_block, msg_to_send, msg_lth);
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
     {
       //dump_buffer_log(ctx, "mac2", ctx->s_mac2, sizeof(ctx->s_mac2));
       //dump_buffer_log(ctx, "padded mac block", padded_block, OSDP_KEY_OCTETS);
@@ -164,8 +162,7 @@ int
     memcpy(ctx->last_calculated_out_mac, hashbuffer,
       sizeof(ctx->last_calculated_out_mac));
 
-    if (ctx->verbosity > 3)
-      dump_buffer_log(ctx, "encrypted mac block", hashbuffer, OSDP_KEY_OCTETS);
+    OO_LOG_DUMP (ctx, OO_LOG_SECURE, 4, "encrypted mac block", hashbuffer, OSDP_KEY_OCTETS);
     mac [0] = hashbuffer [0];
     mac [1] = hashbuffer [1];
     mac [2] = hashbuffer [2];
@@ -310,8 +307,7 @@ int
       next_data ++; // where crc goes (after data)
     };
   };
-  if (ctx->verbosity > 9)
-    dump_buffer_log(ctx, "Secure Before MAC append", buf, new_length);
+  OO_LOG_DUMP (ctx, OO_LOG_SECURE, 10, "Secure Before MAC append", buf, new_length);
 
   // update message length to add crypto padding, add before MAC calculation
 
@@ -325,8 +321,7 @@ int
     (sec_block_type EQUALS OSDP_SEC_SCS_17) ||
     (sec_block_type EQUALS OSDP_SEC_SCS_18))
   {
-    if (ctx->verbosity > 3)
-      dump_buffer_log(ctx, "buffer for mac calc:", buf, new_length);
+    OO_LOG_DUMP (ctx, OO_LOG_SECURE, 4, "buffer for mac calc:", buf, new_length);
     status = osdp_calculate_secure_channel_mac(ctx, buf, new_length, sc_mac);
     if (status EQUALS 0)
     {
@@ -335,8 +330,7 @@ int
       new_length = new_length + 4;
     };
   };
-  if (ctx->verbosity > 9)
-    dump_buffer_log(ctx, "Secure After MAC append", buf, new_length);
+  OO_LOG_DUMP (ctx, OO_LOG_SECURE, 10, "Secure After MAC append", buf, new_length);
 
   // crc
   if (m_check EQUALS OSDP_CRC)
@@ -372,8 +366,7 @@ int
   };
 
   *updated_length = new_length;
-  if (ctx->verbosity > 9)
-    dump_buffer_log(ctx, "buffer after build-secure:", (unsigned char *)p, *updated_length);
+  OO_LOG_DUMP (ctx, OO_LOG_SECURE, 10, "buffer after build-secure:", (unsigned char *)p, *updated_length);
   return (status);
 
 } /* osdp_build_message */
@@ -397,15 +390,14 @@ int
   int status;
 
 
-  if (ctx->verbosity > 9)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 10))
     fprintf(stderr, "DEBUG:osdp_decrypt_payload: top, SCS=%02x\n", msg->security_block_type);
   status = ST_OK;
   memcpy(decrypt_iv, ctx->last_calculated_out_mac, OSDP_KEY_OCTETS);
-  if (ctx->verbosity > 9)
-    dump_buffer_log(ctx, "pre-invert payload iv:", decrypt_iv, OSDP_KEY_OCTETS);
+  OO_LOG_DUMP (ctx, OO_LOG_SECURE, 10, "pre-invert payload iv:", decrypt_iv, OSDP_KEY_OCTETS);
   for(i=0; i<OSDP_KEY_OCTETS; i++)
     decrypt_iv [i] = ~decrypt_iv [i];
-  if (ctx->verbosity > 9)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 10))
     fprintf(ctx->log, "osdp_decrypt_payload: sec blk typ %02x payload is %d. bytes\n", msg->security_block_type,
       msg->data_length);
 
@@ -422,12 +414,12 @@ int
   if ((msg->data_length > 0) &&
     ((msg->security_block_type EQUALS OSDP_SEC_SCS_17) || (msg->security_block_type EQUALS OSDP_SEC_SCS_18)))
   {
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
     {
       dump_buffer_log(ctx,
         "payload to decrypt:", msg->data_payload, msg->data_length);
     };
-    if (ctx->verbosity > 9)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 10))
     {
       dump_buffer_log(ctx, "payload key:", ctx->s_enc, OSDP_KEY_OCTETS);
       dump_buffer_log(ctx, "payload iv:", decrypt_iv, OSDP_KEY_OCTETS);
@@ -436,7 +428,7 @@ int
     AES_ctx_set_iv(&aes_context_decrypt, decrypt_iv);
     AES_CBC_decrypt_buffer(&aes_context_decrypt,
       msg->data_payload, msg->data_length);
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       dump_buffer_log(ctx, "payload decrypted:",
         msg->data_payload, msg->data_length);
 
@@ -450,7 +442,7 @@ int
     done = 0;
     found_marker = 0;
     pad_blocksize = 0;
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       fprintf(ctx->log, "DEBUG: initiating padding removal\n");
     while (!done)
     {
@@ -487,14 +479,14 @@ int
       if (cptr EQUALS msg->data_payload)
         done = 1;
     };
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       fprintf(ctx->log, "DEBUG: padding removal complete.\n");
 
     // if there was padding adjust the actual length.
     if (found_marker && (pad_blocksize > 0))
     {
       cur_actual = cur_actual - pad_blocksize;
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       {
         fprintf(ctx->log, "Stripped padding (%d. bytes)\n", pad_blocksize);
       };
@@ -502,7 +494,7 @@ int
 
     if (status EQUALS ST_OSDP_SC_DECRYPT_NOT_PADDED)
     {
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       {
         fprintf(ctx->log, "Decrypt: no padding detected\n");
       };
@@ -511,13 +503,13 @@ int
     if (status EQUALS ST_OK)
     {
       msg->data_length = cur_actual;
-if (ctx->verbosity > 3)
+if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   fprintf(ctx->log, "  Decrypted payload is %d. bytes\n", msg->data_length);
 
       msg->payload_decrypted = 1;
     };
   };
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
     if (msg->data_length)
       dump_buffer_log(ctx, "decrypted payload:",
         msg->data_payload, msg->data_length);
@@ -575,7 +567,7 @@ void
   memset (iv, 0, sizeof (iv));
   memcpy (message, ctx->rnd_a, 8);
   memcpy (message+8, ctx->rnd_b, 8);
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   {
     fprintf(ctx->log, "  Creating client cryptogram: RND.A %02X%02X%02X%02X %02X%02X%02X%02X RND.B %02X%02X%02X%02X %02X%02X%02X%02X\n",
     ctx->rnd_a [0], ctx->rnd_a [1], ctx->rnd_a [2], ctx->rnd_a [3], ctx->rnd_a [4], ctx->rnd_a [5], ctx->rnd_a [6], ctx->rnd_a [7],
@@ -676,7 +668,7 @@ int
 
 
   status = ST_OK;
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   {
     fprintf(ctx->log, "osdp_encrypt_payload: top\n");
     dump_buffer_log(ctx, "Payload to be encrypted:", data, data_length);
@@ -711,7 +703,7 @@ int
       *padding = *padded_length - data_length;
     };
   };
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   {
     dump_buffer_log(ctx, "payload cleartext with padding:",
       enc_buf, *padded_length);
@@ -720,7 +712,7 @@ int
   memcpy(encrypt_iv, ctx->last_calculated_in_mac, OSDP_KEY_OCTETS);
   for(i=0; i<OSDP_KEY_OCTETS; i++)
     encrypt_iv [i] = ~encrypt_iv [i];
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   {
     dump_buffer_log(ctx, "iv(inverted):", encrypt_iv, OSDP_KEY_OCTETS);
     dump_buffer_log(ctx, "s_enc:", ctx->s_enc, OSDP_KEY_OCTETS);
@@ -729,7 +721,7 @@ int
   AES_ctx_set_iv (&aes_context_encrypt, encrypt_iv);
   AES_CBC_encrypt_buffer(&aes_context_encrypt, enc_buf, *padded_length);
 
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   {
     dump_buffer_log(ctx, "payload ciphertext:",
       enc_buf, *padded_length);
@@ -800,7 +792,7 @@ void
   // secure channel processing is being reset.  set things
   // back to the beginning.
 
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
   {
     fprintf (ctx->log, "  Resetting Secure Channel\n");
     fprintf (ctx->log, "  RND.A is %02X%02X%02X%02x %02X%02X%02X%02X\n",
@@ -817,7 +809,7 @@ void
   ctx->secure_channel_use [OO_SCU_ENAB] = OO_SCS_USE_DISABLED;
   if (ctx->enable_secure_channel > 0)
   {
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
     {
       fprintf(ctx->log, "  Enabling Secure Channel\n");
       dump_buffer_log(ctx, "  Current SCBK:", ctx->current_scbk, sizeof(ctx->current_scbk));
@@ -860,7 +852,7 @@ int
   status = ST_OK;
   if (security_block_type > OSDP_SEC_SCS_14)
   {
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       dump_buffer_log(ctx,
         "msg:", message, message_length);
     status = ST_OSDP_SC_BAD_HASH;
@@ -880,7 +872,7 @@ int
         last_block_length = OSDP_KEY_OCTETS;
       };
       memcpy(current_iv, ctx->last_calculated_out_mac, OSDP_KEY_OCTETS);
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       {
         fprintf(ctx->log, "Hash check inbound: current_length %d. first_blocks_length %d. last_block_length %d.\n",
           current_length, first_blocks_length, last_block_length);
@@ -891,8 +883,7 @@ int
       AES_init_ctx(&aes_context_mac1, ctx->s_mac1);
       AES_ctx_set_iv(&aes_context_mac1, current_iv);
       memcpy(first_blocks_temp, current_pointer, first_blocks_length);
-      if (ctx->verbosity > 3)
-        dump_buffer_log(ctx, "first blocks from wire:", first_blocks_temp, first_blocks_length);
+      OO_LOG_DUMP (ctx, OO_LOG_SECURE, 4, "first blocks from wire:", first_blocks_temp, first_blocks_length);
       AES_CBC_encrypt_buffer(&aes_context_mac1, first_blocks_temp, first_blocks_length);
       memcpy(current_iv, first_blocks_temp + (first_blocks_length - OSDP_KEY_OCTETS), OSDP_KEY_OCTETS);
 
@@ -912,7 +903,7 @@ int
     AES_CBC_encrypt_buffer(&aes_context_mac2, hashbuffer, sizeof(hashbuffer));
     memcpy(ctx->last_calculated_in_mac,
       hashbuffer, sizeof(ctx->last_calculated_in_mac));
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
     {
       dump_buffer_log(ctx, " rcv hash", hash, 4);
       dump_buffer_log(ctx, "calc hash", hashbuffer, sizeof(hashbuffer));
@@ -924,7 +915,7 @@ int
     if (0 EQUALS memcmp(hash, hashbuffer, 4))
     {
       status = ST_OK;
-      if (ctx->verbosity > 3)
+      if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
         fprintf(ctx->log, "  ..SC MAC calculation matches %02x%02x%02x%02x\n",
           hashbuffer [0], hashbuffer [1], hashbuffer [2], hashbuffer [3]);
       ctx->hash_ok ++;
@@ -933,7 +924,7 @@ int
   if (status EQUALS ST_OSDP_SC_BAD_HASH)
   {
     ctx->hash_bad ++;
-    if (ctx->verbosity > 3)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 4))
       fprintf(ctx->log, "  ..SC MAC calculation mis-match\n");
     fprintf(ctx->log, "  resetting secure channel due to MAC error\n");
     fflush(ctx->log);
@@ -1127,7 +1118,7 @@ int
   unsigned char buf [2];
   int old_state;
   int status;
-  unsigned char test_blk [1024];
+  unsigned char test_blk [1600];
   int true_dest;
 
 
@@ -1174,7 +1165,7 @@ int
 //    parse_role = OSDP_ROLE_CP; if (ctx->role EQUALS OSDP_ROLE_CP) parse_role = OSDP_ROLE_PD;
     status_monitor = osdp_parse_message (ctx, OSDP_ROLE_MONITOR, //parse_role,
       &m, &returned_hdr);
-    if (ctx->verbosity > 8)
+    if (OO_LOG_ON (ctx, OO_LOG_SECURE, 9))
       if (status_monitor != ST_OK)
       {
         sprintf (tlogmsg,"parse_message for monitoring returned %d.\n",
@@ -1195,6 +1186,7 @@ int
       ctx->secure_channel_use [0] = 128 + OSDP_SEC_SCS_11;
 
     send_osdp_data (ctx, test_blk, *current_length);
+    oo_latency_transmit_complete (ctx, command);
 
     // keep track of the last command sent (for "secure" messages)
     ctx->last_command_sent = command;
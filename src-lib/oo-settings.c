@@ -36,6 +36,7 @@
 
 
 extern OSDP_PARAMETERS p_card;
+extern OSDP_TLS_CONFIG osdp_tls_config;
 
 
 int
@@ -264,6 +265,26 @@ int
       ctx->disable_certificate_checking = i;
   }; 
 
+  // parameter "emulate-addresses" - PD: answer for all these addresses, e.g. "1-32" (see oo-emulator.c)
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "emulate-addresses");
+    if (json_is_string (value))
+    {
+      char vstr [1024];
+
+      found_field = 1;
+      strncpy (vstr, json_string_value (value), sizeof (vstr)-1);
+      vstr [sizeof (vstr)-1] = 0;
+      if (oo_emulator_addresses (vstr, ctx->emulate) < 0)
+      {
+        fprintf (stderr, "bad emulate-addresses value: %s\n", vstr);
+        status = ST_EMULATE_ADDRESSES;
+      };
+    };
+  };
+
   // parameter "enable-biometrics"
 
   if (status EQUALS ST_OK)
@@ -360,6 +381,75 @@ int
     ctx->trace = 1;
   }; 
 
+  // parameter "event-log" - binary event log file, in place of the frame lines in the log (see oo-eventlog.c)
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "event-log");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      strncpy (ctx->event_log_path, json_string_value (value), sizeof (ctx->event_log_path)-1);
+    };
+  };
+
+  // parameter "log-levels" - per category log levels over the verbosity, e.g. "secure=9,parse=0" (see oo_log_levels)
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "log-levels");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      strncpy (ctx->log_levels, json_string_value (value), sizeof (ctx->log_levels)-1);
+    };
+  };
+
+  // parameter "flight-recorder" - "manual" to dump only on the command or SIGUSR1 (see oo-recorder.c)
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "flight-recorder");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      if (0 EQUALS strcmp ("manual", json_string_value (value)))
+        ctx->recorder_manual = 1;
+    };
+  };
+
+  // parameter "flight-recorder-frames" - frames the flight recorder keeps, 0 for none (see oo-recorder.c)
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "flight-recorder-frames");
+    if (json_is_string (value))
+    {
+      int i;
+
+      found_field = 1;
+      i = OO_RECORDER_FRAMES;
+      sscanf (json_string_value (value), "%d", &i);
+      if (i < 0)
+        i = 0;
+      if (i > OO_RECORDER_FRAMES)
+        i = OO_RECORDER_FRAMES;
+      ctx->recorder_frames = i;
+    };
+  };
+
+  // parameter "pd-events-sink" - ACU: 1 to count and time pd-events card and keypad events instead of acting on them
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "pd-events-sink");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      sscanf (json_string_value (value), "%d", &(ctx->events_sink));
+    };
+  };
+
 //firmware-version goes here
 
   // parameter "fqdn"
@@ -429,6 +519,32 @@ int
     ctx->max_message = i;
   };
 
+  // parameter "metrics-port" - TCP port on 127.0.0.1 for the OpenMetrics endpoint
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "metrics-port");
+    if (json_is_string (value))
+    {
+      int i;
+      found_field = 1;
+      sscanf(json_string_value(value), "%d", &i);
+      ctx->metrics_port = i;
+    };
+  };
+
+  // parameter "metrics-socket" - unix socket path for the OpenMetrics endpoint
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "metrics-socket");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      strncpy (ctx->metrics_socket, json_string_value (value), sizeof (ctx->metrics_socket)-1);
+    };
+  };
+
   // parameter "model-version"
   if (status EQUALS ST_OK)
   {
@@ -560,6 +676,18 @@ int
     };
   };
 
+  // parameter "receive-pipe" - PD: command each received file transfer is streamed into
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "receive-pipe");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      strncpy (ctx->receive_pipe, json_string_value (value), sizeof (ctx->receive_pipe)-1);
+    };
+  };
+
   // results - "keep" or "new", default is "new"
 
   if (status EQUALS ST_OK)
@@ -691,6 +819,36 @@ fprintf(stderr, "DEBUG: serial_number in context is now %02X %02X %02X %02X\n",
       strcpy(ctx->service_root, json_string_value(value));
   };
 
+  // parameters "tls-ca-file", "tls-cert-file", "tls-key-file" - for the TLS transports
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "tls-ca-file");
+    if (json_is_string (value))
+      strncpy (osdp_tls_config.ca_file, json_string_value (value), sizeof (osdp_tls_config.ca_file)-1);
+    value = json_object_get (root, "tls-cert-file");
+    if (json_is_string (value))
+      strncpy (osdp_tls_config.cert_file, json_string_value (value), sizeof (osdp_tls_config.cert_file)-1);
+    value = json_object_get (root, "tls-key-file");
+    if (json_is_string (value))
+      strncpy (osdp_tls_config.key_file, json_string_value (value), sizeof (osdp_tls_config.key_file)-1);
+  };
+
+  // parameter "transport" - serial, tcp-client, tcp-server, tls-client, tls-server
+
+  if (status EQUALS ST_OK)
+  {
+    value = json_object_get (root, "transport");
+    if (json_is_string (value))
+    {
+      found_field = 1;
+      strcpy (this_value, json_string_value (value));
+      status = oo_transport_lookup (this_value, &(ctx->transport_type));
+      if (status != ST_OK)
+        fprintf (stderr, "Unknown transport %s\n", this_value);
+    };
+  };
+
   // parameter "timeout"
   // note this is timer 0 (zero)
 
@@ -952,7 +1110,12 @@ int
   ctx->cparm = PARAMETER_NONE;
   ctx->cparm_v = PARMV_NONE;
 
-  status = oo_parse_config_parameters(ctx);
+  // the JSON is only parsed if the snapshot doesn't already have the result
+  if (oo_snapshot_begin (ctx, OO_SNAPSHOT_CONFIG, &status) != ST_OK)
+  {
+    status = oo_parse_config_parameters(ctx);
+    oo_snapshot_end (ctx, OO_SNAPSHOT_CONFIG, status);
+  };
 
   if (p_card.value_len EQUALS 26)
   {
@@ -989,6 +1152,7 @@ int
   };
 
   ctx->m_check = m_check;  // context field mimics old "m_check" global
+  (void) oo_log_levels (ctx);
 
   return (status);
 
@@ -0,0 +1,202 @@
+/*
+  oo-sha256 - SHA-256 (FIPS 180-4) for file transfer identity and checks
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  self-contained so the exerciser does not need a crypto library just to
+  recognize a file it has seen before.  use oo_sha256_init, then
+  oo_sha256_update as data arrives, then oo_sha256_final.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+
+
+#include <open-osdp.h>
+
+
+#define OO_ROTR(x,n) (((x) >> (n)) | ((x) << (32-(n))))
+
+static const unsigned int oo_sha256_k [64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+static void
+  oo_sha256_block
+    (OO_SHA256_CTX *sha,
+    const unsigned char *block)
+
+{ /* oo_sha256_block */
+
+  unsigned int a, b, c, d, e, f, g, h;
+  int i;
+  unsigned int s0;
+  unsigned int s1;
+  unsigned int t1;
+  unsigned int t2;
+  unsigned int w [64];
+
+
+  for (i=0; i<16; i++)
+    w [i] = ((unsigned int)block [4*i] << 24) | ((unsigned int)block [4*i+1] << 16) |
+      ((unsigned int)block [4*i+2] << 8) | block [4*i+3];
+  for (i=16; i<64; i++)
+  {
+    s0 = OO_ROTR(w [i-15], 7) ^ OO_ROTR(w [i-15], 18) ^ (w [i-15] >> 3);
+    s1 = OO_ROTR(w [i-2], 17) ^ OO_ROTR(w [i-2], 19) ^ (w [i-2] >> 10);
+    w [i] = w [i-16] + s0 + w [i-7] + s1;
+  };
+  a = sha->state [0]; b = sha->state [1]; c = sha->state [2]; d = sha->state [3];
+  e = sha->state [4]; f = sha->state [5]; g = sha->state [6]; h = sha->state [7];
+  for (i=0; i<64; i++)
+  {
+    t1 = h + (OO_ROTR(e, 6) ^ OO_ROTR(e, 11) ^ OO_ROTR(e, 25)) + ((e & f) ^ (~e & g)) +
+      oo_sha256_k [i] + w [i];
+    t2 = (OO_ROTR(a, 2) ^ OO_ROTR(a, 13) ^ OO_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  };
+  sha->state [0] += a; sha->state [1] += b; sha->state [2] += c; sha->state [3] += d;
+  sha->state [4] += e; sha->state [5] += f; sha->state [6] += g; sha->state [7] += h;
+
+} /* oo_sha256_block */
+
+
+void
+  oo_sha256_init
+    (OO_SHA256_CTX *sha)
+
+{ /* oo_sha256_init */
+
+  static const unsigned int initial [8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+
+  memcpy (sha->state, initial, sizeof (sha->state));
+  sha->length = 0;
+  sha->fill = 0;
+
+} /* oo_sha256_init */
+
+
+void
+  oo_sha256_update
+    (OO_SHA256_CTX *sha,
+    const unsigned char *data,
+    size_t length)
+
+{ /* oo_sha256_update */
+
+  size_t take;
+
+
+  sha->length = sha->length + length;
+  while (length > 0)
+  {
+    if ((sha->fill EQUALS 0) && (length >= sizeof (sha->block)))
+    {
+      oo_sha256_block (sha, data);
+      data = data + sizeof (sha->block);
+      length = length - sizeof (sha->block);
+    }
+    else
+    {
+      take = sizeof (sha->block) - sha->fill;
+      if (take > length)
+        take = length;
+      memcpy (sha->block + sha->fill, data, take);
+      sha->fill = sha->fill + take;
+      data = data + take;
+      length = length - take;
+      if (sha->fill EQUALS sizeof (sha->block))
+      {
+        oo_sha256_block (sha, sha->block);
+        sha->fill = 0;
+      };
+    };
+  };
+
+} /* oo_sha256_update */
+
+
+void
+  oo_sha256_final
+    (OO_SHA256_CTX *sha,
+    unsigned char digest [OO_SHA256_OCTETS])
+
+{ /* oo_sha256_final */
+
+  unsigned long long bits;
+  int i;
+
+
+  bits = sha->length * 8;
+  sha->block [sha->fill++] = 0x80;
+  if (sha->fill > 56)
+  {
+    memset (sha->block + sha->fill, 0, sizeof (sha->block) - sha->fill);
+    oo_sha256_block (sha, sha->block);
+    sha->fill = 0;
+  };
+  memset (sha->block + sha->fill, 0, 56 - sha->fill);
+  for (i=0; i<8; i++)
+    sha->block [63-i] = (unsigned char)(bits >> (8*i));
+  oo_sha256_block (sha, sha->block);
+  for (i=0; i<8; i++)
+  {
+    digest [4*i] = (unsigned char)(sha->state [i] >> 24);
+    digest [4*i+1] = (unsigned char)(sha->state [i] >> 16);
+    digest [4*i+2] = (unsigned char)(sha->state [i] >> 8);
+    digest [4*i+3] = (unsigned char)(sha->state [i]);
+  };
+
+} /* oo_sha256_final */
+
+
+/*
+  oo_sha256_hex - digest as lower case hex (2*OO_SHA256_OCTETS+1 octets)
+*/
+
+void
+  oo_sha256_hex
+    (unsigned char digest [OO_SHA256_OCTETS],
+    char *hex)
+
+{ /* oo_sha256_hex */
+
+  int i;
+
+
+  for (i=0; i<OO_SHA256_OCTETS; i++)
+    sprintf (hex + 2*i, "%02x", digest [i]);
+
+} /* oo_sha256_hex */
@@ -0,0 +1,537 @@
+/*
+  oo-snapshot - binary snapshot of the resolved configuration
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  the first start in a directory parses the JSON as always and notes which
+  bytes of the context (and of the few globals the settings touch) each
+  step changed.  those changes go in osdp-config-snapshot.bin.  later starts
+  read that in one go and, if the parameters file, the saved parameters, the
+  saved credentials and the program itself are unchanged since, put the
+  same bytes back instead of parsing anything.
+
+  a snapshot is only good for the build that wrote it.  delete it to force
+  the JSON to be read.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include <osdp-tls.h>
+#include <open-osdp.h>
+
+
+extern OSDP_PARAMETERS p_card;
+extern OSDP_TLS_CONFIG osdp_tls_config;
+extern unsigned char special_pdcap_list [];
+
+
+#define OO_SNAPSHOT_MAGIC    "OOSNAP01"
+#define OO_SNAPSHOT_VERSION  (1)
+#define OO_SNAPSHOT_SOURCES  (4)
+#define OO_SNAPSHOT_MAX      (128*1024)
+#define OO_SNAPSHOT_GAP      (16) // unchanged octets folded into a run rather than starting another
+
+#define OO_SNAPSHOT_REGION_STATUS     (0)
+#define OO_SNAPSHOT_REGION_CONTEXT    (1)
+#define OO_SNAPSHOT_REGION_CARD       (2)
+#define OO_SNAPSHOT_REGION_TLS        (3)
+#define OO_SNAPSHOT_REGION_PDCAP      (4)
+#define OO_SNAPSHOT_REGION_CHECK      (5)
+#define OO_SNAPSHOT_REGION_BIO        (6)
+#define OO_SNAPSHOT_REGIONS           (7)
+
+#define OO_SNAPSHOT_UNKNOWN   (0)
+#define OO_SNAPSHOT_LOADED    (1)
+#define OO_SNAPSHOT_RECORDING (2)
+#define OO_SNAPSHOT_DONE      (3)
+
+typedef struct oo_snapshot_source
+{
+  long long inode;
+  long long size; // -1 if the file isn't there
+  long long mtime_sec;
+  long long mtime_nsec;
+} OO_SNAPSHOT_SOURCE;
+
+typedef struct oo_snapshot_header
+{
+  char magic [8];
+  int version;
+  int context_size;
+  int card_size;
+  int tls_size;
+  char parameters_path [1024];
+  OO_SNAPSHOT_SOURCE source [OO_SNAPSHOT_SOURCES];
+  int payload_length;
+  unsigned char digest [OO_SHA256_OCTETS];
+} OO_SNAPSHOT_HEADER;
+
+// a run is followed by length octets to go at offset in region.  a status run has none, offset is the status
+
+typedef struct oo_snapshot_run
+{
+  unsigned short phase;
+  unsigned short region;
+  int offset;
+  int length;
+} OO_SNAPSHOT_RUN;
+
+
+#define OO_SNAPSHOT_BEFORE_SIZE (sizeof (OSDP_CONTEXT) + sizeof (OSDP_PARAMETERS) + sizeof (OSDP_TLS_CONFIG) + 32*3 + sizeof (int) + 8192)
+
+// only needed while recording.  mapped for that and given back after, so a running instance doesn't carry it
+static unsigned char *oo_snapshot_before;
+static unsigned char oo_snapshot_buffer [sizeof (OO_SNAPSHOT_HEADER) + OO_SNAPSHOT_MAX];
+static int oo_snapshot_length;
+static OO_SNAPSHOT_SOURCE oo_snapshot_source [OO_SNAPSHOT_SOURCES];
+static int oo_snapshot_state;
+
+
+static void
+  oo_snapshot_digest
+    (unsigned char *payload,
+    int payload_length,
+    unsigned char digest [OO_SHA256_OCTETS])
+
+{ /* oo_snapshot_digest */
+
+  OO_SHA256_CTX sha;
+
+
+  oo_sha256_init (&sha);
+  oo_sha256_update (&sha, payload, payload_length);
+  oo_sha256_final (&sha, digest);
+
+} /* oo_snapshot_digest */
+
+
+/*
+  oo_snapshot_region - where a region lives and how big it is
+*/
+
+static unsigned char *
+  oo_snapshot_region
+    (OSDP_CONTEXT *ctx,
+    int region,
+    int *size)
+
+{ /* oo_snapshot_region */
+
+  unsigned char *location;
+
+
+  location = NULL;
+  *size = 0;
+  switch (region)
+  {
+  case OO_SNAPSHOT_REGION_CONTEXT:
+    location = (unsigned char *)ctx;
+    *size = sizeof (*ctx);
+    break;
+  case OO_SNAPSHOT_REGION_CARD:
+    location = (unsigned char *)&p_card;
+    *size = sizeof (p_card);
+    break;
+  case OO_SNAPSHOT_REGION_TLS:
+    location = (unsigned char *)&osdp_tls_config;
+    *size = sizeof (osdp_tls_config);
+    break;
+  case OO_SNAPSHOT_REGION_PDCAP:
+    location = special_pdcap_list;
+    *size = 32*3;
+    break;
+  case OO_SNAPSHOT_REGION_CHECK:
+    location = (unsigned char *)&m_check;
+    *size = sizeof (m_check);
+    break;
+  case OO_SNAPSHOT_REGION_BIO:
+    location = (unsigned char *)saved_bio_template;
+    *size = 8192;
+    break;
+  };
+  return (location);
+
+} /* oo_snapshot_region */
+
+
+static void
+  oo_snapshot_sources
+    (OSDP_CONTEXT *ctx,
+    OO_SNAPSHOT_SOURCE source [OO_SNAPSHOT_SOURCES])
+
+{ /* oo_snapshot_sources */
+
+  int i;
+  char *path [OO_SNAPSHOT_SOURCES];
+  struct stat sb;
+
+
+  path [0] = ctx->init_parameters_path;
+  path [1] = OSDP_SAVED_PARAMETERS;
+  path [2] = OSDP_SAVED_CREDENTIALS;
+  path [3] = "/proc/self/exe";
+  memset (source, 0, OO_SNAPSHOT_SOURCES * sizeof (source [0]));
+  for (i=0; i<OO_SNAPSHOT_SOURCES; i++)
+  {
+    source [i].size = -1;
+    if (stat (path [i], &sb) EQUALS 0)
+    {
+      source [i].inode = sb.st_ino;
+      source [i].size = sb.st_size;
+      source [i].mtime_sec = sb.st_mtim.tv_sec;
+      source [i].mtime_nsec = sb.st_mtim.tv_nsec;
+    };
+  };
+
+} /* oo_snapshot_sources */
+
+
+/*
+  oo_snapshot_read - one read of the snapshot, good only if it matches what's on disk now
+*/
+
+static int
+  oo_snapshot_read
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_snapshot_read */
+
+  unsigned char digest [OO_SHA256_OCTETS];
+  OO_SNAPSHOT_HEADER *header;
+  OO_SNAPSHOT_SOURCE source [OO_SNAPSHOT_SOURCES];
+  int sf;
+  int status;
+  int status_io;
+
+
+  status = ST_OK;
+  header = (OO_SNAPSHOT_HEADER *)oo_snapshot_buffer;
+  status_io = 0;
+  sf = open (OSDP_CONFIG_SNAPSHOT, O_RDONLY);
+  if (sf EQUALS -1)
+    status = ST_SNAPSHOT_STALE;
+  if (status EQUALS ST_OK)
+  {
+    status_io = read (sf, oo_snapshot_buffer, sizeof (oo_snapshot_buffer));
+    close (sf);
+    if (status_io < (int)sizeof (*header))
+      status = ST_SNAPSHOT_STALE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    if ((memcmp (header->magic, OO_SNAPSHOT_MAGIC, sizeof (header->magic)) != 0) ||
+      (header->version != OO_SNAPSHOT_VERSION) ||
+      (header->context_size != sizeof (OSDP_CONTEXT)) ||
+      (header->card_size != sizeof (OSDP_PARAMETERS)) ||
+      (header->tls_size != sizeof (OSDP_TLS_CONFIG)) ||
+      (header->payload_length != status_io - (int)sizeof (*header)))
+      status = ST_SNAPSHOT_STALE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    oo_snapshot_sources (ctx, source);
+    if ((strcmp (header->parameters_path, ctx->init_parameters_path) != 0) ||
+      (memcmp (header->source, source, sizeof (source)) != 0))
+      status = ST_SNAPSHOT_STALE;
+  };
+  if (status EQUALS ST_OK)
+  {
+    oo_snapshot_digest (oo_snapshot_buffer + sizeof (*header), header->payload_length, digest);
+    if (memcmp (digest, header->digest, sizeof (digest)) != 0)
+      status = ST_SNAPSHOT_STALE;
+  };
+  if (status EQUALS ST_OK)
+    oo_snapshot_length = header->payload_length;
+  return (status);
+
+} /* oo_snapshot_read */
+
+
+/*
+  oo_snapshot_apply - put back what a phase changed.  ST_SNAPSHOT_STALE if the phase isn't in the snapshot.
+*/
+
+static int
+  oo_snapshot_apply
+    (OSDP_CONTEXT *ctx,
+    int phase,
+    int *phase_status)
+
+{ /* oo_snapshot_apply */
+
+  unsigned char *location;
+  unsigned char *p;
+  OO_SNAPSHOT_RUN run;
+  int size;
+  int status;
+
+
+  status = ST_SNAPSHOT_STALE;
+  p = oo_snapshot_buffer + sizeof (OO_SNAPSHOT_HEADER);
+  while (p + sizeof (run) <= oo_snapshot_buffer + sizeof (OO_SNAPSHOT_HEADER) + oo_snapshot_length)
+  {
+    memcpy (&run, p, sizeof (run));
+    p = p + sizeof (run);
+    if (run.phase EQUALS phase)
+    {
+      if (run.region EQUALS OO_SNAPSHOT_REGION_STATUS)
+      {
+        *phase_status = run.offset;
+        status = ST_OK;
+      }
+      else
+      {
+        location = oo_snapshot_region (ctx, run.region, &size);
+        if ((location != NULL) && (run.offset >= 0) && (run.length >= 0) && (run.offset + run.length <= size))
+          memcpy (location + run.offset, p, run.length);
+      };
+    };
+    p = p + run.length;
+  };
+  return (status);
+
+} /* oo_snapshot_apply */
+
+
+static int
+  oo_snapshot_append
+    (int phase,
+    int region,
+    int offset,
+    unsigned char *data,
+    int length)
+
+{ /* oo_snapshot_append */
+
+  unsigned char *p;
+  OO_SNAPSHOT_RUN run;
+
+
+  if (oo_snapshot_length + (int)sizeof (run) + length > OO_SNAPSHOT_MAX)
+    return (ST_SNAPSHOT_STALE);
+  p = oo_snapshot_buffer + sizeof (OO_SNAPSHOT_HEADER) + oo_snapshot_length;
+  run.phase = phase;
+  run.region = region;
+  run.offset = offset;
+  run.length = length;
+  memcpy (p, &run, sizeof (run));
+  if (length > 0)
+    memcpy (p + sizeof (run), data, length);
+  oo_snapshot_length = oo_snapshot_length + sizeof (run) + length;
+  return (ST_OK);
+
+} /* oo_snapshot_append */
+
+
+/*
+  oo_snapshot_begin - start a configuration phase
+
+  returns ST_OK if the snapshot had the phase, it's been applied and
+  phase_status is what the phase returned when it really ran.  otherwise
+  returns ST_SNAPSHOT_STALE and the caller does the work then calls
+  oo_snapshot_end.
+*/
+
+int
+  oo_snapshot_begin
+    (OSDP_CONTEXT *ctx,
+    int phase,
+    int *phase_status)
+
+{ /* oo_snapshot_begin */
+
+  unsigned char *before;
+  unsigned char *location;
+  int region;
+  int size;
+  int status;
+
+
+  status = ST_SNAPSHOT_STALE;
+  if (oo_snapshot_state EQUALS OO_SNAPSHOT_UNKNOWN)
+  {
+    oo_snapshot_state = OO_SNAPSHOT_RECORDING;
+    oo_snapshot_length = 0;
+    if (oo_snapshot_read (ctx) EQUALS ST_OK)
+    {
+      oo_snapshot_state = OO_SNAPSHOT_LOADED;
+      fprintf (ctx->log, "Configuration loaded from %s\n", OSDP_CONFIG_SNAPSHOT);
+    }
+    else
+    {
+      // what the files were as they're about to be read, not as they are when the snapshot is written
+      oo_snapshot_length = 0;
+      oo_snapshot_sources (ctx, oo_snapshot_source);
+      oo_snapshot_before = mmap (NULL, OO_SNAPSHOT_BEFORE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (oo_snapshot_before EQUALS MAP_FAILED)
+      {
+        oo_snapshot_before = NULL;
+        oo_snapshot_state = OO_SNAPSHOT_DONE;
+      };
+    };
+  };
+  if (oo_snapshot_state EQUALS OO_SNAPSHOT_LOADED)
+    status = oo_snapshot_apply (ctx, phase, phase_status);
+  if (oo_snapshot_state EQUALS OO_SNAPSHOT_RECORDING)
+  {
+    before = oo_snapshot_before;
+    for (region=OO_SNAPSHOT_REGION_CONTEXT; region<OO_SNAPSHOT_REGIONS; region++)
+    {
+      location = oo_snapshot_region (ctx, region, &size);
+      memcpy (before, location, size);
+      before = before + size;
+    };
+  };
+  return (status);
+
+} /* oo_snapshot_begin */
+
+
+/*
+  oo_snapshot_end - note what a phase that really ran changed
+*/
+
+void
+  oo_snapshot_end
+    (OSDP_CONTEXT *ctx,
+    int phase,
+    int phase_status)
+
+{ /* oo_snapshot_end */
+
+  unsigned char *before;
+  int first;
+  int i;
+  int last;
+  unsigned char *location;
+  int region;
+  int size;
+  int status;
+
+
+  if (oo_snapshot_state != OO_SNAPSHOT_RECORDING)
+    return;
+  status = oo_snapshot_append (phase, OO_SNAPSHOT_REGION_STATUS, phase_status, NULL, 0);
+  before = oo_snapshot_before;
+  for (region=OO_SNAPSHOT_REGION_CONTEXT; region<OO_SNAPSHOT_REGIONS; region++)
+  {
+    location = oo_snapshot_region (ctx, region, &size);
+    i = 0;
+    while ((status EQUALS ST_OK) && (i < size))
+    {
+      if (location [i] EQUALS before [i])
+      {
+        i++;
+        continue;
+      };
+
+      // a run goes on until there are OO_SNAPSHOT_GAP unchanged octets in a row
+
+      first = i;
+      last = i;
+      while ((i < size) && (i - last <= OO_SNAPSHOT_GAP))
+      {
+        if (location [i] != before [i])
+          last = i;
+        i++;
+      };
+      status = oo_snapshot_append (phase, region, first, location + first, last + 1 - first);
+    };
+    before = before + size;
+  };
+
+  // too much changed to be worth keeping, just parse it every time
+  if (status != ST_OK)
+  {
+    oo_snapshot_state = OO_SNAPSHOT_DONE;
+    (void) munmap (oo_snapshot_before, OO_SNAPSHOT_BEFORE_SIZE);
+    oo_snapshot_before = NULL;
+  };
+
+} /* oo_snapshot_end */
+
+
+/*
+  oo_snapshot_save - write the snapshot if this start had to do the work
+
+  built to the side and renamed so another instance never reads half of one.
+*/
+
+int
+  oo_snapshot_save
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_snapshot_save */
+
+  OO_SNAPSHOT_HEADER *header;
+  int sf;
+  int status;
+  int status_io;
+  char temp_path [1024];
+
+
+  status = ST_OK;
+  if (oo_snapshot_state != OO_SNAPSHOT_RECORDING)
+    return (ST_OK);
+  oo_snapshot_state = OO_SNAPSHOT_DONE;
+  (void) munmap (oo_snapshot_before, OO_SNAPSHOT_BEFORE_SIZE);
+  oo_snapshot_before = NULL;
+
+  header = (OO_SNAPSHOT_HEADER *)oo_snapshot_buffer;
+  memset (header, 0, sizeof (*header));
+  memcpy (header->magic, OO_SNAPSHOT_MAGIC, sizeof (header->magic));
+  header->version = OO_SNAPSHOT_VERSION;
+  header->context_size = sizeof (OSDP_CONTEXT);
+  header->card_size = sizeof (OSDP_PARAMETERS);
+  header->tls_size = sizeof (OSDP_TLS_CONFIG);
+  strncpy (header->parameters_path, ctx->init_parameters_path, sizeof (header->parameters_path)-1);
+  memcpy (header->source, oo_snapshot_source, sizeof (header->source));
+  header->payload_length = oo_snapshot_length;
+  oo_snapshot_digest (oo_snapshot_buffer + sizeof (*header), oo_snapshot_length, header->digest);
+
+  snprintf (temp_path, sizeof (temp_path), "%s.new", OSDP_CONFIG_SNAPSHOT);
+  sf = open (temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (sf EQUALS -1)
+    status = ST_SNAPSHOT_STALE;
+  if (status EQUALS ST_OK)
+  {
+    status_io = write (sf, oo_snapshot_buffer, sizeof (*header) + oo_snapshot_length);
+    close (sf);
+    if (status_io != (int)sizeof (*header) + oo_snapshot_length)
+      status = ST_SNAPSHOT_STALE;
+  };
+  if (status EQUALS ST_OK)
+    if (rename (temp_path, OSDP_CONFIG_SNAPSHOT) != 0)
+      status = ST_SNAPSHOT_STALE;
+  if (status != ST_OK)
+    (void) unlink (temp_path);
+  if (ctx->verbosity > 3)
+    fprintf (ctx->log, "Configuration snapshot %s written (%d. octets, status %d)\n",
+      OSDP_CONFIG_SNAPSHOT, oo_snapshot_length, status);
+  return (status);
+
+} /* oo_snapshot_save */
@@ -0,0 +1,1211 @@
+/*
+  oo-transport - line transports (serial, TCP, TLS)
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  every transport is a table of open/read/write/close routines.  all of
+  them leave a descriptor in ctx->fd for the event loop to select on and
+  move octets in and out unchanged, so the framer and the rest of the
+  protocol engine are the same whatever is underneath.
+
+  when a stream's peer goes away the descriptor is closed and ctx->fd is
+  -1 until oo_transport_reconnect, called from the event loop, has a new
+  connection: the server accepts when the listener (which the event loop
+  selects on) is readable, the client starts a non-blocking connect and
+  waits for it to be writable, backing off from OO_TRANSPORT_RETRY_MIN_MSEC
+  to OO_TRANSPORT_RETRY_MAX_MSEC between failed attempts.  nothing blocks
+  the event loop but a client's name lookup and the TLS handshake.
+
+  a stream write the socket doesn't take all of is queued, in order, up
+  to OO_TRANSPORT_OUTPUT_MAX octets.  the event loop selects for writing
+  while anything is queued and calls oo_transport_flush when it can go,
+  so a frame is never dropped or cut short and nothing waits.  a peer
+  that lets the queue fill is disconnected.
+
+  "transport" in the settings picks one:
+    serial      - the RS-485 tty named by "serial-device" (the default)
+    tcp-client  - connect to "network-address" port "port" (ACU side)
+    tcp-server  - listen on "port" and take one connection (PD side)
+    tls-client  - tcp-client wrapped in TLS
+    tls-server  - tcp-server wrapped in TLS
+
+  TLS uses GnuTLS and is only built if OSDP_TLS is defined (see
+  MORE_COMPILE_SWITCHES in src-lib/Makefile and TLS_LIBS in src-485/Makefile.)
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef OSDP_TLS
+#include <gnutls/gnutls.h>
+#endif
+
+
+#include <osdp-tls.h>
+#include <open-osdp.h>
+
+
+OSDP_TLS_CONFIG osdp_tls_config;
+int oo_tcp_client_socket (OSDP_CONTEXT *ctx, int nonblocking, int *sfd, int *in_progress);
+void oo_tcp_connected (OSDP_CONTEXT *ctx, int sfd);
+int oo_tcp_open (OSDP_CONTEXT *ctx, char *device);
+int oo_tcp_read (OSDP_CONTEXT *ctx, unsigned char *buffer, int buffer_max);
+int oo_tcp_write (OSDP_CONTEXT *ctx, unsigned char *buffer, int lth);
+int oo_tcp_close (OSDP_CONTEXT *ctx);
+int oo_tcp_flush (OSDP_CONTEXT *ctx);
+int oo_serial_open (OSDP_CONTEXT *ctx, char *device);
+int oo_serial_read (OSDP_CONTEXT *ctx, unsigned char *buffer, int buffer_max);
+int oo_serial_write (OSDP_CONTEXT *ctx, unsigned char *buffer, int lth);
+int oo_serial_close (OSDP_CONTEXT *ctx);
+int oo_tls_open (OSDP_CONTEXT *ctx, char *device);
+int oo_tls_read (OSDP_CONTEXT *ctx, unsigned char *buffer, int buffer_max);
+int oo_tls_write (OSDP_CONTEXT *ctx, unsigned char *buffer, int lth);
+int oo_tls_close (OSDP_CONTEXT *ctx);
+int oo_tls_pending (OSDP_CONTEXT *ctx);
+int oo_tls_handshake (OSDP_CONTEXT *ctx);
+int oo_tls_flush (OSDP_CONTEXT *ctx);
+
+OSDP_TRANSPORT
+  osdp_transports [] =
+  {
+    { OSDP_TRANSPORT_SERIAL, "serial",
+      oo_serial_open, oo_serial_read, oo_serial_write, oo_serial_close, NULL, NULL },
+    { OSDP_TRANSPORT_TCP_CLIENT, "tcp-client",
+      oo_tcp_open, oo_tcp_read, oo_tcp_write, oo_tcp_close, NULL, oo_tcp_flush },
+    { OSDP_TRANSPORT_TCP_SERVER, "tcp-server",
+      oo_tcp_open, oo_tcp_read, oo_tcp_write, oo_tcp_close, NULL, oo_tcp_flush },
+    { OSDP_TRANSPORT_TLS_CLIENT, "tls-client",
+      oo_tls_open, oo_tls_read, oo_tls_write, oo_tls_close, oo_tls_pending, oo_tls_flush },
+    { OSDP_TRANSPORT_TLS_SERVER, "tls-server",
+      oo_tls_open, oo_tls_read, oo_tls_write, oo_tls_close, oo_tls_pending, oo_tls_flush },
+    { 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+  };
+
+int oo_transport_listen_fd = -1; // server side listener, kept across reconnects
+int oo_transport_connect_fd = -1; // client side connect under way
+struct timespec oo_transport_retry_at; // client side, when to try connecting again
+int oo_transport_retry_msec; // client side, the current backoff
+unsigned char oo_transport_output [OO_TRANSPORT_OUTPUT_MAX]; // stream octets the socket hasn't taken yet
+int oo_transport_output_length;
+int oo_transport_output_again; // TLS: length of the send to repeat after GNUTLS_E_AGAIN, 0 if none
+#ifdef OSDP_TLS
+gnutls_certificate_credentials_t oo_tls_credentials;
+gnutls_session_t oo_tls_session;
+int oo_tls_initialized;
+#endif
+
+
+/*
+  oo_transport_lookup - find a transport by its settings name
+*/
+
+int
+  oo_transport_lookup
+    (char *name,
+    int *transport_type)
+
+{ /* oo_transport_lookup */
+
+  int i;
+  int status;
+
+
+  status = ST_OSDP_TRANSPORT_UNKNOWN;
+  for (i=0; osdp_transports [i].name != NULL; i++)
+  {
+    if (0 EQUALS strcmp (name, osdp_transports [i].name))
+    {
+      *transport_type = osdp_transports [i].transport_type;
+      status = ST_OK;
+    };
+  };
+  return (status);
+
+} /* oo_transport_lookup */
+
+
+/*
+  oo_transport_open - open whichever transport was configured
+*/
+
+int
+  oo_transport_open
+    (OSDP_CONTEXT *ctx,
+    char *device)
+
+{ /* oo_transport_open */
+
+  int i;
+  int status;
+
+
+  status = ST_OSDP_TRANSPORT_UNKNOWN;
+  ctx->transport = NULL;
+  for (i=0; osdp_transports [i].name != NULL; i++)
+    if (osdp_transports [i].transport_type EQUALS ctx->transport_type)
+      ctx->transport = &(osdp_transports [i]);
+  if (ctx->transport != NULL)
+  {
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
+      fprintf (ctx->log, "Transport %s\n", ctx->transport->name);
+    status = (*(ctx->transport->t_open)) (ctx, device);
+  };
+  return (status);
+
+} /* oo_transport_open */
+
+
+/*
+  oo_transport_read - read octets from the line
+
+  returns the count read or -1 if nothing was read.  a stream transport
+  whose peer went away is closed (ctx->fd is -1) for oo_transport_reconnect.
+*/
+
+int
+  oo_transport_read
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int buffer_max)
+
+{ /* oo_transport_read */
+
+  return ((*(ctx->transport->t_read)) (ctx, buffer, buffer_max));
+
+} /* oo_transport_read */
+
+
+int
+  oo_transport_write
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int lth)
+
+{ /* oo_transport_write */
+
+  // the lone 0xff mark sent ahead of a frame isn't one
+  if ((lth > 1) || ((lth EQUALS 1) && (buffer [0] != 0xff)))
+    oo_recorder_frame (ctx, OO_RECORDER_OUT, buffer, lth, ST_OK, NULL);
+  return ((*(ctx->transport->t_write)) (ctx, buffer, lth));
+
+} /* oo_transport_write */
+
+
+int
+  oo_transport_close
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_transport_close */
+
+  int status;
+
+
+  status = ST_OK;
+  if (ctx->transport != NULL)
+    status = (*(ctx->transport->t_close)) (ctx);
+  return (status);
+
+} /* oo_transport_close */
+
+
+/*
+  oo_transport_pending - octets already buffered above the descriptor
+
+  TLS decrypts whole records so input can be waiting even though select
+  says the descriptor is idle.
+*/
+
+int
+  oo_transport_pending
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_transport_pending */
+
+  int pending;
+
+
+  pending = 0;
+  if (ctx->transport != NULL)
+    if (ctx->transport->t_pending != NULL)
+      pending = (*(ctx->transport->t_pending)) (ctx);
+  return (pending);
+
+} /* oo_transport_pending */
+
+
+/*
+  oo_transport_flush - send what's queued.  called from the event loop
+  when select says the line can be written.
+*/
+
+int
+  oo_transport_flush
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_transport_flush */
+
+  int status;
+
+
+  status = ST_OK;
+  if ((ctx->fd != -1) && (oo_transport_output_length > 0) && (ctx->transport != NULL))
+    if (ctx->transport->t_flush != NULL)
+      status = (*(ctx->transport->t_flush)) (ctx);
+  return (status);
+
+} /* oo_transport_flush */
+
+
+/*
+  oo_transport_queue - keep what a stream write didn't send, for oo_transport_flush
+
+  a peer that lets OO_TRANSPORT_OUTPUT_MAX octets back up is hung up on.
+*/
+
+static int
+  oo_transport_queue
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int lth)
+
+{ /* oo_transport_queue */
+
+  int status;
+
+
+  status = ST_OK;
+  if ((oo_transport_output_length + lth) > OO_TRANSPORT_OUTPUT_MAX)
+  {
+    fprintf (ctx->log, "Peer not reading (%d. octets queued), disconnecting\n",
+      oo_transport_output_length);
+    (void) oo_transport_close (ctx);
+    oo_transport_disconnected (ctx);
+    status = ST_OSDP_TRANSPORT_OPEN;
+  }
+  else
+  {
+    memcpy (oo_transport_output + oo_transport_output_length, buffer, lth);
+    oo_transport_output_length = oo_transport_output_length + lth;
+  };
+  return (status);
+
+} /* oo_transport_queue */
+
+
+/*
+  oo_transport_sent - drop what the socket took from the front of the queue
+*/
+
+static void
+  oo_transport_sent
+    (int count)
+
+{ /* oo_transport_sent */
+
+  if (count > oo_transport_output_length)
+    count = oo_transport_output_length;
+  oo_transport_output_length = oo_transport_output_length - count;
+  if (oo_transport_output_length > 0)
+    memmove (oo_transport_output, oo_transport_output + count, oo_transport_output_length);
+
+} /* oo_transport_sent */
+
+
+/*
+  oo_transport_backoff - client: when to try the next connect
+*/
+
+static void
+  oo_transport_backoff
+    (int failed)
+
+{ /* oo_transport_backoff */
+
+  clock_gettime (CLOCK_MONOTONIC, &oo_transport_retry_at);
+  if (!failed)
+  {
+    oo_transport_retry_msec = 0;
+    return;
+  };
+  if (oo_transport_retry_msec EQUALS 0)
+    oo_transport_retry_msec = OO_TRANSPORT_RETRY_MIN_MSEC;
+  else
+    oo_transport_retry_msec = 2 * oo_transport_retry_msec;
+  if (oo_transport_retry_msec > OO_TRANSPORT_RETRY_MAX_MSEC)
+    oo_transport_retry_msec = OO_TRANSPORT_RETRY_MAX_MSEC;
+  oo_transport_retry_at.tv_nsec = oo_transport_retry_at.tv_nsec + (long)oo_transport_retry_msec * 1000000L;
+  oo_transport_retry_at.tv_sec = oo_transport_retry_at.tv_sec + oo_transport_retry_at.tv_nsec / 1000000000L;
+  oo_transport_retry_at.tv_nsec = oo_transport_retry_at.tv_nsec % 1000000000L;
+
+} /* oo_transport_backoff */
+
+
+/*
+  oo_transport_disconnected - a stream transport lost its peer
+
+  a client tries to connect again straight away, then backs off.
+*/
+
+void
+  oo_transport_disconnected
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_transport_disconnected */
+
+  oo_transport_backoff (0);
+
+} /* oo_transport_disconnected */
+
+
+/*
+  oo_transport_established - a new connection becomes the line
+*/
+
+static int
+  oo_transport_established
+    (OSDP_CONTEXT *ctx,
+    int sfd)
+
+{ /* oo_transport_established */
+
+  int status;
+
+
+  status = ST_OK;
+
+  // blocking for the TLS handshake, non-blocking after like the startup connection
+  (void) fcntl (sfd, F_SETFL, fcntl (sfd, F_GETFL, 0) & ~O_NONBLOCK);
+  oo_tcp_connected (ctx, sfd);
+  if ((ctx->transport_type EQUALS OSDP_TRANSPORT_TLS_CLIENT) ||
+    (ctx->transport_type EQUALS OSDP_TRANSPORT_TLS_SERVER))
+    status = oo_tls_handshake (ctx);
+  if (status EQUALS ST_OK)
+    if (fcntl (ctx->fd, F_SETFL, fcntl (ctx->fd, F_GETFL, 0) | O_NONBLOCK) EQUALS -1)
+      status = ST_OSDP_TRANSPORT_OPEN;
+  if ((status != ST_OK) && (ctx->fd != -1))
+  {
+    close (ctx->fd);
+    ctx->fd = -1;
+  };
+  return (status);
+
+} /* oo_transport_established */
+
+
+/*
+  oo_transport_reconnect - get the line back after the peer went away
+
+  called from the event loop on each pass while ctx->fd is -1, with the
+  descriptor sets oo_transport_select filled in and select returned.
+  never waits.
+*/
+
+int
+  oo_transport_reconnect
+    (OSDP_CONTEXT *ctx,
+    fd_set *readfds,
+    fd_set *writefds)
+
+{ /* oo_transport_reconnect */
+
+  int in_progress;
+  struct timespec now;
+  int sfd;
+  int so_error;
+  socklen_t so_error_length;
+  int status;
+
+
+  status = ST_OK;
+  if ((ctx->fd != -1) || (ctx->transport_type EQUALS OSDP_TRANSPORT_SERIAL))
+    return (status);
+
+  if ((ctx->transport_type EQUALS OSDP_TRANSPORT_TCP_SERVER) ||
+    (ctx->transport_type EQUALS OSDP_TRANSPORT_TLS_SERVER))
+  {
+    if (oo_transport_listen_fd != -1)
+      if (FD_ISSET (oo_transport_listen_fd, readfds))
+      {
+        sfd = accept (oo_transport_listen_fd, NULL, NULL);
+        if (sfd != -1)
+          status = oo_transport_established (ctx, sfd);
+      };
+  }
+  else
+  {
+    if (oo_transport_connect_fd != -1)
+    {
+      if (FD_ISSET (oo_transport_connect_fd, writefds))
+      {
+        sfd = oo_transport_connect_fd;
+        oo_transport_connect_fd = -1;
+        so_error = 0;
+        so_error_length = sizeof (so_error);
+        (void) getsockopt (sfd, SOL_SOCKET, SO_ERROR, &so_error, &so_error_length);
+        if (so_error EQUALS 0)
+          status = oo_transport_established (ctx, sfd);
+        else
+        {
+          fprintf (ctx->log, "Connect failed, errno %d\n", so_error);
+          close (sfd);
+          status = ST_OSDP_TRANSPORT_OPEN;
+        };
+        oo_transport_backoff (status != ST_OK);
+      };
+    }
+    else
+    {
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      if ((now.tv_sec > oo_transport_retry_at.tv_sec) ||
+        ((now.tv_sec EQUALS oo_transport_retry_at.tv_sec) && (now.tv_nsec >= oo_transport_retry_at.tv_nsec)))
+      {
+        status = oo_tcp_client_socket (ctx, 1, &sfd, &in_progress);
+        if ((status EQUALS ST_OK) && in_progress)
+          oo_transport_connect_fd = sfd;
+        else
+        {
+          if (status EQUALS ST_OK)
+            status = oo_transport_established (ctx, sfd);
+          oo_transport_backoff (status != ST_OK);
+        };
+      };
+    };
+  };
+  return (status);
+
+} /* oo_transport_reconnect */
+
+
+/*
+  oo_transport_select - add what the event loop waits on for the line
+
+  the line itself (for writing too if output is queued), or while it's
+  down the listener (server) or the connect under way (client.)  scount
+  is raised to cover them.
+*/
+
+void
+  oo_transport_select
+    (OSDP_CONTEXT *ctx,
+    fd_set *readfds,
+    fd_set *writefds,
+    int *scount)
+
+{ /* oo_transport_select */
+
+  if (ctx->fd != -1)
+  {
+    FD_SET (ctx->fd, readfds);
+    if (oo_transport_output_length > 0)
+      FD_SET (ctx->fd, writefds);
+    if (ctx->fd >= *scount)
+      *scount = ctx->fd+1;
+  }
+  else
+  {
+    if (oo_transport_listen_fd != -1)
+    {
+      FD_SET (oo_transport_listen_fd, readfds);
+      if (oo_transport_listen_fd >= *scount)
+        *scount = oo_transport_listen_fd+1;
+    };
+    if (oo_transport_connect_fd != -1)
+    {
+      FD_SET (oo_transport_connect_fd, writefds);
+      if (oo_transport_connect_fd >= *scount)
+        *scount = oo_transport_connect_fd+1;
+    };
+  };
+
+} /* oo_transport_select */
+
+
+/*
+  serial transport.  init_serial does the open.
+*/
+
+int
+  oo_serial_open
+    (OSDP_CONTEXT *ctx,
+    char *device)
+
+{ /* oo_serial_open */
+
+  return (init_serial (ctx, device));
+
+} /* oo_serial_open */
+
+
+int
+  oo_serial_read
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int buffer_max)
+
+{ /* oo_serial_read */
+
+  return (read (ctx->fd, buffer, buffer_max));
+
+} /* oo_serial_read */
+
+
+int
+  oo_serial_write
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int lth)
+
+{ /* oo_serial_write */
+
+  return (write (ctx->fd, buffer, lth));
+
+} /* oo_serial_write */
+
+
+int
+  oo_serial_close
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_serial_close */
+
+  if (ctx->fd != -1)
+    close (ctx->fd);
+  ctx->fd = -1;
+  return (ST_OK);
+
+} /* oo_serial_close */
+
+
+/*
+  oo_tcp_client_socket - start a connection to network-address
+
+  with nonblocking set the connect is only started: *in_progress is 1
+  until the socket is writable (see oo_transport_reconnect.)
+*/
+
+int
+  oo_tcp_client_socket
+    (OSDP_CONTEXT *ctx,
+    int nonblocking,
+    int *sfd,
+    int *in_progress)
+
+{ /* oo_tcp_client_socket */
+
+  struct addrinfo *addr;
+  struct addrinfo hints;
+  char service [32];
+  int status;
+  int status_socket;
+
+
+  status = ST_OK;
+  *sfd = -1;
+  *in_progress = 0;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  sprintf (service, "%d", ctx->listen_sap);
+  status_socket = getaddrinfo (ctx->network_address, service, &hints, &addr);
+  if (status_socket != 0)
+  {
+    fprintf (ctx->log, "Cannot resolve %s port %s: %s\n",
+      ctx->network_address, service, gai_strerror (status_socket));
+    status = ST_OSDP_TRANSPORT_OPEN;
+  };
+  if (status EQUALS ST_OK)
+  {
+    *sfd = socket (addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (*sfd != -1)
+    {
+      if (nonblocking)
+        (void) fcntl (*sfd, F_SETFL, fcntl (*sfd, F_GETFL, 0) | O_NONBLOCK);
+      fprintf (ctx->log, "Connecting to %s port %s\n", ctx->network_address, service);
+      if (connect (*sfd, addr->ai_addr, addr->ai_addrlen) EQUALS -1)
+      {
+        if (nonblocking && (errno EQUALS EINPROGRESS))
+          *in_progress = 1;
+        else
+        {
+          fprintf (ctx->log, "Connect failed, errno %d\n", errno);
+          close (*sfd);
+          *sfd = -1;
+        };
+      };
+    };
+    freeaddrinfo (addr);
+    if (*sfd EQUALS -1)
+      status = ST_OSDP_TRANSPORT_OPEN;
+  };
+  return (status);
+
+} /* oo_tcp_client_socket */
+
+
+/*
+  oo_tcp_connected - the stream is up, make it the line
+*/
+
+void
+  oo_tcp_connected
+    (OSDP_CONTEXT *ctx,
+    int sfd)
+
+{ /* oo_tcp_connected */
+
+  int one;
+
+
+  // OSDP frames are small and turn-around matters more than throughput
+  one = 1;
+  (void) setsockopt (sfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+  ctx->fd = sfd;
+  fprintf (ctx->log, "Connected, fd=%d.\n", ctx->fd);
+
+} /* oo_tcp_connected */
+
+
+/*
+  oo_tcp_connect - (blocking) set up the stream at startup.
+
+  the client connects to network-address, the server accepts one
+  connection on the listener (creating the listener the first time.)
+  the caller makes the descriptor non-blocking.  later connections are
+  made by oo_transport_reconnect without blocking.
+*/
+
+int
+  oo_tcp_connect
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tcp_connect */
+
+  int in_progress;
+  struct pollfd listener;
+  int one;
+  struct sockaddr_in server_addr;
+  int sfd;
+  int status;
+  int status_socket;
+
+
+  status = ST_OK;
+  sfd = -1;
+  if ((ctx->transport_type EQUALS OSDP_TRANSPORT_TCP_CLIENT) ||
+    (ctx->transport_type EQUALS OSDP_TRANSPORT_TLS_CLIENT))
+  {
+    status = oo_tcp_client_socket (ctx, 0, &sfd, &in_progress);
+  }
+  else
+  {
+    if (oo_transport_listen_fd EQUALS -1)
+    {
+      oo_transport_listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+      if (oo_transport_listen_fd EQUALS -1)
+        status = ST_OSDP_TRANSPORT_OPEN;
+      if (status EQUALS ST_OK)
+      {
+        one = 1;
+        (void) setsockopt (oo_transport_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        memset (&server_addr, 0, sizeof (server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_addr.s_addr = htonl (INADDR_ANY);
+        server_addr.sin_port = htons (ctx->listen_sap);
+        status_socket = bind (oo_transport_listen_fd, (struct sockaddr *)&server_addr, sizeof (server_addr));
+        if (status_socket != -1)
+          status_socket = listen (oo_transport_listen_fd, 1);
+
+        // the listener is non-blocking so the event loop never waits in accept
+        if (status_socket != -1)
+          status_socket = fcntl (oo_transport_listen_fd, F_SETFL,
+            fcntl (oo_transport_listen_fd, F_GETFL, 0) | O_NONBLOCK);
+        if (status_socket EQUALS -1)
+        {
+          fprintf (ctx->log, "Listen on port %d failed, errno %d\n", ctx->listen_sap, errno);
+          close (oo_transport_listen_fd);
+          oo_transport_listen_fd = -1;
+          status = ST_OSDP_TRANSPORT_OPEN;
+        };
+      };
+    };
+    if (status EQUALS ST_OK)
+    {
+      fprintf (ctx->log, "Waiting for connection on port %d\n", ctx->listen_sap);
+      fflush (ctx->log);
+      do
+      {
+        listener.fd = oo_transport_listen_fd;
+        listener.events = POLLIN;
+        listener.revents = 0;
+        (void) poll (&listener, 1, -1);
+        sfd = accept (oo_transport_listen_fd, NULL, NULL);
+      } while ((sfd EQUALS -1) && ((errno EQUALS EAGAIN) || (errno EQUALS EWOULDBLOCK) || (errno EQUALS EINTR)));
+      if (sfd EQUALS -1)
+        status = ST_OSDP_TRANSPORT_OPEN;
+      else
+        (void) fcntl (sfd, F_SETFL, fcntl (sfd, F_GETFL, 0) & ~O_NONBLOCK);
+    };
+  };
+  if (status EQUALS ST_OK)
+    oo_tcp_connected (ctx, sfd);
+  return (status);
+
+} /* oo_tcp_connect */
+
+
+/*
+  oo_tcp_open - TCP client or server.  device is not used.
+*/
+
+int
+  oo_tcp_open
+    (OSDP_CONTEXT *ctx,
+    char *device)
+
+{ /* oo_tcp_open */
+
+  int status;
+
+
+  status = oo_tcp_connect (ctx);
+  if (status EQUALS ST_OK)
+    if (fcntl (ctx->fd, F_SETFL, fcntl (ctx->fd, F_GETFL, 0) | O_NONBLOCK) EQUALS -1)
+      status = ST_OSDP_TRANSPORT_OPEN;
+  return (status);
+
+} /* oo_tcp_open */
+
+
+int
+  oo_tcp_read
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int buffer_max)
+
+{ /* oo_tcp_read */
+
+  int status_io;
+
+
+  if (ctx->fd EQUALS -1)
+    return (-1);
+  status_io = read (ctx->fd, buffer, buffer_max);
+  if ((status_io EQUALS 0) ||
+    ((status_io EQUALS -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)))
+  {
+    // the other end hung up.  the event loop waits for (or makes) another connection
+    fprintf (ctx->log, "Peer disconnected, waiting to reconnect\n");
+    (void) oo_tcp_close (ctx);
+    oo_transport_disconnected (ctx);
+    status_io = -1;
+  };
+  return (status_io);
+
+} /* oo_tcp_read */
+
+
+/*
+  oo_tcp_write - write or queue all of it.  returns lth, or -1 if the
+  connection is gone.
+*/
+
+int
+  oo_tcp_write
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int lth)
+
+{ /* oo_tcp_write */
+
+  int sent;
+  int status_io;
+
+
+  if (ctx->fd EQUALS -1)
+    return (-1);
+
+  // behind anything already queued, to keep the order
+  sent = 0;
+  if (oo_transport_output_length EQUALS 0)
+  {
+    status_io = write (ctx->fd, buffer, lth);
+    if (status_io > 0)
+      sent = status_io;
+    if ((status_io EQUALS -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+    {
+      fprintf (ctx->log, "Write failed, errno %d, waiting to reconnect\n", errno);
+      (void) oo_tcp_close (ctx);
+      oo_transport_disconnected (ctx);
+      return (-1);
+    };
+  };
+  if (sent < lth)
+    if (oo_transport_queue (ctx, buffer + sent, lth - sent) != ST_OK)
+      return (-1);
+  return (lth);
+
+} /* oo_tcp_write */
+
+
+/*
+  oo_tcp_flush - write what's queued, as much as the socket takes
+*/
+
+int
+  oo_tcp_flush
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tcp_flush */
+
+  int status;
+  int status_io;
+
+
+  status = ST_OK;
+  status_io = write (ctx->fd, oo_transport_output, oo_transport_output_length);
+  if (status_io > 0)
+    oo_transport_sent (status_io);
+  if ((status_io EQUALS -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+  {
+    fprintf (ctx->log, "Write failed, errno %d, waiting to reconnect\n", errno);
+    (void) oo_tcp_close (ctx);
+    oo_transport_disconnected (ctx);
+    status = ST_OSDP_TRANSPORT_OPEN;
+  };
+  return (status);
+
+} /* oo_tcp_flush */
+
+
+int
+  oo_tcp_close
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tcp_close */
+
+  if (ctx->fd != -1)
+    close (ctx->fd);
+  ctx->fd = -1;
+
+  // part of a frame means nothing to the next connection
+  oo_transport_output_length = 0;
+  return (ST_OK);
+
+} /* oo_tcp_close */
+
+
+#ifdef OSDP_TLS
+/*
+  oo_tls_handshake - TLS over the connection in ctx->fd (blocking, bounded
+  by the handshake timeout.)  on failure the connection is closed.
+*/
+
+int
+  oo_tls_handshake
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tls_handshake */
+
+  int server;
+  int status;
+  int status_tls;
+
+
+  status = ST_OK;
+  server = (ctx->transport_type EQUALS OSDP_TRANSPORT_TLS_SERVER);
+  status_tls = gnutls_init (&oo_tls_session, server ? GNUTLS_SERVER : GNUTLS_CLIENT);
+  if (status_tls >= 0)
+    status_tls = gnutls_set_default_priority (oo_tls_session);
+  if (status_tls >= 0)
+    status_tls = gnutls_credentials_set (oo_tls_session, GNUTLS_CRD_CERTIFICATE, oo_tls_credentials);
+  if (status_tls >= 0)
+  {
+    if (!server)
+    {
+      (void) gnutls_server_name_set (oo_tls_session, GNUTLS_NAME_DNS,
+        ctx->network_address, strlen (ctx->network_address));
+      if (!(ctx->disable_certificate_checking))
+        gnutls_session_set_verify_cert (oo_tls_session, ctx->network_address, 0);
+    };
+    gnutls_transport_set_int (oo_tls_session, ctx->fd);
+    gnutls_handshake_set_timeout (oo_tls_session, GNUTLS_DEFAULT_HANDSHAKE_TIMEOUT);
+    do
+    {
+      status_tls = gnutls_handshake (oo_tls_session);
+    } while ((status_tls < 0) && (gnutls_error_is_fatal (status_tls) EQUALS 0));
+  };
+  if (status_tls < 0)
+  {
+    fprintf (ctx->log, "TLS handshake failed: %s\n", gnutls_strerror (status_tls));
+    gnutls_deinit (oo_tls_session);
+    close (ctx->fd);
+    ctx->fd = -1;
+    status = ST_OSDP_TLS_SETUP;
+  };
+  if (status EQUALS ST_OK)
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
+      fprintf (ctx->log, "TLS session %s\n", gnutls_session_get_desc (oo_tls_session));
+  return (status);
+
+} /* oo_tls_handshake */
+
+
+/*
+  oo_tls_open - TCP connection then a TLS handshake.
+
+  the server needs cert_file and key_file.  the client checks the server
+  against ca_file if it exists (else the system trust store) unless
+  certificate checking was disabled, and offers cert_file if it exists.
+*/
+
+int
+  oo_tls_open
+    (OSDP_CONTEXT *ctx,
+    char *device)
+
+{ /* oo_tls_open */
+
+  int server;
+  int status;
+  int status_tls;
+
+
+  status = ST_OK;
+  server = (ctx->transport_type EQUALS OSDP_TRANSPORT_TLS_SERVER);
+  if (!oo_tls_initialized)
+  {
+    status_tls = gnutls_certificate_allocate_credentials (&oo_tls_credentials);
+    if ((status_tls >= 0) && (access (osdp_tls_config.ca_file, R_OK) EQUALS 0))
+      status_tls = gnutls_certificate_set_x509_trust_file (oo_tls_credentials,
+        osdp_tls_config.ca_file, GNUTLS_X509_FMT_PEM);
+    else
+      if (status_tls >= 0)
+        status_tls = gnutls_certificate_set_x509_system_trust (oo_tls_credentials);
+    if ((status_tls >= 0) && (server || (access (osdp_tls_config.cert_file, R_OK) EQUALS 0)))
+      status_tls = gnutls_certificate_set_x509_key_file (oo_tls_credentials,
+        osdp_tls_config.cert_file, osdp_tls_config.key_file, GNUTLS_X509_FMT_PEM);
+    if (status_tls < 0)
+    {
+      fprintf (ctx->log, "TLS credential setup failed: %s\n", gnutls_strerror (status_tls));
+      status = ST_OSDP_TLS_SETUP;
+    }
+    else
+      oo_tls_initialized = 1;
+  };
+  if (status EQUALS ST_OK)
+    status = oo_tcp_connect (ctx);
+  if (status EQUALS ST_OK)
+    status = oo_tls_handshake (ctx);
+  if (status EQUALS ST_OK)
+    if (fcntl (ctx->fd, F_SETFL, fcntl (ctx->fd, F_GETFL, 0) | O_NONBLOCK) EQUALS -1)
+      status = ST_OSDP_TRANSPORT_OPEN;
+  return (status);
+
+} /* oo_tls_open */
+
+
+int
+  oo_tls_read
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int buffer_max)
+
+{ /* oo_tls_read */
+
+  int status_io;
+
+
+  if (ctx->fd EQUALS -1)
+    return (-1);
+  status_io = gnutls_record_recv (oo_tls_session, buffer, buffer_max);
+  if ((status_io EQUALS GNUTLS_E_AGAIN) || (status_io EQUALS GNUTLS_E_INTERRUPTED))
+    status_io = -1;
+  else
+  {
+    if (status_io <= 0)
+    {
+      // the event loop waits for (or makes) another connection
+      fprintf (ctx->log, "TLS peer disconnected (%d), waiting to reconnect\n", status_io);
+      (void) oo_tls_close (ctx);
+      oo_transport_disconnected (ctx);
+      status_io = -1;
+    };
+  };
+  return (status_io);
+
+} /* oo_tls_read */
+
+
+/*
+  oo_tls_write - send or queue all of it.  returns lth, or -1 if the
+  connection is gone.
+
+  after GNUTLS_E_AGAIN gnutls wants the same send again, so what it
+  didn't take is queued whole and oo_tls_flush repeats it.
+*/
+
+int
+  oo_tls_write
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buffer,
+    int lth)
+
+{ /* oo_tls_write */
+
+  int sent;
+  int status_io;
+
+
+  if (ctx->fd EQUALS -1)
+    return (-1);
+  sent = 0;
+  if (oo_transport_output_length EQUALS 0)
+  {
+    status_io = gnutls_record_send (oo_tls_session, buffer, lth);
+    if (status_io > 0)
+      sent = status_io;
+    if ((status_io EQUALS GNUTLS_E_AGAIN) || (status_io EQUALS GNUTLS_E_INTERRUPTED))
+      oo_transport_output_again = lth;
+    else
+    {
+      if (status_io < 0)
+      {
+        fprintf (ctx->log, "TLS send failed: %s, waiting to reconnect\n", gnutls_strerror (status_io));
+        (void) oo_tls_close (ctx);
+        oo_transport_disconnected (ctx);
+        return (-1);
+      };
+    };
+  };
+  if (sent < lth)
+    if (oo_transport_queue (ctx, buffer + sent, lth - sent) != ST_OK)
+      return (-1);
+  return (lth);
+
+} /* oo_tls_write */
+
+
+/*
+  oo_tls_flush - send what's queued (the repeat of an interrupted send first)
+*/
+
+int
+  oo_tls_flush
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tls_flush */
+
+  int length;
+  int status;
+  int status_io;
+
+
+  status = ST_OK;
+  length = oo_transport_output_length;
+  if (oo_transport_output_again > 0)
+    length = oo_transport_output_again;
+  status_io = gnutls_record_send (oo_tls_session, oo_transport_output, length);
+  if ((status_io EQUALS GNUTLS_E_AGAIN) || (status_io EQUALS GNUTLS_E_INTERRUPTED))
+    oo_transport_output_again = length;
+  else
+  {
+    if (status_io < 0)
+    {
+      fprintf (ctx->log, "TLS send failed: %s, waiting to reconnect\n", gnutls_strerror (status_io));
+      (void) oo_tls_close (ctx);
+      oo_transport_disconnected (ctx);
+      status = ST_OSDP_TRANSPORT_OPEN;
+    }
+    else
+    {
+      oo_transport_output_again = 0;
+      oo_transport_sent (status_io);
+    };
+  };
+  return (status);
+
+} /* oo_tls_flush */
+
+
+int
+  oo_tls_close
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tls_close */
+
+  if (ctx->fd != -1)
+  {
+    (void) gnutls_bye (oo_tls_session, GNUTLS_SHUT_WR);
+    gnutls_deinit (oo_tls_session);
+    close (ctx->fd);
+  };
+  ctx->fd = -1;
+  oo_transport_output_length = 0;
+  oo_transport_output_again = 0;
+  return (ST_OK);
+
+} /* oo_tls_close */
+
+
+int
+  oo_tls_pending
+    (OSDP_CONTEXT *ctx)
+
+{ /* oo_tls_pending */
+
+  if (ctx->fd EQUALS -1)
+    return (0);
+  return ((int)gnutls_record_check_pending (oo_tls_session));
+
+} /* oo_tls_pending */
+#else
+/*
+  without OSDP_TLS the TLS transports only report that they are missing.
+*/
+
+int
+  oo_tls_open
+    (OSDP_CONTEXT *ctx,
+    char *device)
+
+{ /* oo_tls_open */
+
+  fprintf (ctx->log, "TLS transport requested but not built in (OSDP_TLS)\n");
+  return (ST_OSDP_TLS_SETUP);
+
+} /* oo_tls_open */
+
+
+int oo_tls_read (OSDP_CONTEXT *ctx, unsigned char *buffer, int buffer_max) { return (-1); }
+int oo_tls_write (OSDP_CONTEXT *ctx, unsigned char *buffer, int lth) { return (-1); }
+int oo_tls_close (OSDP_CONTEXT *ctx) { return (ST_OK); }
+int oo_tls_pending (OSDP_CONTEXT *ctx) { return (0); }
+int oo_tls_handshake (OSDP_CONTEXT *ctx) { return (ST_OSDP_TLS_SETUP); }
+int oo_tls_flush (OSDP_CONTEXT *ctx) { return (ST_OK); }
+#endif
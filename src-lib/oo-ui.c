@@ -272,8 +272,6 @@ fprintf(context->log, "*** DEPRECATED COMMAND use ident,config-address=1 instead
     case OSDP_CMDB_CHALLENGE:
     case OSDP_CMDB_WITNESS:
       {
-        unsigned char challenge_command [OSDP_OFFICIAL_MSG_MAX];
-        int challenge_payload_size;
         unsigned char osdp_command;
 
         status = ST_OK;
@@ -286,29 +284,18 @@ fprintf(context->log, "*** DEPRECATED COMMAND use ident,config-address=1 instead
         if (status EQUALS ST_OK)
         {
           osdp_command = OSDP_GENAUTH;
-          challenge_payload_size = sizeof(challenge_command);
+          if (command EQUALS OSDP_CMDB_CHALLENGE)
+            osdp_command = OSDP_CRAUTH;
           strcpy (context->test_in_progress, "x-challenge");
-          memset (&challenge_command, 0, sizeof (challenge_command));
 
-          status = oo_build_genauth(ctx, (unsigned char *)challenge_command, &challenge_payload_size,
-            (unsigned char *)details, details_length);
+          // the first fragment goes now, the rest as the PD ACK's each one
+
+          status = oo_mpart_send(ctx, osdp_command, (unsigned char *)details, details_length);
           if (ctx->verbosity > 3)
           {
-            fprintf(ctx->log, "  cmd %02X challenge payload size %d. (status from oo_build_genauth %d.)\n",
-              osdp_command, challenge_payload_size, status);
+            fprintf(ctx->log, "  cmd %02X challenge payload size %d. (status from oo_mpart_send %d.)\n",
+              osdp_command, details_length, status);
           };
-          if (command EQUALS OSDP_CMDB_CHALLENGE)
-            osdp_command = OSDP_CRAUTH;
-        current_length = 0;
-        status = send_message_ex(context, osdp_command, p_card.addr,
-          &current_length, challenge_payload_size, challenge_command, OSDP_SEC_SCS_17, 0, NULL);
-
-// if it was a witness, sleep a while in case it takes a while for the ACK to get back.
-if (command EQUALS OSDP_CMDB_WITNESS)
-{
-  fprintf(stderr, "DEBUG: sleep after GENAUTH send\n");
-  sleep(5);
-}
         };
       };
       break;
@@ -556,6 +543,11 @@ fprintf(stderr, "287 busy, enqueing %02x d %02x-%02x-%02x L %d.\n",
 
     case OSDP_CMDB_STOP:
       fprintf (context->log, "STOP command received.  Terminating now.\n");
+
+      // leave a checkpoint if a file transfer was under way
+      oo_fleet_stop(context);
+      if (context->xferctx.total_length > 0)
+        osdp_wrapup_filetransfer(context);
       fflush(context->log);
       exit (0);
       break;
@@ -564,6 +556,14 @@ fprintf(stderr, "287 busy, enqueing %02x d %02x-%02x-%02x L %d.\n",
       status = oo_filetransfer_initiate(context, details);
       break;
 
+    case OSDP_CMDB_FLEET_TRANSFER:
+      status = oo_fleet_initiate(context, (OO_FLEET_ARGS *)details);
+      break;
+
+    case OSDP_CMDB_PD_EVENTS:
+      status = oo_events_start(context, (OO_EVENT_ARGS *)details);
+      break;
+
     case OSDP_CMDB_XWRITE:
       {
         int payload_length;
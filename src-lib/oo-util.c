@@ -74,7 +74,7 @@ int
   oh = (OSDP_HDR *)(msg->ptr);
   if (context -> role EQUALS OSDP_ROLE_PD)
   {
-    if (context->verbosity > 9)
+    if (OO_LOG_ON (context, OO_LOG_PARSE, 10))
     {
       fprintf (context->log, "PD: command %02x\n",
         context->role);
@@ -86,7 +86,7 @@ int
     {
       if ((oh->ctrl & 0x03) EQUALS 0)
       {
-        if (context->verbosity > 3)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
           fprintf (context->log, "  ACU sent sequence 0 - resetting sequence numbers\n");
         context->next_sequence = 0;
         osdp_reset_secure_channel(context);
@@ -164,7 +164,7 @@ int
           *(msg->data_payload + 0), *(msg->data_payload + 1),
           *(msg->data_payload + 2), *(msg->data_payload + 3),
           *(msg->data_payload + 4));
-        if (context->verbosity > 3)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
           fprintf (context->log, "%s", logmsg);
         logmsg[0]=0;
       osdp_test_set_status(OOC_SYMBOL_cmd_buz, OCONFORM_EXERCISED);
@@ -191,7 +191,7 @@ int
           OSDP_NAK, p_card.addr, &current_length, nak_length, osdp_nak_response_data);
         context->sent_naks ++;
         osdp_test_set_status(OOC_SYMBOL_rep_nak, OCONFORM_EXERCISED);
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         {
           fprintf(context->log, "BUZ command rejected as command unknown.\n");
         };
@@ -236,6 +236,7 @@ int
       break;
 
     case OSDP_CRAUTH:
+    case OSDP_GENAUTH:
       status = action_osdp_CRAUTH(context, msg);
       break;
 
@@ -271,7 +272,7 @@ int
           &current_length, sizeof(osdp_pdid_response_data), osdp_pdid_response_data, current_security, 0, NULL);
         osdp_test_set_status(OOC_SYMBOL_cmd_id, OCONFORM_EXERCISED);
         osdp_test_set_status(OOC_SYMBOL_rep_device_ident, OCONFORM_EXERCISED);
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         {
           sprintf (logmsg, "Responding with OSDP_PDID");
           fprintf (context->log, "%s\n", logmsg);
@@ -296,7 +297,7 @@ int
 
         status = send_message_ex(context, OSDP_ISTATR, p_card.addr,
           &current_length, sizeof(osdp_istat_response_data), osdp_istat_response_data, OSDP_SEC_SCS_18, 0, NULL);
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         {
           sprintf (logmsg, "Responding with OSDP_ISTAT (hard-coded all zeroes)");
           fprintf (context->log, "%s\n", logmsg);
@@ -328,7 +329,7 @@ int
         count = oh->len_lsb + (oh->len_msb << 8);
         count = count - 7;
         count = count / sizeof (*led_ctl);
-        if (context->verbosity > 3)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
         {
           fprintf (context->log, "LED Control cmd count %d\n", count);
           fprintf (context->log, "LED Control Payload:\n");
@@ -354,7 +355,7 @@ int
 
             if (led_ctl->perm_control EQUALS OSDP_LED_SET)
             {
-              if (context->verbosity > 3)
+              if (OO_LOG_ON (context, OO_LOG_PARSE, 4))
               {
                 fprintf(context->log, "LED-PERM: state %d pOnT %d pOffT %d pOnCol %d pOfCol %d\n",
                   context->led [led_ctl->led].state, led_ctl->perm_on_time,
@@ -386,7 +387,7 @@ int
         status = send_message_ex (context, OSDP_ACK, p_card.addr, &current_length,
           0, NULL, OSDP_SEC_SCS_16, 0, NULL);
         context->pd_acks ++;
-        if (context->verbosity > 9)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 10))
           fprintf (stderr, "Responding with OSDP_ACK\n");
       }
       else
@@ -406,7 +407,7 @@ int
           OSDP_NAK, p_card.addr, &current_length, nak_length, osdp_nak_response_data);
         context->sent_naks ++;
         osdp_test_set_status(OOC_SYMBOL_rep_nak, OCONFORM_EXERCISED);
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         {
           fprintf(context->log, "LED command rejected as command unknown.\n");
         };
@@ -439,7 +440,7 @@ int
 
       status = send_message_ex(context, OSDP_LSTATR, p_card.addr,
         &current_length, 2, osdp_lstat_response_data, OSDP_SEC_SCS_18, 0, NULL);
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
       {
         sprintf (logmsg, "Responding with OSDP_LSTATR (T=%d P=%d)", context->tamper, context->power_report);
         fprintf (context->log, "%s\n", logmsg);
@@ -520,7 +521,7 @@ fprintf(context->log, "DEBUG3: NAK: %d.\n", osdp_nak_response_data [0]);
           OSDP_NAK, p_card.addr, &current_length, nak_length, osdp_nak_response_data);
         context->sent_naks ++;
         osdp_test_set_status(OOC_SYMBOL_rep_nak, OCONFORM_EXERCISED);
-        if (context->verbosity > 2)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
         {
           fprintf(context->log, "CMD %02x declared invalid or unknown\n", msg->msg_cmd);
         };
@@ -533,6 +534,8 @@ fprintf(context->log, "DEBUG3: NAK: %d.\n", osdp_nak_response_data [0]);
     // if we're here we think it's a whole sane response so we can say the last was processed.
     context->last_was_processed = 1;
 
+    oo_latency_response_complete (context, msg->msg_cmd);
+
     if (msg->msg_cmd EQUALS OSDP_BIOREADR)
       fprintf(stderr, "DEBUG: monitoring bioreadr...\n");
 
@@ -546,22 +549,23 @@ fprintf(context->log, "DEBUG3: NAK: %d.\n", osdp_nak_response_data [0]);
     case OSDP_ACK:
       status = ST_OK;
 
-      /*
-        if we were in the middle of sending a CRAUTH send the next fragment
-      */
-      if (context->next_out < context->total_outbound_multipart)
-      {
-        status= oo_send_next_genauth_fragment(context);
-      };
-
       // for the moment receiving an ACK is considered processing.
       // really should be more fine-grained
 
       context->last_was_processed = 1;
 
+      /*
+        if we were in the middle of sending a GENAUTH or CRAUTH send the next fragment.
+        (after the line above, so it counts as awaiting a response.)
+      */
+      if (oo_mpart_sending(context))
+      {
+        status = oo_mpart_send_next(context);
+      };
+
       if (msg->security_block_type >= OSDP_SEC_SCS_11)
       {
-        if (context->verbosity > 9)
+        if (OO_LOG_ON (context, OO_LOG_PARSE, 10))
           fprintf(stderr, "Received SCS %02x on osdp_ACK\n", msg->security_block_type);
       };
       break;
@@ -610,23 +614,24 @@ fprintf(context->log, "DEBUG3: NAK: %d.\n", osdp_nak_response_data [0]);
       break;
 
     case OSDP_KEYPAD:
-      status = action_osdp_KEYPAD(context, msg);
+      // scheduled events (see oo-events.c) are only counted and timed
+      if (!oo_events_received(context, msg))
+        status = action_osdp_KEYPAD(context, msg);
       break;
 
     case OSDP_COM:
       status = ST_OK;
       osdp_test_set_status(OOC_SYMBOL_resp_com, OCONFORM_EXERCISED);
-      new_speed = *(1+msg->data_payload);
-      new_speed = (new_speed << 8) +*(2+msg->data_payload);
-      new_speed = (new_speed << 8) +*(3+msg->data_payload);
-      new_speed = (new_speed << 8) +*(4+msg->data_payload);
+      // address then the speed, 4 octets LSB first
+      new_speed = *(1+msg->data_payload) + (*(2+msg->data_payload) << 8) +
+        (*(3+msg->data_payload) << 16) + ((unsigned)*(4+msg->data_payload) << 24);
       switch(new_speed)
       {
       case 38400:
         osdp_test_set_status(OOC_SYMBOL_signalling_38400, OCONFORM_EXERCISED);
         break;
       };
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
       {
         fprintf (context->log, "osdp_COM: Addr %02x Baud (m->l) %02x %02x %02x %02x\n",
           *(0+msg->data_payload), *(1+msg->data_payload), *(2+msg->data_payload),
@@ -762,7 +767,8 @@ fprintf(context->log, "DEBUG3: NAK: %d.\n", osdp_nak_response_data [0]);
       break;
 
     case OSDP_RAW:
-      status = action_osdp_RAW (context, msg);
+      if (!oo_events_received(context, msg))
+        status = action_osdp_RAW (context, msg);
       break;
 
     case OSDP_RMAC_I:
@@ -798,7 +804,7 @@ fprintf(context->log, "DEBUG3: NAK: %d.\n", osdp_nak_response_data [0]);
       break;
 
     default:
-      if (context->verbosity > 2)
+      if (OO_LOG_ON (context, OO_LOG_PARSE, 3))
       {
         fprintf (stderr, "Response %02x Unknown to ACU\n", msg->msg_cmd);
       };
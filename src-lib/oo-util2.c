@@ -92,7 +92,7 @@ int
   {
     if (ctx->xferctx.total_length EQUALS 0)
     {
-      if (ctx->verbosity > 9)
+      if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
         fprintf(ctx->log,
 "background: tl %d. ns %d lsr %d lwp %d response timer %d\n", ctx->xferctx.total_length,
           ctx->next_sequence, ctx->last_sequence_received, ctx->last_was_processed,
@@ -107,7 +107,7 @@ int
 
   if ((ctx->role EQUALS OSDP_ROLE_ACU) && (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL))
   {
-    if (ctx->verbosity > 9)
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
       fprintf(stderr, "ACU and secure channel, background\n");
   };
   if (ctx->role EQUALS OSDP_ROLE_ACU)
@@ -121,9 +121,17 @@ int
     };
   };
 
+  // a fleet transfer polls each PD in turn (see oo_fleet_step)
+
+  if (oo_fleet_active ())
+  {
+    send_poll = 0;
+    send_secure_poll = 0;
+  };
+
   // if waiting for response to last cleartext message then do NOT poll
 
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
     fprintf(ctx->log, "wait: send_poll %d awaiting... %d\n",
       send_poll, osdp_awaiting_response(ctx));
   if (send_poll)
@@ -136,8 +144,12 @@ int
         ctx->timeout_retries --;
         if (ctx->timeout_retries EQUALS 0)
         {
-          if (ctx->verbosity > 3)
-            fprintf(ctx->log, "Timeout while polling, retries (%d) exceeded.)\n", OOSDP_TIMEOUT_RETRIES);
+          ctx->response_timeouts ++;
+          if (ctx->event_log != NULL)
+            (void) oo_eventlog (ctx, OO_EVLOG_TIMEOUT, "bb", OO_EVLOG_TIMEOUT_POLL, OOSDP_TIMEOUT_RETRIES);
+          else
+            if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
+              fprintf(ctx->log, "Timeout while polling, retries (%d) exceeded.)\n", OOSDP_TIMEOUT_RETRIES);
           send_poll = 1;
           if (ctx->post_command_action EQUALS OO_POSTCOMMAND_SINGLESTEP)
           {
@@ -159,17 +171,31 @@ int
       if (ctx->timeout_retries > 0)
       {
         send_secure_poll = 0;
-        fprintf(ctx->log, "Background: waiting for response (%d)\n", ctx->timeout_retries);
+        if (ctx->event_log != NULL)
+          (void) oo_eventlog (ctx, OO_EVLOG_TIMEOUT, "bb", OO_EVLOG_TIMEOUT_WAIT, ctx->timeout_retries);
+        else
+          fprintf(ctx->log, "Background: waiting for response (%d)\n", ctx->timeout_retries);
         ctx->timeout_retries --;
         if (ctx->timeout_retries EQUALS 0)
         {
-          fprintf(ctx->log, "Background: timed out waiting for response, polling.\n");
+          ctx->response_timeouts ++;
+          if (ctx->event_log != NULL)
+            (void) oo_eventlog (ctx, OO_EVLOG_TIMEOUT, "bb", OO_EVLOG_TIMEOUT_EXPIRED, 0);
+          else
+            fprintf(ctx->log, "Background: timed out waiting for response, polling.\n");
           send_secure_poll = 1;
         };
       };
     };
   };
 
+  // a file transfer in progress does its own resends and pacing
+
+  if (status EQUALS ST_OK)
+    status = oo_filetransfer_background (ctx);
+  if (status EQUALS ST_OK)
+    status = oo_fleet_background (ctx);
+
   // if polling is not enabled do not send one
   // (resume is used to start at a given command)
 
@@ -185,6 +211,7 @@ int
     current_length = 0;
     status = send_message_ex(ctx, OSDP_POLL, p_card.addr, &current_length,
       0, NULL, OSDP_SEC_SCS_17, 0, NULL);
+    oo_startup_report (ctx, "first poll sent");
   };
   if (send_secure_poll)
   {
@@ -237,32 +264,6 @@ int
 }
 
 
-unsigned char
-  checksum
-    (unsigned char
-      *msg,
-    int
-      length)
-{
-  unsigned char
-    checksum;
-  int
-    i;
-  int
-    whole_checksum;
-
-
-  whole_checksum = 0;
-  for (i=0; i<length; i++)
-  {
-    whole_checksum = whole_checksum + msg [i];
-    checksum = ~(0xff & whole_checksum)+1;
-  };
-  return (checksum);
-
-} /* checksum */
-
-
 int
   fasc_n_75_to_string
     (char * s, long int *sample_1)
@@ -367,7 +368,7 @@ int
   }
   else
   {
-    if (ctx->verbosity > 2)
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 3))
       fprintf (ctx->log, "Last in was NAK (E=%d) Seq now %d\n",
         ctx->last_nak_error, ctx->next_sequence);
   };
@@ -455,7 +456,7 @@ if (i != OSDP_TIMER_RESPONSE)
         };
       };
     }; // timer not stopped
-    if (ctx->verbosity > 9)
+    if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
     {
       if (i EQUALS OSDP_TIMER_RESPONSE)
       {
@@ -510,12 +511,13 @@ int
       sizeof(param), param, OSDP_SEC_SCS_17, 0, NULL);
   };
   sprintf (ctx->serial_speed, "%d", new_speed);
-  if (ctx->verbosity > 2)
+  if (OO_LOG_ON (ctx, OO_LOG_IO, 3))
     fprintf (stderr, "Diag - set com: addr to %02x speed to %s.\n",
       param [0], ctx->serial_speed);
   ctx->new_address = param [0];
   p_card.addr = ctx->new_address;
-  status = init_serial (ctx, p_card.filename);
+  if (ctx->transport_type EQUALS OSDP_TRANSPORT_SERIAL)
+    status = init_serial (ctx, p_card.filename);
   return (status);
 
 } /* send_comset */
@@ -548,7 +550,7 @@ int
   ctx->last_was_processed = 0;
   ctx->timeout_retries = OOSDP_TIMEOUT_RETRIES;
 
-  if (ctx->verbosity > 9)
+  if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
   {
     fprintf (ctx->log, "Top of send_message cmd=%02x:\n", command);
     fflush (ctx->log);
@@ -557,7 +559,7 @@ int
   true_dest = dest_addr;
   *current_length = 0;
 
-  if (ctx->verbosity > 3)
+  if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
   {
     if (command EQUALS OSDP_NAK)
     {
@@ -593,11 +595,11 @@ int
         &m, &returned_hdr);
       if (status_monitor != ST_OK)
       {
-        if (ctx->verbosity > 3)
+        if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
           fprintf(stderr, "DEBUG: ignoring osdp_parse_message status %d.\n", status);
         status_monitor = ST_OK;
       };
-      if (ctx->verbosity > 8)
+      if (OO_LOG_ON (ctx, OO_LOG_IO, 9))
       {
         if (status_monitor != ST_OK)
         {
@@ -627,6 +629,7 @@ int
 
       // and after we sent the whole PDU bump the counter
       ctx->pdus_sent++;
+      oo_latency_transmit_complete (ctx, command);
     };
   };
   if (status EQUALS ST_OK)
@@ -676,7 +679,7 @@ int
 
     // dump trace buffers so in's and out's land in correct order
 
-    if (context.verbosity > 3)
+    if (OO_LOG_ON (&context, OO_LOG_IO, 4))
       osdp_trace_dump(&context, 1);
     else
       osdp_trace_dump(&context, 0);
@@ -701,7 +704,7 @@ int
     {
       if (ctx->secure_channel_use [OO_SCU_ENAB] EQUALS OO_SCS_OPERATIONAL)
       {
-        if (ctx->verbosity > 3)
+        if (OO_LOG_ON (ctx, OO_LOG_IO, 4))
         {
           fprintf(ctx->log, "send: SC; dlth %d\n", data_length);
         };
@@ -729,7 +732,7 @@ int
 
     if (current_sec_block_type != OSDP_SEC_NOT_SCS)
     {
-      if (ctx->verbosity > 9)
+      if (OO_LOG_ON (ctx, OO_LOG_IO, 10))
       {
         fprintf(ctx->log, "send: SC-%x\n", current_sec_block_type);
       };
@@ -745,7 +748,7 @@ int
 
     // dump trace buffers after also so in's and out's land in correct order
 
-    if (context.verbosity > 3)
+    if (OO_LOG_ON (&context, OO_LOG_IO, 4))
       osdp_trace_dump(&context, 1);
     else
       osdp_trace_dump(&context, 0);
@@ -279,6 +279,10 @@ if (ctx->verbosity>3) fprintf(stderr, "cm was %d, incrementing\n", osdp_conforma
       OSDP_CHECK_CMDREP("osdp_CRAUTH", cmd_crauth, 1);
       break;
 
+    case OSDP_GENAUTH:
+      OSDP_CHECK_CMDREP("osdp_GENAUTH", cmd_genauth, 1);
+      break;
+
     case OSDP_FILETRANSFER:
       status = ST_OSDP_CMDREP_FOUND;
       m->data_payload = m->cmd_payload + 1;
@@ -742,12 +746,12 @@ int
 { /* monitor_osdp_message */
 
   int status;
-  char tlogmsg [30000];
+  static char tlogmsg [30000]; // static, not a 30K frame under everything this calls
   int unknown;
 
 
   status = ST_OK;
-  memset(tlogmsg, 0, sizeof(tlogmsg));
+  tlogmsg [0] = 0;
   unknown = -1;
 
   if (msg->direction EQUALS 0) // direction 0 is TO the PD
@@ -0,0 +1,1069 @@
+/*
+  osdp-bench - end-to-end ACU/PD throughput benchmark over a virtual bus
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  usage: osdp-bench [-x open-osdp] [-b osdp-vbus] [-B bus-options]
+           [-d run-directory] [-p pd-count] [-t seconds] [-n poll-nsec]
+           [-v verbosity] [-E] [-F frames] [-w workload] [-o results.json]
+
+  starts osdp-vbus, one ACU and pd-count PD instances of open-osdp in
+  subdirectories of the run directory, plays the workload file into their
+  command sockets, then collects osdp-status.json from each and CPU time
+  from /proc.  results are written as JSON to stdout and the results file.
+  bus-options (one string) are passed to osdp-vbus, e.g. -B "-s 115200 -e 1e-5"
+  to run over a paced line with bit errors; the line statistics are included
+  in the results.  -E turns on the binary event log (osdp-eventlog shows it.)
+  -F sets flight-recorder-frames for every instance (0 records nothing.)
+
+  workload lines are
+    <start-msec> <repeat> <interval-msec> <acu|pd-N> <command json>
+  and '#' starts a comment.
+*/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#include <jansson.h>
+
+
+#define EQUALS ==
+
+#define BENCH_ARGS_MAX        (32)
+#define BENCH_PD_MAX          (32)
+#define BENCH_WORKLOAD_MAX    (256)
+#define BENCH_LATENCY_MAX     (32)
+#define BENCH_BUCKETS_MAX     (192)
+#define BENCH_TRANSFER_OCTETS (32768)
+
+typedef struct bench_instance
+{
+  char name [32];
+  char directory [1024];
+  pid_t pid;
+  unsigned long cpu_user_start;
+  unsigned long cpu_system_start;
+  unsigned long cpu_user;
+  unsigned long cpu_system;
+  long rss_kb;
+  long pss_kb; // shared pages split between the processes sharing them
+  long private_kb; // dirty pages only this process has
+  long peak_rss_kb;
+  long pdus_sent_start;
+  long octets_sent_start;
+  long pdus_sent;
+  long octets_sent;
+  long crc_errs;
+  long checksum_errs;
+  long naks;
+  long seq_bad;
+  long response_timeouts;
+} BENCH_INSTANCE;
+
+typedef struct bench_bus
+{
+  long speed;
+  long collisions;
+  long bit_errors;
+  long octets_lost;
+  long noise_octets;
+  long queue_overflows;
+} BENCH_BUS;
+
+typedef struct bench_work
+{
+  int start_msec;
+  int repeat;
+  int interval_msec;
+  int sent;
+  char target [32];
+  char command [1024];
+} BENCH_WORK;
+
+typedef struct bench_histogram
+{
+  unsigned long long count;
+  unsigned long long max_usec;
+  int bucket_count;
+  unsigned long long floor_usec [BENCH_BUCKETS_MAX];
+  unsigned long long bucket [BENCH_BUCKETS_MAX];
+} BENCH_HISTOGRAM;
+
+typedef struct bench_latency
+{
+  char command [64];
+  BENCH_HISTOGRAM first_octet;
+  BENCH_HISTOGRAM complete_frame;
+} BENCH_LATENCY;
+
+BENCH_INSTANCE acu;
+BENCH_BUS bus;
+int event_log; // instances write osdp-events.bin instead of the frame lines in osdp.log
+int flight_frames; // flight-recorder-frames for the instances, -1 for their default
+int latency_count;
+BENCH_LATENCY latency [BENCH_LATENCY_MAX];
+int pd_count;
+BENCH_INSTANCE pds [BENCH_PD_MAX];
+BENCH_INSTANCE vbus;
+int work_count;
+BENCH_WORK work [BENCH_WORKLOAD_MAX];
+
+
+long
+  bench_msec_since
+    (struct timespec *start)
+
+{ /* bench_msec_since */
+
+  struct timespec now;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (((now.tv_sec - start->tv_sec) * 1000) + ((now.tv_nsec - start->tv_nsec) / 1000000));
+
+} /* bench_msec_since */
+
+
+void
+  bench_sleep_msec
+    (int msec)
+
+{ /* bench_sleep_msec */
+
+  struct timespec ts;
+
+
+  ts.tv_sec = msec / 1000;
+  ts.tv_nsec = (msec % 1000) * 1000000L;
+  (void) nanosleep (&ts, NULL);
+
+} /* bench_sleep_msec */
+
+
+/*
+  bench_cpu - user and system clock ticks consumed by a process
+*/
+
+void
+  bench_cpu
+    (pid_t pid,
+    unsigned long *user,
+    unsigned long *system)
+
+{ /* bench_cpu */
+
+  char buffer [2048];
+  char *p;
+  char path [1024];
+  FILE *sf;
+
+
+  *user = 0;
+  *system = 0;
+  sprintf (path, "/proc/%d/stat", (int)pid);
+  sf = fopen (path, "r");
+  if (sf != NULL)
+  {
+    if (fgets (buffer, sizeof (buffer), sf) != NULL)
+    {
+      // the command name may contain blanks so skip past its closing paren.
+      // utime and stime are the 12th and 13th fields after it.
+      p = strrchr (buffer, ')');
+      if (p != NULL)
+        sscanf (p+2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+          user, system);
+    };
+    fclose (sf);
+  };
+
+} /* bench_cpu */
+
+
+/*
+  bench_memory - resident, proportional and private memory of a process
+
+  rss counts all of libc in every instance.  pss and private are what one
+  more emulated PD actually costs.
+*/
+
+void
+  bench_memory
+    (BENCH_INSTANCE *inst)
+
+{ /* bench_memory */
+
+  char buffer [1024];
+  long kb;
+  char path [1024];
+  FILE *sf;
+
+
+  inst->rss_kb = 0;
+  inst->pss_kb = 0;
+  inst->private_kb = 0;
+  inst->peak_rss_kb = 0;
+  sprintf (path, "/proc/%d/smaps_rollup", (int)(inst->pid));
+  sf = fopen (path, "r");
+  if (sf != NULL)
+  {
+    while (fgets (buffer, sizeof (buffer), sf) != NULL)
+    {
+      if (sscanf (buffer, "Rss: %ld", &kb) EQUALS 1)
+        inst->rss_kb = kb;
+      if (sscanf (buffer, "Pss: %ld", &kb) EQUALS 1)
+        inst->pss_kb = kb;
+      if (sscanf (buffer, "Private_Clean: %ld", &kb) EQUALS 1)
+        inst->private_kb = inst->private_kb + kb;
+      if (sscanf (buffer, "Private_Dirty: %ld", &kb) EQUALS 1)
+        inst->private_kb = inst->private_kb + kb;
+    };
+    fclose (sf);
+  };
+  sprintf (path, "/proc/%d/status", (int)(inst->pid));
+  sf = fopen (path, "r");
+  if (sf != NULL)
+  {
+    while (fgets (buffer, sizeof (buffer), sf) != NULL)
+      if (sscanf (buffer, "VmHWM: %ld", &kb) EQUALS 1)
+        inst->peak_rss_kb = kb;
+    fclose (sf);
+  };
+
+} /* bench_memory */
+
+
+/*
+  bench_send - deliver a command to an instance's control socket
+*/
+
+int
+  bench_send
+    (BENCH_INSTANCE *inst,
+    char *command)
+
+{ /* bench_send */
+
+  struct sockaddr_un addr;
+  int fd;
+  char path [2048];
+  int status;
+
+
+  status = -1;
+  fd = -1;
+  sprintf (path, "%s/open-osdp-control", inst->directory);
+  if (strlen (path) < sizeof (addr.sun_path))
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd != -1)
+  {
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+    if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) EQUALS 0)
+    {
+      if (write (fd, command, strlen (command)) EQUALS strlen (command))
+        status = 0;
+    };
+    close (fd);
+  };
+  if (status != 0)
+    fprintf (stderr, "osdp-bench: could not send to %s: %s\n", inst->name, command);
+  return (status);
+
+} /* bench_send */
+
+
+pid_t
+  bench_spawn
+    (char *directory,
+    char *args [])
+
+{ /* bench_spawn */
+
+  int fd;
+  pid_t pid;
+
+
+  pid = fork ();
+  if (pid EQUALS 0)
+  {
+    if (chdir (directory) != 0)
+      exit (1);
+    fd = open ("bench-stdio.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1)
+    {
+      dup2 (fd, 1);
+      dup2 (fd, 2);
+      close (fd);
+    };
+    execv (args [0], args);
+    fprintf (stderr, "osdp-bench: cannot exec %s (%s)\n", args [0], strerror (errno));
+    exit (1);
+  };
+  return (pid);
+
+} /* bench_spawn */
+
+
+int
+  bench_setup_instance
+    (BENCH_INSTANCE *inst,
+    char *run_directory,
+    char *name,
+    char *role,
+    int address,
+    long poll_nsec,
+    int verbosity)
+
+{ /* bench_setup_instance */
+
+  char path [2048];
+  FILE *pf;
+  int status;
+
+
+  status = 0;
+  memset (inst, 0, sizeof (*inst));
+  strcpy (inst->name, name);
+  sprintf (inst->directory, "%s/%s", run_directory, name);
+  (void) mkdir (inst->directory, 0755);
+  sprintf (path, "%s/open-osdp-params.json", inst->directory);
+  pf = fopen (path, "w");
+  if (pf EQUALS NULL)
+    status = -1;
+  if (status EQUALS 0)
+  {
+    fprintf (pf, "{\n");
+    fprintf (pf, "  \"role\" : \"%s\",\n", role);
+    fprintf (pf, "  \"address\" : \"%d\",\n", address);
+    fprintf (pf, "  \"serial-device\" : \"../vbus-%s\",\n", name);
+    fprintf (pf, "  \"enable-secure-channel\" : \"DEFAULT\",\n");
+    if (poll_nsec > 0)
+      fprintf (pf, "  \"timeout-nsec\" : \"%ld\",\n", poll_nsec);
+    if (event_log)
+      fprintf (pf, "  \"event-log\" : \"osdp-events.bin\",\n");
+    if (flight_frames >= 0)
+      fprintf (pf, "  \"flight-recorder-frames\" : \"%d\",\n", flight_frames);
+    fprintf (pf, "  \"verbosity\" : \"%d\"\n", verbosity);
+    fprintf (pf, "}\n");
+    fclose (pf);
+  };
+  return (status);
+
+} /* bench_setup_instance */
+
+
+/*
+  bench_histogram_load - pick up one histogram from the latency status
+*/
+
+void
+  bench_histogram_load
+    (BENCH_HISTOGRAM *h,
+    json_t *value)
+
+{ /* bench_histogram_load */
+
+  json_t *buckets;
+  void *iter;
+  int i;
+  int j;
+  unsigned long long t;
+  json_t *v;
+
+
+  memset (h, 0, sizeof (*h));
+  if (json_is_object (value))
+  {
+    v = json_object_get (value, "count");
+    if (json_is_string (v))
+      sscanf (json_string_value (v), "%llu", &(h->count));
+    v = json_object_get (value, "max");
+    if (json_is_string (v))
+      sscanf (json_string_value (v), "%llu", &(h->max_usec));
+    buckets = json_object_get (value, "buckets");
+    if (json_is_object (buckets))
+    {
+      iter = json_object_iter (buckets);
+      while ((iter != NULL) && (h->bucket_count < BENCH_BUCKETS_MAX))
+      {
+        v = json_object_iter_value (iter);
+        i = h->bucket_count;
+        sscanf (json_object_iter_key (iter), "%llu", &(h->floor_usec [i]));
+        if (json_is_string (v))
+          sscanf (json_string_value (v), "%llu", &(h->bucket [i]));
+        h->bucket_count ++;
+        iter = json_object_iter_next (buckets, iter);
+      };
+    };
+
+    // keep the buckets in ascending order whatever order the object had
+    for (i=1; i<h->bucket_count; i++)
+      for (j=i; (j>0) && (h->floor_usec [j-1] > h->floor_usec [j]); j--)
+      {
+        t = h->floor_usec [j]; h->floor_usec [j] = h->floor_usec [j-1]; h->floor_usec [j-1] = t;
+        t = h->bucket [j]; h->bucket [j] = h->bucket [j-1]; h->bucket [j-1] = t;
+      };
+  };
+
+} /* bench_histogram_load */
+
+
+unsigned long long
+  bench_percentile
+    (BENCH_HISTOGRAM *h,
+    int percentile)
+
+{ /* bench_percentile */
+
+  int i;
+  unsigned long long running;
+  unsigned long long target;
+
+
+  if (h->count EQUALS 0)
+    return (0);
+  target = (h->count * percentile + 99) / 100;
+  running = 0;
+  for (i=0; i<h->bucket_count; i++)
+  {
+    running = running + h->bucket [i];
+    if (running >= target)
+      return (h->floor_usec [i]);
+  };
+  return (h->max_usec);
+
+} /* bench_percentile */
+
+
+long
+  bench_status_value
+    (json_t *root,
+    char *name)
+
+{ /* bench_status_value */
+
+  long v;
+  json_t *value;
+
+
+  v = 0;
+  value = json_object_get (root, name);
+  if (json_is_string (value))
+    sscanf (json_string_value (value), "%ld", &v);
+  return (v);
+
+} /* bench_status_value */
+
+
+/*
+  bench_load_status - read an instance's osdp-status.json
+
+  the counters are picked up every time; the latency histograms only if
+  load_latency is set (the ACU is the side that measures.)
+*/
+
+int
+  bench_load_status
+    (BENCH_INSTANCE *inst,
+    int load_latency)
+
+{ /* bench_load_status */
+
+  json_t *entry;
+  json_error_t error;
+  void *iter;
+  BENCH_LATENCY *l;
+  json_t *lat;
+  char path [2048];
+  json_t *root;
+  int status;
+  json_t *v;
+
+
+  status = 0;
+  sprintf (path, "%s/osdp-status.json", inst->directory);
+  root = json_load_file (path, 0, &error);
+  if (root EQUALS NULL)
+  {
+    fprintf (stderr, "osdp-bench: cannot read %s (%s)\n", path, error.text);
+    status = -1;
+  };
+  if (status EQUALS 0)
+  {
+    inst->pdus_sent = bench_status_value (root, "pdus-sent");
+    inst->octets_sent = bench_status_value (root, "octets-sent");
+    inst->crc_errs = bench_status_value (root, "crc_errs");
+    inst->checksum_errs = bench_status_value (root, "checksum_errs");
+    inst->naks = bench_status_value (root, "pd-naks");
+    inst->seq_bad = bench_status_value (root, "seq-bad");
+    inst->response_timeouts = bench_status_value (root, "response-timeouts");
+
+    lat = json_object_get (root, "latency");
+    if (load_latency && json_is_object (lat))
+    {
+      latency_count = 0;
+      iter = json_object_iter (lat);
+      while ((iter != NULL) && (latency_count < BENCH_LATENCY_MAX))
+      {
+        entry = json_object_iter_value (iter);
+        l = latency + latency_count;
+        memset (l, 0, sizeof (*l));
+        strcpy (l->command, json_object_iter_key (iter));
+        v = json_object_get (entry, "command");
+        if (json_is_string (v))
+          snprintf (l->command, sizeof (l->command), "%s", json_string_value (v));
+        bench_histogram_load (&(l->first_octet), json_object_get (entry, "first-octet"));
+        bench_histogram_load (&(l->complete_frame), json_object_get (entry, "complete-frame"));
+        latency_count ++;
+        iter = json_object_iter_next (lat, iter);
+      };
+    };
+    json_decref (root);
+  };
+  return (status);
+
+} /* bench_load_status */
+
+
+/*
+  bench_load_bus - pick up the line statistics osdp-vbus leaves behind
+*/
+
+void
+  bench_load_bus
+    (char *run_directory)
+
+{ /* bench_load_bus */
+
+  json_error_t error;
+  json_t *line;
+  char path [2048];
+  json_t *root;
+
+
+  memset (&bus, 0, sizeof (bus));
+  sprintf (path, "%s/vbus-stats.json", run_directory);
+  root = json_load_file (path, 0, &error);
+  if (root != NULL)
+  {
+    line = json_object_get (root, "line");
+    if (json_is_object (line))
+    {
+      bus.speed = bench_status_value (line, "speed");
+      bus.collisions = bench_status_value (line, "collisions");
+      bus.bit_errors = bench_status_value (line, "bit-errors");
+      bus.octets_lost = bench_status_value (line, "octets-lost");
+      bus.noise_octets = bench_status_value (line, "noise-octets");
+      bus.queue_overflows = bench_status_value (line, "queue-overflows");
+    };
+    json_decref (root);
+  };
+
+} /* bench_load_bus */
+
+
+int
+  bench_load_workload
+    (char *path)
+
+{ /* bench_load_workload */
+
+  char line [2048];
+  int offset;
+  char *p;
+  int status;
+  FILE *wf;
+  BENCH_WORK *w;
+
+
+  status = 0;
+  work_count = 0;
+  wf = fopen (path, "r");
+  if (wf EQUALS NULL)
+  {
+    fprintf (stderr, "osdp-bench: cannot open workload %s\n", path);
+    status = -1;
+  };
+  while ((status EQUALS 0) && (fgets (line, sizeof (line), wf) != NULL))
+  {
+    p = strchr (line, '\n');
+    if (p != NULL)
+      *p = 0;
+    w = work + work_count;
+    memset (w, 0, sizeof (*w));
+    offset = 0;
+    if ((line [0] != '#') && (work_count < BENCH_WORKLOAD_MAX))
+    {
+      if (4 EQUALS sscanf (line, "%d %d %d %31s %n", &(w->start_msec), &(w->repeat),
+        &(w->interval_msec), w->target, &offset))
+      {
+        snprintf (w->command, sizeof (w->command), "%s", line+offset);
+        work_count ++;
+      };
+    };
+  };
+  if (wf != NULL)
+    fclose (wf);
+  return (status);
+
+} /* bench_load_workload */
+
+
+BENCH_INSTANCE *
+  bench_target
+    (char *name)
+
+{ /* bench_target */
+
+  int i;
+
+
+  if (0 EQUALS strcmp (name, "acu"))
+    return (&acu);
+  for (i=0; i<pd_count; i++)
+    if (0 EQUALS strcmp (name, pds [i].name))
+      return (pds+i);
+  return (NULL);
+
+} /* bench_target */
+
+
+void
+  bench_write_cpu
+    (FILE *rf,
+    BENCH_INSTANCE *inst,
+    double seconds,
+    long ticks,
+    int last)
+
+{ /* bench_write_cpu */
+
+  double sys;
+  double user;
+
+
+  user = (double)(inst->cpu_user - inst->cpu_user_start) / ticks;
+  sys = (double)(inst->cpu_system - inst->cpu_system_start) / ticks;
+  fprintf (rf,
+"    \"%s\" : { \"user-sec\" : %.2f, \"system-sec\" : %.2f, \"percent\" : %.1f }%s\n",
+    inst->name, user, sys, 100.0 * (user + sys) / seconds, last ? "" : ",");
+
+} /* bench_write_cpu */
+
+
+void
+  bench_write_memory
+    (FILE *rf,
+    BENCH_INSTANCE *inst,
+    int last)
+
+{ /* bench_write_memory */
+
+  fprintf (rf,
+"    \"%s\" : { \"rss-kb\" : %ld, \"pss-kb\" : %ld, \"private-kb\" : %ld, \"peak-rss-kb\" : %ld }%s\n",
+    inst->name, inst->rss_kb, inst->pss_kb, inst->private_kb, inst->peak_rss_kb, last ? "" : ",");
+
+} /* bench_write_memory */
+
+
+void
+  bench_write_histogram
+    (FILE *rf,
+    char *name,
+    BENCH_HISTOGRAM *h,
+    int last)
+
+{ /* bench_write_histogram */
+
+  fprintf (rf,
+"      \"%s\" : { \"count\" : %llu, \"p50-usec\" : %llu, \"p90-usec\" : %llu, \"p99-usec\" : %llu, \"max-usec\" : %llu }%s\n",
+    name, h->count, bench_percentile (h, 50), bench_percentile (h, 90),
+    bench_percentile (h, 99), h->max_usec, last ? "" : ",");
+
+} /* bench_write_histogram */
+
+
+void
+  bench_write_results
+    (FILE *rf,
+    double seconds,
+    int verbosity)
+
+{ /* bench_write_results */
+
+  long crc_errs;
+  long frames_acu;
+  long frames_pd;
+  int i;
+  long naks;
+  long octets;
+  long pd_private;
+  long pd_pss;
+  long pd_rss;
+  long seq_bad;
+  long ticks;
+
+
+  ticks = sysconf (_SC_CLK_TCK);
+  frames_acu = acu.pdus_sent - acu.pdus_sent_start;
+  octets = acu.octets_sent - acu.octets_sent_start;
+  crc_errs = acu.crc_errs + acu.checksum_errs;
+  naks = acu.naks;
+  seq_bad = acu.seq_bad;
+  frames_pd = 0;
+  for (i=0; i<pd_count; i++)
+  {
+    frames_pd = frames_pd + pds [i].pdus_sent - pds [i].pdus_sent_start;
+    octets = octets + pds [i].octets_sent - pds [i].octets_sent_start;
+    crc_errs = crc_errs + pds [i].crc_errs + pds [i].checksum_errs;
+    naks = naks + pds [i].naks;
+    seq_bad = seq_bad + pds [i].seq_bad;
+  };
+
+  fprintf (rf, "{\n");
+  fprintf (rf, "  \"osdp-bench\" : 1,\n");
+  fprintf (rf, "  \"seconds\" : %.3f,\n", seconds);
+  fprintf (rf, "  \"pd-count\" : %d,\n", pd_count);
+  fprintf (rf, "  \"verbosity\" : %d,\n", verbosity);
+  fprintf (rf, "  \"frames\" : { \"acu-sent\" : %ld, \"pd-sent\" : %ld, \"total\" : %ld },\n",
+    frames_acu, frames_pd, frames_acu + frames_pd);
+  fprintf (rf, "  \"frames-per-sec\" : %.1f,\n", (frames_acu + frames_pd) / seconds);
+  fprintf (rf, "  \"octets-per-sec\" : %.1f,\n", octets / seconds);
+  fprintf (rf, "  \"errors\" : { \"crc\" : %ld, \"nak\" : %ld, \"sequence\" : %ld, \"response-timeout\" : %ld },\n",
+    crc_errs, naks, seq_bad, acu.response_timeouts);
+  fprintf (rf,
+"  \"bus\" : { \"speed\" : %ld, \"collisions\" : %ld, \"bit-errors\" : %ld, \"octets-lost\" : %ld, \"noise-octets\" : %ld, \"queue-overflows\" : %ld },\n",
+    bus.speed, bus.collisions, bus.bit_errors, bus.octets_lost, bus.noise_octets, bus.queue_overflows);
+  fprintf (rf, "  \"cpu\" : {\n");
+  bench_write_cpu (rf, &acu, seconds, ticks, 0);
+  for (i=0; i<pd_count; i++)
+    bench_write_cpu (rf, pds+i, seconds, ticks, 0);
+  bench_write_cpu (rf, &vbus, seconds, ticks, 1);
+  fprintf (rf, "  },\n");
+
+  // memory per instance as the run ended, and the average over the PD's
+
+  fprintf (rf, "  \"memory\" : {\n");
+  bench_write_memory (rf, &acu, 0);
+  pd_pss = 0;
+  pd_private = 0;
+  pd_rss = 0;
+  for (i=0; i<pd_count; i++)
+  {
+    bench_write_memory (rf, pds+i, 0);
+    pd_pss = pd_pss + pds [i].pss_kb;
+    pd_private = pd_private + pds [i].private_kb;
+    pd_rss = pd_rss + pds [i].rss_kb;
+  };
+  if (pd_count > 0)
+    fprintf (rf,
+"    \"pd-average\" : { \"rss-kb\" : %ld, \"pss-kb\" : %ld, \"private-kb\" : %ld }\n",
+      pd_rss / pd_count, pd_pss / pd_count, pd_private / pd_count);
+  else
+    fprintf (rf, "    \"pd-average\" : { }\n");
+  fprintf (rf, "  },\n");
+
+  // latency covers the whole run, warm-up included
+
+  fprintf (rf, "  \"latency\" : {\n");
+  for (i=0; i<latency_count; i++)
+  {
+    fprintf (rf, "    \"%s\" : {\n", latency [i].command);
+    bench_write_histogram (rf, "first-octet", &(latency [i].first_octet), 0);
+    bench_write_histogram (rf, "complete-frame", &(latency [i].complete_frame), 1);
+    fprintf (rf, "    }%s\n", (i < latency_count-1) ? "," : "");
+  };
+  fprintf (rf, "  }\n");
+  fprintf (rf, "}\n");
+
+} /* bench_write_results */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for osdp-bench */
+
+  int bus_argc;
+  char *bus_args [BENCH_ARGS_MAX];
+  char *bus_options;
+  char *bus_program;
+  int duration;
+  int i;
+  char link_path [2048];
+  long now;
+  int opt;
+  char *osdp_args [3];
+  char *osdp_program;
+  char pd_name [32];
+  char pd_count_string [32];
+  long poll_nsec;
+  FILE *rf;
+  char *results_path;
+  char *run_directory;
+  double seconds;
+  struct timespec start;
+  struct stat st;
+  int status;
+  BENCH_INSTANCE *target;
+  int verbosity;
+  BENCH_WORK *w;
+  char *workload_path;
+
+
+  status = 0;
+  osdp_program = "../../src-485/open-osdp";
+  bus_program = "./osdp-vbus";
+  bus_options = NULL;
+  run_directory = "bench-run";
+  results_path = "bench-results.json";
+  workload_path = "bench-workload";
+  pd_count = 1;
+  duration = 10;
+  poll_nsec = 0;
+  verbosity = 3;
+  flight_frames = -1;
+  while ((opt = getopt (argc, argv, "B:b:d:EF:n:o:p:t:v:w:x:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'B': bus_options = optarg; break;
+    case 'b': bus_program = optarg; break;
+    case 'd': run_directory = optarg; break;
+    case 'E': event_log = 1; break;
+    case 'F': sscanf (optarg, "%d", &flight_frames); break;
+    case 'n': sscanf (optarg, "%ld", &poll_nsec); break;
+    case 'o': results_path = optarg; break;
+    case 'p': sscanf (optarg, "%d", &pd_count); break;
+    case 't': sscanf (optarg, "%d", &duration); break;
+    case 'v': sscanf (optarg, "%d", &verbosity); break;
+    case 'w': workload_path = optarg; break;
+    case 'x': osdp_program = optarg; break;
+    default:
+      fprintf (stderr,
+"usage: osdp-bench [-x open-osdp] [-b osdp-vbus] [-B bus-options] [-d run-directory]\n"
+"         [-p pd-count] [-t seconds] [-n poll-nsec] [-v verbosity] [-E] [-F frames]\n"
+"         [-w workload] [-o results.json]\n");
+      return (1);
+    };
+  };
+  if ((pd_count < 1) || (pd_count > BENCH_PD_MAX))
+  {
+    fprintf (stderr, "osdp-bench: pd-count must be 1 to %d\n", BENCH_PD_MAX);
+    status = -1;
+  };
+  signal (SIGPIPE, SIG_IGN);
+
+  // programs are started from inside the run directory, so use absolute paths
+
+  if (status EQUALS 0)
+  {
+    osdp_program = realpath (osdp_program, NULL);
+    bus_program = realpath (bus_program, NULL);
+    if ((osdp_program EQUALS NULL) || (bus_program EQUALS NULL))
+    {
+      fprintf (stderr, "osdp-bench: open-osdp or osdp-vbus not found\n");
+      status = -1;
+    };
+  };
+  if (status EQUALS 0)
+    status = bench_load_workload (workload_path);
+  if (status EQUALS 0)
+  {
+    (void) mkdir (run_directory, 0755);
+    run_directory = realpath (run_directory, NULL);
+    if (run_directory EQUALS NULL)
+      status = -1;
+  };
+
+  // lay out the run directory: one subdirectory per instance
+
+  if (status EQUALS 0)
+    status = bench_setup_instance (&acu, run_directory, "acu", "ACU", 0, poll_nsec, verbosity);
+  for (i=0; (status EQUALS 0) && (i<pd_count); i++)
+  {
+    sprintf (pd_name, "pd-%d", i);
+    status = bench_setup_instance (pds+i, run_directory, pd_name, "PD", i, 0, verbosity);
+  };
+  if (status EQUALS 0)
+  {
+    char transfer_path [2048];
+    FILE *tf;
+
+    sprintf (transfer_path, "%s/bench-transfer.dat", acu.directory);
+    tf = fopen (transfer_path, "w");
+    if (tf != NULL)
+    {
+      for (i=0; i<BENCH_TRANSFER_OCTETS; i++)
+        fputc (i & 0xff, tf);
+      fclose (tf);
+    };
+  };
+
+  // bus first, then the PD's, then the ACU
+
+  if (status EQUALS 0)
+  {
+    strcpy (vbus.name, "vbus");
+    strcpy (vbus.directory, run_directory);
+    sprintf (pd_count_string, "%d", pd_count);
+    sprintf (link_path, "%s/vbus-acu", run_directory);
+    (void) unlink (link_path);
+    bus_argc = 0;
+    bus_args [bus_argc++] = bus_program;
+    if (bus_options != NULL)
+    {
+      char *token;
+
+      token = strtok (bus_options, " ");
+      while ((token != NULL) && (bus_argc < BENCH_ARGS_MAX-3))
+      {
+        bus_args [bus_argc++] = token;
+        token = strtok (NULL, " ");
+      };
+    };
+    bus_args [bus_argc++] = run_directory;
+    bus_args [bus_argc++] = pd_count_string;
+    bus_args [bus_argc] = NULL;
+    vbus.pid = bench_spawn (run_directory, bus_args);
+    for (i=0; (i<50) && (lstat (link_path, &st) != 0); i++)
+      bench_sleep_msec (100);
+    if (lstat (link_path, &st) != 0)
+    {
+      fprintf (stderr, "osdp-bench: virtual bus did not start\n");
+      kill (vbus.pid, SIGTERM);
+      status = -1;
+    };
+  };
+  if (status EQUALS 0)
+  {
+    osdp_args [0] = osdp_program;
+    osdp_args [1] = "open-osdp-params.json";
+    osdp_args [2] = NULL;
+    for (i=0; i<pd_count; i++)
+      pds [i].pid = bench_spawn (pds [i].directory, osdp_args);
+    bench_sleep_msec (500);
+    acu.pid = bench_spawn (acu.directory, osdp_args);
+
+    // warm up, then take the starting counters
+
+    bench_sleep_msec (1500);
+    (void) bench_send (&acu, "{ \"command\" : \"dump-status\" }");
+    for (i=0; i<pd_count; i++)
+      (void) bench_send (pds+i, "{ \"command\" : \"dump-status\" }");
+    bench_sleep_msec (200);
+    (void) bench_load_status (&acu, 0);
+    acu.pdus_sent_start = acu.pdus_sent;
+    acu.octets_sent_start = acu.octets_sent;
+    for (i=0; i<pd_count; i++)
+    {
+      (void) bench_load_status (pds+i, 0);
+      pds [i].pdus_sent_start = pds [i].pdus_sent;
+      pds [i].octets_sent_start = pds [i].octets_sent;
+    };
+    bench_cpu (acu.pid, &(acu.cpu_user_start), &(acu.cpu_system_start));
+    for (i=0; i<pd_count; i++)
+      bench_cpu (pds [i].pid, &(pds [i].cpu_user_start), &(pds [i].cpu_system_start));
+    bench_cpu (vbus.pid, &(vbus.cpu_user_start), &(vbus.cpu_system_start));
+    clock_gettime (CLOCK_MONOTONIC, &start);
+
+    // play the workload
+
+    now = 0;
+    while (now < duration * 1000L)
+    {
+      for (i=0; i<work_count; i++)
+      {
+        w = work + i;
+        if ((w->sent < w->repeat) &&
+          (now >= w->start_msec + ((long)(w->sent) * w->interval_msec)))
+        {
+          target = bench_target (w->target);
+          if (target != NULL)
+            (void) bench_send (target, w->command);
+          w->sent ++;
+        };
+      };
+      bench_sleep_msec (5);
+      now = bench_msec_since (&start);
+    };
+
+    // collect
+
+    bench_cpu (acu.pid, &(acu.cpu_user), &(acu.cpu_system));
+    for (i=0; i<pd_count; i++)
+      bench_cpu (pds [i].pid, &(pds [i].cpu_user), &(pds [i].cpu_system));
+    bench_cpu (vbus.pid, &(vbus.cpu_user), &(vbus.cpu_system));
+    bench_memory (&acu);
+    for (i=0; i<pd_count; i++)
+      bench_memory (pds+i);
+    seconds = bench_msec_since (&start) / 1000.0;
+    (void) bench_send (&acu, "{ \"command\" : \"dump-status\" }");
+    for (i=0; i<pd_count; i++)
+      (void) bench_send (pds+i, "{ \"command\" : \"dump-status\" }");
+    bench_sleep_msec (200);
+    status = bench_load_status (&acu, 1);
+    for (i=0; i<pd_count; i++)
+      (void) bench_load_status (pds+i, 0);
+
+    // shut down
+
+    (void) bench_send (&acu, "{ \"command\" : \"stop\" }");
+    for (i=0; i<pd_count; i++)
+      (void) bench_send (pds+i, "{ \"command\" : \"stop\" }");
+    bench_sleep_msec (200);
+    kill (acu.pid, SIGTERM);
+    for (i=0; i<pd_count; i++)
+      kill (pds [i].pid, SIGTERM);
+    kill (vbus.pid, SIGTERM);
+    while (wait (NULL) > 0)
+      ;
+    bench_load_bus (run_directory);
+
+    if (status EQUALS 0)
+    {
+      bench_write_results (stdout, seconds, verbosity);
+      rf = fopen (results_path, "w");
+      if (rf != NULL)
+      {
+        bench_write_results (rf, seconds, verbosity);
+        fclose (rf);
+      };
+    };
+  };
+  return ((status EQUALS 0) ? 0 : 1);
+
+} /* main for osdp-bench */
@@ -0,0 +1,603 @@
+/*
+  osdp-vbus - virtual OSDP bus over pseudo-terminals
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  usage: osdp-vbus [-s speed] [-e bit-error-rate] [-l loss-rate]
+           [-n noise-rate] [-m noise-max] [-p propagation-usec]
+           [-t turnaround-usec] [-r seed] [directory [pd-count]]
+
+  creates one pseudo-terminal for the ACU and one per PD and links the
+  slave side of each into the directory as vbus-acu, vbus-pd-0, vbus-pd-1...
+  point "serial-device" in each open-osdp instance at one of those.
+  every octet written by one endpoint is delivered to all the others,
+  as it would be on a multi-drop RS-485 bus.
+
+  with no options octets are passed along as fast as the PTY's go.  with
+  a speed each octet occupies the line for 10 bit times, so the bus is
+  half duplex: an endpoint that starts talking while another one's octets
+  are still on the line collides with it and both sides get garbage.
+  on top of that:
+    -e  probability each bit is flipped
+    -l  probability each octet is lost
+    -n  probability a frame (an octet stream starting with SOM after the
+        sender was idle) is preceded by 1 to noise-max noise octets
+    -p  delay from the end of an octet on the line to its delivery
+    -t  extra delay before a different endpoint than the last one can
+        start transmitting (driver turnaround)
+
+  runs until SIGTERM/SIGINT, then writes vbus-stats.json in the directory.
+*/
+
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define EQUALS ==
+
+#define C_SOM (0x53)
+
+#define OSDP_VBUS_ENDPOINTS_MAX (33)
+#define OSDP_VBUS_QUEUE_MAX     (16384)
+#define OSDP_VBUS_SPEED_MAX     (4000000)
+
+typedef struct osdp_vbus_octet
+{
+  long long deliver_at; // nanoseconds, CLOCK_MONOTONIC
+  unsigned char octet;
+} OSDP_VBUS_OCTET;
+
+typedef struct osdp_vbus_endpoint
+{
+  int master;
+  int slave; // held open so the master never sees a hangup
+  char link_path [1024];
+  char slave_path [1024];
+  long long line_free_at; // when this endpoint's last octet leaves the line
+  int head;
+  int count;
+  OSDP_VBUS_OCTET queue [OSDP_VBUS_QUEUE_MAX];
+  unsigned long octets_in;
+  unsigned long octets_out;
+  unsigned long octets_dropped;
+} OSDP_VBUS_ENDPOINT;
+
+typedef struct osdp_vbus_line
+{
+  int speed;
+  long long octet_nsec;
+  double bit_error_rate;
+  double loss_rate;
+  double noise_rate;
+  int noise_max;
+  long long propagation_nsec;
+  long long turnaround_nsec;
+  int last_talker;
+  unsigned long collisions;
+  unsigned long bit_errors;
+  unsigned long octets_lost;
+  unsigned long noise_octets;
+  unsigned long queue_overflows;
+} OSDP_VBUS_LINE;
+
+int endpoint_count;
+OSDP_VBUS_ENDPOINT endpoints [OSDP_VBUS_ENDPOINTS_MAX];
+OSDP_VBUS_LINE line;
+volatile sig_atomic_t vbus_done;
+
+
+long long
+  vbus_now
+    (void)
+
+{ /* vbus_now */
+
+  struct timespec ts;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((long long)ts.tv_sec * 1000000000LL) + ts.tv_nsec);
+
+} /* vbus_now */
+
+
+void
+  vbus_stop
+    (int sig)
+
+{ /* vbus_stop */
+
+  vbus_done = 1;
+
+} /* vbus_stop */
+
+
+/*
+  vbus_open_endpoint - allocate a pty, put the slave in raw mode, link it
+*/
+
+int
+  vbus_open_endpoint
+    (OSDP_VBUS_ENDPOINT *ep,
+    char *directory,
+    char *name)
+
+{ /* vbus_open_endpoint */
+
+  int status;
+  struct termios tio;
+
+
+  status = 0;
+  memset (ep, 0, sizeof (*ep));
+  ep->master = posix_openpt (O_RDWR | O_NOCTTY);
+  if (ep->master EQUALS -1)
+    status = -1;
+  if (status EQUALS 0)
+  {
+    if ((grantpt (ep->master) != 0) || (unlockpt (ep->master) != 0))
+      status = -1;
+  };
+  if (status EQUALS 0)
+  {
+    strcpy (ep->slave_path, ptsname (ep->master));
+    ep->slave = open (ep->slave_path, O_RDWR | O_NOCTTY);
+    if (ep->slave EQUALS -1)
+      status = -1;
+  };
+  if (status EQUALS 0)
+  {
+    // raw from the start so nothing is echoed back onto the bus
+    tcgetattr (ep->slave, &tio);
+    cfmakeraw (&tio);
+    tcsetattr (ep->slave, TCSANOW, &tio);
+    fcntl (ep->master, F_SETFL, fcntl (ep->master, F_GETFL, 0) | O_NONBLOCK);
+
+    sprintf (ep->link_path, "%s/%s", directory, name);
+    (void) unlink (ep->link_path);
+    if (symlink (ep->slave_path, ep->link_path) != 0)
+      status = -1;
+  };
+  if (status != 0)
+    fprintf (stderr, "osdp-vbus: cannot set up %s (%s)\n", name, strerror (errno));
+  return (status);
+
+} /* vbus_open_endpoint */
+
+
+/*
+  vbus_impair - apply bit errors to an octet on its way down the line
+*/
+
+unsigned char
+  vbus_impair
+    (unsigned char octet)
+
+{ /* vbus_impair */
+
+  int bit;
+
+
+  if (line.bit_error_rate > 0.0)
+  {
+    for (bit=0; bit<8; bit++)
+    {
+      if (drand48 () < line.bit_error_rate)
+      {
+        octet = octet ^ (1 << bit);
+        line.bit_errors ++;
+      };
+    };
+  };
+  return (octet);
+
+} /* vbus_impair */
+
+
+/*
+  vbus_collide - garble whatever other endpoints still have on the line
+  after time t.  returns the number of their octets that were hit.
+*/
+
+int
+  vbus_collide
+    (int talker,
+    long long t)
+
+{ /* vbus_collide */
+
+  OSDP_VBUS_ENDPOINT *ep;
+  int hit;
+  int i;
+  int j;
+  OSDP_VBUS_OCTET *q;
+
+
+  hit = 0;
+  for (i=0; i<endpoint_count; i++)
+  {
+    ep = endpoints + i;
+    if ((i != talker) && (ep->line_free_at > t))
+    {
+      for (j=0; j<ep->count; j++)
+      {
+        q = ep->queue + ((ep->head + j) % OSDP_VBUS_QUEUE_MAX);
+        if (q->deliver_at - line.propagation_nsec > t)
+        {
+          q->octet = (unsigned char)(lrand48 () & 0xff);
+          hit ++;
+        };
+      };
+    };
+  };
+  return (hit);
+
+} /* vbus_collide */
+
+
+/*
+  vbus_transmit - put octets an endpoint wrote onto the line
+
+  each octet is scheduled for delivery at the time it would finish
+  crossing the line, plus propagation delay.
+*/
+
+void
+  vbus_transmit
+    (int talker,
+    unsigned char *octets,
+    int length)
+
+{ /* vbus_transmit */
+
+  int collided;
+  OSDP_VBUS_ENDPOINT *ep;
+  int i;
+  unsigned char noise [16];
+  int noise_count;
+  long long now;
+  OSDP_VBUS_OCTET *q;
+  unsigned char *source;
+  long long t;
+  int total;
+
+
+  ep = endpoints + talker;
+  ep->octets_in = ep->octets_in + length;
+  now = vbus_now ();
+  t = now;
+  if (ep->line_free_at > t)
+    t = ep->line_free_at;
+  noise_count = 0;
+
+  // a new transmission: driver turnaround, maybe some noise ahead of the SOM
+
+  if (ep->line_free_at <= now)
+  {
+    if ((line.last_talker != -1) && (line.last_talker != talker))
+      t = t + line.turnaround_nsec;
+    line.last_talker = talker;
+    if ((octets [0] EQUALS C_SOM) && (line.noise_rate > 0.0) && (drand48 () < line.noise_rate))
+    {
+      noise_count = 1 + (int)(lrand48 () % line.noise_max);
+      for (i=0; i<noise_count; i++)
+      {
+        do
+        {
+          noise [i] = (unsigned char)(lrand48 () & 0xff);
+        } while (noise [i] EQUALS C_SOM);
+      };
+      line.noise_octets = line.noise_octets + noise_count;
+    };
+  };
+
+  total = noise_count + length;
+  for (i=0; i<total; i++)
+  {
+    source = (i < noise_count) ? (noise + i) : (octets + i - noise_count);
+
+    // someone else still on the line: both of us turn to garbage
+    collided = 0;
+    if (line.octet_nsec > 0)
+      collided = vbus_collide (talker, t);
+    if (collided)
+      line.collisions ++;
+    t = t + line.octet_nsec;
+    ep->line_free_at = t;
+
+    if ((line.loss_rate > 0.0) && (drand48 () < line.loss_rate))
+    {
+      line.octets_lost ++;
+    }
+    else
+    {
+      if (ep->count >= OSDP_VBUS_QUEUE_MAX)
+      {
+        line.queue_overflows ++;
+      }
+      else
+      {
+        q = ep->queue + ((ep->head + ep->count) % OSDP_VBUS_QUEUE_MAX);
+        q->deliver_at = t + line.propagation_nsec;
+        if (collided)
+          q->octet = (unsigned char)(lrand48 () & 0xff);
+        else
+          q->octet = vbus_impair (*source);
+        ep->count ++;
+      };
+    };
+  };
+
+} /* vbus_transmit */
+
+
+/*
+  vbus_deliver - hand every octet that is due to all the other endpoints
+
+  a PTY that is full (the instance behind it is not reading) loses the
+  octets, as a receiver that is not listening would.  returns the time
+  the next octet is due, or 0 if nothing is queued.
+*/
+
+long long
+  vbus_deliver
+    (void)
+
+{ /* vbus_deliver */
+
+  unsigned char buffer [OSDP_VBUS_QUEUE_MAX];
+  OSDP_VBUS_ENDPOINT *ep;
+  int from;
+  int i;
+  int length;
+  long long next;
+  long long now;
+  OSDP_VBUS_OCTET *q;
+  int status_io;
+
+
+  next = 0;
+  now = vbus_now ();
+  for (from=0; from<endpoint_count; from++)
+  {
+    ep = endpoints + from;
+    length = 0;
+    while (ep->count > 0)
+    {
+      q = ep->queue + ep->head;
+      if (q->deliver_at > now)
+      {
+        if ((next EQUALS 0) || (q->deliver_at < next))
+          next = q->deliver_at;
+        break;
+      };
+      buffer [length] = q->octet;
+      length ++;
+      ep->head = (ep->head + 1) % OSDP_VBUS_QUEUE_MAX;
+      ep->count --;
+    };
+    if (length > 0)
+    {
+      for (i=0; i<endpoint_count; i++)
+      {
+        if (i != from)
+        {
+          status_io = write (endpoints [i].master, buffer, length);
+          if (status_io < 0)
+            status_io = 0;
+          endpoints [i].octets_out = endpoints [i].octets_out + status_io;
+          endpoints [i].octets_dropped = endpoints [i].octets_dropped + (length - status_io);
+        };
+      };
+    };
+  };
+  return (next);
+
+} /* vbus_deliver */
+
+
+void
+  vbus_write_stats
+    (char *directory)
+
+{ /* vbus_write_stats */
+
+  int i;
+  char path [2048];
+  FILE *sf;
+
+
+  sprintf (path, "%s/vbus-stats.json", directory);
+  sf = fopen (path, "w");
+  if (sf != NULL)
+  {
+    fprintf (sf, "{\n");
+    fprintf (sf,
+"  \"line\" : { \"speed\" : \"%d\", \"bit-error-rate\" : \"%g\", \"loss-rate\" : \"%g\", \"noise-rate\" : \"%g\",\n",
+      line.speed, line.bit_error_rate, line.loss_rate, line.noise_rate);
+    fprintf (sf,
+"    \"propagation-usec\" : \"%lld\", \"turnaround-usec\" : \"%lld\",\n",
+      line.propagation_nsec / 1000, line.turnaround_nsec / 1000);
+    fprintf (sf,
+"    \"collisions\" : \"%lu\", \"bit-errors\" : \"%lu\", \"octets-lost\" : \"%lu\", \"noise-octets\" : \"%lu\", \"queue-overflows\" : \"%lu\" },\n",
+      line.collisions, line.bit_errors, line.octets_lost, line.noise_octets, line.queue_overflows);
+    for (i=0; i<endpoint_count; i++)
+    {
+      fprintf (sf,
+"  \"%s\" : { \"octets-in\" : \"%lu\", \"octets-out\" : \"%lu\", \"octets-dropped\" : \"%lu\" },\n",
+        strrchr (endpoints [i].link_path, '/') + 1,
+        endpoints [i].octets_in, endpoints [i].octets_out, endpoints [i].octets_dropped);
+    };
+    fprintf (sf, "  \"_#\" : \"_end\"\n}\n");
+    fclose (sf);
+  };
+
+} /* vbus_write_stats */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for osdp-vbus */
+
+  unsigned char buffer [1024];
+  char *directory;
+  int i;
+  int maxfd;
+  char name [1024];
+  long long next;
+  int opt;
+  int pd_count;
+  fd_set readfds;
+  long seed;
+  int status;
+  int status_io;
+  int status_select;
+  struct timeval timeout;
+  long long usec;
+
+
+  status = 0;
+  directory = ".";
+  pd_count = 1;
+  seed = 1;
+  memset (&line, 0, sizeof (line));
+  line.last_talker = -1;
+  line.noise_max = 4;
+  while ((opt = getopt (argc, argv, "e:l:m:n:p:r:s:t:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'e': sscanf (optarg, "%lf", &(line.bit_error_rate)); break;
+    case 'l': sscanf (optarg, "%lf", &(line.loss_rate)); break;
+    case 'm': sscanf (optarg, "%d", &(line.noise_max)); break;
+    case 'n': sscanf (optarg, "%lf", &(line.noise_rate)); break;
+    case 'p': usec = 0; sscanf (optarg, "%lld", &usec); line.propagation_nsec = usec * 1000; break;
+    case 'r': sscanf (optarg, "%ld", &seed); break;
+    case 's': sscanf (optarg, "%d", &(line.speed)); break;
+    case 't': usec = 0; sscanf (optarg, "%lld", &usec); line.turnaround_nsec = usec * 1000; break;
+    default:
+      fprintf (stderr,
+"usage: osdp-vbus [-s speed] [-e bit-error-rate] [-l loss-rate] [-n noise-rate]\n"
+"         [-m noise-max] [-p propagation-usec] [-t turnaround-usec] [-r seed]\n"
+"         [directory [pd-count]]\n");
+      return (1);
+    };
+  };
+  if (optind < argc)
+    directory = argv [optind];
+  if (optind+1 < argc)
+    sscanf (argv [optind+1], "%d", &pd_count);
+  if ((pd_count < 1) || (pd_count > OSDP_VBUS_ENDPOINTS_MAX-1))
+  {
+    fprintf (stderr, "osdp-vbus: pd-count must be 1 to %d\n", OSDP_VBUS_ENDPOINTS_MAX-1);
+    status = -1;
+  };
+  if ((line.speed < 0) || (line.speed > OSDP_VBUS_SPEED_MAX))
+  {
+    fprintf (stderr, "osdp-vbus: speed must be 0 (unpaced) to %d\n", OSDP_VBUS_SPEED_MAX);
+    status = -1;
+  };
+  if ((line.noise_max < 1) || (line.noise_max > 16))
+    line.noise_max = 4;
+
+  // an octet on the wire is a start bit, 8 data bits and a stop bit
+  if (line.speed > 0)
+    line.octet_nsec = 10000000000LL / line.speed;
+  srand48 (seed);
+  signal (SIGTERM, vbus_stop);
+  signal (SIGINT, vbus_stop);
+  signal (SIGPIPE, SIG_IGN);
+
+  // PD links first, vbus-acu last, so callers can wait on vbus-acu
+
+  endpoint_count = 1 + pd_count;
+  for (i=1; (status EQUALS 0) && (i<endpoint_count); i++)
+  {
+    sprintf (name, "vbus-pd-%d", i-1);
+    status = vbus_open_endpoint (endpoints+i, directory, name);
+  };
+  if (status EQUALS 0)
+    status = vbus_open_endpoint (endpoints+0, directory, "vbus-acu");
+
+  next = 0;
+  while ((status EQUALS 0) && (!vbus_done))
+  {
+    FD_ZERO (&readfds);
+    maxfd = 0;
+    for (i=0; i<endpoint_count; i++)
+    {
+      FD_SET (endpoints [i].master, &readfds);
+      if (endpoints [i].master > maxfd)
+        maxfd = endpoints [i].master;
+    };
+
+    // sleep until there is input or the next queued octet is due
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    if (next > 0)
+    {
+      usec = (next - vbus_now ()) / 1000;
+      if (usec < 0)
+        usec = 0;
+      if (usec < 1000000)
+      {
+        timeout.tv_sec = 0;
+        timeout.tv_usec = usec;
+      };
+    };
+    status_select = select (maxfd+1, &readfds, NULL, NULL, &timeout);
+    if (status_select > 0)
+    {
+      for (i=0; i<endpoint_count; i++)
+      {
+        if (FD_ISSET (endpoints [i].master, &readfds))
+        {
+          status_io = read (endpoints [i].master, buffer, sizeof (buffer));
+          if (status_io > 0)
+            vbus_transmit (i, buffer, status_io);
+        };
+      };
+    };
+    next = vbus_deliver ();
+  };
+
+  if (status EQUALS 0)
+  {
+    vbus_write_stats (directory);
+    for (i=0; i<endpoint_count; i++)
+      (void) unlink (endpoints [i].link_path);
+  };
+  return (status);
+
+} /* main for osdp-vbus */
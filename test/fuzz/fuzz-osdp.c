@@ -0,0 +1,745 @@
+/*
+  fuzz-osdp - feed arbitrary octets through the framer, the parser and the action routines
+
+  Usage:
+    fuzz-osdp [-j results.json] [-n repeat] [-m mutations] [-r seed] [-v verbosity] [-l log-levels] input ...
+    fuzz-osdp -S corpus-directory capture.osdpcap ...
+    fuzz-osdp <input
+
+  (C)Copyright 2017-2024 Smithee Solutions LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Support provided by the Security Industry Association
+  http://www.securityindustry.org
+*/
+
+/*
+  an input is one setup octet and then whatever arrives on the line:
+    setup 0x01 - be the ACU (replies are parsed and acted on), else the PD
+    setup 0x02 - checksum instead of CRC
+    setup 0x04 - secure channel is up, so secure blocks go to the handlers
+    setup 0x08 - put the right CRC or checksum on each frame first, so a
+                 mutation gets past the check and into the handlers
+  the line octets go into osdp_buf one at a time, with the same resync on
+  SOM that open-osdp does, and process_osdp_input runs after each, so
+  frames are found, parsed and dispatched exactly as they are off a port.
+  nothing is transmitted (send_osdp_data is a stub) and no shell is
+  started (system is a stub).  the context is put back before each input.
+
+  LLVMFuzzerTestOneInput is the libFuzzer entry point (build with
+  -DOO_FUZZ_LIBFUZZER, libFuzzer supplies main).  otherwise main runs each
+  input file (or every file in an input directory), -n times each, and
+  reports executions per second; -m adds that many random mutations of
+  the inputs.  with no arguments one input is read from stdin, which is
+  how afl-fuzz runs it.  -S makes a seed corpus from osdpcap captures:
+  one input per frame, commands for the PD and replies for the ACU, plus
+  one per capture and direction with all of them in order.  -v and -l set
+  the verbosity and log levels (everything is logged to /dev/null, so what
+  is measured is the formatting); make log-bench compares them per frame.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+#include <open-osdp.h>
+#include <osdp_conformance.h>
+#include <osdpcap.h>
+
+
+#define OO_FUZZ_SETUP_ACU      (0x01)
+#define OO_FUZZ_SETUP_CHECKSUM (0x02)
+#define OO_FUZZ_SETUP_SECURE   (0x04)
+#define OO_FUZZ_SETUP_FIX      (0x08)
+
+#define OO_FUZZ_INPUT_MAX      (64*1024)
+#define OO_FUZZ_INPUTS_MAX     (4096)
+
+
+typedef struct oo_fuzz_input
+{
+  char *path;
+  unsigned char *octets;
+  int length;
+} OO_FUZZ_INPUT;
+
+typedef struct oo_fuzz_stats
+{
+  unsigned long long execs;
+  unsigned long long octets;
+  unsigned long long frames; // parsed and dispatched
+} OO_FUZZ_STATS;
+
+
+int check_for_command;
+OSDP_CONTEXT context;
+struct timespec last_time_check_ex;
+OSDP_BUFFER osdp_buf;
+OSDP_INTEROP_ASSESSMENT osdp_conformance;
+OSDP_OUT_CMD current_output_command [16];
+OSDP_PARAMETERS p_card;
+char tag [16];
+char trace_in_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+char trace_out_buffer [4*OSDP_OFFICIAL_MSG_MAX];
+unsigned char last_message_sent [2048];
+int last_message_sent_length;
+unsigned char creds_buffer_a [64*1024];
+int creds_buffer_a_lth;
+int creds_buffer_a_next;
+int creds_buffer_a_remaining;
+
+extern OSDP_COMMAND_QUEUE osdp_command_queue [];
+extern unsigned char last_command_received;
+extern int leftover_length;
+
+OO_FUZZ_STATS fuzz_stats;
+static char *fuzz_log_levels = "";
+static int fuzz_verbosity = 0;
+static OSDP_CONTEXT saved_context [2]; // PD, ACU
+static OSDP_PARAMETERS saved_p_card;
+static char last_input_path [1024];
+
+
+// nothing goes out
+
+int
+  send_osdp_data
+    (OSDP_CONTEXT *ctx,
+    unsigned char *buf,
+    int lth)
+
+{ /* send_osdp_data */
+
+  return (ST_OK);
+
+} /* send_osdp_data */
+
+
+// the action callouts and the NAK hook go through system(); don't start shells
+
+int
+  system
+    (const char *command)
+
+{ /* system */
+
+  return (0);
+
+} /* system */
+
+
+/*
+  fuzz_setup - both roles set up the way initialize_osdp would, minus the port and the files
+
+  runs in a scratch directory (the same one each time, afl-fuzz starts it
+  for every input) so what the handlers write (incoming_data, saved
+  parameters) stays there.  the service root has no results directory
+  so the per-test results files aren't written on every input.
+*/
+
+void
+  fuzz_setup
+    (void)
+
+{ /* fuzz_setup */
+
+  FILE *log;
+  char scratch [1024];
+  int role;
+
+
+  sprintf (scratch, "/tmp/fuzz-osdp-%d", (int)getuid ());
+  (void) mkdir (scratch, 0755);
+  if (chdir (scratch) != 0)
+  {
+    fprintf (stderr, "fuzz-osdp: cannot make a scratch directory (%s)\n", strerror (errno));
+    exit (1);
+  };
+  log = fopen ("/dev/null", "w");
+  for (role=0; role<2; role++)
+  {
+    memset (&context, 0, sizeof (context));
+    context.log = log;
+    context.verbosity = fuzz_verbosity;
+    strncpy (context.log_levels, fuzz_log_levels, sizeof (context.log_levels)-1);
+    (void) oo_log_levels (&context);
+    strcpy (context.service_root, scratch);
+    context.q = osdp_command_queue;
+    context.enable_poll = OO_POLL_ENABLED;
+    context.metrics_fd = -1;
+    context.monitor_fd = -1;
+    context.current_key_slot = -1;
+    memcpy (context.current_default_scbk, OSDP_SCBK_DEFAULT, sizeof (context.current_default_scbk));
+    context.model = 3;
+    context.vendor_code [0] = 0x0A;
+    context.vendor_code [1] = 0x00;
+    context.vendor_code [2] = 0x17;
+    context.configured_led = 1;
+    context.configured_sounder = 1;
+    context.configured_text = 1;
+    context.capability_version = -1;
+    context.configured_scbk_d = 1;
+    memcpy (context.rnd_a, "12345678", 8);
+    memcpy (context.rnd_b, "abcdefgh", 8);
+    context.xferctx.state = OSDP_XFER_STATE_IDLE;
+    context.configured_inputs = OOSDP_DEFAULT_INPUTS;
+    context.configured_outputs = OOSDP_DEFAULT_OUTPUTS;
+    context.last_sequence_received = -1;
+    context.max_message = 128;
+    context.role = OSDP_ROLE_PD;
+    if (role EQUALS 1)
+      context.role = OSDP_ROLE_ACU;
+    saved_context [role] = context;
+  };
+  memset (&p_card, 0, sizeof (p_card));
+  p_card.value [1] = 0x80;
+  p_card.value [3] = 0x80;
+  p_card.value_len = 4;
+  p_card.bits = 26;
+  saved_p_card = p_card;
+  osdp_conformance.last_unknown_command = OSDP_POLL;
+
+} /* fuzz_setup */
+
+
+/*
+  fuzz_fix_checks - recalculate the check on each frame that fits in the input
+*/
+
+void
+  fuzz_fix_checks
+    (unsigned char *octets,
+    int length)
+
+{ /* fuzz_fix_checks */
+
+  unsigned short int crc;
+  int frame_length;
+  int i;
+
+
+  i = 0;
+  while (i+5 <= length)
+  {
+    frame_length = octets [i+2] + (octets [i+3] << 8);
+    if ((octets [i] != C_SOM) || (frame_length < 7) || (i+frame_length > length))
+    {
+      i ++;
+      continue;
+    };
+    if (octets [i+4] & 0x04)
+    {
+      crc = fCrcBlk (octets+i, frame_length-2);
+      octets [i+frame_length-2] = 0xff & crc;
+      octets [i+frame_length-1] = 0xff & (crc >> 8);
+    }
+    else
+      octets [i+frame_length-1] = checksum (octets+i, frame_length-1);
+    i = i + frame_length;
+  };
+
+} /* fuzz_fix_checks */
+
+
+/*
+  fuzz_one - one input, from a fresh context
+*/
+
+int
+  fuzz_one
+    (const unsigned char *data,
+    size_t size)
+
+{ /* fuzz_one */
+
+  static unsigned char fixed [OO_FUZZ_INPUT_MAX];
+  size_t i;
+  static int ready;
+  int role;
+  int status;
+
+
+  if (!ready)
+  {
+    fuzz_setup ();
+    ready = 1;
+  };
+  if (size < 1)
+    return (0);
+
+  // put back what the last input changed
+
+  if (context.xferctx.receive_open)
+    close (context.xferctx.receive_fd);
+  if (context.xferctx.receive_stream != NULL)
+    pclose (context.xferctx.receive_stream);
+  role = (data [0] & OO_FUZZ_SETUP_ACU) ? 1 : 0;
+  context = saved_context [role];
+  p_card = saved_p_card;
+  memset (&osdp_buf, 0, sizeof (osdp_buf));
+  memset (osdp_command_queue, 0, sizeof (osdp_command_queue[0]) * OSDP_COMMAND_QUEUE_SIZE);
+  last_command_received = 0;
+  leftover_length = 0;
+  m_check = OSDP_CRC;
+  if (data [0] & OO_FUZZ_SETUP_CHECKSUM)
+    m_check = OSDP_CHECKSUM;
+  if (data [0] & OO_FUZZ_SETUP_SECURE)
+  {
+    context.enable_secure_channel = 1;
+    context.secure_channel_use [OO_SCU_ENAB] = OO_SCS_OPERATIONAL;
+  };
+  if ((data [0] & OO_FUZZ_SETUP_FIX) && (size <= sizeof (fixed)))
+  {
+    memcpy (fixed, data, size);
+    fuzz_fix_checks (fixed+1, size-1);
+    data = fixed;
+  };
+
+  // octet at a time, resync on SOM, as open-osdp reads the port
+
+  for (i=1; i<size; i++)
+  {
+    if (osdp_buf.next < sizeof (osdp_buf.buf))
+    {
+      osdp_buf.buf [osdp_buf.next] = data [i];
+      osdp_buf.next ++;
+      if (osdp_buf.buf [0] != C_SOM)
+        osdp_buf.next = 0;
+    }
+    else
+      osdp_buf.next = 0;
+    status = process_osdp_input (&osdp_buf);
+    if (status EQUALS ST_OK)
+      fuzz_stats.frames ++;
+  };
+  fuzz_stats.execs ++;
+  fuzz_stats.octets = fuzz_stats.octets + size - 1;
+  return (0);
+
+} /* fuzz_one */
+
+
+int
+  LLVMFuzzerTestOneInput
+    (const unsigned char *data,
+    size_t size)
+
+{ /* LLVMFuzzerTestOneInput */
+
+  return (fuzz_one (data, size));
+
+} /* LLVMFuzzerTestOneInput */
+
+
+#ifndef OO_FUZZ_LIBFUZZER
+
+int
+  fuzz_read_file
+    (char *path,
+    OO_FUZZ_INPUT *input)
+
+{ /* fuzz_read_file */
+
+  FILE *f;
+  int status;
+
+
+  status = -1;
+  input->octets = malloc (OO_FUZZ_INPUT_MAX);
+  f = fopen (path, "r");
+  if ((f != NULL) && (input->octets != NULL))
+  {
+    input->length = fread (input->octets, 1, OO_FUZZ_INPUT_MAX, f);
+    input->path = strdup (path);
+    status = 0;
+  };
+  if (f != NULL)
+    fclose (f);
+  return (status);
+
+} /* fuzz_read_file */
+
+
+/*
+  fuzz_load - a file, or every file in a directory
+*/
+
+int
+  fuzz_load
+    (char *path,
+    OO_FUZZ_INPUT *inputs,
+    int *count)
+
+{ /* fuzz_load */
+
+  DIR *d;
+  struct dirent *entry;
+  char file_path [2048];
+  struct stat st;
+  int status;
+
+
+  status = 0;
+  if (stat (path, &st) != 0)
+  {
+    fprintf (stderr, "fuzz-osdp: cannot open %s\n", path);
+    return (-1);
+  };
+  if (!S_ISDIR (st.st_mode))
+  {
+    if ((*count < OO_FUZZ_INPUTS_MAX) && (fuzz_read_file (path, inputs + *count) EQUALS 0))
+      (*count) ++;
+    return (0);
+  };
+  d = opendir (path);
+  while ((d != NULL) && ((entry = readdir (d)) != NULL) && (*count < OO_FUZZ_INPUTS_MAX))
+  {
+    if (entry->d_name [0] EQUALS '.')
+      continue;
+    snprintf (file_path, sizeof (file_path), "%s/%s", path, entry->d_name);
+    if ((stat (file_path, &st) EQUALS 0) && S_ISREG (st.st_mode))
+      if (fuzz_read_file (file_path, inputs + *count) EQUALS 0)
+        (*count) ++;
+  };
+  if (d != NULL)
+    closedir (d);
+  return (status);
+
+} /* fuzz_load */
+
+
+void
+  fuzz_write_seed
+    (char *path,
+    unsigned char setup,
+    unsigned char *octets,
+    int length)
+
+{ /* fuzz_write_seed */
+
+  FILE *f;
+
+
+  f = fopen (path, "w");
+  if (f != NULL)
+  {
+    fputc (setup, f);
+    fwrite (octets, 1, length, f);
+    fclose (f);
+  };
+
+} /* fuzz_write_seed */
+
+
+/*
+  fuzz_seed - a seed corpus from captures
+
+  commands (address without the reply bit) are PD inputs, replies are ACU inputs.
+*/
+
+int
+  fuzz_seed
+    (char *corpus,
+    char *capture)
+
+{ /* fuzz_seed */
+
+  char *base;
+  FILE *cf;
+  int count;
+  char *line;
+  size_t line_size;
+  char path [2048];
+  static OSDPCAP_RECORD record;
+  int som;
+  static unsigned char stream [2][OO_FUZZ_INPUT_MAX];
+  int stream_length [2];
+  int which;
+
+
+  cf = fopen (capture, "r");
+  if (cf EQUALS NULL)
+  {
+    fprintf (stderr, "fuzz-osdp: cannot open %s\n", capture);
+    return (-1);
+  };
+  base = strrchr (capture, '/');
+  base = (base EQUALS NULL) ? capture : base+1;
+  (void) mkdir (corpus, 0755);
+  count = 0;
+  stream_length [0] = 0;
+  stream_length [1] = 0;
+  line = NULL;
+  line_size = 0;
+  while (getline (&line, &line_size, cf) > 0)
+  {
+    if (oo_osdpcap_parse (line, &record) != ST_OK)
+      continue;
+
+    // the address follows the SOM, which may have a mark octet or two in front of it
+
+    som = 0;
+    while ((som < record.length-1) && (record.octets [som] != C_SOM))
+      som ++;
+    if (som >= record.length-1)
+      continue;
+    which = (record.octets [som+1] & 0x80) ? 1 : 0;
+    snprintf (path, sizeof (path), "%s/%s-%04d", corpus, base, count);
+    fuzz_write_seed (path, OO_FUZZ_SETUP_FIX | (which ? OO_FUZZ_SETUP_ACU : 0), record.octets, record.length);
+    count ++;
+    if (stream_length [which] + record.length <= OO_FUZZ_INPUT_MAX-1)
+    {
+      memcpy (stream [which] + stream_length [which], record.octets, record.length);
+      stream_length [which] = stream_length [which] + record.length;
+    };
+  };
+  free (line);
+  fclose (cf);
+  snprintf (path, sizeof (path), "%s/%s-pd-stream", corpus, base);
+  fuzz_write_seed (path, OO_FUZZ_SETUP_FIX, stream [0], stream_length [0]);
+  snprintf (path, sizeof (path), "%s/%s-acu-stream", corpus, base);
+  fuzz_write_seed (path, OO_FUZZ_SETUP_FIX | OO_FUZZ_SETUP_ACU, stream [1], stream_length [1]);
+  fprintf (stderr, "fuzz-osdp: %d. frames from %s\n", count, capture);
+  return (0);
+
+} /* fuzz_seed */
+
+
+/*
+  fuzz_mutate - a few random changes, weighted towards the length and control fields
+
+  the setup octet can change too, so the role, check and secure channel vary.
+*/
+
+int
+  fuzz_mutate
+    (unsigned char *octets,
+    int length,
+    unsigned short seed [3])
+
+{ /* fuzz_mutate */
+
+  int changes;
+  int i;
+  int offset;
+
+
+  changes = 1 + nrand48 (seed) % 4;
+  for (i=0; i<changes; i++)
+  {
+    offset = (length > 0) ? nrand48 (seed) % length : 0;
+    switch (nrand48 (seed) % 6)
+    {
+    case 0: // flip a bit
+      if (offset < length)
+        octets [offset] ^= 1 << (nrand48 (seed) % 8);
+      break;
+    case 1: // any octet
+      if (offset < length)
+        octets [offset] = nrand48 (seed);
+      break;
+    case 2: // frame length (LEN is 2 and 3 after the setup octet)
+      if (length > 4)
+        octets [3 + (nrand48 (seed) % 2)] = nrand48 (seed);
+      break;
+    case 3: // control, which carries the SCB and CRC bits
+      if (length > 5)
+        octets [5] = nrand48 (seed);
+      break;
+    case 4: // drop an octet
+      if (offset < length)
+      {
+        memmove (octets+offset, octets+offset+1, length-offset-1);
+        length --;
+      };
+      break;
+    case 5: // repeat a run
+      if ((offset < length) && (length < OO_FUZZ_INPUT_MAX/2))
+      {
+        int run;
+
+        run = 1 + nrand48 (seed) % (length-offset);
+        memmove (octets+offset+run, octets+offset, length-offset);
+        length = length + run;
+      };
+      break;
+    };
+  };
+  return (length);
+
+} /* fuzz_mutate */
+
+
+/*
+  fuzz_save_last - the input about to run, so a crash leaves it behind
+*/
+
+void
+  fuzz_save_last
+    (unsigned char *octets,
+    int length)
+
+{ /* fuzz_save_last */
+
+  int fd;
+
+
+  fd = open (last_input_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd != -1)
+  {
+    if (write (fd, octets, length) != length)
+      fprintf (stderr, "fuzz-osdp: short write to %s\n", last_input_path);
+    close (fd);
+  };
+
+} /* fuzz_save_last */
+
+
+int
+  main
+    (int argc,
+    char *argv [])
+
+{ /* main for fuzz-osdp */
+
+  char *corpus;
+  int count;
+  double elapsed;
+  double frame_nsec;
+  int i;
+  static OO_FUZZ_INPUT inputs [OO_FUZZ_INPUTS_MAX];
+  char *json_path;
+  FILE *jf;
+  long long mutations;
+  long long n;
+  int option;
+  int repeat;
+  unsigned short seed [3];
+  struct timespec start;
+  int status;
+  struct timespec stop;
+  static unsigned char work [OO_FUZZ_INPUT_MAX];
+  int work_length;
+
+
+  status = ST_OK;
+  corpus = NULL;
+  json_path = NULL;
+  mutations = 0;
+  repeat = 1;
+  seed [0] = 0x4f53;
+  seed [1] = 0x4450;
+  seed [2] = 1;
+  while ((option = getopt (argc, argv, "S:j:l:m:n:r:v:")) != -1)
+  {
+    switch (option)
+    {
+    case 'S': corpus = optarg; break;
+    case 'j': json_path = optarg; break;
+    case 'l': fuzz_log_levels = optarg; break;
+    case 'm': mutations = atoll (optarg); break;
+    case 'n': repeat = atoi (optarg); break;
+    case 'r': seed [2] = atoi (optarg); break;
+    case 'v': fuzz_verbosity = atoi (optarg); break;
+    default:
+      status = -1;
+      break;
+    };
+  };
+  if ((status != ST_OK) || ((corpus != NULL) && (optind >= argc)))
+  {
+    fprintf (stderr,
+"Usage: fuzz-osdp [-j results.json] [-n repeat] [-m mutations] [-r seed] [-v verbosity] [-l log-levels] input ...\n"
+"       fuzz-osdp -S corpus-directory capture.osdpcap ...\n"
+"       fuzz-osdp <input\n");
+    return (1);
+  };
+  if (corpus != NULL)
+  {
+    for (i=optind; (status EQUALS ST_OK) && (i<argc); i++)
+      status = fuzz_seed (corpus, argv [i]);
+    return ((status EQUALS ST_OK) ? 0 : 1);
+  };
+
+  // one input on stdin, for afl-fuzz
+
+  if (optind >= argc)
+  {
+    work_length = fread (work, 1, sizeof (work), stdin);
+    return (fuzz_one (work, work_length));
+  };
+
+  count = 0;
+  for (i=optind; (status EQUALS ST_OK) && (i<argc); i++)
+    status = fuzz_load (argv [i], inputs, &count);
+  if ((status != ST_OK) || (count EQUALS 0))
+  {
+    fprintf (stderr, "fuzz-osdp: no inputs\n");
+    return (1);
+  };
+
+  // the inputs run in the scratch directory, so open the results file first
+  jf = NULL;
+  if (json_path != NULL)
+    jf = fopen (json_path, "w");
+  if (getcwd (last_input_path, sizeof (last_input_path) - 32) EQUALS NULL)
+    strcpy (last_input_path, ".");
+  strcat (last_input_path, "/fuzz-last-input");
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (n=0; n<repeat; n++)
+    for (i=0; i<count; i++)
+      (void) fuzz_one (inputs [i].octets, inputs [i].length);
+  for (n=0; n<mutations; n++)
+  {
+    i = nrand48 (seed) % count;
+    memcpy (work, inputs [i].octets, inputs [i].length);
+    work_length = fuzz_mutate (work, inputs [i].length, seed);
+    fuzz_save_last (work, work_length);
+    (void) fuzz_one (work, work_length);
+  };
+  clock_gettime (CLOCK_MONOTONIC, &stop);
+  elapsed = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  if (mutations > 0)
+    (void) unlink (last_input_path);
+
+  frame_nsec = 0;
+  if (fuzz_stats.frames > 0)
+    frame_nsec = elapsed * 1e9 / fuzz_stats.frames;
+  fprintf (stderr, "fuzz-osdp: %d. inputs, %llu. execs, %llu. octets, %llu. frames dispatched, %.3f sec, %.0f execs/sec, %.0f nsec/frame at verbosity %d\n",
+    count, fuzz_stats.execs, fuzz_stats.octets, fuzz_stats.frames, elapsed,
+    (elapsed > 0) ? fuzz_stats.execs / elapsed : 0, frame_nsec, fuzz_verbosity);
+  if (jf != NULL)
+  {
+    fprintf (jf, "{\n  \"inputs\" : \"%d\", \"execs\" : \"%llu\", \"octets\" : \"%llu\", \"frames\" : \"%llu\",\n",
+      count, fuzz_stats.execs, fuzz_stats.octets, fuzz_stats.frames);
+    fprintf (jf, "  \"verbosity\" : \"%d\", \"log-levels\" : \"%s\", \"nsec-per-frame\" : \"%.0f\",\n",
+      fuzz_verbosity, fuzz_log_levels, frame_nsec);
+    fprintf (jf, "  \"elapsed-seconds\" : \"%.6f\", \"execs-per-second\" : \"%.0f\", \"octets-per-second\" : \"%.0f\"\n}\n",
+      elapsed, (elapsed > 0) ? fuzz_stats.execs / elapsed : 0, (elapsed > 0) ? fuzz_stats.octets / elapsed : 0);
+    fclose (jf);
+  };
+  return (0);
+
+} /* main for fuzz-osdp */
+
+#endif